@@ -0,0 +1,35 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "envoy/common/pure.h"
+
+namespace Envoy {
+namespace Config {
+
+/**
+ * A dedicated thread for the CPU heavy part of processing config updates (decoding and validating
+ * xDS responses) so that large pushes do not stall the main thread. Objects built on the worker
+ * are handed back to the main thread, which is the only thread that commits config.
+ */
+class ConfigWorker {
+public:
+  virtual ~ConfigWorker() {}
+
+  /**
+   * Run work on the config thread and then run commit on the main thread. Work items run one at a
+   * time in the order they were posted, and commits run on the main thread in the same order.
+   * After the worker has been shut down both callbacks run inline.
+   * @param work supplies the callback to run on the config thread. It must not touch any state
+   *             owned by the main thread.
+   * @param commit supplies the callback to run on the main thread once work has completed. The
+   *               caller is responsible for making sure any object it references is still alive.
+   */
+  virtual void post(std::function<void()> work, std::function<void()> commit) PURE;
+};
+
+typedef std::unique_ptr<ConfigWorker> ConfigWorkerPtr;
+
+} // namespace Config
+} // namespace Envoy
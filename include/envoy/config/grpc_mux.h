@@ -1,5 +1,8 @@
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include "envoy/common/exception.h"
 #include "envoy/common/pure.h"
 
@@ -23,6 +26,21 @@ public:
   virtual void onConfigUpdate(const Protobuf::RepeatedPtrField<ProtobufWkt::Any>& resources,
                               const std::string& version_info) PURE;
 
+  /**
+   * Called instead of onConfigUpdate() when the mux has already unpacked the resources, e.g. on a
+   * config worker. By default the unpacked resources are dropped and onConfigUpdate() is called.
+   * @param resources vector of fetched resources corresponding to the configuration update.
+   * @param unpacked supplies the same resources, in the same order, unpacked into messages of the
+   *        type named by the type URL. Ownership is passed to the callee.
+   * @param version_info update version.
+   * @throw EnvoyException same as onConfigUpdate().
+   */
+  virtual void onUnpackedConfigUpdate(const Protobuf::RepeatedPtrField<ProtobufWkt::Any>& resources,
+                                      std::vector<ProtobufTypes::MessagePtr>&&,
+                                      const std::string& version_info) {
+    onConfigUpdate(resources, version_info);
+  }
+
   /**
    * Called when either the subscription is unable to fetch a config update or when onConfigUpdate
    * invokes an exception.
@@ -105,6 +105,12 @@ public:
    *                      should be done by resetting the stream.
    */
   virtual Cancellable* newStream(Http::StreamDecoder& response_decoder, Callbacks& callbacks) PURE;
+
+  /**
+   * Open connections ahead of demand, e.g. to warm a newly added host before traffic shifts to it.
+   * How many connections are opened (if any) is up to the pool implementation.
+   */
+  virtual void prefetch() PURE;
 };
 
 typedef std::unique_ptr<Instance> InstancePtr;
@@ -1,10 +1,12 @@
 #pragma once
 
+#include <chrono>
 #include <functional>
 #include <list>
 #include <memory>
 #include <string>
 
+#include "envoy/common/optional.h"
 #include "envoy/common/pure.h"
 #include "envoy/network/address.h"
 
@@ -50,6 +52,32 @@ public:
    */
   virtual ActiveDnsQuery* resolve(const std::string& dns_name, DnsLookupFamily dns_lookup_family,
                                   ResolveCb callback) PURE;
+
+  /**
+   * Called when a resolution attempt is complete.
+   * @param address_list supplies the list of resolved IP addresses. The list will be empty if
+   *                     the resolution failed.
+   * @param ttl supplies the smallest TTL of the DNS records the addresses came from. It is not
+   *            valid if the resolution failed or did not involve DNS records, e.g. for IP
+   *            literals or names in the hosts file.
+   */
+  typedef std::function<void(std::list<Address::InstanceConstSharedPtr>&& address_list,
+                             const Optional<std::chrono::seconds>& ttl)>
+      ResolveWithTtlCb;
+
+  /**
+   * Initiate an async DNS resolution that also reports the TTL of the result. Same as resolve()
+   * otherwise. Resolvers that cannot report TTLs need not override this; by default it goes
+   * through resolve() and reports no TTL.
+   */
+  virtual ActiveDnsQuery* resolveWithTtl(const std::string& dns_name,
+                                         DnsLookupFamily dns_lookup_family,
+                                         ResolveWithTtlCb callback) {
+    return resolve(dns_name, dns_lookup_family,
+                   [callback](std::list<Address::InstanceConstSharedPtr>&& address_list) -> void {
+                     callback(std::move(address_list), {});
+                   });
+  }
 };
 
 typedef std::shared_ptr<DnsResolver> DnsResolverSharedPtr;
@@ -3,6 +3,7 @@
 #include <chrono>
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "envoy/common/pure.h"
 #include "envoy/network/address.h"
@@ -54,6 +55,18 @@ public:
    */
   virtual uint32_t concurrency() PURE;
 
+  /**
+   * @return the number of dedicated threads to shard active health checking across. If 0, all
+   *         active health checking runs on the main thread.
+   */
+  virtual uint32_t healthCheckConcurrency() PURE;
+
+  /**
+   * @return whether ADS responses are decoded on a dedicated config thread rather than the main
+   *         thread.
+   */
+  virtual bool configWorker() PURE;
+
   /**
    * @return the number of seconds that envoy will perform draining during a hot restart.
    */
@@ -131,6 +144,24 @@ public:
    * router/cluster/listener.
    */
   virtual uint64_t maxObjNameLength() PURE;
+
+  /**
+   * @return uint64_t the number of bytes of shared memory reserved for the names of the stats
+   *         allocated in shared memory. Stats whose names do not fit fall back to the heap.
+   */
+  virtual uint64_t statsNameTableBytes() PURE;
+
+  /**
+   * @return const std::vector<std::string>& the stats matcher inclusions. If there are any, only
+   *         stats that match one of them are exported. See Stats::StatsMatcherImpl.
+   */
+  virtual const std::vector<std::string>& statsInclusions() PURE;
+
+  /**
+   * @return const std::vector<std::string>& the stats matcher exclusions. Stats that match one of
+   *         them are not exported.
+   */
+  virtual const std::vector<std::string>& statsExclusions() PURE;
 };
 
 } // namespace Server
@@ -2,6 +2,7 @@
 
 #include <chrono>
 #include <cstdint>
+#include <functional>
 #include <list>
 #include <memory>
 #include <string>
@@ -58,6 +59,24 @@ public:
 
 typedef std::unique_ptr<TagExtractor> TagExtractorPtr;
 
+/**
+ * Decides which stats are exported. A rejected counter or gauge still tracks its value for the
+ * code that reads it, but takes no space in the stat memory and is never listed or flushed. A
+ * rejected histogram drops all values.
+ */
+class StatsMatcher {
+public:
+  virtual ~StatsMatcher() {}
+
+  /**
+   * @param name supplies the full name of the stat.
+   * @return bool true if the stat should not be exported.
+   */
+  virtual bool rejects(const std::string& name) const PURE;
+};
+
+typedef std::unique_ptr<StatsMatcher> StatsMatcherPtr;
+
 /**
  * General interface for all stats objects.
  */
@@ -65,19 +84,20 @@ class Metric {
 public:
   virtual ~Metric() {}
   /**
-   * Returns the full name of the Metric.
+   * Returns the full name of the Metric. Implementations may keep the name in a compact form and
+   * build it on each call, so callers that use it repeatedly should hold on to the result.
    */
-  virtual const std::string& name() const PURE;
+  virtual std::string name() const PURE;
 
   /**
    * Returns a vector of configurable tags to identify this Metric.
    */
-  virtual const std::vector<Tag>& tags() const PURE;
+  virtual std::vector<Tag> tags() const PURE;
 
   /**
    * Returns the name of the Metric with the portions designated as tags removed.
    */
-  virtual const std::string& tagExtractedName() const PURE;
+  virtual std::string tagExtractedName() const PURE;
 };
 
 /**
@@ -135,6 +155,77 @@ public:
 
 typedef std::shared_ptr<Histogram> HistogramSharedPtr;
 
+/**
+ * Statistics computed over the values recorded into a histogram.
+ */
+class HistogramStatistics {
+public:
+  virtual ~HistogramStatistics() {}
+
+  /**
+   * @return a human readable summary of the computed quantiles, e.g. "P0: 1, P50: 3, P100: 9".
+   */
+  virtual std::string summary() const PURE;
+
+  /**
+   * @return the quantiles (in the range [0, 1]) that are computed, sorted ascending.
+   */
+  virtual const std::vector<double>& supportedQuantiles() const PURE;
+
+  /**
+   * @return the computed value of each of supportedQuantiles(), in the same order.
+   */
+  virtual const std::vector<double>& computedQuantiles() const PURE;
+
+  /**
+   * @return the upper bounds of the buckets that are computed, sorted ascending.
+   */
+  virtual const std::vector<double>& supportedBuckets() const PURE;
+
+  /**
+   * @return the number of recorded values less than or equal to each of supportedBuckets(), in the
+   *         same order.
+   */
+  virtual const std::vector<uint64_t>& computedBuckets() const PURE;
+
+  /**
+   * @return the number of values that were recorded.
+   */
+  virtual uint64_t sampleCount() const PURE;
+
+  /**
+   * @return the sum of the values that were recorded.
+   */
+  virtual uint64_t sampleSum() const PURE;
+};
+
+/**
+ * A histogram that aggregates the values recorded on all threads. Values are recorded per thread
+ * and merged into the parent histogram on the main thread when stats are flushed (see
+ * StoreRoot::mergeHistograms()). The statistics reflect the state as of the last merge.
+ */
+class ParentHistogram : public virtual Histogram {
+public:
+  virtual ~ParentHistogram() {}
+
+  /**
+   * @return whether any value has ever been merged into the histogram.
+   */
+  virtual bool used() const PURE;
+
+  /**
+   * @return statistics over the values recorded between the last two merges.
+   */
+  virtual const HistogramStatistics& intervalStatistics() const PURE;
+
+  /**
+   * @return statistics over all the values recorded up to the last merge.
+   */
+  virtual const HistogramStatistics& cumulativeStatistics() const PURE;
+};
+
+typedef std::shared_ptr<ParentHistogram> ParentHistogramSharedPtr;
+
 /**
  * A sink for stats. Each sink is responsible for writing stats to a backing store.
  */
@@ -143,7 +234,8 @@ public:
   virtual ~Sink() {}
 
   /**
-   * This will be called before a sequence of flushCounter() and flushGauge() calls. Sinks can
+   * This will be called before a sequence of flushCounter(), flushGauge() and flushHistogram()
+   * calls. Sinks can
    * choose to optimize writing if desired with a paired endFlush() call.
    */
   virtual void beginFlush() PURE;
@@ -159,8 +251,14 @@ public:
   virtual void flushGauge(const Gauge& gauge, uint64_t value) PURE;
 
   /**
-   * This will be called after beginFlush(), some number of flushCounter(), and some number of
-   * flushGauge(). Sinks can use this to optimize writing if desired.
+   * Flush the statistics of a histogram merged since the previous flush.
+   */
+  virtual void flushHistogram(const ParentHistogram& histogram) PURE;
+
+  /**
+   * This will be called after beginFlush(), some number of flushCounter(), some number of
+   * flushGauge() and some number of flushHistogram(). Sinks can use this to optimize writing if
+   * desired.
    */
   virtual void endFlush() PURE;
 
@@ -226,6 +324,11 @@ public:
    * @return a list of all known gauges.
    */
   virtual std::list<GaugeSharedPtr> gauges() const PURE;
+
+  /**
+   * @return a list of all known histograms.
+   */
+  virtual std::list<ParentHistogramSharedPtr> histograms() const PURE;
 };
 
 typedef std::unique_ptr<Store> StorePtr;
@@ -245,6 +348,12 @@ public:
    */
   virtual void setTagExtractors(const std::vector<TagExtractorPtr>& tag_extractor) PURE;
 
+  /**
+   * Set the matcher that decides which stats are exported. Must be called before any stat that
+   * it rejects is created.
+   */
+  virtual void setStatsMatcher(const StatsMatcher& stats_matcher) PURE;
+
   /**
    * Initialize the store for threading. This will be called once after all worker threads have
    * been initialized. At this point the store can initialize itself for multi-threaded operation.
@@ -257,6 +366,16 @@ public:
    * down.
    */
   virtual void shutdownThreading() PURE;
+
+  /**
+   * Merge the values recorded on every thread into the parent histograms returned by
+   * histograms(). Must be called on the main thread. The merge completes asynchronously once all
+   * threads have handed over their recorded values.
+   * @param merge_complete_cb supplies the callback that is run on the main thread once all
+   *                          histograms are merged.
+   */
+  typedef std::function<void()> PostMergeCb;
+  virtual void mergeHistograms(PostMergeCb merge_complete_cb) PURE;
 };
 
 typedef std::unique_ptr<StoreRoot> StoreRootPtr;
@@ -7,6 +7,7 @@
 #include <unordered_map>
 
 #include "envoy/access_log/access_log.h"
+#include "envoy/config/config_worker.h"
 #include "envoy/config/grpc_mux.h"
 #include "envoy/http/async_client.h"
 #include "envoy/http/conn_pool.h"
@@ -199,6 +200,12 @@ public:
   virtual CdsApiPtr createCds(const envoy::api::v2::ConfigSource& cds_config,
                               const Optional<envoy::api::v2::ConfigSource>& eds_config,
                               ClusterManager& cm) PURE;
+
+  /**
+   * @return the config worker that ADS responses are decoded on, or nullptr if they should be
+   *         decoded on the main thread.
+   */
+  virtual Config::ConfigWorker* configWorker() PURE;
 };
 
 } // namespace Upstream
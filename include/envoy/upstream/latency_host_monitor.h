@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+
+namespace Envoy {
+namespace Upstream {
+
+/**
+ * A monitor for observed response latency of a host. Response times are fed by proxy filters on
+ * every thread and read by latency aware load balancers on every thread.
+ */
+class LatencyHostMonitor {
+public:
+  virtual ~LatencyHostMonitor() {}
+
+  /**
+   * Add a response time for the host. As with the outlier detector, response time is generic and
+   * might be used for different operations including HTTP, Mongo, Redis, etc.
+   */
+  virtual void putResponseTime(std::chrono::milliseconds time) PURE;
+
+  /**
+   * @return the current latency estimate for the host in milliseconds. 0 indicates that no
+   *         response time has been observed recently enough to produce an estimate.
+   */
+  virtual double latencyEstimate() PURE;
+};
+
+typedef std::unique_ptr<LatencyHostMonitor> LatencyHostMonitorPtr;
+
+} // namespace Upstream
+} // namespace Envoy
@@ -14,7 +14,7 @@ namespace Upstream {
 /**
  * Type of load balancing to perform.
  */
-enum class LoadBalancerType { RoundRobin, LeastRequest, Random, RingHash, OriginalDst };
+enum class LoadBalancerType { RoundRobin, LeastRequest, Random, RingHash, OriginalDst, PeakEwma };
 
 /**
  * Load Balancer subset configuration.
@@ -105,6 +105,28 @@ public:
    */
   virtual void weight(uint32_t new_weight) PURE;
 
+  /**
+   * @return the priority level of the host. 0 is the highest priority. Hosts at lower priority
+   *         levels only receive traffic when higher levels do not have enough healthy capacity.
+   */
+  virtual uint32_t priority() const PURE;
+
+  /**
+   * Set the priority level of the host.
+   */
+  virtual void priority(uint32_t new_priority) PURE;
+
+  /**
+   * @return the load balancing weight of the locality the host belongs to. 0 indicates that no
+   *         locality weight was assigned and locality weighted load balancing is not in use.
+   */
+  virtual uint32_t localityWeight() const PURE;
+
+  /**
+   * Set the load balancing weight of the locality the host belongs to.
+   */
+  virtual void localityWeight(uint32_t new_locality_weight) PURE;
+
   /**
    * @return the current boolean value of host being in use.
    */
@@ -118,6 +140,9 @@ public:
 
 typedef std::shared_ptr<const Host> HostConstSharedPtr;
 
+typedef std::shared_ptr<const std::vector<HostSharedPtr>> HostVectorConstSharedPtr;
+typedef std::shared_ptr<const std::vector<std::vector<HostSharedPtr>>> HostListsConstSharedPtr;
+
 /**
  * Base host set interface. This is used both for clusters, as well as per thread/worker host sets
  * used during routing/forwarding.
@@ -168,6 +193,16 @@ public:
    * @return same as hostsPerLocality but only contains healthy hosts.
    */
   virtual const std::vector<std::vector<HostSharedPtr>>& healthyHostsPerLocality() const PURE;
+
+  /**
+   * The vectors behind hosts(), healthyHosts(), hostsPerLocality() and healthyHostsPerLocality().
+   * A host set never modifies a vector once it is returned, so they can be shared with other host
+   * sets (e.g. the per worker copies of a cluster) instead of being copied.
+   */
+  virtual HostVectorConstSharedPtr hostsPtr() const PURE;
+  virtual HostVectorConstSharedPtr healthyHostsPtr() const PURE;
+  virtual HostListsConstSharedPtr hostsPerLocalityPtr() const PURE;
+  virtual HostListsConstSharedPtr healthyHostsPerLocalityPtr() const PURE;
 };
 
 /**
@@ -177,6 +212,8 @@ public:
 #define ALL_CLUSTER_STATS(COUNTER, GAUGE, HISTOGRAM)                                               \
   COUNTER  (lb_healthy_panic)                                                                      \
   COUNTER  (lb_local_cluster_not_ok)                                                               \
+  COUNTER  (lb_locality_weighted)                                                                  \
+  COUNTER  (lb_priority_spillover)                                                                 \
   COUNTER  (lb_recalculate_zone_structures)                                                        \
   COUNTER  (lb_zone_cluster_too_small)                                                             \
   COUNTER  (lb_zone_no_capacity_left)                                                              \
@@ -211,7 +248,12 @@ public:
   GAUGE    (upstream_cx_tx_bytes_buffered)                                                         \
   COUNTER  (upstream_cx_protocol_error)                                                            \
   COUNTER  (upstream_cx_max_requests)                                                              \
+  COUNTER  (upstream_cx_idle_timeout)                                                              \
+  COUNTER  (upstream_cx_max_duration_reached)                                                      \
   COUNTER  (upstream_cx_none_healthy)                                                              \
+  COUNTER  (upstream_cx_prefetch)                                                                  \
+  COUNTER  (upstream_cx_prefetch_used)                                                             \
+  COUNTER  (upstream_cx_prefetch_unused)                                                           \
   COUNTER  (upstream_rq_total)                                                                     \
   GAUGE    (upstream_rq_active)                                                                    \
   COUNTER  (upstream_rq_pending_total)                                                             \
@@ -227,6 +269,7 @@ public:
   COUNTER  (upstream_rq_retry)                                                                     \
   COUNTER  (upstream_rq_retry_success)                                                             \
   COUNTER  (upstream_rq_retry_overflow)                                                            \
+  COUNTER  (upstream_rq_shared_pool_remote)                                                        \
   COUNTER  (upstream_flow_control_paused_reading_total)                                            \
   COUNTER  (upstream_flow_control_resumed_reading_total)                                           \
   COUNTER  (upstream_flow_control_backed_up_total)                                                 \
@@ -241,6 +284,7 @@ public:
   COUNTER  (update_success)                                                                        \
   COUNTER  (update_failure)                                                                        \
   COUNTER  (update_empty)                                                                          \
+  COUNTER  (update_no_rebuild)                                                                     \
   GAUGE    (version)
 // clang-format on
 
@@ -327,6 +371,31 @@ public:
    */
   virtual uint64_t maxRequestsPerConnection() const PURE;
 
+  /**
+   * @return how long a connection pool keeps an upstream connection that has no active requests
+   *         before closing it. 0 indicates no idle timeout.
+   */
+  virtual std::chrono::milliseconds idleTimeout() const PURE;
+
+  /**
+   * @return the maximum age of an upstream connection. Once it is reached a connection pool stops
+   *         using the connection for new requests and closes it as soon as it has no active
+   *         requests. 0 indicates no maximum.
+   */
+  virtual std::chrono::milliseconds maxConnectionDuration() const PURE;
+
+  /**
+   * @return the number of connections a connection pool keeps idle (or connecting) on top of the
+   *         ones serving active and pending requests. 0 disables this kind of prefetching.
+   */
+  virtual uint64_t prefetchMinIdleConnections() const PURE;
+
+  /**
+   * @return the number of connections a connection pool keeps per active or pending request, in
+   *         percent. 0 disables this kind of prefetching.
+   */
+  virtual uint64_t prefetchRatioPercent() const PURE;
+
   /**
    * @return the human readable name of the cluster.
    */
@@ -354,6 +423,12 @@ public:
    */
   virtual Stats::Scope& statsScope() const PURE;
 
+  /**
+   * @return uint64_t the number of cluster stats that are only allocated on first use (see the
+   *         upstream.compact_cluster_stats runtime key) and have not been allocated yet.
+   */
+  virtual uint64_t pendingStats() const PURE;
+
   /**
    * @return ClusterLoadReportStats& strongly named load report stats for this cluster.
    */
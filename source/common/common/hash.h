@@ -15,6 +15,11 @@ public:
   static uint64_t xxHash64(const std::string& input) {
     return XXH64(input.c_str(), input.size(), 0);
   }
+
+  /**
+   * Return 64-bit hash with seed of 0 from the xxHash algorithm over length bytes of input.
+   */
+  static uint64_t xxHash64(const void* input, size_t length) { return XXH64(input, length, 0); }
 };
 
 } // namespace Envoy
@@ -0,0 +1,86 @@
+#include "common/config/config_worker_impl.h"
+
+#include <chrono>
+#include <memory>
+
+namespace Envoy {
+namespace Config {
+
+ConfigWorkerImpl::ConfigWorkerImpl(Event::Dispatcher& main_dispatcher, Stats::Scope& scope,
+                                   MonotonicTimeSource& time_source)
+    : main_dispatcher_(main_dispatcher),
+      stats_{ALL_CONFIG_WORKER_STATS(POOL_COUNTER_PREFIX(scope, "config_worker."),
+                                     POOL_GAUGE_PREFIX(scope, "config_worker."),
+                                     POOL_HISTOGRAM_PREFIX(scope, "config_worker."))},
+      time_source_(time_source),
+      thread_(new Thread::Thread([this]() -> void { threadRoutine(); })) {}
+
+ConfigWorkerImpl::~ConfigWorkerImpl() { shutdown(); }
+
+void ConfigWorkerImpl::shutdown() {
+  if (shutdown_) {
+    return;
+  }
+
+  shutdown_ = true;
+  {
+    std::unique_lock<std::mutex> guard(lock_);
+    exit_ = true;
+  }
+  work_available_.notify_one();
+  thread_->join();
+}
+
+void ConfigWorkerImpl::post(std::function<void()> work, std::function<void()> commit) {
+  stats_.work_total_.inc();
+  if (shutdown_) {
+    work();
+    commit();
+    return;
+  }
+
+  stats_.work_pending_.inc();
+  {
+    std::unique_lock<std::mutex> guard(lock_);
+    queue_.push_back({work, commit});
+  }
+  work_available_.notify_one();
+}
+
+void ConfigWorkerImpl::threadRoutine() {
+  ENVOY_LOG(debug, "config worker started");
+  std::unique_lock<std::mutex> guard(lock_);
+  while (true) {
+    work_available_.wait(guard, [this]() -> bool { return exit_ || !queue_.empty(); });
+    if (exit_) {
+      break;
+    }
+
+    WorkItem item = std::move(queue_.front());
+    queue_.pop_front();
+    guard.unlock();
+
+    const MonotonicTime start = time_source_.currentTime();
+    item.work_();
+    const MonotonicTime done = time_source_.currentTime();
+
+    // Stats are recorded on the main thread, which also tells how long the main loop took to get to
+    // the commit.
+    std::function<void()> commit = item.commit_;
+    main_dispatcher_.post([this, commit, start, done]() -> void {
+      stats_.work_pending_.dec();
+      stats_.work_time_ms_.recordValue(
+          std::chrono::duration_cast<std::chrono::milliseconds>(done - start).count());
+      stats_.commit_lag_ms_.recordValue(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                            time_source_.currentTime() - done)
+                                            .count());
+      commit();
+    });
+
+    guard.lock();
+  }
+  ENVOY_LOG(debug, "config worker exited");
+}
+
+} // namespace Config
+} // namespace Envoy
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+
+#include "envoy/common/time.h"
+#include "envoy/config/config_worker.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/stats/stats.h"
+#include "envoy/stats/stats_macros.h"
+
+#include "common/common/logger.h"
+#include "common/common/thread.h"
+
+namespace Envoy {
+namespace Config {
+
+/**
+ * All config worker stats. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_CONFIG_WORKER_STATS(COUNTER, GAUGE, HISTOGRAM)                                         \
+  COUNTER  (work_total)                                                                            \
+  GAUGE    (work_pending)                                                                          \
+  HISTOGRAM(work_time_ms)                                                                          \
+  HISTOGRAM(commit_lag_ms)
+// clang-format on
+
+/**
+ * Struct definition for all config worker stats. @see stats_macros.h
+ */
+struct ConfigWorkerStats {
+  ALL_CONFIG_WORKER_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT,
+                          GENERATE_HISTOGRAM_STRUCT)
+};
+
+/**
+ * ConfigWorker implementation backed by a single thread draining a FIFO queue. Commits are posted
+ * to the main dispatcher, so both work and commit order follow post order. Stats are only touched
+ * from the main thread.
+ */
+class ConfigWorkerImpl : public ConfigWorker, Logger::Loggable<Logger::Id::config> {
+public:
+  ConfigWorkerImpl(Event::Dispatcher& main_dispatcher, Stats::Scope& scope,
+                   MonotonicTimeSource& time_source);
+  ~ConfigWorkerImpl();
+
+  /**
+   * Stop the config thread and join it. Queued work that has not started is dropped. Must be
+   * called from the main thread.
+   */
+  void shutdown();
+
+  // Config::ConfigWorker
+  void post(std::function<void()> work, std::function<void()> commit) override;
+
+private:
+  struct WorkItem {
+    std::function<void()> work_;
+    std::function<void()> commit_;
+  };
+
+  void threadRoutine();
+
+  Event::Dispatcher& main_dispatcher_;
+  ConfigWorkerStats stats_;
+  MonotonicTimeSource& time_source_;
+  std::mutex lock_;
+  std::condition_variable work_available_;
+  std::list<WorkItem> queue_;
+  bool exit_{};
+  bool shutdown_{};
+  Thread::ThreadPtr thread_;
+};
+
+} // namespace Config
+} // namespace Envoy
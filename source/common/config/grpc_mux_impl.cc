@@ -31,6 +31,7 @@ GrpcMuxImpl::GrpcMuxImpl(const envoy::api::v2::Node& node,
                   dispatcher, service_method) {}
 
 GrpcMuxImpl::~GrpcMuxImpl() {
+  *alive_ = false;
   for (const auto& api_state : api_state_) {
     for (auto watch : api_state.second.watches_) {
       watch->inserted_ = false;
@@ -46,6 +47,7 @@ void GrpcMuxImpl::setRetryTimer() {
 
 void GrpcMuxImpl::establishNewStream() {
   ENVOY_LOG(debug, "Establishing new gRPC bidi stream for {}", service_method_.DebugString());
+  stream_generation_++;
   stream_ = async_client_->start(service_method_, *this);
   if (stream_ == nullptr) {
     ENVOY_LOG(warn, "Unable to establish new stream");
@@ -160,42 +162,109 @@ void GrpcMuxImpl::onReceiveMessage(std::unique_ptr<envoy::api::v2::DiscoveryResp
     ENVOY_LOG(warn, "Ignoring unknown type URL {}", type_url);
     return;
   }
+
+  DecodedResponseSharedPtr decoded = std::make_shared<DecodedResponse>();
+  decoded->message_ = std::move(message);
+  if (config_worker_ == nullptr) {
+    decodeResponse(*decoded);
+    commitResponse(*decoded);
+    return;
+  }
+
+  std::shared_ptr<bool> alive = alive_;
+  const uint64_t stream_generation = stream_generation_;
+  config_worker_->post([decoded]() -> void { decodeResponse(*decoded); },
+                       [this, alive, stream_generation, decoded]() -> void {
+                         if (!*alive || stream_generation != stream_generation_) {
+                           ENVOY_LOG(debug, "Dropping gRPC message for {} from a previous stream",
+                                     decoded->message_->type_url());
+                           return;
+                         }
+                         commitResponse(*decoded);
+                       });
+}
+
+void GrpcMuxImpl::decodeResponse(DecodedResponse& decoded) {
+  const envoy::api::v2::DiscoveryResponse& message = *decoded.message_;
   try {
     // To avoid O(n^2) explosion (e.g. when we have 1000s of EDS watches), we
     // build a map here from resource name to resource and then walk watches_.
     // We have to walk all watches (and need an efficient map as a result) to
     // ensure we deliver empty config updates when a resource is dropped.
-    std::unordered_map<std::string, ProtobufWkt::Any> resources;
-    for (const auto& resource : message->resources()) {
-      if (type_url != resource.type_url()) {
+    decoded.resources_.reserve(message.resources_size());
+    decoded.unpacked_.reserve(message.resources_size());
+    for (int i = 0; i < message.resources_size(); i++) {
+      const ProtobufWkt::Any& resource = message.resources(i);
+      if (message.type_url() != resource.type_url()) {
         throw EnvoyException(fmt::format("{} does not match {} type URL is DiscoveryResponse {}",
-                                         resource.type_url(), type_url, message->DebugString()));
+                                         resource.type_url(), message.type_url(),
+                                         message.DebugString()));
       }
-      const std::string resource_name = Utility::resourceName(resource);
-      resources.emplace(resource_name, resource);
+      std::string name;
+      decoded.unpacked_.emplace_back(Utility::unpackResource(resource, name));
+      decoded.resources_.emplace(name, i);
+    }
+  } catch (const EnvoyException& e) {
+    decoded.resources_.clear();
+    decoded.unpacked_.clear();
+    decoded.error_ = e.what();
+  }
+}
+
+void GrpcMuxImpl::commitResponse(DecodedResponse& decoded) {
+  const envoy::api::v2::DiscoveryResponse& message = *decoded.message_;
+  const std::string& type_url = message.type_url();
+  try {
+    if (!decoded.error_.empty()) {
+      throw EnvoyException(decoded.error_);
     }
     for (auto watch : api_state_[type_url].watches_) {
+      // Watches get the unpacked resources unless an earlier watch already took one of them.
+      std::vector<ProtobufTypes::MessagePtr> unpacked;
+      bool all_unpacked = true;
+      auto take_unpacked = [&decoded, &unpacked, &all_unpacked](int index) -> void {
+        if (all_unpacked && decoded.unpacked_[index] != nullptr) {
+          unpacked.emplace_back(std::move(decoded.unpacked_[index]));
+        } else {
+          all_unpacked = false;
+        }
+      };
+
       if (watch->resources_.empty()) {
-        watch->callbacks_.onConfigUpdate(message->resources(), message->version_info());
+        for (int i = 0; i < message.resources_size(); i++) {
+          take_unpacked(i);
+        }
+        if (all_unpacked) {
+          watch->callbacks_.onUnpackedConfigUpdate(message.resources(), std::move(unpacked),
+                                                   message.version_info());
+        } else {
+          watch->callbacks_.onConfigUpdate(message.resources(), message.version_info());
+        }
         continue;
       }
       Protobuf::RepeatedPtrField<ProtobufWkt::Any> found_resources;
       for (auto watched_resource_name : watch->resources_) {
-        auto it = resources.find(watched_resource_name);
-        if (it != resources.end()) {
-          found_resources.Add()->MergeFrom(it->second);
+        auto it = decoded.resources_.find(watched_resource_name);
+        if (it != decoded.resources_.end()) {
+          found_resources.Add()->MergeFrom(message.resources(it->second));
+          take_unpacked(it->second);
         }
       }
-      watch->callbacks_.onConfigUpdate(found_resources, message->version_info());
+      if (all_unpacked) {
+        watch->callbacks_.onUnpackedConfigUpdate(found_resources, std::move(unpacked),
+                                                 message.version_info());
+      } else {
+        watch->callbacks_.onConfigUpdate(found_resources, message.version_info());
+      }
     }
-    api_state_[type_url].request_.set_version_info(message->version_info());
+    api_state_[type_url].request_.set_version_info(message.version_info());
   } catch (const EnvoyException& e) {
-    ENVOY_LOG(warn, "gRPC config for {} update rejected: {}", message->type_url(), e.what());
+    ENVOY_LOG(warn, "gRPC config for {} update rejected: {}", type_url, e.what());
     for (auto watch : api_state_[type_url].watches_) {
       watch->callbacks_.onConfigUpdateFailed(&e);
     }
   }
-  api_state_[type_url].request_.set_response_nonce(message->nonce());
+  api_state_[type_url].request_.set_response_nonce(message.nonce());
   sendDiscoveryRequest(type_url);
 }
 
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "envoy/config/config_worker.h"
 #include "envoy/config/grpc_mux.h"
 #include "envoy/config/subscription.h"
 #include "envoy/event/dispatcher.h"
@@ -30,6 +35,13 @@ public:
               Event::Dispatcher& dispatcher, const Protobuf::MethodDescriptor& service_method);
   ~GrpcMuxImpl();
 
+  /**
+   * Decode DiscoveryResponses on a config worker instead of the main thread. Decoding unpacks the
+   * resources into typed messages, which is where they are actually parsed. Watch callbacks, the
+   * version/nonce bookkeeping and the following DiscoveryRequest still happen on the main thread.
+   */
+  void setConfigWorker(ConfigWorker& config_worker) { config_worker_ = &config_worker; }
+
   void start() override;
   GrpcMuxWatchPtr subscribe(const std::string& type_url, const std::vector<std::string>& resources,
                             GrpcMuxCallbacks& callbacks) override;
@@ -52,6 +64,23 @@ private:
   void sendDiscoveryRequest(const std::string& type_url);
   void handleFailure();
 
+  // A DiscoveryResponse together with its unpacked resources and a resource name index.
+  struct DecodedResponse {
+    std::unique_ptr<envoy::api::v2::DiscoveryResponse> message_;
+    // Indexed like message_->resources(). Each message is handed to the first watch that wants it,
+    // later watches for the same resource get it packed.
+    std::vector<ProtobufTypes::MessagePtr> unpacked_;
+    // Resource name to index in message_->resources().
+    std::unordered_map<std::string, int> resources_;
+    std::string error_;
+  };
+  typedef std::shared_ptr<DecodedResponse> DecodedResponseSharedPtr;
+
+  // Validates resource type URLs, unpacks the resources and builds the name index. Does not touch
+  // any mux state so that it can run on the config worker.
+  static void decodeResponse(DecodedResponse& decoded);
+  void commitResponse(DecodedResponse& decoded);
+
   struct GrpcMuxWatchImpl : public GrpcMuxWatch {
     GrpcMuxWatchImpl(const std::vector<std::string>& resources, GrpcMuxCallbacks& callbacks,
                      const std::string& type_url, GrpcMuxImpl& parent)
@@ -98,6 +127,11 @@ private:
   // Envoy's dependendency ordering.
   std::list<std::string> subscriptions_;
   Event::TimerPtr retry_timer_;
+  ConfigWorker* config_worker_{};
+  // Commits posted by the config worker are dropped if the mux has been destroyed or the stream
+  // they were received on has been replaced.
+  std::shared_ptr<bool> alive_{std::make_shared<bool>(true)};
+  uint64_t stream_generation_{};
 };
 
 class NullGrpcMuxImpl : public GrpcMux {
@@ -51,13 +51,20 @@ public:
     std::transform(resources.cbegin(), resources.cend(),
                    Protobuf::RepeatedPtrFieldBackInserter(&typed_resources),
                    MessageUtil::anyConvert<ResourceType>);
-    callbacks_->onConfigUpdate(typed_resources);
-    stats_.update_success_.inc();
-    stats_.update_attempt_.inc();
-    version_info_ = version_info;
-    stats_.version_.set(HashUtil::xxHash64(version_info_));
-    ENVOY_LOG(debug, "gRPC config for {} accepted with {} resources: {}", type_url_,
-              resources.size(), RepeatedPtrUtil::debugString(typed_resources));
+    onTypedConfigUpdate(typed_resources, version_info);
+  }
+
+  void onUnpackedConfigUpdate(const Protobuf::RepeatedPtrField<ProtobufWkt::Any>&,
+                              std::vector<ProtobufTypes::MessagePtr>&& unpacked,
+                              const std::string& version_info) override {
+    Protobuf::RepeatedPtrField<ResourceType> typed_resources;
+    typed_resources.Reserve(unpacked.size());
+    for (ProtobufTypes::MessagePtr& resource : unpacked) {
+      // The mux unpacks into the type named by the type URL, which is the one we subscribed to.
+      ASSERT(resource->GetDescriptor() == ResourceType::descriptor());
+      typed_resources.AddAllocated(static_cast<ResourceType*>(resource.release()));
+    }
+    onTypedConfigUpdate(typed_resources, version_info);
   }
 
   void onConfigUpdateFailed(const EnvoyException* e) override {
@@ -74,6 +81,17 @@ public:
   }
 
 private:
+  void onTypedConfigUpdate(const Protobuf::RepeatedPtrField<ResourceType>& typed_resources,
+                           const std::string& version_info) {
+    callbacks_->onConfigUpdate(typed_resources);
+    stats_.update_success_.inc();
+    stats_.update_attempt_.inc();
+    version_info_ = version_info;
+    stats_.version_.set(HashUtil::xxHash64(version_info_));
+    ENVOY_LOG(debug, "gRPC config for {} accepted with {} resources: {}", type_url_,
+              typed_resources.size(), RepeatedPtrUtil::debugString(typed_resources));
+  }
+
   GrpcMux& grpc_mux_;
   SubscriptionStats stats_;
   const std::string type_url_;
@@ -112,17 +112,40 @@ void Utility::translateLdsConfig(const Json::Object& json_lds,
 }
 
 std::string Utility::resourceName(const ProtobufWkt::Any& resource) {
+  std::string name;
+  unpackResource(resource, name);
+  return name;
+}
+
+namespace {
+
+template <class ResourceType>
+ProtobufTypes::MessagePtr unpackTyped(const ProtobufWkt::Any& resource,
+                                      const std::string& (ResourceType::*name_field)() const,
+                                      std::string& name) {
+  std::unique_ptr<ResourceType> typed_resource(new ResourceType());
+  if (!resource.UnpackTo(typed_resource.get())) {
+    throw EnvoyException("Unable to unpack " + resource.DebugString());
+  }
+  name = ((*typed_resource).*name_field)();
+  return std::move(typed_resource);
+}
+
+} // namespace
+
+ProtobufTypes::MessagePtr Utility::unpackResource(const ProtobufWkt::Any& resource,
+                                                  std::string& name) {
   if (resource.type_url() == Config::TypeUrl::get().Listener) {
-    return MessageUtil::anyConvert<envoy::api::v2::Listener>(resource).name();
+    return unpackTyped(resource, &envoy::api::v2::Listener::name, name);
   }
   if (resource.type_url() == Config::TypeUrl::get().RouteConfiguration) {
-    return MessageUtil::anyConvert<envoy::api::v2::RouteConfiguration>(resource).name();
+    return unpackTyped(resource, &envoy::api::v2::RouteConfiguration::name, name);
   }
   if (resource.type_url() == Config::TypeUrl::get().Cluster) {
-    return MessageUtil::anyConvert<envoy::api::v2::Cluster>(resource).name();
+    return unpackTyped(resource, &envoy::api::v2::Cluster::name, name);
   }
   if (resource.type_url() == Config::TypeUrl::get().ClusterLoadAssignment) {
-    return MessageUtil::anyConvert<envoy::api::v2::ClusterLoadAssignment>(resource).cluster_name();
+    return unpackTyped(resource, &envoy::api::v2::ClusterLoadAssignment::cluster_name, name);
   }
   throw EnvoyException(
       fmt::format("Unknown type URL {} in DiscoveryResponse", resource.type_url()));
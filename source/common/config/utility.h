@@ -214,6 +214,16 @@ public:
    */
   static std::string resourceName(const ProtobufWkt::Any& resource);
 
+  /**
+   * Unpack a v2 API resource in a google.protobuf.Any into a message of its underlying type.
+   * @param resource google.protobuf.Any v2 API resource.
+   * @param name supplies where to store the resource name, @see resourceName().
+   * @return ProtobufTypes::MessagePtr the unpacked resource.
+   * @throw EnvoyException if the type is unknown or the resource cannot be unpacked.
+   */
+  static ProtobufTypes::MessagePtr unpackResource(const ProtobufWkt::Any& resource,
+                                                  std::string& name);
+
   /**
    * Creates the set of stats tag extractors requested by the config and transfers ownership to the
    * caller.
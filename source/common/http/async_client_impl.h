@@ -50,6 +50,11 @@ public:
 
   Event::Dispatcher& dispatcher() override { return dispatcher_; }
 
+  /**
+   * @return whether there are requests or streams in flight. The client must outlive them.
+   */
+  bool hasActiveStreams() const { return !active_streams_.empty(); }
+
 private:
   const Upstream::ClusterInfo& cluster_;
   Router::FilterConfig config_;
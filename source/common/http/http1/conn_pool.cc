@@ -1,5 +1,6 @@
 #include "common/http/http1/conn_pool.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <list>
 
@@ -45,6 +46,13 @@ void ConnPoolImpl::addDrainedCallback(DrainedCb cb) {
 void ConnPoolImpl::attachRequestToClient(ActiveClient& client, StreamDecoder& response_decoder,
                                          ConnectionPool::Callbacks& callbacks) {
   ASSERT(!client.stream_wrapper_);
+  if (client.prefetched_) {
+    client.prefetched_ = false;
+    host_->cluster().stats().upstream_cx_prefetch_used_.inc();
+  }
+  if (client.idle_timer_) {
+    client.idle_timer_->disableTimer();
+  }
   client.stream_wrapper_.reset(new StreamWrapper(response_decoder, client));
   callbacks.onPoolReady(*client.stream_wrapper_, client.real_host_description_);
 }
@@ -65,6 +73,30 @@ void ConnPoolImpl::createNewConnection() {
   ENVOY_LOG(debug, "creating a new connection");
   ActiveClientPtr client(new ActiveClient(*this));
   client->moveIntoList(std::move(client), busy_clients_);
+  connecting_clients_++;
+}
+
+void ConnPoolImpl::enableIdleTimer(ActiveClient& client) {
+  const std::chrono::milliseconds idle_timeout = host_->cluster().idleTimeout();
+  if (idle_timeout.count() == 0) {
+    return;
+  }
+
+  if (!client.idle_timer_) {
+    client.idle_timer_ = dispatcher_.createTimer([&client]() -> void { client.onIdleTimeout(); });
+  }
+  client.idle_timer_->enableTimer(idle_timeout);
+}
+
+void ConnPoolImpl::enableMaxDurationTimer(ActiveClient& client) {
+  const std::chrono::milliseconds max_duration = host_->cluster().maxConnectionDuration();
+  if (max_duration.count() == 0) {
+    return;
+  }
+
+  client.max_duration_timer_ =
+      dispatcher_.createTimer([&client]() -> void { client.onMaxDurationTimeout(); });
+  client.max_duration_timer_->enableTimer(max_duration);
 }
 
 ConnectionPool::Cancellable* ConnPoolImpl::newStream(StreamDecoder& response_decoder,
@@ -73,6 +105,7 @@ ConnectionPool::Cancellable* ConnPoolImpl::newStream(StreamDecoder& response_dec
     ready_clients_.front()->moveBetweenLists(ready_clients_, busy_clients_);
     ENVOY_CONN_LOG(debug, "using existing connection", *busy_clients_.front()->codec_client_);
     attachRequestToClient(*busy_clients_.front(), response_decoder, callbacks);
+    prefetch();
     return nullptr;
   }
 
@@ -83,15 +116,22 @@ ConnectionPool::Cancellable* ConnPoolImpl::newStream(StreamDecoder& response_dec
       host_->cluster().stats().upstream_cx_overflow_.inc();
     }
 
-    // If we have no connections at all, make one no matter what so we don't starve.
-    if ((ready_clients_.size() == 0 && busy_clients_.size() == 0) || can_create_connection) {
+    // If we have no connections at all, make one no matter what so we don't starve. When
+    // prefetching, a connection that is already on its way and not claimed by an earlier pending
+    // request is used instead of opening another one.
+    const bool covered_by_prefetch =
+        connecting_clients_ > pending_requests_.size() && prefetchEnabled();
+    if ((ready_clients_.size() == 0 && busy_clients_.size() == 0) ||
+        (can_create_connection && !covered_by_prefetch)) {
       createNewConnection();
     }
 
     ENVOY_LOG(debug, "queueing request due to no available connections");
     PendingRequestPtr pending_request(new PendingRequest(*this, response_decoder, callbacks));
     pending_request->moveIntoList(std::move(pending_request), pending_requests_);
-    return pending_requests_.front().get();
+    ConnectionPool::Cancellable* handle = pending_requests_.front().get();
+    prefetch();
+    return handle;
   } else {
     ENVOY_LOG(debug, "max pending requests overflow");
     callbacks.onPoolFailure(ConnectionPool::PoolFailureReason::Overflow, nullptr);
@@ -101,10 +141,24 @@ ConnectionPool::Cancellable* ConnPoolImpl::newStream(StreamDecoder& response_dec
 }
 
 void ConnPoolImpl::onConnectionEvent(ActiveClient& client, Network::ConnectionEvent event) {
+  // Either way the client is done connecting. This is accounted for up front since the callbacks
+  // below can reenter newStream().
+  const bool was_connecting = client.connect_timer_ != nullptr;
+  if (was_connecting) {
+    ASSERT(connecting_clients_ > 0);
+    connecting_clients_--;
+  }
+
   if (event == Network::ConnectionEvent::RemoteClose ||
       event == Network::ConnectionEvent::LocalClose) {
     // The client died.
     ENVOY_CONN_LOG(debug, "client disconnected", *client.codec_client_);
+    if (client.idle_timer_) {
+      client.idle_timer_->disableTimer();
+    }
+    if (client.max_duration_timer_) {
+      client.max_duration_timer_->disableTimer();
+    }
     ActiveClientPtr removed;
     bool check_for_drained = true;
     if (client.stream_wrapper_) {
@@ -136,10 +190,14 @@ void ConnPoolImpl::onConnectionEvent(ActiveClient& client, Network::ConnectionEv
       // Raw connect failures should never happen under normal circumstances. If we have an upstream
       // that is behaving badly, requests can get stuck here in the pending state. If we see a
       // connect failure, we purge all pending requests so that calling code can determine what to
-      // do with the request.
+      // do with the request. A failed prefetch only means we opened one connection too many, so
+      // pending requests keep waiting for the connections that are still on their way.
       // NOTE: We move the existing pending requests to a temporary list. This is done so that
       //       if retry logic submits a new request to the pool, we don't fail it inline.
-      std::list<PendingRequestPtr> pending_requests_to_purge(std::move(pending_requests_));
+      std::list<PendingRequestPtr> pending_requests_to_purge;
+      if (!client.prefetched_) {
+        pending_requests_to_purge = std::move(pending_requests_);
+      }
       while (!pending_requests_to_purge.empty()) {
         PendingRequestPtr request =
             pending_requests_to_purge.front()->removeFromList(pending_requests_to_purge);
@@ -159,6 +217,13 @@ void ConnPoolImpl::onConnectionEvent(ActiveClient& client, Network::ConnectionEv
     if (check_for_drained) {
       checkForDrained();
     }
+
+    // Replace connections the upstream closed. Connect failures and local closes (draining, health
+    // failures, max requests) are not replaced here so that a dead host is not reconnected to in a
+    // loop; the next request will prefetch again.
+    if (event == Network::ConnectionEvent::RemoteClose && !was_connecting) {
+      prefetch();
+    }
   }
 
   if (client.connect_timer_) {
@@ -172,6 +237,7 @@ void ConnPoolImpl::onConnectionEvent(ActiveClient& client, Network::ConnectionEv
   // whether the client is in the ready list (connected) or the busy list (failed to connect).
   if (event == Network::ConnectionEvent::Connected) {
     conn_connect_ms_->complete();
+    enableMaxDurationTimer(client);
     processIdleClient(client);
   }
 }
@@ -200,17 +266,51 @@ void ConnPoolImpl::onResponseComplete(ActiveClient& client) {
     ENVOY_CONN_LOG(debug, "maximum requests per connection", *client.codec_client_);
     host_->cluster().stats().upstream_cx_max_requests_.inc();
     onDownstreamReset(client);
+  } else if (client.max_duration_reached_) {
+    ENVOY_CONN_LOG(debug, "maximum connection duration", *client.codec_client_);
+    onDownstreamReset(client);
   } else {
     processIdleClient(client);
   }
 }
 
+bool ConnPoolImpl::prefetchEnabled() {
+  return host_->cluster().prefetchMinIdleConnections() > 0 ||
+         host_->cluster().prefetchRatioPercent() > 0;
+}
+
+void ConnPoolImpl::prefetch() {
+  if (!drained_callbacks_.empty()) {
+    return;
+  }
+
+  const uint64_t min_idle = host_->cluster().prefetchMinIdleConnections();
+  const uint64_t ratio_percent = host_->cluster().prefetchRatioPercent();
+  if (min_idle == 0 && ratio_percent == 0) {
+    return;
+  }
+
+  // Every connected busy client is serving a request, and every pending request will take a
+  // connection as soon as one is available.
+  const uint64_t active = busy_clients_.size() - connecting_clients_ + pending_requests_.size();
+  const uint64_t target = std::max(active + min_idle, (active * ratio_percent + 99) / 100);
+  Upstream::ResourceManager& resource_manager = host_->cluster().resourceManager(priority_);
+  while (ready_clients_.size() + busy_clients_.size() < target &&
+         resource_manager.connections().canCreate()) {
+    ENVOY_LOG(debug, "prefetching a connection");
+    createNewConnection();
+    busy_clients_.front()->prefetched_ = true;
+    host_->cluster().stats().upstream_cx_prefetch_.inc();
+  }
+}
+
 void ConnPoolImpl::processIdleClient(ActiveClient& client) {
   client.stream_wrapper_.reset();
   if (pending_requests_.empty()) {
     // There is nothing to service so just move the connection into the ready list.
     ENVOY_CONN_LOG(debug, "moving to ready", *client.codec_client_);
     client.moveBetweenLists(busy_clients_, ready_clients_);
+    enableIdleTimer(client);
   } else {
     // There is work to do so bind a request to the client and move it to the busy list. Pending
     // requests are pushed onto the front, so pull from the back.
@@ -300,6 +400,9 @@ ConnPoolImpl::ActiveClient::ActiveClient(ConnPoolImpl& parent)
 }
 
 ConnPoolImpl::ActiveClient::~ActiveClient() {
+  if (prefetched_) {
+    parent_.host_->cluster().stats().upstream_cx_prefetch_unused_.inc();
+  }
   parent_.host_->cluster().stats().upstream_cx_active_.dec();
   parent_.host_->stats().cx_active_.dec();
   conn_length_->complete();
@@ -314,6 +417,23 @@ void ConnPoolImpl::ActiveClient::onConnectTimeout() {
   codec_client_->close();
 }
 
+void ConnPoolImpl::ActiveClient::onIdleTimeout() {
+  ENVOY_CONN_LOG(debug, "idle timeout", *codec_client_);
+  parent_.host_->cluster().stats().upstream_cx_idle_timeout_.inc();
+  codec_client_->close();
+}
+
+void ConnPoolImpl::ActiveClient::onMaxDurationTimeout() {
+  ENVOY_CONN_LOG(debug, "max connection duration reached", *codec_client_);
+  parent_.host_->cluster().stats().upstream_cx_max_duration_reached_.inc();
+  if (stream_wrapper_) {
+    // Let the active request finish. The connection is closed when the response is complete.
+    max_duration_reached_ = true;
+  } else {
+    codec_client_->close();
+  }
+}
+
 CodecClientPtr ConnPoolImplProd::createCodecClient(Upstream::Host::CreateConnectionData& data) {
   CodecClientPtr codec{new CodecClientProd(CodecClient::Type::HTTP1, std::move(data.connection_),
                                            data.host_description_)};
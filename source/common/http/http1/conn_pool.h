@@ -25,6 +25,17 @@ namespace Http1 {
  * NOTE: The connection pool does NOT do DNS resolution. It assumes it is being given a numeric IP
  *       address. Higher layer code should handle resolving DNS on error and creating a new pool
  *       bound to a different IP address.
+ *
+ * Connections can be opened ahead of demand, as configured by the cluster (@see
+ * ClusterInfo::prefetchMinIdleConnections() and ClusterInfo::prefetchRatioPercent()). For example
+ * a ratio of 150 keeps 3 connections open for 2 requests. The pool keeps
+ * max(active + min_idle_connections, active * ratio_percent / 100) connections, subject to the
+ * cluster's connection circuit breaker. Both default to 0 (no prefetching). Connections opened
+ * ahead of demand that fail to connect do not fail pending requests.
+ *
+ * Connections that sit in the ready list for longer than the cluster's idle timeout are closed.
+ * Connections older than the cluster's max connection duration are closed when idle, or once their
+ * active request completes.
  */
 class ConnPoolImpl : Logger::Loggable<Logger::Id::pool>, public ConnectionPool::Instance {
 public:
@@ -40,6 +51,7 @@ public:
   void closeConnections() override;
   ConnectionPool::Cancellable* newStream(StreamDecoder& response_decoder,
                                          ConnectionPool::Callbacks& callbacks) override;
+  void prefetch() override;
 
 protected:
   struct ActiveClient;
@@ -78,6 +90,8 @@ protected:
     ~ActiveClient();
 
     void onConnectTimeout();
+    void onIdleTimeout();
+    void onMaxDurationTimeout();
 
     // Network::ConnectionCallbacks
     void onEvent(Network::ConnectionEvent event) override {
@@ -91,8 +105,15 @@ protected:
     Upstream::HostDescriptionConstSharedPtr real_host_description_;
     StreamWrapperPtr stream_wrapper_;
     Event::TimerPtr connect_timer_;
+    // Only created if the cluster has an idle timeout or max connection duration.
+    Event::TimerPtr idle_timer_;
+    Event::TimerPtr max_duration_timer_;
     Stats::TimespanPtr conn_length_;
     uint64_t remaining_requests_;
+    // Opened by prefetch() and not yet used for a request.
+    bool prefetched_{};
+    // Close once the active request is complete.
+    bool max_duration_reached_{};
   };
 
   typedef std::unique_ptr<ActiveClient> ActiveClientPtr;
@@ -117,10 +138,13 @@ protected:
   virtual CodecClientPtr createCodecClient(Upstream::Host::CreateConnectionData& data) PURE;
   void checkForDrained();
   void createNewConnection();
+  void enableIdleTimer(ActiveClient& client);
+  void enableMaxDurationTimer(ActiveClient& client);
   void onConnectionEvent(ActiveClient& client, Network::ConnectionEvent event);
   void onDownstreamReset(ActiveClient& client);
   void onPendingRequestCancel(PendingRequest& request);
   void onResponseComplete(ActiveClient& client);
+  bool prefetchEnabled();
   void processIdleClient(ActiveClient& client);
 
   Stats::TimespanPtr conn_connect_ms_;
@@ -131,6 +155,8 @@ protected:
   std::list<PendingRequestPtr> pending_requests_;
   std::list<DrainedCb> drained_callbacks_;
   Upstream::ResourcePriority priority_;
+  // Clients in busy_clients_ that have not connected yet.
+  uint64_t connecting_clients_{};
 };
 
 /**
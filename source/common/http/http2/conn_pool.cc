@@ -92,6 +92,13 @@ ConnectionPool::Cancellable* ConnPoolImpl::newStream(Http::StreamDecoder& respon
     host_->cluster().stats().upstream_rq_pending_overflow_.inc();
   } else {
     ENVOY_CONN_LOG(debug, "creating stream", *primary_client_->client_);
+    if (primary_client_->prefetched_) {
+      primary_client_->prefetched_ = false;
+      host_->cluster().stats().upstream_cx_prefetch_used_.inc();
+    }
+    if (primary_client_->idle_timer_) {
+      primary_client_->idle_timer_->disableTimer();
+    }
     primary_client_->total_streams_++;
     host_->stats().rq_total_.inc();
     host_->stats().rq_active_.inc();
@@ -105,9 +112,28 @@ ConnectionPool::Cancellable* ConnPoolImpl::newStream(Http::StreamDecoder& respon
   return nullptr;
 }
 
+void ConnPoolImpl::prefetch() {
+  // All streams are multiplexed over the primary client, so warming the pool only means opening
+  // it before the first stream.
+  if (primary_client_ || !drained_callbacks_.empty()) {
+    return;
+  }
+
+  ENVOY_LOG(debug, "prefetching primary client");
+  primary_client_.reset(new ActiveClient(*this));
+  primary_client_->prefetched_ = true;
+  host_->cluster().stats().upstream_cx_prefetch_.inc();
+}
+
 void ConnPoolImpl::onConnectionEvent(ActiveClient& client, Network::ConnectionEvent event) {
   if (event == Network::ConnectionEvent::RemoteClose ||
       event == Network::ConnectionEvent::LocalClose) {
+    if (client.idle_timer_) {
+      client.idle_timer_->disableTimer();
+    }
+    if (client.max_duration_timer_) {
+      client.max_duration_timer_->disableTimer();
+    }
 
     if (client.closed_with_active_rq_) {
       host_->cluster().stats().upstream_cx_destroy_with_active_rq_.inc();
@@ -136,14 +162,41 @@ void ConnPoolImpl::onConnectionEvent(ActiveClient& client, Network::ConnectionEv
     }
   }
 
+  if (client.connect_timer_) {
+    client.connect_timer_->disableTimer();
+    client.connect_timer_.reset();
+  }
+
   if (event == Network::ConnectionEvent::Connected) {
     conn_connect_ms_->complete();
+    enableMaxDurationTimer(client);
+    if (client.client_->numActiveRequests() == 0) {
+      enableIdleTimer(client);
+    }
   }
+}
 
-  if (client.connect_timer_) {
-    client.connect_timer_->disableTimer();
-    client.connect_timer_.reset();
+void ConnPoolImpl::enableIdleTimer(ActiveClient& client) {
+  const std::chrono::milliseconds idle_timeout = host_->cluster().idleTimeout();
+  if (idle_timeout.count() == 0) {
+    return;
   }
+
+  if (!client.idle_timer_) {
+    client.idle_timer_ = dispatcher_.createTimer([&client]() -> void { client.onIdleTimeout(); });
+  }
+  client.idle_timer_->enableTimer(idle_timeout);
+}
+
+void ConnPoolImpl::enableMaxDurationTimer(ActiveClient& client) {
+  const std::chrono::milliseconds max_duration = host_->cluster().maxConnectionDuration();
+  if (max_duration.count() == 0) {
+    return;
+  }
+
+  client.max_duration_timer_ =
+      dispatcher_.createTimer([&client]() -> void { client.onMaxDurationTimeout(); });
+  client.max_duration_timer_->enableTimer(max_duration);
 }
 
 void ConnPoolImpl::movePrimaryClientToDraining() {
@@ -181,6 +234,22 @@ void ConnPoolImpl::onGoAway(ActiveClient& client) {
   }
 }
 
+void ConnPoolImpl::onIdleTimeout(ActiveClient& client) {
+  ENVOY_CONN_LOG(debug, "idle timeout", *client.client_);
+  ASSERT(client.client_->numActiveRequests() == 0);
+  host_->cluster().stats().upstream_cx_idle_timeout_.inc();
+  client.client_->close();
+}
+
+void ConnPoolImpl::onMaxDurationTimeout(ActiveClient& client) {
+  ENVOY_CONN_LOG(debug, "max connection duration reached", *client.client_);
+  host_->cluster().stats().upstream_cx_max_duration_reached_.inc();
+  if (&client == primary_client_.get()) {
+    // Existing streams finish on the draining client, new ones go to a new primary.
+    movePrimaryClientToDraining();
+  }
+}
+
 void ConnPoolImpl::onStreamDestroy(ActiveClient& client) {
   ENVOY_CONN_LOG(debug, "destroying stream: {} remaining", *client.client_,
                  client.client_->numActiveRequests());
@@ -190,6 +259,9 @@ void ConnPoolImpl::onStreamDestroy(ActiveClient& client) {
   if (&client == draining_client_.get() && client.client_->numActiveRequests() == 0) {
     // Close out the draining client if we no long have active requests.
     client.client_->close();
+  } else if (&client == primary_client_.get() && client.client_->numActiveRequests() == 0 &&
+             !client.connect_timer_ && !client.closed_with_active_rq_) {
+    enableIdleTimer(client);
   }
 
   // If we are destroying this stream because of a disconnect, do not check for drain here. We will
@@ -241,6 +313,9 @@ ConnPoolImpl::ActiveClient::ActiveClient(ConnPoolImpl& parent)
 }
 
 ConnPoolImpl::ActiveClient::~ActiveClient() {
+  if (prefetched_) {
+    parent_.host_->cluster().stats().upstream_cx_prefetch_unused_.inc();
+  }
   parent_.host_->stats().cx_active_.dec();
   parent_.host_->cluster().stats().upstream_cx_active_.dec();
   conn_length_->complete();
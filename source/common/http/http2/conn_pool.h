@@ -20,6 +20,10 @@ namespace Http2 {
  * Implementation of a "connection pool" for HTTP/2. This mainly handles stats as well as
  * shifting to a new connection if we reach max streams on the primary. This is a base class
  * used for both the prod implementation as well as the testing one.
+ *
+ * The primary connection is closed once it has had no active streams for the cluster's idle
+ * timeout. Once it is older than the cluster's max connection duration it is drained the same way
+ * as when max streams is reached.
  */
 class ConnPoolImpl : Logger::Loggable<Logger::Id::pool>, public ConnectionPool::Instance {
 public:
@@ -33,6 +37,7 @@ public:
   void closeConnections() override;
   ConnectionPool::Cancellable* newStream(Http::StreamDecoder& response_decoder,
                                          ConnectionPool::Callbacks& callbacks) override;
+  void prefetch() override;
 
 protected:
   struct ActiveClient : public Network::ConnectionCallbacks,
@@ -43,6 +48,8 @@ protected:
     ~ActiveClient();
 
     void onConnectTimeout() { parent_.onConnectTimeout(*this); }
+    void onIdleTimeout() { parent_.onIdleTimeout(*this); }
+    void onMaxDurationTimeout() { parent_.onMaxDurationTimeout(*this); }
 
     // Network::ConnectionCallbacks
     void onEvent(Network::ConnectionEvent event) override {
@@ -65,19 +72,28 @@ protected:
     Upstream::HostDescriptionConstSharedPtr real_host_description_;
     uint64_t total_streams_{};
     Event::TimerPtr connect_timer_;
+    // Only created if the cluster has an idle timeout or max connection duration.
+    Event::TimerPtr idle_timer_;
+    Event::TimerPtr max_duration_timer_;
     Stats::TimespanPtr conn_length_;
     bool closed_with_active_rq_{};
+    // Opened by prefetch() and not yet used for a stream.
+    bool prefetched_{};
   };
 
   typedef std::unique_ptr<ActiveClient> ActiveClientPtr;
 
   void checkForDrained();
   virtual CodecClientPtr createCodecClient(Upstream::Host::CreateConnectionData& data) PURE;
+  void enableIdleTimer(ActiveClient& client);
+  void enableMaxDurationTimer(ActiveClient& client);
   virtual uint32_t maxTotalStreams() PURE;
   void movePrimaryClientToDraining();
   void onConnectionEvent(ActiveClient& client, Network::ConnectionEvent event);
   void onConnectTimeout(ActiveClient& client);
   void onGoAway(ActiveClient& client);
+  void onIdleTimeout(ActiveClient& client);
+  void onMaxDurationTimeout(ActiveClient& client);
   void onStreamDestroy(ActiveClient& client);
   void onStreamReset(ActiveClient& client, Http::StreamResetReason reason);
 
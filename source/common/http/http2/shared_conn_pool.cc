@@ -0,0 +1,539 @@
+#include "common/http/http2/shared_conn_pool.h"
+
+#include <list>
+#include <memory>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/common/assert.h"
+#include "common/http/header_map_impl.h"
+
+namespace Envoy {
+namespace Http {
+namespace Http2 {
+
+bool GuardedDispatcher::post(Event::PostCb callback) {
+  std::unique_lock<std::mutex> lock(lock_);
+  if (!dispatcher_) {
+    return false;
+  }
+
+  dispatcher_->post(callback);
+  return true;
+}
+
+void GuardedDispatcher::close() {
+  std::unique_lock<std::mutex> lock(lock_);
+  dispatcher_ = nullptr;
+}
+
+ConnectionPool::InstancePtr
+SharedConnPoolRegistry::allocate(Event::Dispatcher& dispatcher, Upstream::HostConstSharedPtr host,
+                                 Upstream::ResourcePriority priority, PoolFactory factory) {
+  return ConnectionPool::InstancePtr{
+      new SharedConnPool(*this, dispatcher, host, priority, factory)};
+}
+
+SharedConnPoolOwnerSharedPtr
+SharedConnPoolRegistry::acquire(GuardedDispatcherSharedPtr dispatcher,
+                                Upstream::HostConstSharedPtr host,
+                                Upstream::ResourcePriority priority, const PoolFactory& factory,
+                                ConnectionPool::InstancePtr& owned_pool) {
+  std::unique_lock<std::mutex> lock(lock_);
+  std::weak_ptr<SharedConnPoolOwner>& entry = owners_[Key(host.get(), priority)];
+  SharedConnPoolOwnerSharedPtr owner = entry.lock();
+  if (owner && !owner->closed_) {
+    return owner;
+  }
+
+  // No open owner, the calling worker becomes the owner. The pool is created while holding the lock
+  // so that two workers racing here cannot both become the owner.
+  owner = std::make_shared<SharedConnPoolOwner>(dispatcher, host);
+  owned_pool = factory();
+  owner->pool_ = owned_pool.get();
+  entry = owner;
+  return owner;
+}
+
+void SharedConnPoolRegistry::release(const SharedConnPoolOwnerSharedPtr& owner,
+                                     Upstream::ResourcePriority priority) {
+  owner->closed_ = true;
+  owner->pool_ = nullptr;
+
+  std::unique_lock<std::mutex> lock(lock_);
+  auto it = owners_.find(Key(owner->host_.get(), priority));
+  if (it != owners_.end() && it->second.lock() == owner) {
+    owners_.erase(it);
+  }
+}
+
+SharedConnPool::SharedConnPool(SharedConnPoolRegistry& registry, Event::Dispatcher& dispatcher,
+                               Upstream::HostConstSharedPtr host,
+                               Upstream::ResourcePriority priority,
+                               SharedConnPoolRegistry::PoolFactory factory)
+    : registry_(registry), dispatcher_(new GuardedDispatcher(dispatcher)), host_(host),
+      priority_(priority), factory_(factory) {
+  owner_ = registry_.acquire(dispatcher_, host_, priority_, factory_, owned_pool_);
+}
+
+SharedConnPool::~SharedConnPool() {
+  if (owned_pool_ && !draining_) {
+    registry_.release(owner_, priority_);
+  }
+
+  // Streams from other workers fail with the pool. This does not wait for the pool to reset them
+  // since the owner worker may not get to run anything posted to it anymore.
+  if (owned_pool_) {
+    std::list<SharedConnPoolOwnedStream*> owned_streams(owner_->owned_streams_);
+    for (SharedConnPoolOwnedStream* stream : owned_streams) {
+      stream->onOwnerClose();
+    }
+  }
+
+  // Remote streams still running at this point are reset. Nothing is delivered back to this
+  // worker for them anymore.
+  std::list<RemoteStreamSharedPtr> streams;
+  streams.swap(streams_);
+  for (const RemoteStreamSharedPtr& stream : streams) {
+    stream->detached_ = true;
+    stream->postToOwner(
+        0, [](OwnerSide& owner_side) -> void { owner_side.reset(StreamResetReason::LocalReset); });
+  }
+
+  // This worker may be exiting, other workers must not post to its dispatcher anymore.
+  dispatcher_->close();
+}
+
+void SharedConnPool::addDrainedCallback(DrainedCb cb) {
+  drained_callbacks_.push_back(cb);
+  if (owned_pool_ && !draining_) {
+    // Other workers pick a new owner from here on. The real pool must not see any new streams once
+    // it is draining, so remote starts that are already in flight fail.
+    draining_ = true;
+    registry_.release(owner_, priority_);
+    owned_pool_->addDrainedCallback([this]() -> void {
+      owned_pool_drained_ = true;
+      checkForDrained();
+    });
+    return;
+  }
+
+  draining_ = true;
+  checkForDrained();
+}
+
+void SharedConnPool::checkForDrained() {
+  if (drained_callbacks_.empty() || !streams_.empty() || (owned_pool_ && !owned_pool_drained_)) {
+    return;
+  }
+
+  ENVOY_LOG(debug, "shared pool for {} drained", host_->address()->asString());
+  for (const DrainedCb& cb : drained_callbacks_) {
+    cb();
+  }
+}
+
+void SharedConnPool::closeConnections() {
+  // Only the owner has connections to close.
+  if (owned_pool_) {
+    owned_pool_->closeConnections();
+  }
+}
+
+ConnectionPool::Cancellable* SharedConnPool::newStream(Http::StreamDecoder& response_decoder,
+                                                       ConnectionPool::Callbacks& callbacks) {
+  ASSERT(!draining_);
+  if (owned_pool_) {
+    return owned_pool_->newStream(response_decoder, callbacks);
+  }
+
+  if (owner_->closed_) {
+    owner_ = registry_.acquire(dispatcher_, host_, priority_, factory_, owned_pool_);
+    if (owned_pool_) {
+      ENVOY_LOG(debug, "taking over shared pool for {}", host_->address()->asString());
+      return owned_pool_->newStream(response_decoder, callbacks);
+    }
+  }
+
+  host_->cluster().stats().upstream_rq_shared_pool_remote_.inc();
+  RemoteStreamSharedPtr stream(new RemoteStream(*this, owner_, response_decoder, callbacks));
+  streams_.push_front(stream);
+  stream->entry_ = streams_.begin();
+  stream->postToOwner(0, [](OwnerSide& owner_side) -> void { owner_side.start(); });
+
+  // Same as a regular pool, no handle is returned if the stream was already ready or failed.
+  return stream->ready_ || stream->detached_ ? nullptr : stream.get();
+}
+
+void SharedConnPool::prefetch() {
+  if (owned_pool_) {
+    owned_pool_->prefetch();
+    return;
+  }
+
+  SharedConnPoolOwnerSharedPtr owner = owner_;
+  owner->dispatcher_->post([owner]() -> void {
+    if (owner->pool_) {
+      owner->pool_->prefetch();
+    }
+  });
+}
+
+SharedConnPool::RemoteStream::RemoteStream(SharedConnPool& parent,
+                                           SharedConnPoolOwnerSharedPtr owner,
+                                           StreamDecoder& decoder,
+                                           ConnectionPool::Callbacks& callbacks)
+    : buffer_limit_(parent.host_->cluster().perConnectionBufferLimitBytes()), parent_(parent),
+      dispatcher_(parent.dispatcher_), owner_(owner), decoder_(decoder), callbacks_(callbacks),
+      owner_side_(*this) {}
+
+void SharedConnPool::RemoteStream::postToOwner(uint64_t bytes,
+                                               std::function<void(OwnerSide&)> cb) {
+  RemoteStreamSharedPtr self = shared_from_this();
+  bytes_to_owner_ += bytes;
+  const bool posted = owner_->dispatcher_->post([self, bytes, cb]() -> void {
+    cb(self->owner_side_);
+    self->owner_side_.onBytesToOwner(bytes);
+  });
+  if (!posted) {
+    // The owner worker is exiting and nothing posted to it will run, so the stream fails here.
+    bytes_to_owner_ -= bytes;
+    postToRequester([](RemoteStream& stream) -> void { stream.onOwnerGone(); });
+    return;
+  }
+
+  if (buffer_limit_ > 0 && !detached_ && !above_high_watermark_ &&
+      bytes_to_owner_ > buffer_limit_) {
+    above_high_watermark_ = true;
+    runHighWatermarkCallbacks();
+  }
+}
+
+void SharedConnPool::RemoteStream::postToRequester(std::function<void(RemoteStream&)> cb) {
+  RemoteStreamSharedPtr self = shared_from_this();
+  dispatcher_->post([self, cb]() -> void {
+    if (!self->detached_) {
+      cb(*self);
+    }
+  });
+}
+
+void SharedConnPool::RemoteStream::checkBytesToOwner() {
+  if (above_high_watermark_ && bytes_to_owner_ <= buffer_limit_ / 2) {
+    above_high_watermark_ = false;
+    runLowWatermarkCallbacks();
+  }
+}
+
+void SharedConnPool::RemoteStream::onBytesToRequester(uint64_t bytes) {
+  // Only crossing the low watermark is worth a post, the owner re-checks when it gets there.
+  const uint64_t low_watermark = buffer_limit_ / 2;
+  const uint64_t before = bytes_to_requester_.fetch_sub(bytes);
+  if (buffer_limit_ > 0 && before > low_watermark && before - bytes <= low_watermark) {
+    postToOwner(0, [](OwnerSide& owner_side) -> void { owner_side.checkBytesToRequester(); });
+  }
+}
+
+void SharedConnPool::RemoteStream::runHighWatermarkCallbacks() {
+  for (StreamCallbacks* callbacks : std::list<StreamCallbacks*>(stream_callbacks_)) {
+    callbacks->onAboveWriteBufferHighWatermark();
+  }
+}
+
+void SharedConnPool::RemoteStream::runLowWatermarkCallbacks() {
+  for (StreamCallbacks* callbacks : std::list<StreamCallbacks*>(stream_callbacks_)) {
+    callbacks->onBelowWriteBufferLowWatermark();
+  }
+}
+
+void SharedConnPool::RemoteStream::detach() {
+  if (detached_) {
+    return;
+  }
+
+  // Removing the stream from the parent may drop the last reference. Callers must not touch the
+  // stream after this returns.
+  RemoteStreamSharedPtr self = shared_from_this();
+  detached_ = true;
+  parent_.streams_.erase(entry_);
+  parent_.checkForDrained();
+}
+
+void SharedConnPool::RemoteStream::encodeHeaders(const HeaderMap& headers, bool end_stream) {
+  std::shared_ptr<HeaderMapImpl> copy(new HeaderMapImpl(headers));
+  postToOwner(copy->byteSize(), [copy, end_stream](OwnerSide& owner_side) -> void {
+    if (owner_side.encoder_) {
+      owner_side.encoder_->encodeHeaders(*copy, end_stream);
+      owner_side.onLocalEnd(end_stream);
+    }
+  });
+
+  local_end_ = end_stream;
+  if (local_end_ && remote_end_) {
+    detach();
+  }
+}
+
+void SharedConnPool::RemoteStream::encodeData(Buffer::Instance& data, bool end_stream) {
+  std::shared_ptr<Buffer::OwnedImpl> copy(new Buffer::OwnedImpl());
+  copy->move(data);
+  postToOwner(copy->length(), [copy, end_stream](OwnerSide& owner_side) -> void {
+    if (owner_side.encoder_) {
+      owner_side.encoder_->encodeData(*copy, end_stream);
+      owner_side.onLocalEnd(end_stream);
+    }
+  });
+
+  local_end_ = end_stream;
+  if (local_end_ && remote_end_) {
+    detach();
+  }
+}
+
+void SharedConnPool::RemoteStream::encodeTrailers(const HeaderMap& trailers) {
+  std::shared_ptr<HeaderMapImpl> copy(new HeaderMapImpl(trailers));
+  postToOwner(copy->byteSize(), [copy](OwnerSide& owner_side) -> void {
+    if (owner_side.encoder_) {
+      owner_side.encoder_->encodeTrailers(*copy);
+      owner_side.onLocalEnd(true);
+    }
+  });
+
+  local_end_ = true;
+  if (remote_end_) {
+    detach();
+  }
+}
+
+void SharedConnPool::RemoteStream::resetStream(StreamResetReason reason) {
+  if (detached_) {
+    return;
+  }
+
+  postToOwner(0, [reason](OwnerSide& owner_side) -> void { owner_side.reset(reason); });
+  for (StreamCallbacks* callbacks : std::list<StreamCallbacks*>(stream_callbacks_)) {
+    callbacks->onResetStream(reason);
+  }
+  detach();
+}
+
+void SharedConnPool::RemoteStream::readDisable(bool disable) {
+  postToOwner(0, [disable](OwnerSide& owner_side) -> void {
+    if (owner_side.encoder_) {
+      owner_side.encoder_->getStream().readDisable(disable);
+    }
+  });
+}
+
+void SharedConnPool::RemoteStream::onRemoteEnd() {
+  if (detached_) {
+    return;
+  }
+
+  remote_end_ = true;
+  if (local_end_) {
+    detach();
+  }
+}
+
+void SharedConnPool::RemoteStream::onRemoteReset(StreamResetReason reason) {
+  for (StreamCallbacks* callbacks : std::list<StreamCallbacks*>(stream_callbacks_)) {
+    callbacks->onResetStream(reason);
+  }
+  detach();
+}
+
+void SharedConnPool::RemoteStream::onOwnerGone() {
+  if (!ready_) {
+    callbacks_.onPoolFailure(ConnectionPool::PoolFailureReason::ConnectionFailure, owner_->host_);
+    detach();
+    return;
+  }
+
+  onRemoteReset(StreamResetReason::ConnectionFailure);
+}
+
+void SharedConnPool::OwnerSide::start() {
+  if (done_) {
+    return;
+  }
+
+  // The owner's pool and codec refer to this stream until it is done, keep it alive until then.
+  self_ = parent_.shared_from_this();
+  std::list<SharedConnPoolOwnedStream*>& owned_streams = parent_.owner_->owned_streams_;
+  entry_ = owned_streams.insert(owned_streams.end(), this);
+  ConnectionPool::Instance* pool = parent_.owner_->pool_;
+  if (!pool) {
+    onPoolFailure(ConnectionPool::PoolFailureReason::ConnectionFailure, parent_.owner_->host_);
+    return;
+  }
+
+  // The pool may call back into onPoolReady() or onPoolFailure() inline and return nullptr.
+  handle_ = pool->newStream(*this, *this);
+}
+
+void SharedConnPool::OwnerSide::reset(StreamResetReason reason) {
+  if (done_) {
+    return;
+  }
+
+  done_ = true;
+  if (handle_) {
+    handle_->cancel();
+    handle_ = nullptr;
+  } else if (encoder_) {
+    StreamEncoder* encoder = encoder_;
+    encoder_ = nullptr;
+    encoder->getStream().resetStream(reason);
+  }
+  onDone();
+}
+
+void SharedConnPool::OwnerSide::onLocalEnd(bool end_stream) {
+  local_end_ |= end_stream;
+  if (local_end_ && remote_end_) {
+    // The codec stream goes away once both directions are complete.
+    encoder_->getStream().removeCallbacks(*this);
+    onDone();
+  }
+}
+
+void SharedConnPool::OwnerSide::onRemoteEnd(bool end_stream) {
+  remote_end_ |= end_stream;
+  if (local_end_ && remote_end_) {
+    encoder_->getStream().removeCallbacks(*this);
+    onDone();
+  }
+}
+
+void SharedConnPool::OwnerSide::onDone() {
+  // Callers hold their own reference, so dropping the owner worker's one here cannot free the
+  // stream under them.
+  done_ = true;
+  encoder_ = nullptr;
+  if (self_) {
+    parent_.owner_->owned_streams_.erase(entry_);
+    self_.reset();
+  }
+}
+
+void SharedConnPool::OwnerSide::onOwnerClose() {
+  RemoteStreamSharedPtr self = parent_.shared_from_this();
+  reset(StreamResetReason::LocalReset);
+  parent_.postToRequester([](RemoteStream& stream) -> void { stream.onOwnerGone(); });
+}
+
+void SharedConnPool::OwnerSide::onBytesToOwner(uint64_t bytes) {
+  // Only crossing the low watermark is worth a post, the requester re-checks when it gets there.
+  const uint64_t low_watermark = parent_.buffer_limit_ / 2;
+  const uint64_t before = parent_.bytes_to_owner_.fetch_sub(bytes);
+  if (parent_.buffer_limit_ > 0 && before > low_watermark && before - bytes <= low_watermark) {
+    parent_.postToRequester([](RemoteStream& stream) -> void { stream.checkBytesToOwner(); });
+  }
+}
+
+void SharedConnPool::OwnerSide::checkBytesToRequester() {
+  if (read_disabled_ && parent_.bytes_to_requester_ <= parent_.buffer_limit_ / 2) {
+    read_disabled_ = false;
+    if (encoder_) {
+      encoder_->getStream().readDisable(false);
+    }
+  }
+}
+
+void SharedConnPool::OwnerSide::postToRequester(uint64_t bytes,
+                                                std::function<void(RemoteStream&)> cb) {
+  parent_.bytes_to_requester_ += bytes;
+  parent_.postToRequester([bytes, cb](RemoteStream& stream) -> void {
+    cb(stream);
+    stream.onBytesToRequester(bytes);
+  });
+
+  if (parent_.buffer_limit_ > 0 && encoder_ && !read_disabled_ &&
+      parent_.bytes_to_requester_ > parent_.buffer_limit_) {
+    read_disabled_ = true;
+    encoder_->getStream().readDisable(true);
+  }
+}
+
+void SharedConnPool::OwnerSide::decodeHeaders(HeaderMapPtr&& headers, bool end_stream) {
+  RemoteStreamSharedPtr self = parent_.shared_from_this();
+  const uint64_t bytes = headers->byteSize();
+  std::shared_ptr<HeaderMapPtr> holder(new HeaderMapPtr(std::move(headers)));
+  postToRequester(bytes, [holder, end_stream](RemoteStream& stream) -> void {
+    stream.decoder_.decodeHeaders(std::move(*holder), end_stream);
+    if (end_stream) {
+      stream.onRemoteEnd();
+    }
+  });
+  onRemoteEnd(end_stream);
+}
+
+void SharedConnPool::OwnerSide::decodeData(Buffer::Instance& data, bool end_stream) {
+  RemoteStreamSharedPtr self = parent_.shared_from_this();
+  std::shared_ptr<Buffer::OwnedImpl> copy(new Buffer::OwnedImpl());
+  copy->move(data);
+  postToRequester(copy->length(), [copy, end_stream](RemoteStream& stream) -> void {
+    stream.decoder_.decodeData(*copy, end_stream);
+    if (end_stream) {
+      stream.onRemoteEnd();
+    }
+  });
+  onRemoteEnd(end_stream);
+}
+
+void SharedConnPool::OwnerSide::decodeTrailers(HeaderMapPtr&& trailers) {
+  RemoteStreamSharedPtr self = parent_.shared_from_this();
+  const uint64_t bytes = trailers->byteSize();
+  std::shared_ptr<HeaderMapPtr> holder(new HeaderMapPtr(std::move(trailers)));
+  postToRequester(bytes, [holder](RemoteStream& stream) -> void {
+    stream.decoder_.decodeTrailers(std::move(*holder));
+    stream.onRemoteEnd();
+  });
+  onRemoteEnd(true);
+}
+
+void SharedConnPool::OwnerSide::onResetStream(StreamResetReason reason) {
+  if (done_) {
+    return;
+  }
+
+  RemoteStreamSharedPtr self = parent_.shared_from_this();
+  parent_.postToRequester(
+      [reason](RemoteStream& stream) -> void { stream.onRemoteReset(reason); });
+  onDone();
+}
+
+void SharedConnPool::OwnerSide::onAboveWriteBufferHighWatermark() {
+  parent_.postToRequester(
+      [](RemoteStream& stream) -> void { stream.runHighWatermarkCallbacks(); });
+}
+
+void SharedConnPool::OwnerSide::onBelowWriteBufferLowWatermark() {
+  parent_.postToRequester([](RemoteStream& stream) -> void { stream.runLowWatermarkCallbacks(); });
+}
+
+void SharedConnPool::OwnerSide::onPoolFailure(ConnectionPool::PoolFailureReason reason,
+                                              Upstream::HostDescriptionConstSharedPtr host) {
+  RemoteStreamSharedPtr self = parent_.shared_from_this();
+  handle_ = nullptr;
+  parent_.postToRequester([reason, host](RemoteStream& stream) -> void {
+    stream.callbacks_.onPoolFailure(reason, host);
+    stream.detach();
+  });
+  onDone();
+}
+
+void SharedConnPool::OwnerSide::onPoolReady(StreamEncoder& encoder,
+                                            Upstream::HostDescriptionConstSharedPtr host) {
+  handle_ = nullptr;
+  encoder_ = &encoder;
+  encoder.getStream().addCallbacks(*this);
+  parent_.postToRequester([host](RemoteStream& stream) -> void {
+    stream.ready_ = true;
+    stream.callbacks_.onPoolReady(stream, host);
+  });
+}
+
+} // namespace Http2
+} // namespace Http
+} // namespace Envoy
@@ -0,0 +1,302 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "envoy/event/dispatcher.h"
+#include "envoy/http/codec.h"
+#include "envoy/http/conn_pool.h"
+#include "envoy/upstream/upstream.h"
+
+#include "common/common/logger.h"
+
+namespace Envoy {
+namespace Http {
+namespace Http2 {
+
+/**
+ * A worker's dispatcher as seen from other workers. Once the worker's pool handle is destroyed the
+ * worker may be exiting and its dispatcher may go away at any time, so posts are dropped from then
+ * on.
+ */
+class GuardedDispatcher {
+public:
+  GuardedDispatcher(Event::Dispatcher& dispatcher) : dispatcher_(&dispatcher) {}
+
+  /**
+   * Post a callback to the worker.
+   * @return false if the worker is gone and the callback was dropped.
+   */
+  bool post(Event::PostCb callback);
+
+  /**
+   * Drop all posts from here on. Must be called on the worker before its dispatcher goes away.
+   */
+  void close();
+
+private:
+  std::mutex lock_;
+  Event::Dispatcher* dispatcher_;
+};
+
+typedef std::shared_ptr<GuardedDispatcher> GuardedDispatcherSharedPtr;
+
+/**
+ * The owner worker's side of a stream from another worker that runs on its pool.
+ */
+class SharedConnPoolOwnedStream {
+public:
+  virtual ~SharedConnPoolOwnedStream() {}
+
+  /**
+   * Called on the owner worker when its pool goes away while the stream is still running.
+   */
+  virtual void onOwnerClose() PURE;
+};
+
+/**
+ * State shared by every worker's handle on one shared HTTP/2 pool.
+ */
+struct SharedConnPoolOwner {
+  SharedConnPoolOwner(GuardedDispatcherSharedPtr dispatcher, Upstream::HostConstSharedPtr host)
+      : dispatcher_(dispatcher), host_(host) {}
+
+  // The dispatcher of the worker that owns the pool and its connections.
+  const GuardedDispatcherSharedPtr dispatcher_;
+  // Keeps the host (and hence the registry key) alive for as long as anyone refers to the owner.
+  const Upstream::HostConstSharedPtr host_;
+  // Only accessed on the owner worker. nullptr once the owner has stopped taking new streams.
+  ConnectionPool::Instance* pool_{};
+  // Set once the owner stops taking new streams so that other workers pick a new owner.
+  std::atomic<bool> closed_{};
+  // Only accessed on the owner worker. Streams from other workers that are running on the pool.
+  std::list<SharedConnPoolOwnedStream*> owned_streams_;
+};
+
+typedef std::shared_ptr<SharedConnPoolOwner> SharedConnPoolOwnerSharedPtr;
+
+/**
+ * Process wide index of shared HTTP/2 pools by host and priority. Thread safe.
+ */
+class SharedConnPoolRegistry {
+public:
+  typedef std::function<ConnectionPool::InstancePtr()> PoolFactory;
+
+  /**
+   * Allocate a pool handle for the calling worker. The first worker to ask for a host and priority
+   * (or the first one after the previous owner went away) creates the real pool with factory and
+   * owns its connections. Other workers get a handle that runs their streams on the owner's
+   * connections.
+   * @param dispatcher supplies the calling worker's dispatcher.
+   * @param host supplies the upstream host.
+   * @param priority supplies the resource priority of the pool.
+   * @param factory supplies a callback that allocates a regular pool on the calling worker.
+   */
+  ConnectionPool::InstancePtr allocate(Event::Dispatcher& dispatcher,
+                                       Upstream::HostConstSharedPtr host,
+                                       Upstream::ResourcePriority priority, PoolFactory factory);
+
+  /**
+   * @return the owner for a host and priority. If there is no open owner the calling worker becomes
+   *         the owner and the real pool is returned in owned_pool.
+   */
+  SharedConnPoolOwnerSharedPtr acquire(GuardedDispatcherSharedPtr dispatcher,
+                                       Upstream::HostConstSharedPtr host,
+                                       Upstream::ResourcePriority priority,
+                                       const PoolFactory& factory,
+                                       ConnectionPool::InstancePtr& owned_pool);
+
+  /**
+   * Close an owner so that no new streams are handed to it. Must be called on the owner worker.
+   */
+  void release(const SharedConnPoolOwnerSharedPtr& owner, Upstream::ResourcePriority priority);
+
+private:
+  typedef std::pair<const Upstream::Host*, Upstream::ResourcePriority> Key;
+
+  std::mutex lock_;
+  std::map<Key, std::weak_ptr<SharedConnPoolOwner>> owners_;
+};
+
+/**
+ * A worker's handle on a shared HTTP/2 pool. On the owner worker it is a thin wrapper around the
+ * real pool. On other workers each stream is proxied to the owner worker: encoder calls are posted
+ * to the owner and decoder and reset callbacks are posted back, with headers and data moved across.
+ * Headers and data that are in flight between workers count against the cluster's per connection
+ * buffer limit in each direction. Past the limit the requester's stream callbacks see a high
+ * watermark for upstream bound data, and the owner's stream is read disabled for downstream bound
+ * data. Write buffer watermarks of the owner's stream are forwarded to the requester as well.
+ */
+class SharedConnPool : public ConnectionPool::Instance, Logger::Loggable<Logger::Id::pool> {
+public:
+  SharedConnPool(SharedConnPoolRegistry& registry, Event::Dispatcher& dispatcher,
+                 Upstream::HostConstSharedPtr host, Upstream::ResourcePriority priority,
+                 SharedConnPoolRegistry::PoolFactory factory);
+  ~SharedConnPool();
+
+  // Http::ConnectionPool::Instance
+  Http::Protocol protocol() const override { return Http::Protocol::Http2; }
+  void addDrainedCallback(DrainedCb cb) override;
+  void closeConnections() override;
+  ConnectionPool::Cancellable* newStream(Http::StreamDecoder& response_decoder,
+                                         ConnectionPool::Callbacks& callbacks) override;
+  void prefetch() override;
+
+  bool isOwner() const { return owned_pool_ != nullptr; }
+
+private:
+  class RemoteStream;
+  typedef std::shared_ptr<RemoteStream> RemoteStreamSharedPtr;
+
+  /**
+   * The owner worker side of a remote stream. Only touched on the owner worker.
+   */
+  struct OwnerSide : public SharedConnPoolOwnedStream,
+                     public StreamDecoder,
+                     public StreamCallbacks,
+                     public ConnectionPool::Callbacks {
+    OwnerSide(RemoteStream& parent) : parent_(parent) {}
+
+    void start();
+    void reset(StreamResetReason reason);
+    void onLocalEnd(bool end_stream);
+    void onRemoteEnd(bool end_stream);
+    void onDone();
+    void onBytesToOwner(uint64_t bytes);
+    void checkBytesToRequester();
+    void postToRequester(uint64_t bytes, std::function<void(RemoteStream&)> cb);
+
+    // SharedConnPoolOwnedStream
+    void onOwnerClose() override;
+
+    // Http::StreamDecoder
+    void decodeHeaders(HeaderMapPtr&& headers, bool end_stream) override;
+    void decodeData(Buffer::Instance& data, bool end_stream) override;
+    void decodeTrailers(HeaderMapPtr&& trailers) override;
+
+    // Http::StreamCallbacks
+    void onResetStream(StreamResetReason reason) override;
+    void onAboveWriteBufferHighWatermark() override;
+    void onBelowWriteBufferLowWatermark() override;
+
+    // Http::ConnectionPool::Callbacks
+    void onPoolFailure(ConnectionPool::PoolFailureReason reason,
+                       Upstream::HostDescriptionConstSharedPtr host) override;
+    void onPoolReady(StreamEncoder& encoder, Upstream::HostDescriptionConstSharedPtr host) override;
+
+    RemoteStream& parent_;
+    // Held while the owner's pool or codec may still call into the stream.
+    RemoteStreamSharedPtr self_;
+    std::list<SharedConnPoolOwnedStream*>::iterator entry_;
+    ConnectionPool::Cancellable* handle_{};
+    StreamEncoder* encoder_{};
+    bool local_end_{};
+    bool remote_end_{};
+    bool done_{};
+    // Set while the owner's stream is read disabled because too much data is queued for the
+    // requester.
+    bool read_disabled_{};
+  };
+
+  /**
+   * A stream from this (non-owner) worker running on the owner's connections. The encoder and
+   * stream methods run on this worker; OwnerSide runs on the owner. All cross-thread calls hold a
+   * reference so that neither side can free the stream under the other.
+   */
+  class RemoteStream : public ConnectionPool::Cancellable,
+                       public StreamEncoder,
+                       public Stream,
+                       public std::enable_shared_from_this<RemoteStream> {
+  public:
+    RemoteStream(SharedConnPool& parent, SharedConnPoolOwnerSharedPtr owner,
+                 StreamDecoder& decoder, ConnectionPool::Callbacks& callbacks);
+
+    // Http::ConnectionPool::Cancellable
+    void cancel() override { resetStream(StreamResetReason::LocalReset); }
+
+    // Http::StreamEncoder
+    void encodeHeaders(const HeaderMap& headers, bool end_stream) override;
+    void encodeData(Buffer::Instance& data, bool end_stream) override;
+    void encodeTrailers(const HeaderMap& trailers) override;
+    Stream& getStream() override { return *this; }
+
+    // Http::Stream
+    void addCallbacks(StreamCallbacks& callbacks) override {
+      stream_callbacks_.push_back(&callbacks);
+    }
+    void removeCallbacks(StreamCallbacks& callbacks) override {
+      stream_callbacks_.remove(&callbacks);
+    }
+    void resetStream(StreamResetReason reason) override;
+    void readDisable(bool disable) override;
+    uint32_t bufferLimit() override { return buffer_limit_; }
+
+  private:
+    void detach();
+    void onRemoteEnd();
+    void onRemoteReset(StreamResetReason reason);
+    void onOwnerGone();
+    void onBytesToRequester(uint64_t bytes);
+    void checkBytesToOwner();
+    void runHighWatermarkCallbacks();
+    void runLowWatermarkCallbacks();
+    void postToOwner(uint64_t bytes, std::function<void(OwnerSide&)> cb);
+    void postToRequester(std::function<void(RemoteStream&)> cb);
+
+    // Maximum number of bytes in flight between the workers in each direction.
+    const uint32_t buffer_limit_;
+    // Bytes posted to the owner that it has not encoded yet. Added on the requester worker and
+    // subtracted on the owner worker.
+    std::atomic<uint64_t> bytes_to_owner_{};
+    // Bytes posted to the requester that it has not decoded yet. Added on the owner worker and
+    // subtracted on the requester worker.
+    std::atomic<uint64_t> bytes_to_requester_{};
+
+    // Requester worker state.
+    SharedConnPool& parent_;
+    // Outlives parent_, so it is safe to post to from the owner worker.
+    const GuardedDispatcherSharedPtr dispatcher_;
+    std::list<RemoteStreamSharedPtr>::iterator entry_;
+    const SharedConnPoolOwnerSharedPtr owner_;
+    StreamDecoder& decoder_;
+    ConnectionPool::Callbacks& callbacks_;
+    std::list<StreamCallbacks*> stream_callbacks_;
+    bool local_end_{};
+    bool remote_end_{};
+    bool ready_{};
+    bool detached_{};
+    // Set while the stream callbacks see a high watermark because too much data is queued for the
+    // owner.
+    bool above_high_watermark_{};
+
+    // Owner worker state.
+    OwnerSide owner_side_;
+
+    friend class SharedConnPool;
+    friend struct OwnerSide;
+  };
+
+  void checkForDrained();
+
+  SharedConnPoolRegistry& registry_;
+  const GuardedDispatcherSharedPtr dispatcher_;
+  Upstream::HostConstSharedPtr host_;
+  const Upstream::ResourcePriority priority_;
+  const SharedConnPoolRegistry::PoolFactory factory_;
+  SharedConnPoolOwnerSharedPtr owner_;
+  // Set if this worker owns the pool.
+  ConnectionPool::InstancePtr owned_pool_;
+  bool owned_pool_drained_{};
+  bool draining_{};
+  std::list<RemoteStreamSharedPtr> streams_;
+  std::list<DrainedCb> drained_callbacks_;
+};
+
+} // namespace Http2
+} // namespace Http
+} // namespace Envoy
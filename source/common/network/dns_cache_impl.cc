@@ -0,0 +1,211 @@
+#include "common/network/dns_cache_impl.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <string>
+
+#include "common/common/assert.h"
+#include "common/common/enum_to_int.h"
+
+#include "fmt/format.h"
+
+namespace Envoy {
+namespace Network {
+
+// Bound to references by std::max() and std::chrono, so it needs storage.
+const uint64_t CachingDnsResolverImpl::MIN_EVICTION_AGE_MS;
+
+CachingDnsResolverImpl::CachingDnsResolverImpl(DnsResolverSharedPtr resolver,
+                                               Runtime::Loader& runtime, Stats::Scope& scope,
+                                               MonotonicTimeSource& time_source)
+    : resolver_(resolver), runtime_(runtime), time_source_(time_source),
+      stats_(generateStats(scope)) {}
+
+CachingDnsResolverImpl::~CachingDnsResolverImpl() {
+  for (auto& entry : cache_) {
+    if (entry.second.active_query_) {
+      entry.second.active_query_->cancel();
+    }
+  }
+  if (!cache_.empty()) {
+    stats_.entries_.sub(cache_.size());
+  }
+}
+
+DnsCacheStats CachingDnsResolverImpl::generateStats(Stats::Scope& scope) {
+  std::string final_prefix = "dns_cache.";
+  return {ALL_DNS_CACHE_STATS(POOL_COUNTER_PREFIX(scope, final_prefix),
+                              POOL_GAUGE_PREFIX(scope, final_prefix))};
+}
+
+ActiveDnsQuery* CachingDnsResolverImpl::resolve(const std::string& dns_name,
+                                                DnsLookupFamily dns_lookup_family,
+                                                ResolveCb callback) {
+  return resolveWithTtl(dns_name, dns_lookup_family,
+                        [callback](std::list<Address::InstanceConstSharedPtr>&& address_list,
+                                   const Optional<std::chrono::seconds>&) -> void {
+                          callback(std::move(address_list));
+                        });
+}
+
+ActiveDnsQuery* CachingDnsResolverImpl::resolveWithTtl(const std::string& dns_name,
+                                                       DnsLookupFamily dns_lookup_family,
+                                                       ResolveWithTtlCb callback) {
+  const std::string key = fmt::format("{}/{}", enumToInt(dns_lookup_family), dns_name);
+  auto entry = cache_.find(key);
+  if (entry == cache_.end()) {
+    entry = cache_.emplace(key, CacheEntry(dns_name, dns_lookup_family)).first;
+    entry->second.lru_position_ = lru_.insert(lru_.end(), key);
+    stats_.entries_.inc();
+  } else {
+    lru_.splice(lru_.end(), lru_, entry->second.lru_position_);
+  }
+
+  CacheEntry& cache_entry = entry->second;
+  cache_entry.last_accessed_ = time_source_.currentTime();
+  // This entry was just moved to the back, so it is not evicted.
+  evictExpired();
+  if (cache_entry.has_result_) {
+    const Runtime::Snapshot& snapshot = runtime_.snapshot();
+    const std::chrono::milliseconds age = std::chrono::duration_cast<std::chrono::milliseconds>(
+        time_source_.currentTime() - cache_entry.resolved_at_);
+    if (cache_entry.addresses_.empty()) {
+      if (static_cast<uint64_t>(age.count()) <
+          snapshot.getInteger("dns_cache.negative_ttl_ms", DEFAULT_NEGATIVE_TTL_MS)) {
+        stats_.negative_hit_.inc();
+        callback({}, {});
+        return nullptr;
+      }
+    } else {
+      const uint64_t ttl_ms = snapshot.getInteger(
+          "dns_cache.ttl_ms",
+          cache_entry.ttl_.valid()
+              ? std::chrono::duration_cast<std::chrono::milliseconds>(cache_entry.ttl_.value())
+                    .count()
+              : DEFAULT_TTL_MS);
+      if (static_cast<uint64_t>(age.count()) < ttl_ms) {
+        stats_.hit_.inc();
+        callback(std::list<Address::InstanceConstSharedPtr>(cache_entry.addresses_),
+                 remainingTtl(cache_entry, age));
+        return nullptr;
+      }
+
+      if (static_cast<uint64_t>(age.count()) <
+          ttl_ms + snapshot.getInteger("dns_cache.stale_ms", DEFAULT_STALE_MS)) {
+        stats_.stale_hit_.inc();
+        if (!cache_entry.query_in_flight_) {
+          startQuery(key, cache_entry);
+        }
+        // The refresh may have completed inline, in which case the result is the fresh one.
+        const std::chrono::milliseconds new_age =
+            std::chrono::duration_cast<std::chrono::milliseconds>(time_source_.currentTime() -
+                                                                  cache_entry.resolved_at_);
+        callback(std::list<Address::InstanceConstSharedPtr>(cache_entry.addresses_),
+                 remainingTtl(cache_entry, new_age));
+        return nullptr;
+      }
+    }
+  }
+
+  // Either there is no usable result or it has expired. Wait for the current or a new query.
+  PendingResolution* pending = new PendingResolution(callback);
+  cache_entry.pending_.emplace_back(pending);
+  if (cache_entry.query_in_flight_) {
+    stats_.coalesced_.inc();
+    return pending;
+  }
+
+  stats_.miss_.inc();
+  startQuery(key, cache_entry);
+  // The query may have completed inline, in which case the callback already ran.
+  return cache_entry.query_in_flight_ ? pending : nullptr;
+}
+
+Optional<std::chrono::seconds>
+CachingDnsResolverImpl::remainingTtl(const CacheEntry& entry, std::chrono::milliseconds age) {
+  if (!entry.ttl_.valid()) {
+    return {};
+  }
+
+  const std::chrono::seconds age_s = std::chrono::duration_cast<std::chrono::seconds>(age);
+  return age_s < entry.ttl_.value() ? entry.ttl_.value() - age_s : std::chrono::seconds(0);
+}
+
+void CachingDnsResolverImpl::startQuery(const std::string& key, CacheEntry& entry) {
+  ENVOY_LOG(debug, "dns cache: resolving {}", entry.dns_name_);
+  stats_.query_.inc();
+  entry.query_in_flight_ = true;
+  ActiveDnsQuery* query = resolver_->resolveWithTtl(
+      entry.dns_name_, entry.dns_lookup_family_,
+      [this, key](std::list<Address::InstanceConstSharedPtr>&& address_list,
+                  const Optional<std::chrono::seconds>& ttl) -> void {
+        onQueryComplete(key, std::move(address_list), ttl);
+      });
+  if (entry.query_in_flight_) {
+    entry.active_query_ = query;
+  }
+}
+
+void CachingDnsResolverImpl::onQueryComplete(
+    const std::string& key, std::list<Address::InstanceConstSharedPtr>&& address_list,
+    const Optional<std::chrono::seconds>& ttl) {
+  evictExpired();
+
+  auto entry = cache_.find(key);
+  ASSERT(entry != cache_.end());
+  CacheEntry& cache_entry = entry->second;
+  ENVOY_LOG(debug, "dns cache: resolved {} to {} addresses", cache_entry.dns_name_,
+            address_list.size());
+  if (address_list.empty()) {
+    stats_.query_failure_.inc();
+  }
+
+  cache_entry.addresses_ = std::move(address_list);
+  cache_entry.ttl_ = ttl;
+  cache_entry.resolved_at_ = time_source_.currentTime();
+  cache_entry.has_result_ = true;
+  cache_entry.query_in_flight_ = false;
+  cache_entry.active_query_ = nullptr;
+
+  // Callbacks may resolve again (including this name) so run them from a local list.
+  std::list<PendingResolutionPtr> pending;
+  pending.swap(cache_entry.pending_);
+  const std::list<Address::InstanceConstSharedPtr> addresses = cache_entry.addresses_;
+  for (const PendingResolutionPtr& resolution : pending) {
+    if (!resolution->cancelled_) {
+      resolution->callback_(std::list<Address::InstanceConstSharedPtr>(addresses), ttl);
+    }
+  }
+}
+
+void CachingDnsResolverImpl::evictExpired() {
+  // Entries that nobody resolved for longer than they can be served are dropped. This bounds the
+  // cache to the names that are in use, e.g. after clusters are removed. Entries that are resolved
+  // often enough are kept however old their result is.
+  const Runtime::Snapshot& snapshot = runtime_.snapshot();
+  const std::chrono::milliseconds max_age(
+      std::max({snapshot.getInteger("dns_cache.ttl_ms", DEFAULT_TTL_MS) +
+                    snapshot.getInteger("dns_cache.stale_ms", DEFAULT_STALE_MS),
+                snapshot.getInteger("dns_cache.negative_ttl_ms", DEFAULT_NEGATIVE_TTL_MS),
+                MIN_EVICTION_AGE_MS}));
+  const MonotonicTime now = time_source_.currentTime();
+  // lru_ is ordered by last access, so the scan stops at the first entry that is recent enough.
+  // An entry with a query in flight also stops it, and is evicted by a later pass.
+  while (!lru_.empty()) {
+    auto entry = cache_.find(lru_.front());
+    ASSERT(entry != cache_.end());
+    if (entry->second.query_in_flight_ || now - entry->second.last_accessed_ < max_age) {
+      break;
+    }
+    ENVOY_LOG(debug, "dns cache: evicting {}", entry->second.dns_name_);
+    stats_.evicted_.inc();
+    stats_.entries_.dec();
+    cache_.erase(entry);
+    lru_.pop_front();
+  }
+}
+
+} // namespace Network
+} // namespace Envoy
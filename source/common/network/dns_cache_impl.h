@@ -0,0 +1,130 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "envoy/common/time.h"
+#include "envoy/network/dns.h"
+#include "envoy/runtime/runtime.h"
+#include "envoy/stats/stats.h"
+#include "envoy/stats/stats_macros.h"
+
+#include "common/common/logger.h"
+
+namespace Envoy {
+namespace Network {
+
+/**
+ * All DNS cache stats. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_DNS_CACHE_STATS(COUNTER, GAUGE)                                                        \
+  COUNTER(hit)                                                                                     \
+  COUNTER(stale_hit)                                                                               \
+  COUNTER(negative_hit)                                                                            \
+  COUNTER(miss)                                                                                    \
+  COUNTER(coalesced)                                                                               \
+  COUNTER(query)                                                                                   \
+  COUNTER(query_failure)                                                                           \
+  COUNTER(evicted)                                                                                 \
+  GAUGE  (entries)
+// clang-format on
+
+/**
+ * Struct definition for all DNS cache stats. @see stats_macros.h
+ */
+struct DnsCacheStats {
+  ALL_DNS_CACHE_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT)
+};
+
+/**
+ * A DnsResolver that caches the results of another resolver by name and lookup family. All
+ * clusters that share the wrapped resolver then share one query per name:
+ * - Concurrent resolutions of the same name are coalesced into a single query.
+ * - Results are served from the cache for their record TTL. "dns_cache.ttl_ms" overrides the
+ *   record TTL when set, and applies to results without one (e.g. IP literals and hosts file
+ *   entries). After that they are still served for "dns_cache.stale_ms" while a background query
+ *   refreshes them (stale while revalidate).
+ * - Failed resolutions (empty results) are cached for "dns_cache.negative_ttl_ms".
+ * - Entries that have not been resolved for a while are evicted. Entries are kept in least
+ *   recently resolved order, so each eviction pass only looks at the entries it evicts.
+ * The runtime keys are read on every resolution. With the defaults only results with a record TTL
+ * are cached, and they are never served past it.
+ *
+ * Cache hits complete inline, i.e. the callback is invoked before resolve() returns nullptr. Like
+ * the wrapped resolver, all calls and callbacks happen on the dispatcher thread of the resolver.
+ */
+class CachingDnsResolverImpl : public DnsResolver, Logger::Loggable<Logger::Id::upstream> {
+public:
+  CachingDnsResolverImpl(DnsResolverSharedPtr resolver, Runtime::Loader& runtime,
+                         Stats::Scope& scope, MonotonicTimeSource& time_source);
+  ~CachingDnsResolverImpl();
+
+  static const uint64_t DEFAULT_TTL_MS = 0;
+  static const uint64_t DEFAULT_STALE_MS = 0;
+  static const uint64_t DEFAULT_NEGATIVE_TTL_MS = 0;
+  // Entries are kept at least this long after they were last resolved so that names that are
+  // resolved periodically keep their entry even when nothing is cached.
+  static const uint64_t MIN_EVICTION_AGE_MS = 60000;
+
+  // Network::DnsResolver
+  ActiveDnsQuery* resolve(const std::string& dns_name, DnsLookupFamily dns_lookup_family,
+                          ResolveCb callback) override;
+  ActiveDnsQuery* resolveWithTtl(const std::string& dns_name, DnsLookupFamily dns_lookup_family,
+                                 ResolveWithTtlCb callback) override;
+
+private:
+  struct PendingResolution : public ActiveDnsQuery {
+    PendingResolution(ResolveWithTtlCb callback) : callback_(callback) {}
+
+    // Network::ActiveDnsQuery
+    void cancel() override { cancelled_ = true; }
+
+    const ResolveWithTtlCb callback_;
+    bool cancelled_{};
+  };
+
+  typedef std::unique_ptr<PendingResolution> PendingResolutionPtr;
+
+  struct CacheEntry {
+    CacheEntry(const std::string& dns_name, DnsLookupFamily dns_lookup_family)
+        : dns_name_(dns_name), dns_lookup_family_(dns_lookup_family) {}
+
+    const std::string dns_name_;
+    const DnsLookupFamily dns_lookup_family_;
+    std::list<Address::InstanceConstSharedPtr> addresses_;
+    Optional<std::chrono::seconds> ttl_;
+    MonotonicTime resolved_at_;
+    MonotonicTime last_accessed_;
+    bool has_result_{};
+    bool query_in_flight_{};
+    ActiveDnsQuery* active_query_{};
+    std::list<PendingResolutionPtr> pending_;
+    // Position of the key in lru_.
+    std::list<std::string>::iterator lru_position_;
+  };
+
+  static DnsCacheStats generateStats(Stats::Scope& scope);
+  void startQuery(const std::string& key, CacheEntry& entry);
+  void onQueryComplete(const std::string& key,
+                       std::list<Address::InstanceConstSharedPtr>&& address_list,
+                       const Optional<std::chrono::seconds>& ttl);
+  static Optional<std::chrono::seconds> remainingTtl(const CacheEntry& entry,
+                                                     std::chrono::milliseconds age);
+  void evictExpired();
+
+  DnsResolverSharedPtr resolver_;
+  Runtime::Loader& runtime_;
+  MonotonicTimeSource& time_source_;
+  DnsCacheStats stats_;
+  std::unordered_map<std::string, CacheEntry> cache_;
+  // Keys of cache_, least recently resolved first.
+  std::list<std::string> lru_;
+};
+
+} // namespace Network
+} // namespace Envoy
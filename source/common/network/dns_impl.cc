@@ -1,14 +1,18 @@
 #include "common/network/dns_impl.h"
 
+#include <arpa/inet.h>
+#include <arpa/nameser.h>
 #include <netdb.h>
 #include <netinet/ip.h>
 #include <sys/socket.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <list>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "common/common/assert.h"
 #include "common/network/address_impl.h"
@@ -61,16 +65,6 @@ void DnsResolverImpl::initializeChannel(ares_options* options, int optmask) {
 
 void DnsResolverImpl::PendingResolution::onAresHostCallback(int status, int timeouts,
                                                             hostent* hostent) {
-  // We receive ARES_EDESTRUCTION when destructing with pending queries.
-  if (status == ARES_EDESTRUCTION) {
-    ASSERT(owned_);
-    delete this;
-    return;
-  }
-  if (status == ARES_SUCCESS || !fallback_if_failed_) {
-    completed_ = true;
-  }
-
   std::list<Address::InstanceConstSharedPtr> address_list;
   if (status == ARES_SUCCESS) {
     if (hostent->h_addrtype == AF_INET) {
@@ -96,13 +90,85 @@ void DnsResolverImpl::PendingResolution::onAresHostCallback(int status, int time
     }
   }
 
+  onResolutionComplete(status, timeouts, std::move(address_list), {});
+}
+
+int DnsResolverImpl::PendingResolution::answerCount(const unsigned char* abuf, int alen) {
+  // ANCOUNT is the big endian 16 bit field at offset 6 of the fixed size header.
+  return alen >= HFIXEDSZ ? (abuf[6] << 8) | abuf[7] : 0;
+}
+
+void DnsResolverImpl::PendingResolution::onAresQueryCallback(int status, int timeouts,
+                                                             unsigned char* abuf, int alen) {
+  std::list<Address::InstanceConstSharedPtr> address_list;
+  Optional<std::chrono::seconds> ttl;
+  if (status == ARES_SUCCESS) {
+    // Size the record arrays from the response so that no address in it is dropped.
+    int num_records = answerCount(abuf, alen);
+    int min_ttl = 0;
+    if (family_ == AF_INET) {
+      std::vector<ares_addrttl> records(num_records);
+      status = ares_parse_a_reply(abuf, alen, nullptr, records.data(), &num_records);
+      for (int i = 0; status == ARES_SUCCESS && i < num_records; ++i) {
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = 0;
+        address.sin_addr = records[i].ipaddr;
+        address_list.emplace_back(new Address::Ipv4Instance(&address));
+        min_ttl = i == 0 ? records[i].ttl : std::min(min_ttl, records[i].ttl);
+      }
+    } else {
+      std::vector<ares_addr6ttl> records(num_records);
+      status = ares_parse_aaaa_reply(abuf, alen, nullptr, records.data(), &num_records);
+      for (int i = 0; status == ARES_SUCCESS && i < num_records; ++i) {
+        sockaddr_in6 address;
+        memset(&address, 0, sizeof(address));
+        address.sin6_family = AF_INET6;
+        address.sin6_port = 0;
+        static_assert(sizeof(address.sin6_addr) == sizeof(records[i].ip6addr),
+                      "unexpected ares_in6_addr size");
+        memcpy(&address.sin6_addr, &records[i].ip6addr, sizeof(address.sin6_addr));
+        address_list.emplace_back(new Address::Ipv6Instance(address));
+        min_ttl = i == 0 ? records[i].ttl : std::min(min_ttl, records[i].ttl);
+      }
+    }
+
+    if (status == ARES_SUCCESS && address_list.empty()) {
+      status = ARES_ENODATA;
+    }
+    if (status == ARES_SUCCESS) {
+      ttl.value(std::chrono::seconds(std::max(min_ttl, 0)));
+    }
+  }
+
+  onResolutionComplete(status, timeouts, std::move(address_list), ttl);
+}
+
+void DnsResolverImpl::PendingResolution::onResolutionComplete(
+    int status, int timeouts, std::list<Address::InstanceConstSharedPtr>&& address_list,
+    const Optional<std::chrono::seconds>& ttl) {
+  // We receive ARES_EDESTRUCTION when destructing with pending queries.
+  if (status == ARES_EDESTRUCTION) {
+    ASSERT(owned_);
+    delete this;
+    return;
+  }
+  if (status == ARES_SUCCESS || !fallback_if_failed_) {
+    completed_ = true;
+  }
+
+  if (status != ARES_SUCCESS) {
+    address_list.clear();
+  }
+
   if (timeouts > 0) {
     ENVOY_LOG(debug, "DNS request timed out {} times", timeouts);
   }
 
   if (completed_) {
     if (!cancelled_) {
-      callback_(std::move(address_list));
+      callback_(std::move(address_list), ttl);
     }
     if (owned_) {
       delete this;
@@ -163,6 +229,16 @@ void DnsResolverImpl::onAresSocketStateChange(int fd, int read, int write) {
 
 ActiveDnsQuery* DnsResolverImpl::resolve(const std::string& dns_name,
                                          DnsLookupFamily dns_lookup_family, ResolveCb callback) {
+  return resolveWithTtl(dns_name, dns_lookup_family,
+                        [callback](std::list<Address::InstanceConstSharedPtr>&& address_list,
+                                   const Optional<std::chrono::seconds>&) -> void {
+                          callback(std::move(address_list));
+                        });
+}
+
+ActiveDnsQuery* DnsResolverImpl::resolveWithTtl(const std::string& dns_name,
+                                                DnsLookupFamily dns_lookup_family,
+                                                ResolveWithTtlCb callback) {
   // TODO(hennna): Add DNS caching which will allow testing the edge case of a
   // failed intial call to getHostbyName followed by a synchronous IPv4
   // resolution.
@@ -194,12 +270,39 @@ ActiveDnsQuery* DnsResolverImpl::resolve(const std::string& dns_name,
 }
 
 void DnsResolverImpl::PendingResolution::getHostByName(int family) {
-  ares_gethostbyname(channel_, dns_name_.c_str(), family,
-                     [](void* arg, int status, int timeouts, hostent* hostent) {
-                       static_cast<PendingResolution*>(arg)->onAresHostCallback(status, timeouts,
-                                                                                hostent);
-                     },
-                     this);
+  family_ = family;
+
+  // The hosts file is checked first, as ares_gethostbyname() does with the default lookup order.
+  hostent* file_hostent;
+  if (ares_gethostbyname_file(channel_, dns_name_.c_str(), family, &file_hostent) ==
+      ARES_SUCCESS) {
+    onAresHostCallback(ARES_SUCCESS, 0, file_hostent);
+    // Note: this object may have been deleted by the callback.
+    ares_free_hostent(file_hostent);
+    return;
+  }
+
+  // IP literals are turned into a hostent by ares_gethostbyname() without a query.
+  in6_addr literal;
+  if (inet_pton(AF_INET, dns_name_.c_str(), &literal) == 1 ||
+      inet_pton(AF_INET6, dns_name_.c_str(), &literal) == 1) {
+    ares_gethostbyname(channel_, dns_name_.c_str(), family,
+                       [](void* arg, int status, int timeouts, hostent* hostent) {
+                         static_cast<PendingResolution*>(arg)->onAresHostCallback(status, timeouts,
+                                                                                  hostent);
+                       },
+                       this);
+    return;
+  }
+
+  // ares_search() applies search domains the same way as ares_gethostbyname(), and unlike it the
+  // response gives access to the record TTLs.
+  ares_search(channel_, dns_name_.c_str(), ns_c_in, family == AF_INET ? ns_t_a : ns_t_aaaa,
+              [](void* arg, int status, int timeouts, unsigned char* abuf, int alen) {
+                static_cast<PendingResolution*>(arg)->onAresQueryCallback(status, timeouts, abuf,
+                                                                          alen);
+              },
+              this);
 }
 
 } // namespace Network
@@ -2,7 +2,9 @@
 
 #include <netdb.h>
 
+#include <chrono>
 #include <cstdint>
+#include <list>
 #include <string>
 #include <unordered_map>
 
@@ -34,12 +36,15 @@ public:
   // Network::DnsResolver
   ActiveDnsQuery* resolve(const std::string& dns_name, DnsLookupFamily dns_lookup_family,
                           ResolveCb callback) override;
+  ActiveDnsQuery* resolveWithTtl(const std::string& dns_name, DnsLookupFamily dns_lookup_family,
+                                 ResolveWithTtlCb callback) override;
 
 private:
   friend class DnsResolverImplPeer;
   struct PendingResolution : public ActiveDnsQuery {
     // Network::ActiveDnsQuery
-    PendingResolution(ResolveCb callback, ares_channel channel, const std::string& dns_name)
+    PendingResolution(ResolveWithTtlCb callback, ares_channel channel,
+                      const std::string& dns_name)
         : callback_(callback), channel_(channel), dns_name_(dns_name) {}
 
     void cancel() override {
@@ -49,20 +54,38 @@ private:
     }
 
     /**
-     * c-ares ares_gethostbyname() query callback.
+     * c-ares ares_gethostbyname() query callback. Only used for names that resolve without a DNS
+     * query (IP literals and the hosts file), so there is no TTL.
      * @param status return status of call to ares_gethostbyname.
      * @param timeouts the number of times the request timed out.
      * @param hostent structure that stores information about a given host.
      */
     void onAresHostCallback(int status, int timeouts, hostent* hostent);
     /**
-     * wrapper function of call to ares_gethostbyname.
+     * c-ares ares_search() query callback.
+     * @param status return status of call to ares_search.
+     * @param timeouts the number of times the request timed out.
+     * @param abuf the DNS response.
+     * @param alen the length of abuf.
+     */
+    void onAresQueryCallback(int status, int timeouts, unsigned char* abuf, int alen);
+    /**
+     * @return int the number of answer records announced in the header of a DNS response, which
+     *         bounds the number of A or AAAA records in it.
+     */
+    static int answerCount(const unsigned char* abuf, int alen);
+    void onResolutionComplete(int status, int timeouts,
+                              std::list<Address::InstanceConstSharedPtr>&& address_list,
+                              const Optional<std::chrono::seconds>& ttl);
+    /**
+     * Resolve dns_name_ for a family. Names in the hosts file and IP literals are resolved without
+     * a query, everything else with an A or AAAA query so that record TTLs are known.
      * @param family currently AF_INET and AF_INET6 are supported.
      */
     void getHostByName(int family);
 
     // Caller supplied callback to invoke on query completion or error.
-    const ResolveCb callback_;
+    const ResolveWithTtlCb callback_;
     // Does the object own itself? Resource reclamation occurs via self-deleting
     // on query completion or error.
     bool owned_ = false;
@@ -75,6 +98,8 @@ private:
     bool fallback_if_failed_ = false;
     const ares_channel channel_;
     const std::string dns_name_;
+    // The family of the current query.
+    int family_{};
   };
 
   // Callback for events on sockets tracked in events_.
@@ -647,6 +647,7 @@ void Filter::onUpstreamComplete() {
         std::chrono::steady_clock::now() - downstream_request_complete_time_);
 
     upstream_request_->upstream_host_->outlierDetector().putResponseTime(response_time);
+    upstream_request_->upstream_host_->latencyMonitor().putResponseTime(response_time);
 
     const Http::HeaderEntry* internal_request_header = downstream_headers_->EnvoyInternalRequest();
     const bool internal_request =
@@ -0,0 +1,194 @@
+#include "common/stats/histogram_impl.h"
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common/common/assert.h"
+#include "common/common/macros.h"
+
+#include "fmt/format.h"
+
+namespace Envoy {
+namespace Stats {
+
+void LogLinearHistogram::recordValue(uint64_t value) {
+  const uint32_t index = bucketIndex(value);
+  if (index < EXACT_BUCKETS) {
+    exact_buckets_[index]++;
+  } else {
+    std::unique_ptr<Decade>& decade = decades_[(index - EXACT_BUCKETS) / BUCKETS_PER_DECADE];
+    if (!decade) {
+      decade.reset(new Decade());
+    }
+    (*decade)[(index - EXACT_BUCKETS) % BUCKETS_PER_DECADE]++;
+  }
+  sample_count_++;
+  sample_sum_ += value;
+}
+
+void LogLinearHistogram::merge(const LogLinearHistogram& other) {
+  for (size_t i = 0; i < EXACT_BUCKETS; i++) {
+    exact_buckets_[i] += other.exact_buckets_[i];
+  }
+  for (size_t i = 0; i < DECADES; i++) {
+    if (!other.decades_[i]) {
+      continue;
+    }
+    if (!decades_[i]) {
+      decades_[i].reset(new Decade(*other.decades_[i]));
+      continue;
+    }
+    for (size_t j = 0; j < BUCKETS_PER_DECADE; j++) {
+      (*decades_[i])[j] += (*other.decades_[i])[j];
+    }
+  }
+  sample_count_ += other.sample_count_;
+  sample_sum_ += other.sample_sum_;
+}
+
+void LogLinearHistogram::clear() {
+  exact_buckets_.fill(0);
+  // The decades stay allocated so that recording into them again does not allocate.
+  for (std::unique_ptr<Decade>& decade : decades_) {
+    if (decade) {
+      decade->fill(0);
+    }
+  }
+  sample_count_ = 0;
+  sample_sum_ = 0;
+}
+
+void LogLinearHistogram::forEachBucket(BucketCb cb) const {
+  for (size_t i = 0; i < EXACT_BUCKETS; i++) {
+    if (exact_buckets_[i] > 0) {
+      cb(i, 0, exact_buckets_[i]);
+    }
+  }
+  for (size_t i = 0; i < DECADES; i++) {
+    if (!decades_[i]) {
+      continue;
+    }
+    for (size_t j = 0; j < BUCKETS_PER_DECADE; j++) {
+      if ((*decades_[i])[j] > 0) {
+        const uint32_t index = EXACT_BUCKETS + i * BUCKETS_PER_DECADE + j;
+        cb(bucketLowerBound(index), bucketWidth(index), (*decades_[i])[j]);
+      }
+    }
+  }
+}
+
+double LogLinearHistogram::quantile(double quantile) const {
+  ASSERT(quantile >= 0 && quantile <= 1);
+  if (sample_count_ == 0) {
+    return 0;
+  }
+
+  // Find the bucket holding the sample at the requested rank and assume the samples are spread
+  // evenly over the bucket.
+  const double rank = quantile * sample_count_;
+  uint64_t samples_below = 0;
+  double value = 0;
+  bool found = false;
+  forEachBucket([&](double lower_bound, double width, uint64_t count) -> void {
+    if (found) {
+      return;
+    }
+    if (rank <= samples_below + count) {
+      value = lower_bound + (rank - samples_below) / count * width;
+      found = true;
+    }
+    samples_below += count;
+  });
+  ASSERT(found);
+  return value;
+}
+
+uint64_t LogLinearHistogram::countLessOrEqual(double bound) const {
+  double count = 0;
+  forEachBucket([&](double lower_bound, double width, uint64_t bucket_count) -> void {
+    if (lower_bound + width <= bound) {
+      count += bucket_count;
+    } else if (lower_bound <= bound) {
+      count += width == 0 ? bucket_count : bucket_count * (bound - lower_bound) / width;
+    }
+  });
+  return std::llround(count);
+}
+
+uint32_t LogLinearHistogram::bucketIndex(uint64_t value) {
+  if (value < EXACT_BUCKETS) {
+    return value;
+  }
+
+  // Reduce the value to its two most significant digits, which are in [10, 99].
+  uint32_t exponent = 0;
+  while (value >= 100) {
+    value /= 10;
+    exponent++;
+  }
+  return EXACT_BUCKETS + (exponent - 1) * BUCKETS_PER_DECADE + (value - 10);
+}
+
+double LogLinearHistogram::bucketLowerBound(uint32_t index) {
+  if (index < EXACT_BUCKETS) {
+    return index;
+  }
+
+  const uint32_t exponent = (index - EXACT_BUCKETS) / BUCKETS_PER_DECADE + 1;
+  const uint32_t mantissa = (index - EXACT_BUCKETS) % BUCKETS_PER_DECADE + 10;
+  return mantissa * std::pow(10.0, exponent);
+}
+
+double LogLinearHistogram::bucketWidth(uint32_t index) {
+  // Exact buckets hold a single value.
+  if (index < EXACT_BUCKETS) {
+    return 0;
+  }
+
+  return std::pow(10.0, (index - EXACT_BUCKETS) / BUCKETS_PER_DECADE + 1);
+}
+
+HistogramStatisticsImpl::HistogramStatisticsImpl()
+    : computed_quantiles_(supportedQuantiles().size(), 0),
+      computed_buckets_(supportedBuckets().size(), 0) {}
+
+void HistogramStatisticsImpl::refresh(const LogLinearHistogram& histogram) {
+  const std::vector<double>& quantiles = supportedQuantiles();
+  for (size_t i = 0; i < quantiles.size(); i++) {
+    computed_quantiles_[i] = histogram.quantile(quantiles[i]);
+  }
+  const std::vector<double>& buckets = supportedBuckets();
+  for (size_t i = 0; i < buckets.size(); i++) {
+    computed_buckets_[i] = histogram.countLessOrEqual(buckets[i]);
+  }
+  sample_count_ = histogram.sampleCount();
+  sample_sum_ = histogram.sampleSum();
+}
+
+std::string HistogramStatisticsImpl::summary() const {
+  std::string summary;
+  const std::vector<double>& quantiles = supportedQuantiles();
+  for (size_t i = 0; i < quantiles.size(); i++) {
+    if (i > 0) {
+      summary += ", ";
+    }
+    summary += fmt::format("P{:g}: {}", quantiles[i] * 100, computed_quantiles_[i]);
+  }
+  return summary;
+}
+
+const std::vector<double>& HistogramStatisticsImpl::supportedQuantiles() const {
+  CONSTRUCT_ON_FIRST_USE(std::vector<double>, {0, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 0.999, 1});
+}
+
+const std::vector<double>& HistogramStatisticsImpl::supportedBuckets() const {
+  // Most histograms are latencies in milliseconds, so the bounds go from 0.5ms to an hour.
+  CONSTRUCT_ON_FIRST_USE(std::vector<double>,
+                         {0.5, 1, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000,
+                          60000, 300000, 600000, 1800000, 3600000});
+}
+
+} // namespace Stats
+} // namespace Envoy
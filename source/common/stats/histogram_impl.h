@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "envoy/stats/stats.h"
+
+namespace Envoy {
+namespace Stats {
+
+/**
+ * Log-linear histogram sketch in the style of circllhist. Values below 100 are counted exactly.
+ * Larger values are bucketed by their two most significant decimal digits and their decimal
+ * exponent, e.g. 12345 goes to the bucket [12000, 13000). That bounds the relative error of any
+ * quantile to 10% with at most 90 buckets per decade. Bucket counts live in fixed arrays: the exact
+ * buckets inline and one array per decade, allocated the first time a value in that decade is
+ * recorded and kept (zeroed) by clear(), so recording into a sketch that was used before never
+ * allocates. Sketches are merged by adding bucket counts, so values can be recorded into
+ * independent sketches (one per thread) and combined later without losing accuracy.
+ *
+ * This class is not thread safe.
+ */
+class LogLinearHistogram {
+public:
+  void recordValue(uint64_t value);
+  void merge(const LogLinearHistogram& other);
+  void clear();
+
+  uint64_t sampleCount() const { return sample_count_; }
+  uint64_t sampleSum() const { return sample_sum_; }
+
+  /**
+   * @param quantile supplies the quantile in the range [0, 1].
+   * @return the approximate value at the quantile, interpolated linearly within its bucket. 0 if
+   *         no values were recorded.
+   */
+  double quantile(double quantile) const;
+
+  /**
+   * @param bound supplies an upper bound.
+   * @return the approximate number of values less than or equal to bound, assuming the values in
+   *         the bucket that bound falls into are spread evenly over it.
+   */
+  uint64_t countLessOrEqual(double bound) const;
+
+  /**
+   * Calls cb with the lower bound, the width and the count of each non-empty bucket, in ascending
+   * order.
+   */
+  typedef std::function<void(double lower_bound, double width, uint64_t count)> BucketCb;
+  void forEachBucket(BucketCb cb) const;
+
+  static uint32_t bucketIndex(uint64_t value);
+  static double bucketLowerBound(uint32_t index);
+  static double bucketWidth(uint32_t index);
+
+private:
+  // Values below this are counted in their own bucket.
+  static const uint64_t EXACT_BUCKETS = 100;
+  static const uint64_t BUCKETS_PER_DECADE = 90;
+  // Values from 100 up to UINT64_MAX (1.8e19) span 18 decades.
+  static const uint64_t DECADES = 18;
+
+  typedef std::array<uint64_t, BUCKETS_PER_DECADE> Decade;
+
+  std::array<uint64_t, EXACT_BUCKETS> exact_buckets_{};
+  std::array<std::unique_ptr<Decade>, DECADES> decades_;
+  uint64_t sample_count_{};
+  uint64_t sample_sum_{};
+};
+
+/**
+ * Quantiles computed from a LogLinearHistogram.
+ */
+class HistogramStatisticsImpl : public HistogramStatistics {
+public:
+  HistogramStatisticsImpl();
+  HistogramStatisticsImpl(const LogLinearHistogram& histogram) : HistogramStatisticsImpl() {
+    refresh(histogram);
+  }
+
+  void refresh(const LogLinearHistogram& histogram);
+
+  // Stats::HistogramStatistics
+  std::string summary() const override;
+  const std::vector<double>& supportedQuantiles() const override;
+  const std::vector<double>& computedQuantiles() const override { return computed_quantiles_; }
+  const std::vector<double>& supportedBuckets() const override;
+  const std::vector<uint64_t>& computedBuckets() const override { return computed_buckets_; }
+  uint64_t sampleCount() const override { return sample_count_; }
+  uint64_t sampleSum() const override { return sample_sum_; }
+
+private:
+  std::vector<double> computed_quantiles_;
+  std::vector<uint64_t> computed_buckets_;
+  uint64_t sample_count_{};
+  uint64_t sample_sum_{};
+};
+
+} // namespace Stats
+} // namespace Envoy
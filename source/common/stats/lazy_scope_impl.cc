@@ -0,0 +1,49 @@
+#include "common/stats/lazy_scope_impl.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace Envoy {
+namespace Stats {
+
+LazyScopeImpl::~LazyScopeImpl() {
+  if (pending_stats_ > 0) {
+    pending_.sub(pending_stats_);
+  }
+}
+
+ScopePtr LazyScopeImpl::createScope(const std::string& name) {
+  // Nested scopes allocate lazily too, in the matching scope of the parent.
+  return ScopePtr{new LazyScopeImpl(parent_.createScope(name), pending_)};
+}
+
+Counter& LazyScopeImpl::counter(const std::string& name) { return getOrCreate(counters_, name); }
+
+Gauge& LazyScopeImpl::gauge(const std::string& name) { return getOrCreate(gauges_, name); }
+
+Histogram& LazyScopeImpl::histogram(const std::string& name) {
+  return getOrCreate(histograms_, name);
+}
+
+template <class Impl>
+Impl& LazyScopeImpl::getOrCreate(std::unordered_map<std::string, std::unique_ptr<Impl>>& stats,
+                                 const std::string& name) {
+  std::unique_ptr<Impl>& stat = stats[name];
+  if (!stat) {
+    stat.reset(new Impl(*this, name));
+    pending_stats_++;
+    pending_.inc();
+  }
+  return *stat;
+}
+
+void LazyScopeImpl::onStatAllocated() {
+  ASSERT(pending_stats_ > 0);
+  pending_stats_--;
+  pending_.dec();
+}
+
+} // namespace Stats
+} // namespace Envoy
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "envoy/stats/stats.h"
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Stats {
+
+/**
+ * A scope that hands out stats which are only allocated in the parent scope the first time they
+ * are written to. This is meant for fixed stat structs (see stats_macros.h) that are mostly unused,
+ * e.g. the cluster stats of thousands of idle clusters, where each allocated stat costs a
+ * RawStatData block (possibly in hot restart shared memory) and a --max-stats slot.
+ *
+ * Until a stat is allocated it reads as zero and unused, name() is the name relative to the parent
+ * scope, and it is not visible to sinks or the admin stats output. Stats must be created on a
+ * single thread (normally while building the owning object) but can be written to from any thread.
+ */
+class LazyScopeImpl : public Scope {
+public:
+  /**
+   * @param parent supplies the scope that stats are allocated in on first write. It must outlive
+   *        this scope.
+   * @param pending supplies a gauge that tracks how many stats handed out by all lazy scopes that
+   *        share it have not been allocated yet.
+   */
+  LazyScopeImpl(Scope& parent, Gauge& pending) : parent_(parent), pending_(pending) {}
+
+  /**
+   * Same as above but the scope owns its parent.
+   */
+  LazyScopeImpl(ScopePtr&& parent, Gauge& pending)
+      : owned_parent_(std::move(parent)), parent_(*owned_parent_), pending_(pending) {}
+  ~LazyScopeImpl();
+
+  /**
+   * @return the number of stats handed out by this scope that have not been allocated yet.
+   */
+  uint64_t pendingStats() const { return pending_stats_; }
+
+  // Stats::Scope
+  ScopePtr createScope(const std::string& name) override;
+  void deliverHistogramToSinks(const Histogram& histogram, uint64_t value) override {
+    parent_.deliverHistogramToSinks(histogram, value);
+  }
+  Counter& counter(const std::string& name) override;
+  Gauge& gauge(const std::string& name) override;
+  Histogram& histogram(const std::string& name) override;
+
+private:
+  /**
+   * Shared implementation of the lazily allocated stat types. The allocated stat is published
+   * through an atomic since any thread can be the first to write. Racing writers all get the same
+   * stat from the parent scope so only the publication needs to be ordered.
+   */
+  template <class Base> class LazyStat : public virtual Metric {
+  public:
+    typedef Base& (Scope::*Allocator)(const std::string& name);
+
+    LazyStat(LazyScopeImpl& parent, const std::string& name, Allocator allocator)
+        : parent_(parent), name_(name), allocator_(allocator) {}
+
+    bool allocated() const { return stat_.load(std::memory_order_acquire) != nullptr; }
+
+    // Stats::Metric
+    std::string name() const override {
+      const Base* stat = stat_.load(std::memory_order_acquire);
+      return stat ? stat->name() : name_;
+    }
+    std::vector<Tag> tags() const override {
+      const Base* stat = stat_.load(std::memory_order_acquire);
+      return stat ? stat->tags() : std::vector<Tag>();
+    }
+    std::string tagExtractedName() const override {
+      const Base* stat = stat_.load(std::memory_order_acquire);
+      return stat ? stat->tagExtractedName() : name_;
+    }
+
+  protected:
+    Base& stat() {
+      Base* stat = stat_.load(std::memory_order_acquire);
+      if (stat == nullptr) {
+        Base* new_stat = &(parent_.parent_.*allocator_)(name_);
+        if (stat_.compare_exchange_strong(stat, new_stat, std::memory_order_acq_rel)) {
+          parent_.onStatAllocated();
+          stat = new_stat;
+        }
+      }
+      return *stat;
+    }
+    const Base* statIfAllocated() const { return stat_.load(std::memory_order_acquire); }
+
+  private:
+    LazyScopeImpl& parent_;
+    const std::string name_;
+    const Allocator allocator_;
+    std::atomic<Base*> stat_{};
+  };
+
+  class LazyCounterImpl : public Counter, public LazyStat<Counter> {
+  public:
+    LazyCounterImpl(LazyScopeImpl& parent, const std::string& name)
+        : LazyStat<Counter>(parent, name, &Scope::counter) {}
+
+    // Stats::Counter
+    void add(uint64_t amount) override { stat().add(amount); }
+    void inc() override { stat().inc(); }
+    uint64_t latch() override { return allocated() ? stat().latch() : 0; }
+    void reset() override {
+      if (allocated()) {
+        stat().reset();
+      }
+    }
+    bool used() const override { return statIfAllocated() && statIfAllocated()->used(); }
+    uint64_t value() const override { return statIfAllocated() ? statIfAllocated()->value() : 0; }
+  };
+
+  class LazyGaugeImpl : public Gauge, public LazyStat<Gauge> {
+  public:
+    LazyGaugeImpl(LazyScopeImpl& parent, const std::string& name)
+        : LazyStat<Gauge>(parent, name, &Scope::gauge) {}
+
+    // Stats::Gauge
+    void add(uint64_t amount) override { stat().add(amount); }
+    void dec() override { stat().dec(); }
+    void inc() override { stat().inc(); }
+    void set(uint64_t value) override { stat().set(value); }
+    void sub(uint64_t amount) override { stat().sub(amount); }
+    bool used() const override { return statIfAllocated() && statIfAllocated()->used(); }
+    uint64_t value() const override { return statIfAllocated() ? statIfAllocated()->value() : 0; }
+  };
+
+  class LazyHistogramImpl : public Histogram, public LazyStat<Histogram> {
+  public:
+    LazyHistogramImpl(LazyScopeImpl& parent, const std::string& name)
+        : LazyStat<Histogram>(parent, name, &Scope::histogram) {}
+
+    // Stats::Histogram
+    void recordValue(uint64_t value) override { stat().recordValue(value); }
+  };
+
+  template <class Impl>
+  Impl& getOrCreate(std::unordered_map<std::string, std::unique_ptr<Impl>>& stats,
+                    const std::string& name);
+  void onStatAllocated();
+
+  const ScopePtr owned_parent_;
+  Scope& parent_;
+  Gauge& pending_;
+  std::atomic<uint64_t> pending_stats_{};
+  std::unordered_map<std::string, std::unique_ptr<LazyCounterImpl>> counters_;
+  std::unordered_map<std::string, std::unique_ptr<LazyGaugeImpl>> gauges_;
+  std::unordered_map<std::string, std::unique_ptr<LazyHistogramImpl>> histograms_;
+};
+
+} // namespace Stats
+} // namespace Envoy
@@ -0,0 +1,197 @@
+#include "common/stats/sharded_counter_impl.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Stats {
+
+CounterShards& CounterShards::global() {
+  static CounterShards* shards = new CounterShards();
+  return *shards;
+}
+
+CounterShards::~CounterShards() {
+  Shard* shard = shards_.load();
+  while (shard != nullptr) {
+    Shard* next = shard->next_;
+    delete shard;
+    shard = next;
+  }
+}
+
+CounterShards::Shard::~Shard() {
+  for (std::atomic<std::atomic<uint64_t>*>& page : pages_) {
+    delete[] page.load();
+  }
+}
+
+CounterShards::ShardHandle::~ShardHandle() {
+  if (shard_ != nullptr) {
+    CounterShards& shards = global();
+    std::unique_lock<std::mutex> lock(shards.lock_);
+    shards.free_shards_.push_back(shard_);
+  }
+}
+
+CounterShards::Slot* CounterShards::acquireSlot(const void* key) {
+  std::unique_lock<std::mutex> lock(lock_);
+  auto slot = slots_.find(key);
+  if (slot != slots_.end()) {
+    slot->second->ref_count_++;
+    return slot->second.get();
+  }
+
+  uint32_t index;
+  if (!free_indexes_.empty()) {
+    index = free_indexes_.back();
+    free_indexes_.pop_back();
+  } else if (next_index_ < SLOTS_PER_PAGE * MAX_PAGES) {
+    index = next_index_++;
+  } else {
+    return nullptr;
+  }
+
+  // A reused index keeps the cells of its previous slot, the new slot starts from their sum.
+  return slots_.emplace(key, std::unique_ptr<Slot>{new Slot(index, sum(index))})
+      .first->second.get();
+}
+
+void CounterShards::releaseSlot(const void* key) {
+  std::unique_lock<std::mutex> lock(lock_);
+  auto slot = slots_.find(key);
+  ASSERT(slot != slots_.end());
+  if (--slot->second->ref_count_ == 0) {
+    free_indexes_.push_back(slot->second->index_);
+    slots_.erase(slot);
+  }
+}
+
+CounterShards::Shard& CounterShards::threadShard() {
+  static thread_local ShardHandle handle;
+  if (handle.shard_ == nullptr) {
+    std::unique_lock<std::mutex> lock(lock_);
+    if (!free_shards_.empty()) {
+      handle.shard_ = free_shards_.back();
+      free_shards_.pop_back();
+    } else {
+      handle.shard_ = new Shard(shards_.load(std::memory_order_relaxed));
+      shards_.store(handle.shard_, std::memory_order_release);
+      num_shards_++;
+    }
+  }
+  return *handle.shard_;
+}
+
+void CounterShards::add(const Slot& slot, uint64_t amount) {
+  Shard& shard = threadShard();
+  std::atomic<std::atomic<uint64_t>*>& page_ref = shard.pages_[slot.index_ / SLOTS_PER_PAGE];
+  std::atomic<uint64_t>* page = page_ref.load(std::memory_order_relaxed);
+  if (page == nullptr) {
+    page = new std::atomic<uint64_t>[SLOTS_PER_PAGE + 2 * PAGE_PADDING]();
+    page_ref.store(page, std::memory_order_release);
+  }
+
+  // This thread is the only writer of the cell, so there is no need for a read-modify-write.
+  std::atomic<uint64_t>& cell = page[PAGE_PADDING + slot.index_ % SLOTS_PER_PAGE];
+  cell.store(cell.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+uint64_t CounterShards::sum(uint32_t index) const {
+  uint64_t sum = 0;
+  for (const Shard* shard = shards_.load(std::memory_order_acquire); shard != nullptr;
+       shard = shard->next_) {
+    const std::atomic<uint64_t>* page =
+        shard->pages_[index / SLOTS_PER_PAGE].load(std::memory_order_acquire);
+    if (page != nullptr) {
+      sum += page[PAGE_PADDING + index % SLOTS_PER_PAGE].load(std::memory_order_relaxed);
+    }
+  }
+  return sum;
+}
+
+uint64_t CounterShards::fold(Slot& slot) const {
+  // Concurrent folds may see different sums. Whichever advances folded_ returns the difference, so
+  // the increments returned add up to the largest sum seen.
+  const uint64_t current = sum(slot);
+  uint64_t folded = slot.folded_.load();
+  while (current > folded) {
+    if (slot.folded_.compare_exchange_weak(folded, current)) {
+      return current - folded;
+    }
+  }
+  return 0;
+}
+
+size_t CounterShards::activeShards() const {
+  std::unique_lock<std::mutex> lock(lock_);
+  return num_shards_ - free_shards_.size();
+}
+
+ShardedCounterImpl::ShardedCounterImpl(RawStatData& data, RawStatDataAllocator& alloc,
+                                       const std::string& name, std::string&& tag_extracted_name,
+                                       std::vector<Tag>&& tags)
+    : MetricImpl(name, std::move(tag_extracted_name), std::move(tags)), data_(data),
+      alloc_(alloc), slot_(CounterShards::global().acquireSlot(&data)) {}
+
+ShardedCounterImpl::~ShardedCounterImpl() {
+  if (slot_ != nullptr) {
+    fold();
+    CounterShards::global().releaseSlot(&data_);
+  }
+  alloc_.free(data_);
+}
+
+void ShardedCounterImpl::fold() const {
+  if (slot_ != nullptr) {
+    const uint64_t amount = CounterShards::global().fold(*slot_);
+    if (amount > 0) {
+      addToData(amount);
+    }
+  }
+}
+
+void ShardedCounterImpl::addToData(uint64_t amount) const {
+  data_.value_ += amount;
+  data_.pending_increment_ += amount;
+  data_.flags_ |= RawStatData::Flags::Used;
+}
+
+void ShardedCounterImpl::add(uint64_t amount) {
+  if (slot_ == nullptr) {
+    addToData(amount);
+  } else {
+    CounterShards::global().add(*slot_, amount);
+  }
+}
+
+uint64_t ShardedCounterImpl::latch() {
+  fold();
+  return data_.pending_increment_.exchange(0);
+}
+
+void ShardedCounterImpl::reset() {
+  fold();
+  data_.value_ = 0;
+}
+
+bool ShardedCounterImpl::used() const {
+  // Once set, the flag stays set, so there is nothing to fold.
+  if (!(data_.flags_ & RawStatData::Flags::Used)) {
+    fold();
+  }
+  return data_.flags_ & RawStatData::Flags::Used;
+}
+
+uint64_t ShardedCounterImpl::value() const {
+  fold();
+  return data_.value_;
+}
+
+} // namespace Stats
+} // namespace Envoy
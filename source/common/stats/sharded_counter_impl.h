@@ -0,0 +1,166 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "envoy/stats/stats.h"
+
+#include "common/stats/stats_impl.h"
+
+namespace Envoy {
+namespace Stats {
+
+/**
+ * Per-thread storage for counter increments. Every sharded counter owns a slot, and every thread
+ * that increments counters owns a shard with one 64 bit cell per slot. A thread only ever writes
+ * to its own shard, so increments are a plain load and store without contended cache lines, and
+ * the value of a slot is the sum of its cells over all shards. Cells only grow, which lets readers
+ * fold the sum into the counter without coordinating with the writers.
+ *
+ * Shards are allocated a page of cells at a time when a thread first writes to a slot in the page,
+ * so threads only pay for the counters they use. The shard of a thread that exits is handed to the
+ * next new thread, keeping its cells.
+ *
+ * Reading a slot takes no lock. Shards are kept in a list that only grows at its head, and both
+ * new shards and new pages are published with release stores.
+ */
+class CounterShards {
+public:
+  CounterShards() {}
+  ~CounterShards();
+
+  struct Slot {
+    Slot(uint32_t index, uint64_t folded) : index_(index), folded_(folded) {}
+
+    const uint32_t index_;
+    // Sum of the cells that has been folded into the counter.
+    std::atomic<uint64_t> folded_;
+    // Protected by the lock of CounterShards.
+    uint32_t ref_count_{1};
+  };
+
+  /**
+   * @return CounterShards& the process wide shards. They are never destroyed, so threads that
+   *         exit during static destruction can still return their shards.
+   */
+  static CounterShards& global();
+
+  /**
+   * Returns the slot for key, adding a reference. Counters that are backed by the same RawStatData
+   * (overlapping scopes) pass the same key and share a slot, so their increments are folded once.
+   * @param key supplies the key, usually the address of the RawStatData.
+   * @return Slot* the slot, or nullptr if all slots are in use.
+   */
+  Slot* acquireSlot(const void* key);
+
+  /**
+   * Release a reference to the slot for key. The slot is reused once it has no references left.
+   */
+  void releaseSlot(const void* key);
+
+  /**
+   * Add to the cell of slot in the calling thread's shard.
+   */
+  void add(const Slot& slot, uint64_t amount);
+
+  /**
+   * @return uint64_t the sum of the cells of slot over all shards. Thread safe and lock free.
+   */
+  uint64_t sum(const Slot& slot) const { return sum(slot.index_); }
+
+  /**
+   * @return uint64_t the increments to slot since the previous fold(). Thread safe, each increment
+   *         is returned by exactly one call.
+   */
+  uint64_t fold(Slot& slot) const;
+
+  /**
+   * @return size_t the number of shards, i.e. the number of threads that have added to a slot and
+   *         have not exited.
+   */
+  size_t activeShards() const;
+
+private:
+  // One 4KiB page of cells.
+  static const uint32_t SLOTS_PER_PAGE = 512;
+  static const uint32_t MAX_PAGES = 256;
+  // Pages are padded with a cache line of unused cells on either side, so that the cells of
+  // different threads never share a cache line whatever the alignment of the allocation.
+  static const uint32_t PAGE_PADDING = 64 / sizeof(uint64_t);
+
+  struct Shard {
+    Shard(Shard* next) : next_(next) {}
+    ~Shard();
+
+    // Written by the owning thread only. Readers see either nullptr (no cells written yet) or a
+    // complete page.
+    std::array<std::atomic<std::atomic<uint64_t>*>, MAX_PAGES> pages_{};
+    // The shard that was created before this one.
+    Shard* const next_;
+  };
+
+  /**
+   * Returns the shard of a thread to the pool when the thread exits.
+   */
+  struct ShardHandle {
+    ~ShardHandle();
+
+    Shard* shard_{};
+  };
+
+  Shard& threadShard();
+  uint64_t sum(uint32_t index) const;
+
+  // Protects everything below except for reads of shards_.
+  mutable std::mutex lock_;
+  // The most recently created shard, which links to all shards that were ever created. Shards are
+  // only destroyed with CounterShards so that their cells still count.
+  std::atomic<Shard*> shards_{};
+  size_t num_shards_{};
+  std::vector<Shard*> free_shards_;
+  std::unordered_map<const void*, std::unique_ptr<Slot>> slots_;
+  std::vector<uint32_t> free_indexes_;
+  uint32_t next_index_{};
+};
+
+/**
+ * Counter that records increments into CounterShards instead of its RawStatData, so that a counter
+ * incremented from all workers does not bounce a cache line between their cores. The increments
+ * are folded into the RawStatData whenever the counter is read, latched or destroyed, so the
+ * RawStatData (which may be in hot restart shared memory) lags the counter by the increments since
+ * the last flush. Folding takes no lock, it sums one cell per thread. If there are no free slots
+ * the counter updates its RawStatData directly.
+ */
+class ShardedCounterImpl : public Counter, public MetricImpl {
+public:
+  ShardedCounterImpl(RawStatData& data, RawStatDataAllocator& alloc, const std::string& name,
+                     std::string&& tag_extracted_name, std::vector<Tag>&& tags);
+  ~ShardedCounterImpl();
+
+  // Stats::Counter
+  void add(uint64_t amount) override;
+  void inc() override { add(1); }
+  uint64_t latch() override;
+  void reset() override;
+  bool used() const override;
+  uint64_t value() const override;
+
+private:
+  void fold() const;
+  void addToData(uint64_t amount) const;
+
+  RawStatData& data_;
+  RawStatDataAllocator& alloc_;
+  CounterShards::Slot* const slot_;
+};
+
+typedef std::shared_ptr<ShardedCounterImpl> ShardedCounterImplSharedPtr;
+
+} // namespace Stats
+} // namespace Envoy
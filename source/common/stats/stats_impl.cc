@@ -1,39 +1,17 @@
 #include "common/stats/stats_impl.h"
 
-#include <string.h>
-
 #include <algorithm>
+#include <cctype>
 #include <chrono>
 #include <string>
 
 #include "envoy/common/exception.h"
 
-#include "common/common/utility.h"
 #include "common/config/well_known_names.h"
 
 namespace Envoy {
 namespace Stats {
 
-namespace {
-
-// Round val up to the next multiple of the natural alignment.
-// Note: this implementation only works because 8 is a power of 2.
-size_t roundUpMultipleNaturalAlignment(size_t val) {
-  const size_t multiple = alignof(RawStatData);
-  static_assert(multiple == 1 || multiple == 2 || multiple == 4 || multiple == 8 || multiple == 16,
-                "multiple must be a power of 2 for this algorithm to work");
-  return (val + multiple - 1) & ~(multiple - 1);
-}
-
-} // namespace
-
-size_t RawStatData::size() {
-  // Normally the compiler would do this, but because name_ is a flexible-array-length
-  // element, the compiler can't.  RawStatData is put into an array in HotRestartImpl, so
-  // it's important that each element starts on the required alignment for the type.
-  return roundUpMultipleNaturalAlignment(sizeof(RawStatData) + nameSize());
-}
-
 size_t& RawStatData::initializeAndGetMutableMaxObjNameLength(size_t configured_size) {
   // Like CONSTRUCT_ON_FIRST_USE, but non-const so that the value can be changed by tests
   static size_t size = configured_size;
@@ -62,7 +40,58 @@ std::string Utility::sanitizeStatsName(const std::string& name) {
 }
 
 TagExtractorImpl::TagExtractorImpl(const std::string& name, const std::string& regex)
-    : name_(name), regex_(regex) {}
+    : name_(name), regex_(regex), literal_(requiredLiteral(regex)),
+      anchored_(!regex.empty() && regex[0] == '^') {}
+
+std::string TagExtractorImpl::requiredLiteral(const std::string& regex) {
+  // An alternation outside of any group means no part of the regex is required.
+  uint32_t depth = 0;
+  bool in_class = false;
+  for (size_t i = 0; i < regex.size(); i++) {
+    const char c = regex[i];
+    if (c == '\\') {
+      i++;
+    } else if (in_class) {
+      in_class = c != ']';
+    } else if (c == '[') {
+      in_class = true;
+    } else if (c == '(') {
+      depth++;
+    } else if (c == ')' && depth > 0) {
+      depth--;
+    } else if (c == '|' && depth == 0) {
+      return "";
+    }
+  }
+
+  // Collect the leading run of literal characters, including escaped punctuation such as "\\.".
+  std::string literal;
+  size_t i = (!regex.empty() && regex[0] == '^') ? 1 : 0;
+  while (i < regex.size()) {
+    const char c = regex[i];
+    if (std::isalnum(c) || c == '_' || c == '-' || c == ':' || c == '=' || c == '/') {
+      literal.push_back(c);
+      i++;
+    } else if (c == '\\' && i + 1 < regex.size() && std::ispunct(regex[i + 1])) {
+      literal.push_back(regex[i + 1]);
+      i += 2;
+    } else {
+      break;
+    }
+  }
+
+  // A quantifier makes the preceding character optional (or repeatable, which is ambiguous once
+  // the character was part of an escape), so drop it.
+  if (i < regex.size() && !literal.empty() &&
+      (regex[i] == '*' || regex[i] == '?' || regex[i] == '{' || regex[i] == '+')) {
+    literal.pop_back();
+  } else if (regex.compare(i, 6, "(?=\\.)") == 0) {
+    // The default regexes use a lookahead to require a '.' after the first name segment.
+    literal.push_back('.');
+  }
+
+  return literal;
+}
 
 TagExtractorPtr TagExtractorImpl::createTagExtractor(const std::string& name,
                                                      const std::string& regex) {
@@ -89,8 +118,78 @@ TagExtractorPtr TagExtractorImpl::createTagExtractor(const std::string& name,
   }
 }
 
+StatsMatcherImpl::StatsMatcherImpl(const std::vector<std::string>& inclusions,
+                                   const std::vector<std::string>& exclusions) {
+  for (const std::string& spec : inclusions) {
+    inclusions_.emplace_back(spec);
+  }
+  for (const std::string& spec : exclusions) {
+    exclusions_.emplace_back(spec);
+  }
+}
+
+StatsMatcherImpl::Pattern::Pattern(const std::string& spec) {
+  const size_t colon = spec.find(':');
+  const std::string type = spec.substr(0, colon);
+  value_ = colon == std::string::npos ? "" : spec.substr(colon + 1);
+  if (colon == std::string::npos || value_.empty()) {
+    throw EnvoyException(fmt::format("invalid stats matcher '{}'", spec));
+  }
+
+  if (type == "prefix") {
+    type_ = Type::Prefix;
+  } else if (type == "suffix") {
+    type_ = Type::Suffix;
+  } else if (type == "regex") {
+    type_ = Type::Regex;
+    try {
+      regex_ = std::regex(value_, std::regex::optimize);
+    } catch (const std::regex_error& e) {
+      throw EnvoyException(fmt::format("invalid stats matcher regex '{}': {}", value_, e.what()));
+    }
+  } else {
+    throw EnvoyException(
+        fmt::format("invalid stats matcher '{}': type must be prefix, suffix or regex", spec));
+  }
+}
+
+bool StatsMatcherImpl::Pattern::matches(const std::string& name) const {
+  switch (type_) {
+  case Type::Prefix:
+    return name.compare(0, value_.size(), value_) == 0;
+  case Type::Suffix:
+    return name.size() >= value_.size() &&
+           name.compare(name.size() - value_.size(), value_.size(), value_) == 0;
+  case Type::Regex:
+    return std::regex_match(name, regex_);
+  }
+
+  NOT_REACHED;
+}
+
+bool StatsMatcherImpl::matchesAny(const std::vector<Pattern>& patterns, const std::string& name) {
+  for (const Pattern& pattern : patterns) {
+    if (pattern.matches(name)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool StatsMatcherImpl::rejects(const std::string& name) const {
+  if (!inclusions_.empty() && !matchesAny(inclusions_, name)) {
+    return true;
+  }
+  return matchesAny(exclusions_, name);
+}
+
 std::string TagExtractorImpl::extractTag(const std::string& tag_extracted_name,
                                          std::vector<Tag>& tags) const {
+  if (anchored_ ? tag_extracted_name.compare(0, literal_.size(), literal_) != 0
+                : tag_extracted_name.find(literal_) == std::string::npos) {
+    return tag_extracted_name;
+  }
+
   std::smatch match;
   // The regex must match and contain one or more subexpressions (all after the first are ignored).
   if (std::regex_search(tag_extracted_name, match, regex_) && match.size() > 1) {
@@ -115,10 +214,63 @@ std::string TagExtractorImpl::extractTag(const std::string& tag_extracted_name,
   return tag_extracted_name;
 }
 
-RawStatData* HeapRawStatDataAllocator::alloc(const std::string& name) {
+MetricImpl::MetricImpl(const std::string& name, std::string&& tag_extracted_name,
+                       std::vector<Tag>&& tags) {
+  SymbolTable& symbol_table = SymbolTable::global();
+  std::vector<uint8_t> encoding;
+  symbol_table.encode(name, encoding);
+  symbol_table.encode(tag_extracted_name, encoding);
+  SymbolTable::encodeVarint(tags.size(), encoding);
+  for (const Tag& tag : tags) {
+    symbol_table.encode(tag.name_, encoding);
+    symbol_table.encode(tag.value_, encoding);
+  }
+
+  encoding_.reset(new uint8_t[encoding.size()]);
+  std::copy(encoding.begin(), encoding.end(), encoding_.get());
+}
+
+MetricImpl::~MetricImpl() {
+  SymbolTable& symbol_table = SymbolTable::global();
+  const uint8_t* encoding = encoding_.get();
+  symbol_table.free(encoding);
+  symbol_table.free(encoding);
+  const uint64_t num_tags = SymbolTable::decodeVarint(encoding);
+  for (uint64_t i = 0; i < num_tags * 2; i++) {
+    symbol_table.free(encoding);
+  }
+}
+
+std::string MetricImpl::name() const {
+  const uint8_t* encoding = encoding_.get();
+  return SymbolTable::global().decode(encoding);
+}
+
+std::string MetricImpl::tagExtractedName() const {
+  const SymbolTable& symbol_table = SymbolTable::global();
+  const uint8_t* encoding = encoding_.get();
+  SymbolTable::skip(encoding);
+  return symbol_table.decode(encoding);
+}
+
+std::vector<Tag> MetricImpl::tags() const {
+  const SymbolTable& symbol_table = SymbolTable::global();
+  const uint8_t* encoding = encoding_.get();
+  SymbolTable::skip(encoding);
+  SymbolTable::skip(encoding);
+
+  std::vector<Tag> tags(SymbolTable::decodeVarint(encoding));
+  for (Tag& tag : tags) {
+    tag.name_ = symbol_table.decode(encoding);
+    tag.value_ = symbol_table.decode(encoding);
+  }
+  return tags;
+}
+
+RawStatData* HeapRawStatDataAllocator::alloc(const std::string&) {
   // This must be zero-initialized
   RawStatData* data = static_cast<RawStatData*>(::calloc(RawStatData::size(), 1));
-  data->initialize(name);
+  data->initialize();
   return data;
 }
 
@@ -128,17 +280,9 @@ void HeapRawStatDataAllocator::free(RawStatData& data) {
   ::free(&data);
 }
 
-void RawStatData::initialize(const std::string& name) {
-  ASSERT(!initialized());
-  ASSERT(name.size() <= maxNameLength());
-  ASSERT(std::string::npos == name.find(':'));
+void RawStatData::initialize() {
+  ASSERT(ref_count_ == 0);
   ref_count_ = 1;
-  StringUtil::strlcpy(name_, name.substr(0, maxNameLength()).c_str(), nameSize());
-}
-
-bool RawStatData::matches(const std::string& name) {
-  // In case a stat got truncated, match on the truncated name.
-  return 0 == strcmp(name.substr(0, maxNameLength()).c_str(), name_);
 }
 
 } // namespace Stats
@@ -17,6 +17,7 @@
 #include "common/common/assert.h"
 #include "common/common/singleton.h"
 #include "common/protobuf/protobuf.h"
+#include "common/stats/symbol_table_impl.h"
 
 #include "api/bootstrap.pb.h"
 
@@ -39,9 +40,62 @@ public:
   std::string extractTag(const std::string& tag_extracted_name,
                          std::vector<Tag>& tags) const override;
 
+  /**
+   * Returns the literal text that every name matched by a regex must contain. If the regex is
+   * anchored with '^' the literal is a prefix of the name, otherwise it may appear anywhere. For
+   * example "^cluster(?=\\.).*?\\.grpc" yields "cluster." and "_rq(_(\\d{3}))$" yields "_rq".
+   * The literal is derived conservatively: an empty string is returned whenever it cannot be proven
+   * to be required, e.g. if the regex has a top level alternation.
+   * @param regex supplies the regex.
+   * @return std::string the required literal, possibly empty.
+   */
+  static std::string requiredLiteral(const std::string& regex);
+
+  const std::string& literal() const { return literal_; }
+  bool anchored() const { return anchored_; }
+
 private:
   const std::string name_;
   const std::regex regex_;
+  // Names that do not contain literal_ (at the start if anchored_) are not run through regex_.
+  // Matching the regex is far more expensive than the string search, and most extractors only
+  // apply to a few stat name prefixes.
+  const std::string literal_;
+  const bool anchored_;
+};
+
+/**
+ * Matches stat names against inclusion and exclusion lists. A stat is rejected if there are
+ * inclusions and it matches none of them, or if it matches any exclusion. Each entry is written as
+ * "prefix:<value>", "suffix:<value>" or "regex:<value>". Regexes must match the whole name.
+ */
+class StatsMatcherImpl : public StatsMatcher {
+public:
+  /**
+   * @throw EnvoyException if an entry has an unknown type or an invalid regex.
+   */
+  StatsMatcherImpl(const std::vector<std::string>& inclusions,
+                   const std::vector<std::string>& exclusions);
+
+  // Stats::StatsMatcher
+  bool rejects(const std::string& name) const override;
+
+private:
+  struct Pattern {
+    enum class Type { Prefix, Suffix, Regex };
+
+    Pattern(const std::string& spec);
+    bool matches(const std::string& name) const;
+
+    Type type_;
+    std::string value_;
+    std::regex regex_;
+  };
+
+  static bool matchesAny(const std::vector<Pattern>& patterns, const std::string& name);
+
+  std::vector<Pattern> inclusions_;
+  std::vector<Pattern> exclusions_;
 };
 
 /**
@@ -58,8 +112,9 @@ public:
  * This structure is the backing memory for both CounterImpl and GaugeImpl. It is designed so that
  * it can be allocated from shared memory if needed.
  *
- * @note Due to name_ being variable size, sizeof(RawStatData) probably isn't useful.  Use
- * RawStatData::size() instead.
+ * The stat's name is not part of this structure. Allocators that need to find a stat by name,
+ * such as the hot restart shared memory allocator, keep the name alongside it in their own
+ * variable-length storage, so that no space is reserved for the longest possible name.
  */
 struct RawStatData {
   struct Flags {
@@ -67,7 +122,7 @@ struct RawStatData {
   };
 
   /**
-   * Due to the flexible-array-length of name_, c-style allocation
+   * This structure is laid into memory that allocators manage themselves, so c-style allocation
    * and initialization are neccessary.
    */
   RawStatData() = delete;
@@ -106,38 +161,20 @@ struct RawStatData {
   static size_t maxStatSuffixLength() { return MAX_STAT_SUFFIX_LENGTH; }
 
   /**
-   * size in bytes of name_
+   * Returns the size of this struct.
    */
-  static size_t nameSize() { return maxNameLength() + 1; }
+  static size_t size() { return sizeof(RawStatData); }
 
   /**
-   * Returns the size of this struct, accounting for the length of name_
-   * and padding for alignment.
+   * Initializes zeroed memory to a refcount of 1. All other values stay zero.
    */
-  static size_t size();
-
-  /**
-   * Initializes this object to have the specified name,
-   * a refcount of 1, and all other values zero.
-   */
-  void initialize(const std::string& name);
-
-  /**
-   * Returns true if object is in use.
-   */
-  bool initialized() { return name_[0] != '\0'; }
-
-  /**
-   * Returns true if this matches name, truncated to maxNameLength().
-   */
-  bool matches(const std::string& name);
+  void initialize();
 
   std::atomic<uint64_t> value_;
   std::atomic<uint64_t> pending_increment_;
   std::atomic<uint16_t> flags_;
   std::atomic<uint16_t> ref_count_;
   std::atomic<uint32_t> unused_;
-  char name_[];
 
 private:
   // The max name length is based on current set of stats.
@@ -183,20 +220,29 @@ public:
 /**
  * Implementation of the Metric interface. Virtual inheritance is used because the interfaces that
  * will inherit from Metric will have other base classes that will also inherit from Metric.
+ *
+ * The name, tag extracted name and tags are kept encoded by the global SymbolTable and are only
+ * decoded, without taking a lock, when they are asked for, which is typically when stats are
+ * output. Stores compare and look up stats by statName() instead.
  */
 class MetricImpl : public virtual Metric {
 public:
-  MetricImpl(const std::string& name, std::string&& tag_extracted_name, std::vector<Tag>&& tags)
-      : name_(name), tag_extracted_name_(std::move(tag_extracted_name)), tags_(std::move(tags)) {}
+  MetricImpl(const std::string& name, std::string&& tag_extracted_name, std::vector<Tag>&& tags);
+  ~MetricImpl();
 
-  const std::string& name() const override { return name_; }
-  const std::string& tagExtractedName() const override { return tag_extracted_name_; }
-  const std::vector<Tag>& tags() const override { return tags_; }
+  std::string name() const override;
+  std::string tagExtractedName() const override;
+  std::vector<Tag> tags() const override;
+
+  /**
+   * @return StatName the encoded name, valid for the lifetime of the metric.
+   */
+  StatName statName() const { return StatName(encoding_.get()); }
 
 private:
-  const std::string name_;
-  const std::string tag_extracted_name_;
-  const std::vector<Tag> tags_;
+  // The name, the tag extracted name, the number of tags as a varint, then the name and value of
+  // each tag. All names and values are encoded by SymbolTable::encode().
+  std::unique_ptr<uint8_t[]> encoding_;
 };
 
 /**
@@ -204,9 +250,9 @@ private:
  */
 class CounterImpl : public Counter, public MetricImpl {
 public:
-  CounterImpl(RawStatData& data, RawStatDataAllocator& alloc, std::string&& tag_extracted_name,
-              std::vector<Tag>&& tags)
-      : MetricImpl(data.name_, std::move(tag_extracted_name), std::move(tags)), data_(data),
+  CounterImpl(RawStatData& data, RawStatDataAllocator& alloc, const std::string& name,
+              std::string&& tag_extracted_name, std::vector<Tag>&& tags)
+      : MetricImpl(name, std::move(tag_extracted_name), std::move(tags)), data_(data),
         alloc_(alloc) {}
   ~CounterImpl() { alloc_.free(data_); }
 
@@ -233,9 +279,9 @@ private:
  */
 class GaugeImpl : public Gauge, public MetricImpl {
 public:
-  GaugeImpl(RawStatData& data, RawStatDataAllocator& alloc, std::string&& tag_extracted_name,
-            std::vector<Tag>&& tags)
-      : MetricImpl(data.name_, std::move(tag_extracted_name), std::move(tags)), data_(data),
+  GaugeImpl(RawStatData& data, RawStatDataAllocator& alloc, const std::string& name,
+            std::string&& tag_extracted_name, std::vector<Tag>&& tags)
+      : MetricImpl(name, std::move(tag_extracted_name), std::move(tags)), data_(data),
         alloc_(alloc) {}
   ~GaugeImpl() { alloc_.free(data_); }
 
@@ -263,6 +309,8 @@ private:
   RawStatDataAllocator& alloc_;
 };
 
+typedef std::shared_ptr<GaugeImpl> GaugeImplSharedPtr;
+
 /**
  * Histogram implementation for the heap.
  */
@@ -278,6 +326,85 @@ public:
   Store& parent_;
 };
 
+/**
+ * Histogram that drops all values instead of delivering them to sinks. Stores hand out one shared
+ * instance for every rejected histogram.
+ */
+class NullHistogramImpl : public Histogram {
+public:
+  // Stats::Metric
+  std::string name() const override { return ""; }
+  std::vector<Tag> tags() const override { return {}; }
+  std::string tagExtractedName() const override { return ""; }
+
+  // Stats::Histogram
+  void recordValue(uint64_t) override {}
+};
+
+/**
+ * Counter that is never exported and only keeps its value on the heap. Stores hand these out for
+ * counters rejected by the stats matcher, which code such as health checking may still read back.
+ * It has no name and takes no stat memory.
+ */
+class UnexportedCounterImpl : public Counter {
+public:
+  // Stats::Metric
+  std::string name() const override { return ""; }
+  std::vector<Tag> tags() const override { return {}; }
+  std::string tagExtractedName() const override { return ""; }
+
+  // Stats::Counter
+  void add(uint64_t amount) override {
+    value_ += amount;
+    pending_increment_ += amount;
+    used_ = true;
+  }
+  void inc() override { add(1); }
+  uint64_t latch() override { return pending_increment_.exchange(0); }
+  void reset() override { value_ = 0; }
+  bool used() const override { return used_; }
+  uint64_t value() const override { return value_; }
+
+private:
+  std::atomic<uint64_t> value_{};
+  std::atomic<uint64_t> pending_increment_{};
+  std::atomic<bool> used_{};
+};
+
+/**
+ * Gauge that is never exported and only keeps its value on the heap. See UnexportedCounterImpl.
+ */
+class UnexportedGaugeImpl : public Gauge {
+public:
+  // Stats::Metric
+  std::string name() const override { return ""; }
+  std::vector<Tag> tags() const override { return {}; }
+  std::string tagExtractedName() const override { return ""; }
+
+  // Stats::Gauge
+  void add(uint64_t amount) override {
+    value_ += amount;
+    used_ = true;
+  }
+  void dec() override { sub(1); }
+  void inc() override { add(1); }
+  void set(uint64_t value) override {
+    value_ = value;
+    used_ = true;
+  }
+  void sub(uint64_t amount) override {
+    ASSERT(value_ >= amount);
+    ASSERT(used());
+    value_ -= amount;
+  }
+  bool used() const override { return used_; }
+  uint64_t value() const override { return value_; }
+
+private:
+  std::atomic<uint64_t> value_{};
+  std::atomic<bool> used_{};
+};
+
 /**
  * Implementation of RawStatDataAllocator that just allocates a new structure in memory and returns
  * it.
@@ -330,11 +457,12 @@ class IsolatedStoreImpl : public Store {
 public:
   IsolatedStoreImpl()
       : counters_([this](const std::string& name) -> CounterImpl* {
-          return new CounterImpl(*alloc_.alloc(name), alloc_, std::string(name),
+          return new CounterImpl(*alloc_.alloc(name), alloc_, name, std::string(name),
                                  std::vector<Tag>());
         }),
         gauges_([this](const std::string& name) -> GaugeImpl* {
-          return new GaugeImpl(*alloc_.alloc(name), alloc_, std::string(name), std::vector<Tag>());
+          return new GaugeImpl(*alloc_.alloc(name), alloc_, name, std::string(name),
+                               std::vector<Tag>());
         }),
         histograms_([this](const std::string& name) -> HistogramImpl* {
           return new HistogramImpl(name, *this, std::string(name), std::vector<Tag>());
@@ -355,6 +483,10 @@ public:
   // Stats::Store
   std::list<CounterSharedPtr> counters() const override { return counters_.toList(); }
   std::list<GaugeSharedPtr> gauges() const override { return gauges_.toList(); }
+  // Histograms are not aggregated by the isolated store.
+  std::list<ParentHistogramSharedPtr> histograms() const override {
+    return std::list<ParentHistogramSharedPtr>{};
+  }
 
 private:
   struct ScopeImpl : public Scope {
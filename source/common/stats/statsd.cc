@@ -1,8 +1,12 @@
 #include "common/stats/statsd.h"
 
+#include <sys/socket.h>
+
 #include <chrono>
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "envoy/common/exception.h"
 #include "envoy/event/dispatcher.h"
@@ -18,7 +22,9 @@ namespace Envoy {
 namespace Stats {
 namespace Statsd {
 
-Writer::Writer(Network::Address::InstanceConstSharedPtr address) {
+Writer::Writer(Network::Address::InstanceConstSharedPtr address, Event::Dispatcher& dispatcher,
+               uint64_t max_datagram_bytes, bool use_tags)
+    : dispatcher_(dispatcher), max_datagram_bytes_(max_datagram_bytes), use_tags_(use_tags) {
   fd_ = address->socket(Network::Address::SocketType::Datagram);
   ASSERT(fd_ != -1);
 
@@ -33,44 +39,120 @@ Writer::~Writer() {
   }
 }
 
-void Writer::writeCounter(const std::string& name, uint64_t increment) {
-  std::string message(fmt::format("envoy.{}:{}|c", name, increment));
-  send(message);
-}
+void Writer::write(const Metric& metric, uint64_t value, const char* type) {
+  // Produces something like "envoy.{}:{}|c" or "envoy.{}:{}|c|#{}:{},{}:{}" with tags, appended to
+  // the open datagram after a newline.
+  const size_t message_start = buffer_.size();
+  if (message_start > open_datagram_start_) {
+    buffer_.push_back('\n');
+  }
+  buffer_.append("envoy.");
+  buffer_.append(use_tags_ ? metric.tagExtractedName() : metric.name());
+  buffer_.push_back(':');
+  char value_buffer[32];
+  buffer_.append(value_buffer, StringUtil::itoa(value_buffer, sizeof(value_buffer), value));
+  buffer_.push_back('|');
+  buffer_.append(type);
+  if (use_tags_ && !metric.tags().empty()) {
+    char separator = '#';
+    buffer_.push_back('|');
+    for (const Tag& tag : metric.tags()) {
+      buffer_.push_back(separator);
+      separator = ',';
+      buffer_.append(tag.name_);
+      buffer_.push_back(':');
+      buffer_.append(tag.value_);
+    }
+  }
 
-void Writer::writeGauge(const std::string& name, uint64_t value) {
-  std::string message(fmt::format("envoy.{}:{}|g", name, value));
-  send(message);
+  // If the message made the open datagram too large, complete the datagram without it and move
+  // the message (minus the newline) to a new datagram.
+  if (buffer_.size() - open_datagram_start_ > max_datagram_bytes_ &&
+      message_start > open_datagram_start_) {
+    datagrams_.emplace_back(open_datagram_start_, message_start - open_datagram_start_);
+    buffer_.erase(message_start, 1);
+    open_datagram_start_ = message_start;
+  }
+
+  if (datagrams_.size() >= MAX_PENDING_DATAGRAMS) {
+    flush();
+  } else if (!flush_posted_) {
+    // Send whatever was written during this event loop iteration once it is done. This coalesces
+    // the timings recorded by the requests handled in one iteration on workers.
+    flush_posted_ = true;
+    std::weak_ptr<Writer> weak_this = shared_from_this();
+    dispatcher_.post([weak_this]() -> void {
+      std::shared_ptr<Writer> writer = weak_this.lock();
+      if (writer) {
+        writer->flush_posted_ = false;
+        writer->flush();
+      }
+    });
+  }
 }
 
-void Writer::writeTimer(const std::string& name, const std::chrono::milliseconds& ms) {
-  std::string message(fmt::format("envoy.{}:{}|ms", name, ms.count()));
-  send(message);
+void Writer::flush() {
+  if (buffer_.size() > open_datagram_start_) {
+    datagrams_.emplace_back(open_datagram_start_, buffer_.size() - open_datagram_start_);
+  }
+  if (!datagrams_.empty()) {
+    send();
+  }
+
+  buffer_.clear();
+  datagrams_.clear();
+  open_datagram_start_ = 0;
 }
 
-void Writer::send(const std::string& message) {
-  ::send(fd_, message.c_str(), message.size(), MSG_DONTWAIT);
+void Writer::send() {
+#ifdef __APPLE__
+  for (const auto& datagram : datagrams_) {
+    ::send(fd_, &buffer_[datagram.first], datagram.second, MSG_DONTWAIT);
+  }
+#else
+  std::vector<iovec> iovecs(datagrams_.size());
+  std::vector<mmsghdr> messages(datagrams_.size());
+  for (size_t i = 0; i < datagrams_.size(); i++) {
+    iovecs[i].iov_base = &buffer_[datagrams_[i].first];
+    iovecs[i].iov_len = datagrams_[i].second;
+    messages[i].msg_hdr.msg_iov = &iovecs[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  // Like individual sends, datagrams are dropped rather than waited for if the socket buffer is
+  // full.
+  size_t sent = 0;
+  while (sent < messages.size()) {
+    const int rc = ::sendmmsg(fd_, &messages[sent], messages.size() - sent, MSG_DONTWAIT);
+    if (rc <= 0) {
+      break;
+    }
+    sent += rc;
+  }
+#endif
 }
 
 UdpStatsdSink::UdpStatsdSink(ThreadLocal::SlotAllocator& tls,
-                             Network::Address::InstanceConstSharedPtr address)
-    : tls_(tls.allocateSlot()), server_address_(address) {
-  tls_->set([this](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
-    return std::make_shared<Writer>(this->server_address_);
+                             Network::Address::InstanceConstSharedPtr address,
+                             uint64_t max_datagram_bytes, bool use_tags)
+    : tls_(tls.allocateSlot()), server_address_(address), max_datagram_bytes_(max_datagram_bytes),
+      use_tags_(use_tags) {
+  tls_->set([this](Event::Dispatcher& dispatcher) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<Writer>(server_address_, dispatcher, max_datagram_bytes_, use_tags_);
   });
 }
 
 void UdpStatsdSink::flushCounter(const Counter& counter, uint64_t delta) {
-  tls_->getTyped<Writer>().writeCounter(counter.name(), delta);
+  tls_->getTyped<Writer>().writeCounter(counter, delta);
 }
 
 void UdpStatsdSink::flushGauge(const Gauge& gauge, uint64_t value) {
-  tls_->getTyped<Writer>().writeGauge(gauge.name(), value);
+  tls_->getTyped<Writer>().writeGauge(gauge, value);
 }
 
 void UdpStatsdSink::onHistogramComplete(const Histogram& histogram, uint64_t value) {
   // For statsd histograms are all timers.
-  tls_->getTyped<Writer>().writeTimer(histogram.name(), std::chrono::milliseconds(value));
+  tls_->getTyped<Writer>().writeTimer(histogram, std::chrono::milliseconds(value));
 }
 
 char TcpStatsdSink::STAT_PREFIX[] = "envoy.";
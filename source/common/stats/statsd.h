@@ -2,8 +2,12 @@
 
 #include <chrono>
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "envoy/event/dispatcher.h"
 #include "envoy/local_info/local_info.h"
 #include "envoy/network/connection.h"
 #include "envoy/stats/stats.h"
@@ -17,46 +21,83 @@ namespace Stats {
 namespace Statsd {
 
 /**
- * This is a simple UDP localhost writer for statsd messages.
+ * Per thread UDP writer for statsd messages. Messages are formatted into a reusable buffer and
+ * packed into datagrams of up to max_datagram_bytes, separated by newlines. Pending datagrams are
+ * sent in one batch (with sendmmsg() where available) when flush() is called, when enough
+ * datagrams are pending, or at the end of the current event loop iteration.
  */
-class Writer : public ThreadLocal::ThreadLocalObject {
+class Writer : public ThreadLocal::ThreadLocalObject, public std::enable_shared_from_this<Writer> {
 public:
-  Writer(Network::Address::InstanceConstSharedPtr address);
+  Writer(Network::Address::InstanceConstSharedPtr address, Event::Dispatcher& dispatcher,
+         uint64_t max_datagram_bytes, bool use_tags);
   ~Writer();
 
-  void writeCounter(const std::string& name, uint64_t increment);
-  void writeGauge(const std::string& name, uint64_t value);
-  void writeTimer(const std::string& name, const std::chrono::milliseconds& ms);
+  void writeCounter(const Metric& counter, uint64_t increment) { write(counter, increment, "c"); }
+  void writeGauge(const Metric& gauge, uint64_t value) { write(gauge, value, "g"); }
+  void writeTimer(const Metric& timer, const std::chrono::milliseconds& ms) {
+    write(timer, ms.count(), "ms");
+  }
+
+  /**
+   * Send all pending datagrams.
+   */
+  void flush();
 
   // Called in unit test to validate address.
   int getFdForTests() const { return fd_; };
 
 private:
-  void send(const std::string& message);
+  void send();
+  void write(const Metric& metric, uint64_t value, const char* type);
+
+  // Upper bound on the datagrams buffered before they are sent without waiting for a flush.
+  static const uint64_t MAX_PENDING_DATAGRAMS = 64;
 
   int fd_;
+  Event::Dispatcher& dispatcher_;
+  const uint64_t max_datagram_bytes_;
+  const bool use_tags_;
+  // Pending datagrams back to back. The last one is still open for more messages.
+  std::string buffer_;
+  // Offset and length of the completed datagrams in buffer_.
+  std::vector<std::pair<size_t, size_t>> datagrams_;
+  size_t open_datagram_start_{};
+  bool flush_posted_{};
 };
 
 /**
  * Implementation of Sink that writes to a UDP statsd address.
+ * @param max_datagram_bytes supplies the size that multiple messages are packed into. A message
+ *                           that does not fit on its own is sent in a datagram of its own, so 0
+ *                           sends one message per datagram.
+ * @param use_tags supplies whether to send the tag extracted name with DogStatsD style tags
+ *                 ("|#name:value,...") instead of the full stat name.
  */
 class UdpStatsdSink : public Sink {
 public:
-  UdpStatsdSink(ThreadLocal::SlotAllocator& tls, Network::Address::InstanceConstSharedPtr address);
+  UdpStatsdSink(ThreadLocal::SlotAllocator& tls, Network::Address::InstanceConstSharedPtr address,
+                uint64_t max_datagram_bytes, bool use_tags);
 
   // Stats::Sink
   void beginFlush() override {}
   void flushCounter(const Counter& counter, uint64_t delta) override;
   void flushGauge(const Gauge& gauge, uint64_t value) override;
-  void endFlush() override {}
+  // Histogram values are sent individually via onHistogramComplete() and aggregated by statsd.
+  void flushHistogram(const ParentHistogram&) override {}
+  void endFlush() override { tls_->getTyped<Writer>().flush(); }
   void onHistogramComplete(const Histogram& histogram, uint64_t value) override;
 
   // Called in unit test to validate writer construction and address.
   int getFdForTests() { return tls_->getTyped<Writer>().getFdForTests(); }
 
+  // Safe for typical internet paths without fragmentation.
+  static const uint64_t DEFAULT_MAX_DATAGRAM_BYTES = 1432;
+
 private:
   ThreadLocal::SlotPtr tls_;
   Network::Address::InstanceConstSharedPtr server_address_;
+  const uint64_t max_datagram_bytes_;
+  const bool use_tags_;
 };
 
 /**
@@ -79,6 +120,9 @@ public:
     tls_->getTyped<TlsSink>().flushGauge(gauge.name(), value);
   }
 
+  // Histogram values are sent individually via onHistogramComplete() and aggregated by statsd.
+  void flushHistogram(const ParentHistogram&) override {}
+
   void endFlush() override { tls_->getTyped<TlsSink>().endFlush(true); }
 
   void onHistogramComplete(const Histogram& histogram, uint64_t value) override {
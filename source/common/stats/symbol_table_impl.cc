@@ -0,0 +1,173 @@
+#include "common/stats/symbol_table_impl.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Stats {
+
+SymbolTable& SymbolTable::global() {
+  static SymbolTable* table = new SymbolTable();
+  return *table;
+}
+
+SymbolTable::~SymbolTable() {
+  for (std::atomic<DecodePage*>& page : decode_pages_) {
+    delete page.load();
+  }
+}
+
+void SymbolTable::encodeVarint(uint64_t value, std::vector<uint8_t>& encoding) {
+  while (value >= 0x80) {
+    encoding.push_back(static_cast<uint8_t>(value) | 0x80);
+    value >>= 7;
+  }
+  encoding.push_back(static_cast<uint8_t>(value));
+}
+
+uint64_t SymbolTable::decodeVarint(const uint8_t*& encoding) {
+  uint64_t value = 0;
+  for (uint32_t shift = 0;; shift += 7) {
+    const uint8_t byte = *encoding++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+}
+
+std::vector<std::string> SymbolTable::tokenize(const std::string& name) {
+  // Split on '.', keeping empty tokens so that every name decodes back to itself.
+  std::vector<std::string> tokens;
+  size_t start = 0;
+  while (true) {
+    const size_t end = name.find('.', start);
+    tokens.emplace_back(name, start, end == std::string::npos ? std::string::npos : end - start);
+    if (end == std::string::npos) {
+      break;
+    }
+    start = end + 1;
+  }
+  return tokens;
+}
+
+void SymbolTable::encode(const std::string& name, std::vector<uint8_t>& encoding) {
+  const std::vector<std::string> tokens = tokenize(name);
+  encodeVarint(tokens.size(), encoding);
+  for (const std::string& token : tokens) {
+    encodeVarint(toSymbol(token), encoding);
+  }
+}
+
+Symbol SymbolTable::toSymbol(const std::string& token) {
+  Shard& shard = shardFor(token);
+  std::unique_lock<std::mutex> lock(shard.lock_);
+  auto it = shard.encode_map_.find(token);
+  if (it == shard.encode_map_.end()) {
+    it = shard.encode_map_.emplace(token, SharedSymbol{0, 0}).first;
+    std::unique_lock<std::mutex> symbol_lock(symbol_lock_);
+    if (free_symbols_.empty()) {
+      RELEASE_ASSERT(next_symbol_ < MAX_DECODE_PAGES * SYMBOLS_PER_PAGE);
+      it->second.symbol_ = next_symbol_++;
+    } else {
+      it->second.symbol_ = free_symbols_.back();
+      free_symbols_.pop_back();
+    }
+    setDecode(it->second.symbol_, &it->first);
+  }
+
+  it->second.ref_count_++;
+  return it->second.symbol_;
+}
+
+void SymbolTable::setDecode(Symbol symbol, const std::string* token) {
+  std::atomic<DecodePage*>& page_ref = decode_pages_[symbol / SYMBOLS_PER_PAGE];
+  DecodePage* page = page_ref.load(std::memory_order_relaxed);
+  if (page == nullptr) {
+    page = new DecodePage();
+    for (std::atomic<const std::string*>& entry : *page) {
+      entry.store(nullptr, std::memory_order_relaxed);
+    }
+    page_ref.store(page, std::memory_order_release);
+  }
+  (*page)[symbol % SYMBOLS_PER_PAGE].store(token, std::memory_order_release);
+}
+
+const std::string& SymbolTable::fromSymbol(Symbol symbol) const {
+  const DecodePage* page = decode_pages_[symbol / SYMBOLS_PER_PAGE].load(std::memory_order_acquire);
+  ASSERT(page != nullptr);
+  const std::string* token = (*page)[symbol % SYMBOLS_PER_PAGE].load(std::memory_order_acquire);
+  ASSERT(token != nullptr);
+  return *token;
+}
+
+std::string SymbolTable::decode(const uint8_t*& encoding) const {
+  std::string name;
+  const uint64_t num_tokens = decodeVarint(encoding);
+  for (uint64_t i = 0; i < num_tokens; i++) {
+    if (i > 0) {
+      name.push_back('.');
+    }
+    name.append(fromSymbol(decodeVarint(encoding)));
+  }
+  return name;
+}
+
+void SymbolTable::free(const uint8_t*& encoding) {
+  const uint64_t num_tokens = decodeVarint(encoding);
+  for (uint64_t i = 0; i < num_tokens; i++) {
+    const Symbol symbol = decodeVarint(encoding);
+    const std::string& token = fromSymbol(symbol);
+    Shard& shard = shardFor(token);
+    std::unique_lock<std::mutex> lock(shard.lock_);
+    auto it = shard.encode_map_.find(token);
+    ASSERT(it != shard.encode_map_.end());
+    if (--it->second.ref_count_ == 0) {
+      std::unique_lock<std::mutex> symbol_lock(symbol_lock_);
+      setDecode(symbol, nullptr);
+      free_symbols_.push_back(symbol);
+      // token refers to the key that is erased here.
+      shard.encode_map_.erase(it);
+    }
+  }
+}
+
+void SymbolTable::skip(const uint8_t*& encoding) {
+  const uint64_t num_tokens = decodeVarint(encoding);
+  for (uint64_t i = 0; i < num_tokens; i++) {
+    decodeVarint(encoding);
+  }
+}
+
+size_t SymbolTable::size() const {
+  size_t size = 0;
+  for (const Shard& shard : shards_) {
+    std::unique_lock<std::mutex> lock(shard.lock_);
+    size += shard.encode_map_.size();
+  }
+  return size;
+}
+
+StatNameStorage::StatNameStorage(const std::string& name, SymbolTable& symbol_table)
+    : symbol_table_(symbol_table) {
+  symbol_table_.encode(name, encoding_);
+}
+
+StatNameStorage::~StatNameStorage() {
+  const uint8_t* encoding = encoding_.data();
+  symbol_table_.free(encoding);
+}
+
+size_t StatName::size() const {
+  const uint8_t* end = encoding_;
+  SymbolTable::skip(end);
+  return end - encoding_;
+}
+
+} // namespace Stats
+} // namespace Envoy
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "common/common/hash.h"
+
+namespace Envoy {
+namespace Stats {
+
+typedef uint32_t Symbol;
+
+/**
+ * Reference to a name encoded by SymbolTable::encode(). It neither owns the encoding nor holds
+ * references to its symbols, so it is only valid while the owner of the encoding (a MetricImpl or a
+ * StatNameStorage) is alive. Encodings of equal names are equal while their tokens are in the
+ * table, so stat names are compared and hashed by their encoding without decoding them.
+ */
+class StatName {
+public:
+  StatName() {}
+  explicit StatName(const uint8_t* encoding) : encoding_(encoding) {}
+
+  const uint8_t* data() const { return encoding_; }
+
+  /**
+   * @return size_t the number of bytes of the encoding.
+   */
+  size_t size() const;
+
+  bool operator==(const StatName& rhs) const {
+    const size_t size = this->size();
+    return size == rhs.size() && memcmp(encoding_, rhs.encoding_, size) == 0;
+  }
+  bool operator!=(const StatName& rhs) const { return !(*this == rhs); }
+
+private:
+  const uint8_t* encoding_{};
+};
+
+struct StatNameHash {
+  size_t operator()(const StatName& name) const {
+    return HashUtil::xxHash64(name.data(), name.size());
+  }
+};
+
+template <class Value> using StatNameHashMap = std::unordered_map<StatName, Value, StatNameHash>;
+typedef std::unordered_set<StatName, StatNameHash> StatNameHashSet;
+
+/**
+ * Maps the dot-separated tokens of stat names to small integer symbols. Stat names repeat the same
+ * tokens over and over ("cluster", cluster names, "upstream_rq_200", ...), so a stat that keeps
+ * its name as a sequence of symbols needs a few bytes instead of a string per name.
+ *
+ * A name is encoded as the number of its tokens followed by the symbol of each token, all as
+ * base 128 varints. Tokens are reference counted by the names that were encoded with them, and
+ * the symbol of a token that is no longer referenced is reused so that symbols stay small.
+ *
+ * This class is thread safe. Tokens are spread over shards by hash, each with its own lock, so
+ * encoding and freeing names from different threads rarely contend. The lock that hands out
+ * symbols is only taken when a token is added to or removed from the table. Decoding takes no lock
+ * at all: the token of a symbol is found through pages that are published with release stores and
+ * never move, and it cannot change while an encoding that references it is alive.
+ */
+class SymbolTable {
+public:
+  SymbolTable() {}
+  ~SymbolTable();
+
+  /**
+   * @return SymbolTable& the process wide table used by MetricImpl. It is never destroyed, so
+   *         stats that are released during static destruction can still return their symbols.
+   */
+  static SymbolTable& global();
+
+  /**
+   * Appends the encoding of a name, adding a reference to the symbol of each of its tokens.
+   * @param name supplies the name.
+   * @param encoding supplies the buffer to append to.
+   */
+  void encode(const std::string& name, std::vector<uint8_t>& encoding);
+
+  /**
+   * Decodes a name appended by encode().
+   * @param encoding supplies the start of the encoded name and is advanced past it.
+   * @return std::string the name.
+   */
+  std::string decode(const uint8_t*& encoding) const;
+
+  /**
+   * Releases the references that encode() added for a name.
+   * @param encoding supplies the start of the encoded name and is advanced past it.
+   */
+  void free(const uint8_t*& encoding);
+
+  /**
+   * Advances encoding past a name appended by encode() without decoding it.
+   */
+  static void skip(const uint8_t*& encoding);
+
+  /**
+   * @return size_t the number of tokens currently in the table.
+   */
+  size_t size() const;
+
+  /**
+   * Appends value as a base 128 varint, least significant group first.
+   */
+  static void encodeVarint(uint64_t value, std::vector<uint8_t>& encoding);
+
+  /**
+   * Decodes a varint appended by encodeVarint() and advances encoding past it.
+   */
+  static uint64_t decodeVarint(const uint8_t*& encoding);
+
+private:
+  struct SharedSymbol {
+    Symbol symbol_;
+    uint64_t ref_count_;
+  };
+
+  struct Shard {
+    mutable std::mutex lock_;
+    std::unordered_map<std::string, SharedSymbol> encode_map_;
+  };
+
+  static const size_t NUM_SHARDS = 8;
+  static const uint32_t SYMBOLS_PER_PAGE = 1024;
+  static const uint32_t MAX_DECODE_PAGES = 4096;
+
+  typedef std::array<std::atomic<const std::string*>, SYMBOLS_PER_PAGE> DecodePage;
+
+  static std::vector<std::string> tokenize(const std::string& name);
+  Shard& shardFor(const std::string& token) {
+    return shards_[std::hash<std::string>()(token) % NUM_SHARDS];
+  }
+  Symbol toSymbol(const std::string& token);
+  const std::string& fromSymbol(Symbol symbol) const;
+  void setDecode(Symbol symbol, const std::string* token);
+
+  std::array<Shard, NUM_SHARDS> shards_;
+  // Protects the symbol allocation below and writes to decode_pages_.
+  std::mutex symbol_lock_;
+  // Indexed by symbol. Points at the keys of the encode maps, nullptr for unused symbols.
+  std::array<std::atomic<DecodePage*>, MAX_DECODE_PAGES> decode_pages_{};
+  // Unused symbols below next_symbol_.
+  std::vector<Symbol> free_symbols_;
+  Symbol next_symbol_{};
+};
+
+/**
+ * Owns the encoding of a single name and the symbol references it holds.
+ */
+class StatNameStorage {
+public:
+  StatNameStorage(const std::string& name, SymbolTable& symbol_table);
+  ~StatNameStorage();
+
+  StatName statName() const { return StatName(encoding_.data()); }
+
+private:
+  SymbolTable& symbol_table_;
+  std::vector<uint8_t> encoding_;
+};
+
+typedef std::unique_ptr<StatNameStorage> StatNameStoragePtr;
+
+} // namespace Stats
+} // namespace Envoy
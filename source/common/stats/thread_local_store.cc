@@ -7,6 +7,7 @@
 #include <mutex>
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 namespace Envoy {
 namespace Stats {
@@ -24,14 +25,32 @@ ThreadLocalStoreImpl::~ThreadLocalStoreImpl() {
 std::list<CounterSharedPtr> ThreadLocalStoreImpl::counters() const {
   // Handle de-dup due to overlapping scopes.
   std::list<CounterSharedPtr> ret;
-  std::unordered_set<std::string> names;
+  StatNameHashSet names;
   std::unique_lock<std::mutex> lock(lock_);
   for (ScopeImpl* scope : scopes_) {
-    for (auto counter : scope->central_cache_.counters_) {
-      if (names.insert(counter.first).second) {
-        ret.push_back(counter.second);
-      }
-    }
+    scope->central_cache_.counters_.forEach(
+        [&ret, &names](StatName name, const ShardedCounterImplSharedPtr& counter) -> void {
+          if (names.insert(name).second) {
+            ret.push_back(counter);
+          }
+        });
+  }
+
+  return ret;
+}
+
+std::list<ParentHistogramSharedPtr> ThreadLocalStoreImpl::histograms() const {
+  // Handle de-dup due to overlapping scopes.
+  std::list<ParentHistogramSharedPtr> ret;
+  StatNameHashSet names;
+  std::unique_lock<std::mutex> lock(lock_);
+  for (ScopeImpl* scope : scopes_) {
+    scope->central_cache_.histograms_.forEach(
+        [&ret, &names](StatName name, const ParentHistogramImplSharedPtr& histogram) -> void {
+          if (names.insert(name).second) {
+            ret.push_back(histogram);
+          }
+        });
   }
 
   return ret;
@@ -47,14 +66,15 @@ ScopePtr ThreadLocalStoreImpl::createScope(const std::string& name) {
 std::list<GaugeSharedPtr> ThreadLocalStoreImpl::gauges() const {
   // Handle de-dup due to overlapping scopes.
   std::list<GaugeSharedPtr> ret;
-  std::unordered_set<std::string> names;
+  StatNameHashSet names;
   std::unique_lock<std::mutex> lock(lock_);
   for (ScopeImpl* scope : scopes_) {
-    for (auto gauge : scope->central_cache_.gauges_) {
-      if (names.insert(gauge.first).second) {
-        ret.push_back(gauge.second);
-      }
-    }
+    scope->central_cache_.gauges_.forEach(
+        [&ret, &names](StatName name, const GaugeImplSharedPtr& gauge) -> void {
+          if (names.insert(name).second) {
+            ret.push_back(gauge);
+          }
+        });
   }
 
   return ret;
@@ -74,6 +94,47 @@ void ThreadLocalStoreImpl::shutdownThreading() {
   shutting_down_ = true;
 }
 
+void ThreadLocalStoreImpl::mergeHistograms(PostMergeCb merge_complete_cb) {
+  if (!shutting_down_ && tls_) {
+    // Switch the recording buffer on every thread first. Once all threads have switched, nothing
+    // writes to the inactive buffers and the main thread can merge them.
+    tls_->runOnAllThreads(
+        [this]() -> void {
+          for (auto& scope : tls_->getTyped<TlsCache>().scope_cache_) {
+            for (auto& histogram : scope.second.histograms_) {
+              histogram.second->beginMerge();
+            }
+          }
+        },
+        [this, merge_complete_cb]() -> void { mergeInternal(merge_complete_cb); });
+  } else {
+    mergeInternal(merge_complete_cb);
+  }
+}
+
+void ThreadLocalStoreImpl::mergeInternal(PostMergeCb merge_complete_cb) {
+  // Once we are shutting down the workers may no longer have switched their buffers, so the
+  // histograms keep their last merged values. The final flush still goes ahead.
+  if (!shutting_down_) {
+    std::list<ParentHistogramImplSharedPtr> histograms;
+    {
+      std::unique_lock<std::mutex> lock(lock_);
+      for (ScopeImpl* scope : scopes_) {
+        scope->central_cache_.histograms_.forEach(
+            [&histograms](StatName, const ParentHistogramImplSharedPtr& histogram) -> void {
+              histograms.push_back(histogram);
+            });
+      }
+    }
+
+    for (const ParentHistogramImplSharedPtr& histogram : histograms) {
+      histogram->merge();
+    }
+  }
+
+  merge_complete_cb();
+}
+
 void ThreadLocalStoreImpl::releaseScopeCrossThread(ScopeImpl* scope) {
   std::unique_lock<std::mutex> lock(lock_);
   ASSERT(scopes_.count(scope) == 1);
@@ -138,16 +199,28 @@ Counter& ThreadLocalStoreImpl::ScopeImpl::counter(const std::string& name) {
     return **tls_ref;
   }
 
-  // We must now look in the central store so we must be locked. We grab a reference to the
-  // central store location. It might contain nothing. In this case, we allocate a new stat.
-  std::unique_lock<std::mutex> lock(parent_.lock_);
-  CounterSharedPtr& central_ref = central_cache_.counters_[final_name];
-  if (!central_ref) {
-    SafeAllocData alloc = parent_.safeAlloc(final_name);
-    std::vector<Tag> tags;
-    std::string tag_extracted_name = parent_.getTagsForName(final_name, tags);
-    central_ref.reset(
-        new CounterImpl(alloc.data_, alloc.free_, std::move(tag_extracted_name), std::move(tags)));
+  // Rejected counters live in their own map, which is never listed, and only keep their value.
+  CounterSharedPtr central_ref;
+  if (parent_.rejects(final_name)) {
+    std::unique_lock<std::mutex> lock(central_cache_.rejected_lock_);
+    CounterSharedPtr& rejected_ref = central_cache_.rejected_counters_[final_name];
+    if (!rejected_ref) {
+      rejected_ref = std::make_shared<UnexportedCounterImpl>();
+    }
+    central_ref = rejected_ref;
+  } else {
+    // We must now look in the central store. If it does not have the stat yet, we allocate a new
+    // one and extract its tags without holding the central store's lock.
+    StatNameStorage stat_name(final_name, SymbolTable::global());
+    central_ref = central_cache_.counters_.getOrCreate(
+        stat_name.statName(), [this, &final_name]() -> ShardedCounterImplSharedPtr {
+          SafeAllocData alloc = parent_.safeAlloc(final_name);
+          std::vector<Tag> tags;
+          std::string tag_extracted_name = parent_.getTagsForName(final_name, tags);
+          return std::make_shared<ShardedCounterImpl>(alloc.data_, alloc.free_, final_name,
+                                                      std::move(tag_extracted_name),
+                                                      std::move(tags));
+        });
   }
 
   // If we have a TLS location to store or allocation into, do it.
@@ -155,7 +228,7 @@ Counter& ThreadLocalStoreImpl::ScopeImpl::counter(const std::string& name) {
     *tls_ref = central_ref;
   }
 
-  // Finally we return the reference.
+  // Finally we return the reference. The central store keeps the stat alive.
   return *central_ref;
 }
 
@@ -188,14 +261,24 @@ Gauge& ThreadLocalStoreImpl::ScopeImpl::gauge(const std::string& name) {
     return **tls_ref;
   }
 
-  std::unique_lock<std::mutex> lock(parent_.lock_);
-  GaugeSharedPtr& central_ref = central_cache_.gauges_[final_name];
-  if (!central_ref) {
-    SafeAllocData alloc = parent_.safeAlloc(final_name);
-    std::vector<Tag> tags;
-    std::string tag_extracted_name = parent_.getTagsForName(final_name, tags);
-    central_ref.reset(
-        new GaugeImpl(alloc.data_, alloc.free_, std::move(tag_extracted_name), std::move(tags)));
+  GaugeSharedPtr central_ref;
+  if (parent_.rejects(final_name)) {
+    std::unique_lock<std::mutex> lock(central_cache_.rejected_lock_);
+    GaugeSharedPtr& rejected_ref = central_cache_.rejected_gauges_[final_name];
+    if (!rejected_ref) {
+      rejected_ref = std::make_shared<UnexportedGaugeImpl>();
+    }
+    central_ref = rejected_ref;
+  } else {
+    StatNameStorage stat_name(final_name, SymbolTable::global());
+    central_ref = central_cache_.gauges_.getOrCreate(
+        stat_name.statName(), [this, &final_name]() -> GaugeImplSharedPtr {
+          SafeAllocData alloc = parent_.safeAlloc(final_name);
+          std::vector<Tag> tags;
+          std::string tag_extracted_name = parent_.getTagsForName(final_name, tags);
+          return std::make_shared<GaugeImpl>(alloc.data_, alloc.free_, final_name,
+                                             std::move(tag_extracted_name), std::move(tags));
+        });
   }
 
   if (tls_ref) {
@@ -206,32 +289,78 @@ Gauge& ThreadLocalStoreImpl::ScopeImpl::gauge(const std::string& name) {
 }
 
 Histogram& ThreadLocalStoreImpl::ScopeImpl::histogram(const std::string& name) {
-  // See comments in counter(). There is no super clean way (via templates or otherwise) to
-  // share this code so I'm leaving it largely duplicated for now.
+  // See comments in counter(). Unlike counters and gauges, each thread caches its own histogram
+  // that it records into, and the central cache holds the parent histogram that merges them.
   std::string final_name = prefix_ + name;
-  HistogramSharedPtr* tls_ref = nullptr;
+  TlsCacheEntry* tls_entry = nullptr;
   if (!parent_.shutting_down_ && parent_.tls_) {
-    tls_ref = &parent_.tls_->getTyped<TlsCache>().scope_cache_[this].histograms_[final_name];
+    tls_entry = &parent_.tls_->getTyped<TlsCache>().scope_cache_[this];
+    auto histogram = tls_entry->histograms_.find(final_name);
+    if (histogram != tls_entry->histograms_.end()) {
+      return *histogram->second;
+    }
+    if (tls_entry->rejected_histograms_.count(final_name) > 0) {
+      return parent_.null_histogram_;
+    }
   }
 
-  if (tls_ref && *tls_ref) {
-    return **tls_ref;
+  if (parent_.rejects(final_name)) {
+    if (tls_entry) {
+      tls_entry->rejected_histograms_.insert(final_name);
+    }
+    return parent_.null_histogram_;
   }
 
-  std::unique_lock<std::mutex> lock(parent_.lock_);
-  HistogramSharedPtr& central_ref = central_cache_.histograms_[final_name];
-  if (!central_ref) {
-    std::vector<Tag> tags;
-    std::string tag_extracted_name = parent_.getTagsForName(final_name, tags);
-    central_ref.reset(
-        new HistogramImpl(final_name, parent_, std::move(tag_extracted_name), std::move(tags)));
+  StatNameStorage stat_name(final_name, SymbolTable::global());
+  ParentHistogramImplSharedPtr central_ref = central_cache_.histograms_.getOrCreate(
+      stat_name.statName(), [this, &final_name]() -> ParentHistogramImplSharedPtr {
+        std::vector<Tag> tags;
+        std::string tag_extracted_name = parent_.getTagsForName(final_name, tags);
+        return std::make_shared<ParentHistogramImpl>(final_name, parent_,
+                                                     std::move(tag_extracted_name),
+                                                     std::move(tags));
+      });
+
+  if (!tls_entry) {
+    return *central_ref;
   }
 
-  if (tls_ref) {
-    *tls_ref = central_ref;
+  ThreadLocalHistogramSharedPtr& tls_ref = tls_entry->histograms_[final_name];
+  tls_ref = central_ref->createTlsHistogram();
+  return *tls_ref;
+}
+
+ThreadLocalHistogramSharedPtr ParentHistogramImpl::createTlsHistogram() {
+  ThreadLocalHistogramSharedPtr histogram =
+      std::make_shared<ThreadLocalHistogramImpl>(name(), parent_, tagExtractedName(), tags());
+  std::unique_lock<std::mutex> lock(lock_);
+  tls_histograms_.push_back(histogram);
+  return histogram;
+}
+
+void ParentHistogramImpl::merge() {
+  interval_.clear();
+  {
+    std::unique_lock<std::mutex> lock(lock_);
+    for (const ThreadLocalHistogramSharedPtr& tls_histogram : tls_histograms_) {
+      tls_histogram->merge(interval_);
+    }
+    interval_.merge(unmerged_);
+    unmerged_.clear();
   }
 
-  return *central_ref;
+  cumulative_.merge(interval_);
+  used_ = used_ || interval_.sampleCount() > 0;
+  interval_statistics_.refresh(interval_);
+  cumulative_statistics_.refresh(cumulative_);
+}
+
+void ParentHistogramImpl::recordValue(uint64_t value) {
+  {
+    std::unique_lock<std::mutex> lock(lock_);
+    unmerged_.recordValue(value);
+  }
+  parent_.deliverHistogramToSinks(*this, value);
 }
 
 } // namespace Stats
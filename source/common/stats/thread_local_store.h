@@ -1,21 +1,166 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <functional>
 #include <list>
 #include <mutex>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "envoy/thread_local/thread_local.h"
 
+#include "common/stats/histogram_impl.h"
+#include "common/stats/sharded_counter_impl.h"
 #include "common/stats/stats_impl.h"
+#include "common/stats/symbol_table_impl.h"
 
 namespace Envoy {
 namespace Stats {
 
+/**
+ * Histogram that is only recorded into from a single thread. Values go into one of two sketches.
+ * When merging, the store first switches the active sketch on the recording thread and then merges
+ * the inactive sketch on the main thread, so recording never needs a lock. Every value is also
+ * delivered to the sinks, since backends such as statsd aggregate the individual samples.
+ */
+class ThreadLocalHistogramImpl : public Histogram, public MetricImpl {
+public:
+  ThreadLocalHistogramImpl(const std::string& name, Store& parent,
+                           std::string&& tag_extracted_name, std::vector<Tag>&& tags)
+      : MetricImpl(name, std::move(tag_extracted_name), std::move(tags)), parent_(parent) {}
+
+  // Stats::Histogram
+  void recordValue(uint64_t value) override {
+    sketches_[current_active_].recordValue(value);
+    parent_.deliverHistogramToSinks(*this, value);
+  }
+
+  /**
+   * Switch the sketch that values are recorded into. Must be called on the recording thread.
+   */
+  void beginMerge() { current_active_ = 1 - current_active_; }
+
+  /**
+   * Merge the inactive sketch into target and clear it. Called on the main thread after
+   * beginMerge() has run on the recording thread.
+   */
+  void merge(LogLinearHistogram& target) {
+    LogLinearHistogram& inactive = sketches_[1 - current_active_];
+    target.merge(inactive);
+    inactive.clear();
+  }
+
+private:
+  Store& parent_;
+  LogLinearHistogram sketches_[2];
+  uint32_t current_active_{};
+};
+
+typedef std::shared_ptr<ThreadLocalHistogramImpl> ThreadLocalHistogramSharedPtr;
+
+/**
+ * Central histogram that merges the values of the per-thread histograms created from it. It is
+ * recorded into directly only when thread local storage is not available.
+ */
+class ParentHistogramImpl : public ParentHistogram, public MetricImpl {
+public:
+  ParentHistogramImpl(const std::string& name, Store& parent, std::string&& tag_extracted_name,
+                      std::vector<Tag>&& tags)
+      : MetricImpl(name, std::move(tag_extracted_name), std::move(tags)), parent_(parent) {}
+
+  /**
+   * @return a new histogram for the calling thread to record into.
+   */
+  ThreadLocalHistogramSharedPtr createTlsHistogram();
+
+  /**
+   * Merge the values of all per-thread histograms and refresh the statistics. Called on the main
+   * thread.
+   */
+  void merge();
+
+  // Stats::Histogram
+  void recordValue(uint64_t value) override;
+
+  // Stats::ParentHistogram
+  bool used() const override { return used_; }
+  const HistogramStatistics& intervalStatistics() const override { return interval_statistics_; }
+  const HistogramStatistics& cumulativeStatistics() const override {
+    return cumulative_statistics_;
+  }
+
+private:
+  Store& parent_;
+  std::mutex lock_;
+  std::list<ThreadLocalHistogramSharedPtr> tls_histograms_;
+  // Values recorded without thread local storage. Protected by lock_.
+  LogLinearHistogram unmerged_;
+  LogLinearHistogram interval_;
+  LogLinearHistogram cumulative_;
+  HistogramStatisticsImpl interval_statistics_;
+  HistogramStatisticsImpl cumulative_statistics_;
+  bool used_{};
+};
+
+typedef std::shared_ptr<ParentHistogramImpl> ParentHistogramImplSharedPtr;
+
+/**
+ * Map from stat name to stat that can be used from any thread. The stats are spread over shards by
+ * name, each with its own lock, so that threads looking up different stats rarely contend. Stats
+ * are keyed by their own statName(), so the map holds no names of its own.
+ */
+template <class StatSharedPtr> class ShardedStatMap {
+public:
+  typedef std::function<StatSharedPtr()> MakeStatCb;
+
+  /**
+   * @return the stat with the given name. If there is none, a stat is created with make_stat().
+   *         make_stat() runs without holding a lock. If another thread adds the same stat in the
+   *         meantime, that stat is returned and the newly created one is dropped.
+   */
+  StatSharedPtr getOrCreate(StatName name, MakeStatCb make_stat) {
+    Shard& shard = shards_[StatNameHash()(name) % NUM_SHARDS];
+    {
+      std::unique_lock<std::mutex> lock(shard.lock_);
+      auto stat = shard.stats_.find(name);
+      if (stat != shard.stats_.end()) {
+        return stat->second;
+      }
+    }
+
+    StatSharedPtr new_stat = make_stat();
+    std::unique_lock<std::mutex> lock(shard.lock_);
+    return shard.stats_.emplace(new_stat->statName(), new_stat).first->second;
+  }
+
+  /**
+   * Run a callback for each stat in the map. Stats added concurrently may or may not be included.
+   */
+  void forEach(std::function<void(StatName name, const StatSharedPtr& stat)> cb) const {
+    for (const Shard& shard : shards_) {
+      std::unique_lock<std::mutex> lock(shard.lock_);
+      for (const auto& stat : shard.stats_) {
+        cb(stat.first, stat.second);
+      }
+    }
+  }
+
+private:
+  struct Shard {
+    mutable std::mutex lock_;
+    StatNameHashMap<StatSharedPtr> stats_;
+  };
+
+  static const size_t NUM_SHARDS = 8;
+
+  std::array<Shard, NUM_SHARDS> shards_;
+};
+
 /**
  * Store implementation with thread local caching. This implementation supports the following
  * features:
@@ -31,6 +176,9 @@ namespace Stats {
  * - Scopes can be deleted from any thread, and they are in practice as scopes are likely to be
  *   shared across all worker threads.
  * - Per thread caches are checked, and if empty, they are populated from the central cache.
+ * - The central cache of each scope is a sharded map, so filling per thread caches does not take
+ *   a store wide lock. New stats are allocated and their tags are extracted without holding any
+ *   lock, and if two threads race to create the same stat one of them is dropped.
  * - Scopes are entirely owned by the caller. The store only keeps weak pointers.
  * - When a scope is destroyed, a cache flush operation is run on all threads to flush any cached
  *   data owned by the destroyed scope.
@@ -38,8 +186,23 @@ namespace Stats {
  *         with the same address, and a cache flush operation could race and delete cache data
  *         for the new scope. This is extremely unlikely, and if it happens the cache will be
  *         repopulated on the next access.
- * - Since it's possible to have overlapping scopes, we de-dup stats when counters() or gauges() is
- *   called since these are very uncommon operations.
+ * - Since it's possible to have overlapping scopes, we de-dup stats when counters(), gauges() or
+ *   histograms() is called since these are very uncommon operations.
+ * - Histograms are recorded into per-thread histograms without locking. At each stats flush,
+ *   mergeHistograms() swaps the recording buffer on every thread and then merges the values into
+ *   the central parent histograms on the main thread.
+ * - Counters are ShardedCounterImpl, so workers incrementing the same counter each write to their
+ *   own cache lines. The increments are folded into the backing RawStatData when the counter is
+ *   read or latched. Counters of overlapping scopes share their shards along with the RawStatData.
+ * - Counters and gauges rejected by the stats matcher are UnexportedCounterImpl and
+ *   UnexportedGaugeImpl, kept in separate central maps that are never listed, so they are never
+ *   flushed. They still count, because code such as the health check state reads its own stats
+ *   back, but they take no stat memory or counter shard, have no name and skip tag extraction.
+ *   Rejected histograms resolve to one shared null histogram.
+ *   Per thread caches remember rejected names so that the matcher only runs once per name and
+ *   thread.
+ * - The central caches are keyed by StatName, which is only computed on a per thread cache miss.
+ *   Per thread caches are keyed by the full name, so that a hit takes no lock at all.
  * - Though this implementation is designed to work with a fixed shared memory space, it will fall
  *   back to heap allocated stats if needed. NOTE: In this case, overlapping scopes will not share
  *   the same backing store. This is to keep things simple, it could be done in the future if
@@ -64,21 +227,39 @@ public:
   // Stats::Store
   std::list<CounterSharedPtr> counters() const override;
   std::list<GaugeSharedPtr> gauges() const override;
+  std::list<ParentHistogramSharedPtr> histograms() const override;
 
   // Stats::StoreRoot
   void addSink(Sink& sink) override { timer_sinks_.push_back(sink); }
   void setTagExtractors(const std::vector<TagExtractorPtr>& tag_extractors) override {
     tag_extractors_ = &tag_extractors;
   }
+  void setStatsMatcher(const StatsMatcher& stats_matcher) override {
+    stats_matcher_ = &stats_matcher;
+  }
   void initializeThreading(Event::Dispatcher& main_thread_dispatcher,
                            ThreadLocal::Instance& tls) override;
   void shutdownThreading() override;
+  void mergeHistograms(PostMergeCb merge_complete_cb) override;
 
 private:
   struct TlsCacheEntry {
     std::unordered_map<std::string, CounterSharedPtr> counters_;
     std::unordered_map<std::string, GaugeSharedPtr> gauges_;
-    std::unordered_map<std::string, HistogramSharedPtr> histograms_;
+    std::unordered_map<std::string, ThreadLocalHistogramSharedPtr> histograms_;
+    // Rejected counters and gauges are cached like any other, rejected histograms are remembered
+    // here.
+    std::unordered_set<std::string> rejected_histograms_;
+  };
+
+  struct CentralCacheEntry {
+    ShardedStatMap<ShardedCounterImplSharedPtr> counters_;
+    ShardedStatMap<GaugeImplSharedPtr> gauges_;
+    ShardedStatMap<ParentHistogramImplSharedPtr> histograms_;
+    // Protects the rejected stats below, which are only looked up on a per thread cache miss.
+    std::mutex rejected_lock_;
+    std::unordered_map<std::string, CounterSharedPtr> rejected_counters_;
+    std::unordered_map<std::string, GaugeSharedPtr> rejected_gauges_;
   };
 
   struct ScopeImpl : public Scope {
@@ -97,7 +278,7 @@ private:
 
     ThreadLocalStoreImpl& parent_;
     const std::string prefix_;
-    TlsCacheEntry central_cache_;
+    CentralCacheEntry central_cache_;
   };
 
   struct TlsCache : public ThreadLocal::ThreadLocalObject {
@@ -110,21 +291,29 @@ private:
   };
 
   std::string getTagsForName(const std::string& name, std::vector<Tag>& tags);
+  bool rejects(const std::string& name) const {
+    return stats_matcher_ != nullptr && stats_matcher_->rejects(name);
+  }
   void clearScopeFromCaches(ScopeImpl* scope);
+  void mergeInternal(PostMergeCb merge_complete_cb);
   void releaseScopeCrossThread(ScopeImpl* scope);
   SafeAllocData safeAlloc(const std::string& name);
 
   RawStatDataAllocator& alloc_;
+  // Declared first so that it outlives the per thread caches that may hold stats allocated from it.
+  HeapRawStatDataAllocator heap_allocator_;
   Event::Dispatcher* main_thread_dispatcher_{};
   ThreadLocal::SlotPtr tls_;
+  // Protects scopes_. The central caches of the scopes have their own locks.
   mutable std::mutex lock_;
   std::unordered_set<ScopeImpl*> scopes_;
   ScopePtr default_scope_;
   std::list<std::reference_wrapper<Sink>> timer_sinks_;
   const std::vector<TagExtractorPtr>* tag_extractors_{};
+  const StatsMatcher* stats_matcher_{};
+  NullHistogramImpl null_histogram_;
   std::atomic<bool> shutting_down_{};
   Counter& num_last_resort_stats_;
-  HeapRawStatDataAllocator heap_allocator_;
 };
 
 } // namespace Stats
@@ -3,6 +3,7 @@
 #include <atomic>
 #include <cstdint>
 #include <list>
+#include <memory>
 
 #include "envoy/event/dispatcher.h"
 
@@ -89,6 +90,32 @@ void InstanceImpl::runOnAllThreads(Event::PostCb cb) {
   cb();
 }
 
+void InstanceImpl::runOnAllThreads(Event::PostCb cb, Event::PostCb all_threads_complete_cb) {
+  ASSERT(std::this_thread::get_id() == main_thread_id_);
+  ASSERT(!shutdown_);
+
+  // Handle main thread first so that the last worker thread to run the callback can post the
+  // completion callback back to the main thread.
+  cb();
+  if (registered_threads_.empty()) {
+    all_threads_complete_cb();
+    return;
+  }
+
+  std::shared_ptr<std::atomic<uint64_t>> remaining_threads =
+      std::make_shared<std::atomic<uint64_t>>(registered_threads_.size());
+  Event::Dispatcher& main_thread_dispatcher = *main_thread_dispatcher_;
+  for (Event::Dispatcher& dispatcher : registered_threads_) {
+    dispatcher.post([remaining_threads, cb, all_threads_complete_cb,
+                     &main_thread_dispatcher]() -> void {
+      cb();
+      if (--*remaining_threads == 0) {
+        main_thread_dispatcher.post(all_threads_complete_cb);
+      }
+    });
+  }
+}
+
 void InstanceImpl::SlotImpl::set(InitializeCb cb) {
   ASSERT(std::this_thread::get_id() == parent_.main_thread_id_);
   ASSERT(!parent_.shutdown_);
@@ -26,6 +26,7 @@
 #include "common/upstream/cds_api_impl.h"
 #include "common/upstream/load_balancer_impl.h"
 #include "common/upstream/original_dst_cluster.h"
+#include "common/upstream/peak_ewma_lb.h"
 #include "common/upstream/ring_hash_lb.h"
 #include "common/upstream/subset_lb.h"
 
@@ -169,7 +170,8 @@ ClusterManagerImpl::ClusterManagerImpl(const envoy::api::v2::Bootstrap& bootstra
                                        const LocalInfo::LocalInfo& local_info,
                                        AccessLog::AccessLogManager& log_manager,
                                        Event::Dispatcher& primary_dispatcher)
-    : factory_(factory), runtime_(runtime), stats_(stats), tls_(tls.allocateSlot()),
+    : factory_(factory), primary_dispatcher_(primary_dispatcher), runtime_(runtime), stats_(stats),
+      tls_(tls.allocateSlot()),
       random_(random), local_info_(local_info), cm_stats_(generateStats(stats)) {
   const auto& ads_config = bootstrap.dynamic_resources().ads_config();
   if (ads_config.cluster_name().empty()) {
@@ -181,10 +183,14 @@ ClusterManagerImpl::ClusterManagerImpl(const envoy::api::v2::Bootstrap& bootstra
       throw EnvoyException(
           "envoy::api::v2::ApiConfigSource must have a singleton cluster name specified");
     }
-    ads_mux_.reset(new Config::GrpcMuxImpl(
+    Config::GrpcMuxImpl* grpc_mux = new Config::GrpcMuxImpl(
         bootstrap.node(), *this, ads_config.cluster_name()[0], primary_dispatcher,
         *Protobuf::DescriptorPool::generated_pool()->FindMethodByName(
-            "envoy.api.v2.AggregatedDiscoveryService.StreamAggregatedResources")));
+            "envoy.api.v2.AggregatedDiscoveryService.StreamAggregatedResources"));
+    if (factory.configWorker() != nullptr) {
+      grpc_mux->setConfigWorker(*factory.configWorker());
+    }
+    ads_mux_.reset(grpc_mux);
   }
 
   const auto& cm_config = bootstrap.cluster_manager();
@@ -260,7 +266,8 @@ ClusterManagerImpl::ClusterManagerImpl(const envoy::api::v2::Bootstrap& bootstra
 ClusterManagerStats ClusterManagerImpl::generateStats(Stats::Scope& scope) {
   const std::string final_prefix = "cluster_manager.";
   return {ALL_CLUSTER_MANAGER_STATS(POOL_COUNTER_PREFIX(scope, final_prefix),
-                                    POOL_GAUGE_PREFIX(scope, final_prefix))};
+                                    POOL_GAUGE_PREFIX(scope, final_prefix),
+                                    POOL_HISTOGRAM_PREFIX(scope, final_prefix))};
 }
 
 void ClusterManagerImpl::postInitializeCluster(Cluster& cluster) {
@@ -287,20 +294,12 @@ bool ClusterManagerImpl::addOrUpdatePrimaryCluster(const envoy::api::v2::Cluster
   }
 
   loadCluster(cluster, true);
-  ClusterInfoConstSharedPtr new_cluster = primary_clusters_.at(cluster_name).cluster_->info();
-  ENVOY_LOG(info, "add/update cluster {}", cluster_name);
-  tls_->runOnAllThreads([this, new_cluster]() -> void {
-    ThreadLocalClusterManagerImpl& cluster_manager =
-        tls_->getTyped<ThreadLocalClusterManagerImpl>();
-
-    if (cluster_manager.thread_local_clusters_.count(new_cluster->name()) > 0) {
-      ENVOY_LOG(debug, "updating TLS cluster {}", new_cluster->name());
-    } else {
-      ENVOY_LOG(debug, "adding TLS cluster {}", new_cluster->name());
-    }
-
-    cluster_manager.thread_local_clusters_[new_cluster->name()].reset(
-        new ThreadLocalClusterManagerImpl::ClusterEntry(cluster_manager, new_cluster));
+  const PrimaryClusterData& data = primary_clusters_.at(cluster_name);
+  ClusterInfoConstSharedPtr new_cluster = data.cluster_->info();
+  const bool lazy = data.lazy_;
+  ENVOY_LOG(info, "add/update cluster {}{}", cluster_name, lazy ? " (lazy)" : "");
+  tls_->runOnAllThreads([this, new_cluster, lazy]() -> void {
+    tls_->getTyped<ThreadLocalClusterManagerImpl>().addCluster(new_cluster, lazy);
   });
 
   postInitializeCluster(*primary_clusters_.at(cluster_name).cluster_);
@@ -314,17 +313,15 @@ bool ClusterManagerImpl::removePrimaryCluster(const std::string& cluster_name) {
   }
 
   init_helper_.removeCluster(*existing_cluster->second.cluster_);
+  if (existing_cluster->second.lazy_) {
+    cm_stats_.lazy_clusters_.dec();
+  }
   primary_clusters_.erase(existing_cluster);
   cm_stats_.cluster_removed_.inc();
   cm_stats_.total_clusters_.set(primary_clusters_.size());
   ENVOY_LOG(info, "removing cluster {}", cluster_name);
   tls_->runOnAllThreads([this, cluster_name]() -> void {
-    ThreadLocalClusterManagerImpl& cluster_manager =
-        tls_->getTyped<ThreadLocalClusterManagerImpl>();
-
-    ASSERT(cluster_manager.thread_local_clusters_.count(cluster_name) == 1);
-    ENVOY_LOG(debug, "removing TLS cluster {}", cluster_name);
-    cluster_manager.thread_local_clusters_.erase(cluster_name);
+    tls_->getTyped<ThreadLocalClusterManagerImpl>().removeCluster(cluster_name);
   });
 
   return true;
@@ -348,7 +345,7 @@ void ClusterManagerImpl::loadCluster(const envoy::api::v2::Cluster& cluster, boo
                                          const std::vector<HostSharedPtr>& hosts_removed) {
         // This fires when a cluster is about to have an updated member set. We need to send this
         // out to all of the thread local configurations.
-        postThreadLocalClusterUpdate(primary_cluster_reference, hosts_added, hosts_removed);
+        onClusterMemberUpdate(primary_cluster_reference, hosts_added, hosts_removed);
       });
 
   if (new_cluster->healthChecker() != nullptr) {
@@ -368,11 +365,27 @@ void ClusterManagerImpl::loadCluster(const envoy::api::v2::Cluster& cluster, boo
     });
   }
 
+  // Only CDS clusters can be lazy. Static clusters are few, and the local cluster must always be
+  // present on every worker.
+  const bool lazy =
+      added_via_api && runtime_.snapshot().featureEnabled("upstream.lazy_cds_clusters", 0);
+  if (lazy) {
+    cm_stats_.lazy_clusters_.inc();
+  }
+
   // emplace() will do nothing if the key already exists. Always erase first.
-  size_t num_erased = primary_clusters_.erase(primary_cluster_reference.info()->name());
+  auto existing_cluster = primary_clusters_.find(primary_cluster_reference.info()->name());
+  size_t num_erased = 0;
+  if (existing_cluster != primary_clusters_.end()) {
+    if (existing_cluster->second.lazy_) {
+      cm_stats_.lazy_clusters_.dec();
+    }
+    primary_clusters_.erase(existing_cluster);
+    num_erased = 1;
+  }
   primary_clusters_.emplace(
       primary_cluster_reference.info()->name(),
-      PrimaryClusterData{MessageUtil::hash(cluster), added_via_api, std::move(new_cluster)});
+      PrimaryClusterData{MessageUtil::hash(cluster), added_via_api, lazy, std::move(new_cluster)});
 
   cm_stats_.total_clusters_.set(primary_clusters_.size());
   if (num_erased) {
@@ -383,28 +396,76 @@ void ClusterManagerImpl::loadCluster(const envoy::api::v2::Cluster& cluster, boo
 }
 
 ThreadLocalCluster* ClusterManagerImpl::get(const std::string& cluster) {
-  ThreadLocalClusterManagerImpl& cluster_manager = tls_->getTyped<ThreadLocalClusterManagerImpl>();
-
-  auto entry = cluster_manager.thread_local_clusters_.find(cluster);
-  if (entry != cluster_manager.thread_local_clusters_.end()) {
-    return entry->second.get();
-  } else {
-    return nullptr;
-  }
+  return tls_->getTyped<ThreadLocalClusterManagerImpl>().getCluster(cluster);
 }
 
 Http::ConnectionPool::Instance*
 ClusterManagerImpl::httpConnPoolForCluster(const std::string& cluster, ResourcePriority priority,
                                            LoadBalancerContext* context) {
-  ThreadLocalClusterManagerImpl& cluster_manager = tls_->getTyped<ThreadLocalClusterManagerImpl>();
-
-  auto entry = cluster_manager.thread_local_clusters_.find(cluster);
-  if (entry == cluster_manager.thread_local_clusters_.end()) {
+  ThreadLocalClusterManagerImpl::ClusterEntry* entry =
+      tls_->getTyped<ThreadLocalClusterManagerImpl>().getCluster(cluster);
+  if (entry == nullptr) {
     return nullptr;
   }
 
   // Select a host and create a connection pool for it if it does not already exist.
-  return entry->second->connPool(priority, context);
+  return entry->connPool(priority, context);
+}
+
+void ClusterManagerImpl::onClusterMemberUpdate(const Cluster& primary_cluster,
+                                               const std::vector<HostSharedPtr>& hosts_added,
+                                               const std::vector<HostSharedPtr>& hosts_removed) {
+  if (init_helper_.state() == ClusterManagerInitHelper::State::Loading) {
+    // A cluster may try to post updates before we are ready for multi-threading. Block this case
+    // since we will post the update in postInitializeCluster().
+    return;
+  }
+
+  auto entry = primary_clusters_.find(primary_cluster.info()->name());
+  if (entry == primary_clusters_.end() || entry->second.cluster_.get() != &primary_cluster) {
+    // Update from a cluster that is still being loaded. Nothing can be pending for it.
+    postThreadLocalClusterUpdate(primary_cluster, hosts_added, hosts_removed);
+    return;
+  }
+
+  PrimaryClusterData& data = entry->second;
+  const uint64_t merge_window_ms = runtime_.snapshot().getInteger(
+      "upstream.update_merge_window_ms", DEFAULT_UPDATE_MERGE_WINDOW_MS);
+  if (!hosts_added.empty() || !hosts_removed.empty() || merge_window_ms == 0) {
+    // Membership changes go out right away since workers must drain connection pools for removed
+    // hosts. The update carries the current health state so anything pending is superseded.
+    if (data.update_pending_) {
+      data.update_pending_ = false;
+      data.update_merge_timer_->disableTimer();
+      cm_stats_.update_merge_cancelled_.inc();
+    }
+    postThreadLocalClusterUpdate(primary_cluster, hosts_added, hosts_removed);
+    return;
+  }
+
+  // Otherwise this is a health (or weight) only change. During a mass flap, e.g. a deploy
+  // restarting hundreds of hosts, these arrive one host at a time. Each one would rebuild every
+  // worker's load balancer, so they are merged into a single update per window instead.
+  if (data.update_pending_) {
+    cm_stats_.update_merged_.inc();
+    return;
+  }
+
+  if (!data.update_merge_timer_) {
+    data.update_merge_timer_ = primary_dispatcher_.createTimer(
+        [this, name = primary_cluster.info()->name()]() -> void { onUpdateMergeTimer(name); });
+  }
+  data.update_pending_ = true;
+  data.update_merge_timer_->enableTimer(std::chrono::milliseconds(merge_window_ms));
+}
+
+void ClusterManagerImpl::onUpdateMergeTimer(const std::string& cluster_name) {
+  // The timer is owned by the cluster's entry, so the entry still exists.
+  PrimaryClusterData& data = primary_clusters_.at(cluster_name);
+  ASSERT(data.update_pending_);
+  data.update_pending_ = false;
+  cm_stats_.cluster_updated_via_merge_.inc();
+  postThreadLocalClusterUpdate(*data.cluster_, {}, {});
 }
 
 void ClusterManagerImpl::postThreadLocalClusterUpdate(
@@ -416,13 +477,15 @@ void ClusterManagerImpl::postThreadLocalClusterUpdate(
     return;
   }
 
-  HostVectorConstSharedPtr hosts_copy(new std::vector<HostSharedPtr>(primary_cluster.hosts()));
-  HostVectorConstSharedPtr healthy_hosts_copy(
-      new std::vector<HostSharedPtr>(primary_cluster.healthyHosts()));
-  HostListsConstSharedPtr hosts_per_locality_copy(
-      new std::vector<std::vector<HostSharedPtr>>(primary_cluster.hostsPerLocality()));
-  HostListsConstSharedPtr healthy_hosts_per_locality_copy(
-      new std::vector<std::vector<HostSharedPtr>>(primary_cluster.healthyHostsPerLocality()));
+  cm_stats_.cluster_updated_.inc();
+
+  // Host vectors are immutable once published by the primary host set, so workers can share them
+  // rather than getting a copy of every vector on every update.
+  HostVectorConstSharedPtr hosts_copy = primary_cluster.hostsPtr();
+  HostVectorConstSharedPtr healthy_hosts_copy = primary_cluster.healthyHostsPtr();
+  HostListsConstSharedPtr hosts_per_locality_copy = primary_cluster.hostsPerLocalityPtr();
+  HostListsConstSharedPtr healthy_hosts_per_locality_copy =
+      primary_cluster.healthyHostsPerLocalityPtr();
 
   tls_->runOnAllThreads([
     this, name = primary_cluster.info()->name(), hosts_copy, healthy_hosts_copy,
@@ -445,25 +508,25 @@ Host::CreateConnectionData ClusterManagerImpl::tcpConnForCluster(const std::stri
                                                                  LoadBalancerContext* context) {
   ThreadLocalClusterManagerImpl& cluster_manager = tls_->getTyped<ThreadLocalClusterManagerImpl>();
 
-  auto entry = cluster_manager.thread_local_clusters_.find(cluster);
-  if (entry == cluster_manager.thread_local_clusters_.end()) {
+  ThreadLocalClusterManagerImpl::ClusterEntry* entry = cluster_manager.getCluster(cluster);
+  if (entry == nullptr) {
     throw EnvoyException(fmt::format("unknown cluster '{}'", cluster));
   }
 
-  HostConstSharedPtr logical_host = entry->second->lb_->chooseHost(context);
+  HostConstSharedPtr logical_host = entry->lb_->chooseHost(context);
   if (logical_host) {
     return logical_host->createConnection(cluster_manager.thread_local_dispatcher_);
   } else {
-    entry->second->cluster_info_->stats().upstream_cx_none_healthy_.inc();
+    entry->cluster_info_->stats().upstream_cx_none_healthy_.inc();
     return {nullptr, nullptr};
   }
 }
 
 Http::AsyncClient& ClusterManagerImpl::httpAsyncClientForCluster(const std::string& cluster) {
-  ThreadLocalClusterManagerImpl& cluster_manager = tls_->getTyped<ThreadLocalClusterManagerImpl>();
-  auto entry = cluster_manager.thread_local_clusters_.find(cluster);
-  if (entry != cluster_manager.thread_local_clusters_.end()) {
-    return entry->second->http_async_client_;
+  ThreadLocalClusterManagerImpl::ClusterEntry* entry =
+      tls_->getTyped<ThreadLocalClusterManagerImpl>().getCluster(cluster);
+  if (entry != nullptr) {
+    return entry->http_async_client_;
   } else {
     throw EnvoyException(fmt::format("unknown cluster '{}'", cluster));
   }
@@ -472,7 +535,7 @@ Http::AsyncClient& ClusterManagerImpl::httpAsyncClientForCluster(const std::stri
 ClusterManagerImpl::ThreadLocalClusterManagerImpl::ThreadLocalClusterManagerImpl(
     ClusterManagerImpl& parent, Event::Dispatcher& dispatcher,
     const Optional<std::string>& local_cluster_name)
-    : parent_(parent), thread_local_dispatcher_(dispatcher) {
+    : parent_(parent), thread_local_dispatcher_(dispatcher), cm_stats_(parent.cm_stats_) {
   // If local cluster is defined then we need to initialize it first.
   if (local_cluster_name.valid()) {
     ENVOY_LOG(debug, "adding TLS local cluster {}", local_cluster_name.value());
@@ -491,10 +554,8 @@ ClusterManagerImpl::ThreadLocalClusterManagerImpl::ThreadLocalClusterManagerImpl
       continue;
     }
 
-    ENVOY_LOG(debug, "adding TLS initial cluster {}", cluster.first);
     ASSERT(thread_local_clusters_.count(cluster.first) == 0);
-    thread_local_clusters_[cluster.first].reset(
-        new ClusterEntry(*this, cluster.second.cluster_->info()));
+    addCluster(cluster.second.cluster_->info(), cluster.second.lazy_);
   }
 }
 
@@ -515,6 +576,121 @@ ClusterManagerImpl::ThreadLocalClusterManagerImpl::~ThreadLocalClusterManagerImp
   thread_local_clusters_.clear();
 }
 
+ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry*
+ClusterManagerImpl::ThreadLocalClusterManagerImpl::getCluster(const std::string& name) {
+  auto lazy_cluster = lazy_clusters_.find(name);
+  if (lazy_cluster != lazy_clusters_.end()) {
+    lazy_cluster->second.used_since_sweep_ = true;
+  }
+
+  auto entry = thread_local_clusters_.find(name);
+  if (entry != thread_local_clusters_.end()) {
+    return entry->second.get();
+  }
+
+  if (lazy_cluster == lazy_clusters_.end()) {
+    return nullptr;
+  }
+
+  return materializeLazyCluster(name, lazy_cluster->second);
+}
+
+void ClusterManagerImpl::ThreadLocalClusterManagerImpl::addCluster(ClusterInfoConstSharedPtr info,
+                                                                   bool lazy) {
+  const std::string& name = info->name();
+  if (thread_local_clusters_.count(name) > 0 || lazy_clusters_.count(name) > 0) {
+    ENVOY_LOG(debug, "updating TLS cluster {}", name);
+  } else {
+    ENVOY_LOG(debug, "adding TLS cluster {}", name);
+  }
+
+  if (lazy) {
+    // Any materialized state belongs to the old cluster. Host updates for the new cluster will
+    // follow from the main thread.
+    thread_local_clusters_.erase(name);
+    LazyCluster& lazy_cluster = lazy_clusters_[name];
+    lazy_cluster = LazyCluster();
+    lazy_cluster.info_ = info;
+  } else {
+    lazy_clusters_.erase(name);
+    thread_local_clusters_[name].reset(new ClusterEntry(*this, info));
+  }
+}
+
+void ClusterManagerImpl::ThreadLocalClusterManagerImpl::removeCluster(const std::string& name) {
+  ASSERT(thread_local_clusters_.count(name) == 1 || lazy_clusters_.count(name) == 1);
+  ENVOY_LOG(debug, "removing TLS cluster {}", name);
+  thread_local_clusters_.erase(name);
+  lazy_clusters_.erase(name);
+}
+
+ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry*
+ClusterManagerImpl::ThreadLocalClusterManagerImpl::materializeLazyCluster(
+    const std::string& name, LazyCluster& lazy_cluster) {
+  ENVOY_LOG(debug, "materializing lazy TLS cluster {}", name);
+  const MonotonicTime start = ProdMonotonicTimeSource::instance_.currentTime();
+
+  ClusterEntry* entry = new ClusterEntry(*this, lazy_cluster.info_);
+  thread_local_clusters_[name].reset(entry);
+  if (lazy_cluster.hosts_) {
+    // Every host is new to this worker.
+    entry->host_set_.updateHosts(
+        lazy_cluster.hosts_, lazy_cluster.healthy_hosts_, lazy_cluster.hosts_per_locality_,
+        lazy_cluster.healthy_hosts_per_locality_, *lazy_cluster.hosts_, {});
+  }
+
+  cm_stats_.lazy_cluster_materialized_.inc();
+  cm_stats_.lazy_cluster_materialize_us_.recordValue(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          ProdMonotonicTimeSource::instance_.currentTime() - start)
+          .count());
+
+  if (!lazy_cluster_sweep_timer_) {
+    lazy_cluster_sweep_timer_ =
+        thread_local_dispatcher_.createTimer([this]() -> void { onLazyClusterSweep(); });
+  }
+  if (!lazy_cluster_sweep_armed_) {
+    lazy_cluster_sweep_armed_ = true;
+    lazy_cluster_sweep_timer_->enableTimer(std::chrono::milliseconds(
+        parent_.runtime_.snapshot().getInteger("upstream.lazy_cluster_idle_timeout_ms",
+                                               DEFAULT_LAZY_CLUSTER_IDLE_TIMEOUT_MS)));
+  }
+
+  return entry;
+}
+
+void ClusterManagerImpl::ThreadLocalClusterManagerImpl::onLazyClusterSweep() {
+  // A materialized lazy cluster is collected if it was not used for a whole sweep period, so idle
+  // clusters live between one and two idle timeouts. Draining its connection pools is graceful,
+  // but the async client must not have anything in flight.
+  lazy_cluster_sweep_armed_ = false;
+  bool any_materialized = false;
+  for (auto& lazy_cluster : lazy_clusters_) {
+    auto entry = thread_local_clusters_.find(lazy_cluster.first);
+    if (entry == thread_local_clusters_.end()) {
+      continue;
+    }
+
+    if (lazy_cluster.second.used_since_sweep_ ||
+        entry->second->http_async_client_.hasActiveStreams()) {
+      lazy_cluster.second.used_since_sweep_ = false;
+      any_materialized = true;
+      continue;
+    }
+
+    ENVOY_LOG(debug, "collecting idle lazy TLS cluster {}", lazy_cluster.first);
+    thread_local_clusters_.erase(entry);
+    cm_stats_.lazy_cluster_collected_.inc();
+  }
+
+  if (any_materialized) {
+    lazy_cluster_sweep_armed_ = true;
+    lazy_cluster_sweep_timer_->enableTimer(std::chrono::milliseconds(
+        parent_.runtime_.snapshot().getInteger("upstream.lazy_cluster_idle_timeout_ms",
+                                               DEFAULT_LAZY_CLUSTER_IDLE_TIMEOUT_MS)));
+  }
+}
+
 void ClusterManagerImpl::ThreadLocalClusterManagerImpl::drainConnPools(
     const std::vector<HostSharedPtr>& hosts) {
   for (const HostSharedPtr& host : hosts) {
@@ -567,10 +743,25 @@ void ClusterManagerImpl::ThreadLocalClusterManagerImpl::updateClusterMembership(
 
   ThreadLocalClusterManagerImpl& config = tls.getTyped<ThreadLocalClusterManagerImpl>();
 
-  ASSERT(config.thread_local_clusters_.find(name) != config.thread_local_clusters_.end());
-  config.thread_local_clusters_[name]->host_set_.updateHosts(
-      std::move(hosts), std::move(healthy_hosts), std::move(hosts_per_locality),
-      std::move(healthy_hosts_per_locality), hosts_added, hosts_removed);
+  auto lazy_cluster = config.lazy_clusters_.find(name);
+  if (lazy_cluster != config.lazy_clusters_.end()) {
+    // Keep the latest hosts for when (or if) the cluster is materialized on this worker.
+    lazy_cluster->second.hosts_ = hosts;
+    lazy_cluster->second.healthy_hosts_ = healthy_hosts;
+    lazy_cluster->second.hosts_per_locality_ = hosts_per_locality;
+    lazy_cluster->second.healthy_hosts_per_locality_ = healthy_hosts_per_locality;
+  }
+
+  auto entry = config.thread_local_clusters_.find(name);
+  if (entry == config.thread_local_clusters_.end()) {
+    ASSERT(lazy_cluster != config.lazy_clusters_.end());
+    return;
+  }
+
+  entry->second->host_set_.updateHosts(std::move(hosts), std::move(healthy_hosts),
+                                       std::move(hosts_per_locality),
+                                       std::move(healthy_hosts_per_locality), hosts_added,
+                                       hosts_removed);
 }
 
 void ClusterManagerImpl::ThreadLocalClusterManagerImpl::onHostHealthFailure(
@@ -602,6 +793,7 @@ ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::ClusterEntry(
                          parent.parent_.local_info_, parent.parent_, parent.parent_.runtime_,
                          parent.parent_.random_,
                          Router::ShadowWriterPtr{new Router::ShadowWriterImpl(parent.parent_)}) {
+  parent.cm_stats_.worker_clusters_active_.inc();
   if (cluster->lbSubsetInfo().isEnabled()) {
     lb_.reset(new SubsetLoadBalancer(cluster->lbType(), host_set_, parent.local_host_set_,
                                      cluster->stats(), parent.parent_.runtime_,
@@ -613,6 +805,11 @@ ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::ClusterEntry(
                                              parent.parent_.runtime_, parent.parent_.random_));
       break;
     }
+    case LoadBalancerType::PeakEwma: {
+      lb_.reset(new PeakEwmaLoadBalancer(host_set_, parent.local_host_set_, cluster->stats(),
+                                         parent.parent_.runtime_, parent.parent_.random_));
+      break;
+    }
     case LoadBalancerType::Random: {
       lb_.reset(new RandomLoadBalancer(host_set_, parent.local_host_set_, cluster->stats(),
                                        parent.parent_.runtime_, parent.parent_.random_));
@@ -636,12 +833,13 @@ ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::ClusterEntry(
     }
   }
 
-  host_set_.addMemberUpdateCb([this](const std::vector<HostSharedPtr>&,
+  host_set_.addMemberUpdateCb([this](const std::vector<HostSharedPtr>& hosts_added,
                                      const std::vector<HostSharedPtr>& hosts_removed) -> void {
     // We need to go through and purge any connection pools for hosts that got deleted.
     // Even if two hosts actually point to the same address this will be safe, since if a
     // host is readded it will be a different physical HostSharedPtr.
     parent_.drainConnPools(hosts_removed);
+    warmConnPools(hosts_added);
   });
 }
 
@@ -653,6 +851,7 @@ ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::~ClusterEntry()
   // the hosts inside of the HostImpl destructor. That is a change with wide implications, so we are
   // going with a more targeted approach for now.
   parent_.drainConnPools(host_set_.hosts());
+  parent_.cm_stats_.worker_clusters_active_.dec();
 }
 
 Http::ConnectionPool::Instance*
@@ -665,6 +864,12 @@ ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::connPool(
     return nullptr;
   }
 
+  return &connPoolForHost(host, priority);
+}
+
+Http::ConnectionPool::Instance&
+ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::connPoolForHost(
+    HostConstSharedPtr host, ResourcePriority priority) {
   ConnPoolsContainer& container = parent_.host_http_conn_pool_map_[host];
   ASSERT(enumToInt(priority) < container.pools_.size());
   if (!container.pools_[enumToInt(priority)]) {
@@ -672,7 +877,22 @@ ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::connPool(
         parent_.parent_.factory_.allocateConnPool(parent_.thread_local_dispatcher_, host, priority);
   }
 
-  return container.pools_[enumToInt(priority)].get();
+  return *container.pools_[enumToInt(priority)];
+}
+
+void ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::warmConnPools(
+    const std::vector<HostSharedPtr>& hosts) {
+  // Open default priority connections to new hosts before the load balancer starts sending them
+  // traffic (e.g. while they wait for their first health check to pass). How many connections a
+  // pool opens is up to its prefetch settings.
+  if (hosts.empty() ||
+      !parent_.parent_.runtime_.snapshot().featureEnabled("upstream.prefetch.warm_new_hosts", 0)) {
+    return;
+  }
+
+  for (const HostSharedPtr& host : hosts) {
+    connPoolForHost(host, ResourcePriority::Default).prefetch();
+  }
 }
 
 ClusterManagerPtr ProdClusterManagerFactory::clusterManagerFromProto(
@@ -688,6 +908,17 @@ ProdClusterManagerFactory::allocateConnPool(Event::Dispatcher& dispatcher, HostC
                                             ResourcePriority priority) {
   if ((host->cluster().features() & ClusterInfo::Features::HTTP2) &&
       runtime_.snapshot().featureEnabled("upstream.use_http2", 100)) {
+    // Low traffic clusters can opt into sharing one pool, and hence one set of connections per
+    // host, across all workers.
+    if (runtime_.snapshot().getInteger(
+            fmt::format("upstream.shared_http2_pool.{}", host->cluster().name()), 0) > 0) {
+      return shared_http2_pools_.allocate(
+          dispatcher, host, priority,
+          [&dispatcher, host, priority]() -> Http::ConnectionPool::InstancePtr {
+            return Http::ConnectionPool::InstancePtr{
+                new Http::Http2::ProdConnPoolImpl(dispatcher, host, priority)};
+          });
+    }
     return Http::ConnectionPool::InstancePtr{
         new Http::Http2::ProdConnPoolImpl(dispatcher, host, priority)};
   } else {
@@ -701,7 +932,7 @@ ClusterSharedPtr ProdClusterManagerFactory::clusterFromProto(
     Outlier::EventLoggerSharedPtr outlier_event_logger, bool added_via_api) {
   return ClusterImplBase::create(cluster, cm, stats_, tls_, dns_resolver_, ssl_context_manager_,
                                  runtime_, random_, primary_dispatcher_, local_info_,
-                                 outlier_event_logger, added_via_api);
+                                 outlier_event_logger, added_via_api, health_check_shard_pool_);
 }
 
 CdsApiPtr
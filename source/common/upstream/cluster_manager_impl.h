@@ -9,6 +9,8 @@
 #include <unordered_map>
 #include <vector>
 
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
 #include "envoy/http/codes.h"
 #include "envoy/local_info/local_info.h"
 #include "envoy/runtime/runtime.h"
@@ -18,6 +20,8 @@
 
 #include "common/config/grpc_mux_impl.h"
 #include "common/http/async_client_impl.h"
+#include "common/http/http2/shared_conn_pool.h"
+#include "common/network/dns_cache_impl.h"
 #include "common/upstream/load_stats_reporter.h"
 #include "common/upstream/upstream_impl.h"
 
@@ -36,10 +40,18 @@ public:
                             Network::DnsResolverSharedPtr dns_resolver,
                             Ssl::ContextManager& ssl_context_manager,
                             Event::Dispatcher& primary_dispatcher,
-                            const LocalInfo::LocalInfo& local_info)
+                            const LocalInfo::LocalInfo& local_info,
+                            HealthCheckShardPool* health_check_shard_pool,
+                            Config::ConfigWorker* config_worker)
       : primary_dispatcher_(primary_dispatcher), runtime_(runtime), stats_(stats), tls_(tls),
-        random_(random), dns_resolver_(dns_resolver), ssl_context_manager_(ssl_context_manager),
-        local_info_(local_info) {}
+        random_(random),
+        // All clusters that use the default resolver share one cache. Clusters that specify their
+        // own resolvers bypass it.
+        dns_resolver_(new Network::CachingDnsResolverImpl(dns_resolver, runtime, stats,
+                                                          ProdMonotonicTimeSource::instance_)),
+        ssl_context_manager_(ssl_context_manager),
+        local_info_(local_info), health_check_shard_pool_(health_check_shard_pool),
+        config_worker_(config_worker) {}
 
   // Upstream::ClusterManagerFactory
   ClusterManagerPtr clusterManagerFromProto(const envoy::api::v2::Bootstrap& bootstrap,
@@ -57,6 +69,7 @@ public:
   CdsApiPtr createCds(const envoy::api::v2::ConfigSource& cds_config,
                       const Optional<envoy::api::v2::ConfigSource>& eds_config,
                       ClusterManager& cm) override;
+  Config::ConfigWorker* configWorker() override { return config_worker_; }
 
 protected:
   Event::Dispatcher& primary_dispatcher_;
@@ -69,6 +82,9 @@ private:
   Network::DnsResolverSharedPtr dns_resolver_;
   Ssl::ContextManager& ssl_context_manager_;
   const LocalInfo::LocalInfo& local_info_;
+  HealthCheckShardPool* health_check_shard_pool_;
+  Config::ConfigWorker* config_worker_;
+  Http::Http2::SharedConnPoolRegistry shared_http2_pools_;
 };
 
 /**
@@ -116,18 +132,28 @@ private:
  * All cluster manager stats. @see stats_macros.h
  */
 // clang-format off
-#define ALL_CLUSTER_MANAGER_STATS(COUNTER, GAUGE)                                                  \
-  COUNTER(cluster_added)                                                                           \
-  COUNTER(cluster_modified)                                                                        \
-  COUNTER(cluster_removed)                                                                         \
-  GAUGE  (total_clusters)
+#define ALL_CLUSTER_MANAGER_STATS(COUNTER, GAUGE, HISTOGRAM)                                       \
+  COUNTER  (cluster_added)                                                                         \
+  COUNTER  (cluster_modified)                                                                      \
+  COUNTER  (cluster_removed)                                                                       \
+  COUNTER  (cluster_updated)                                                                       \
+  COUNTER  (cluster_updated_via_merge)                                                             \
+  COUNTER  (update_merge_cancelled)                                                                \
+  COUNTER  (update_merged)                                                                         \
+  COUNTER  (lazy_cluster_materialized)                                                             \
+  COUNTER  (lazy_cluster_collected)                                                                \
+  GAUGE    (total_clusters)                                                                        \
+  GAUGE    (lazy_clusters)                                                                         \
+  GAUGE    (worker_clusters_active)                                                                \
+  HISTOGRAM(lazy_cluster_materialize_us)
 // clang-format on
 
 /**
  * Struct definition for all cluster manager stats. @see stats_macros.h
  */
 struct ClusterManagerStats {
-  ALL_CLUSTER_MANAGER_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT)
+  ALL_CLUSTER_MANAGER_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT,
+                            GENERATE_HISTOGRAM_STRUCT)
 };
 
 /**
@@ -142,6 +168,17 @@ public:
                      AccessLog::AccessLogManager& log_manager,
                      Event::Dispatcher& primary_dispatcher);
 
+  // Host set updates that carry no membership change (health, weight, etc.) are merged per cluster
+  // for this long before being posted to the workers. Overridden by the
+  // "upstream.update_merge_window_ms" runtime key; 0 posts every update right away.
+  static const uint64_t DEFAULT_UPDATE_MERGE_WINDOW_MS = 50;
+
+  // CDS clusters selected by the "upstream.lazy_cds_clusters" runtime key only get per worker state
+  // (load balancer, connection pools, async client) the first time a worker uses them. That state
+  // is collected again once it has been idle for this long. Overridden by the
+  // "upstream.lazy_cluster_idle_timeout_ms" runtime key.
+  static const uint64_t DEFAULT_LAZY_CLUSTER_IDLE_TIMEOUT_MS = 300000;
+
   // Upstream::ClusterManager
   bool addOrUpdatePrimaryCluster(const envoy::api::v2::Cluster& cluster) override;
   void setInitializedCb(std::function<void()> callback) override {
@@ -194,6 +231,9 @@ private:
 
       Http::ConnectionPool::Instance* connPool(ResourcePriority priority,
                                                LoadBalancerContext* context);
+      Http::ConnectionPool::Instance& connPoolForHost(HostConstSharedPtr host,
+                                                      ResourcePriority priority);
+      void warmConnPools(const std::vector<HostSharedPtr>& hosts);
 
       // Upstream::ThreadLocalCluster
       const HostSet& hostSet() override { return host_set_; }
@@ -209,9 +249,33 @@ private:
 
     typedef std::unique_ptr<ClusterEntry> ClusterEntryPtr;
 
+    /**
+     * A lazy cluster known to this worker. The latest host set is kept (the vectors are shared with
+     * the primary cluster) so that the cluster can be materialized without going to the main
+     * thread.
+     */
+    struct LazyCluster {
+      ClusterInfoConstSharedPtr info_;
+      HostVectorConstSharedPtr hosts_;
+      HostVectorConstSharedPtr healthy_hosts_;
+      HostListsConstSharedPtr hosts_per_locality_;
+      HostListsConstSharedPtr healthy_hosts_per_locality_;
+      bool used_since_sweep_{};
+    };
+
     ThreadLocalClusterManagerImpl(ClusterManagerImpl& parent, Event::Dispatcher& dispatcher,
                                   const Optional<std::string>& local_cluster_name);
     ~ThreadLocalClusterManagerImpl();
+
+    /**
+     * @return the cluster entry for a cluster, materializing it first if it is lazy. nullptr if
+     *         the cluster does not exist.
+     */
+    ClusterEntry* getCluster(const std::string& name);
+    void addCluster(ClusterInfoConstSharedPtr info, bool lazy);
+    void removeCluster(const std::string& name);
+    ClusterEntry* materializeLazyCluster(const std::string& name, LazyCluster& lazy_cluster);
+    void onLazyClusterSweep();
     void drainConnPools(const std::vector<HostSharedPtr>& hosts);
     void drainConnPools(HostSharedPtr old_host, ConnPoolsContainer& container);
     static void updateClusterMembership(const std::string& name, HostVectorConstSharedPtr hosts,
@@ -225,29 +289,45 @@ private:
 
     ClusterManagerImpl& parent_;
     Event::Dispatcher& thread_local_dispatcher_;
+    // A copy so that cluster entries destroyed during thread shutdown do not reach into parent_.
+    ClusterManagerStats cm_stats_;
     std::unordered_map<std::string, ClusterEntryPtr> thread_local_clusters_;
+    std::unordered_map<std::string, LazyCluster> lazy_clusters_;
+    Event::TimerPtr lazy_cluster_sweep_timer_;
+    bool lazy_cluster_sweep_armed_{};
     std::unordered_map<HostConstSharedPtr, ConnPoolsContainer> host_http_conn_pool_map_;
     const HostSet* local_host_set_{};
   };
 
   struct PrimaryClusterData {
-    PrimaryClusterData(uint64_t config_hash, bool added_via_api, ClusterSharedPtr&& cluster)
-        : config_hash_(config_hash), added_via_api_(added_via_api), cluster_(std::move(cluster)) {}
+    PrimaryClusterData(uint64_t config_hash, bool added_via_api, bool lazy,
+                       ClusterSharedPtr&& cluster)
+        : config_hash_(config_hash), added_via_api_(added_via_api), lazy_(lazy),
+          cluster_(std::move(cluster)) {}
 
     const uint64_t config_hash_;
     const bool added_via_api_;
+    const bool lazy_;
     ClusterSharedPtr cluster_;
+    // Fires at the end of the merge window when a host set update is pending.
+    Event::TimerPtr update_merge_timer_;
+    bool update_pending_{};
   };
 
   static ClusterManagerStats generateStats(Stats::Scope& scope);
   void loadCluster(const envoy::api::v2::Cluster& cluster, bool added_via_api);
   void postInitializeCluster(Cluster& cluster);
+  void onClusterMemberUpdate(const Cluster& primary_cluster,
+                             const std::vector<HostSharedPtr>& hosts_added,
+                             const std::vector<HostSharedPtr>& hosts_removed);
+  void onUpdateMergeTimer(const std::string& cluster_name);
   void postThreadLocalClusterUpdate(const Cluster& primary_cluster,
                                     const std::vector<HostSharedPtr>& hosts_added,
                                     const std::vector<HostSharedPtr>& hosts_removed);
   void postThreadLocalHealthFailure(const HostSharedPtr& host);
 
   ClusterManagerFactory& factory_;
+  Event::Dispatcher& primary_dispatcher_;
   Runtime::Loader& runtime_;
   Stats::Store& stats_;
   ThreadLocal::SlotPtr tls_;
@@ -1,5 +1,10 @@
 #include "common/upstream/eds.h"
 
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
 #include "envoy/common/exception.h"
 
 #include "common/config/metadata.h"
@@ -9,6 +14,7 @@
 #include "common/network/address_impl.h"
 #include "common/network/resolver_impl.h"
 #include "common/network/utility.h"
+#include "common/protobuf/utility.h"
 #include "common/upstream/sds_subscription.h"
 
 #include "fmt/format.h"
@@ -58,12 +64,51 @@ void EdsClusterImpl::onConfigUpdate(const ResourceVector& resources) {
     throw EnvoyException(fmt::format("Unexpected EDS cluster (expecting {}): {}", cluster_name_,
                                      cluster_load_assignment.cluster_name()));
   }
+
+  // Management servers commonly push the full assignment on every change to any cluster. If
+  // nothing changed, and there are no hosts waiting on health checks to be removed, there is no
+  // need to rebuild or diff the host list at all.
+  const std::size_t assignment_hash = MessageUtil::hash(cluster_load_assignment);
+  if (last_assignment_hash_.valid() && last_assignment_hash_.value() == assignment_hash &&
+      hosts().size() == last_endpoint_count_) {
+    info_->stats().update_no_rebuild_.inc();
+    onPreInitComplete();
+    return;
+  }
+
+  // Hosts are only created for endpoints that are new or whose load balancing attributes changed.
+  // Everything else reuses the existing host so that a small change in a large cluster does not
+  // reallocate every host (and its stats).
+  std::unordered_map<std::string, HostSharedPtr> existing_hosts;
+  existing_hosts.reserve(hosts().size());
+  for (const HostSharedPtr& host : hosts()) {
+    existing_hosts.emplace(host->address()->asString(), host);
+  }
+  // Duplicate endpoints share a host, so they are only counted once.
+  std::unordered_set<std::string> endpoint_addresses;
   for (const auto& locality_lb_endpoint : cluster_load_assignment.endpoints()) {
+    const uint32_t priority = locality_lb_endpoint.priority();
+    const uint32_t locality_weight = locality_lb_endpoint.load_balancing_weight().value();
     for (const auto& lb_endpoint : locality_lb_endpoint.lb_endpoints()) {
-      new_hosts.emplace_back(new HostImpl(
-          info_, "", Network::Address::resolveProtoAddress(lb_endpoint.endpoint().address()),
-          lb_endpoint.metadata(), lb_endpoint.load_balancing_weight().value(),
-          locality_lb_endpoint.locality()));
+      Network::Address::InstanceConstSharedPtr address =
+          Network::Address::resolveProtoAddress(lb_endpoint.endpoint().address());
+      const std::string& address_string = *endpoint_addresses.emplace(address->asString()).first;
+      const uint32_t weight = lb_endpoint.load_balancing_weight().value();
+      auto existing = existing_hosts.find(address_string);
+      // Host weights are clamped the same way as in HostImpl::weight().
+      if (existing != existing_hosts.end() &&
+          existing->second->weight() == std::max(1U, std::min(100U, weight)) &&
+          existing->second->priority() == priority &&
+          existing->second->localityWeight() == locality_weight) {
+        new_hosts.emplace_back(existing->second);
+        continue;
+      }
+
+      HostSharedPtr host(new HostImpl(info_, "", address, lb_endpoint.metadata(), weight,
+                                      locality_lb_endpoint.locality()));
+      host->priority(priority);
+      host->localityWeight(locality_weight);
+      new_hosts.emplace_back(host);
     }
   }
 
@@ -102,6 +147,9 @@ void EdsClusterImpl::onConfigUpdate(const ResourceVector& resources) {
     onPreInitComplete();
   }
 
+  last_assignment_hash_ = assignment_hash;
+  last_endpoint_count_ = endpoint_addresses.size();
+
   // If we didn't setup to initialize when our first round of health checking is complete, just
   // do it now.
   onPreInitComplete();
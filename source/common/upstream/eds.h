@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstddef>
+
+#include "envoy/common/optional.h"
 #include "envoy/config/subscription.h"
 #include "envoy/local_info/local_info.h"
 
@@ -39,6 +42,9 @@ private:
   std::unique_ptr<Config::Subscription<envoy::api::v2::ClusterLoadAssignment>> subscription_;
   const LocalInfo::LocalInfo& local_info_;
   const std::string cluster_name_;
+  // Hash and number of distinct endpoint addresses of the last applied assignment.
+  Optional<std::size_t> last_assignment_hash_;
+  std::size_t last_endpoint_count_{};
 };
 
 } // namespace Upstream
@@ -0,0 +1,126 @@
+#include "common/upstream/health_check_shard_pool.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include "common/common/assert.h"
+
+#include "fmt/format.h"
+
+namespace Envoy {
+namespace Upstream {
+
+const std::chrono::milliseconds HealthCheckShardPool::LOOP_LAG_INTERVAL{1000};
+
+HealthCheckShardPool::Shard::Shard(HealthCheckShardPool& parent, uint32_t index,
+                                   Event::DispatcherPtr&& dispatcher)
+    : parent_(parent), index_(index), dispatcher_(std::move(dispatcher)),
+      stats_(generateStats(parent.scope_, index)) {}
+
+HealthCheckShardStats HealthCheckShardPool::Shard::generateStats(Stats::Scope& scope,
+                                                                 uint32_t index) {
+  std::string prefix(fmt::format("health_check_shard.{}.", index));
+  return {ALL_HEALTH_CHECK_SHARD_STATS(POOL_COUNTER_PREFIX(scope, prefix),
+                                       POOL_GAUGE_PREFIX(scope, prefix),
+                                       POOL_HISTOGRAM_PREFIX(scope, prefix))};
+}
+
+bool HealthCheckShardPool::Shard::isShardThread() const {
+  return thread_id_ == Thread::Thread::currentThreadId();
+}
+
+void HealthCheckShardPool::Shard::onLoopLagTimer() {
+  // The timer both measures how late the shard loop is running callbacks and keeps the loop from
+  // exiting when the shard has no sessions.
+  const MonotonicTime now = parent_.time_source_.currentTime();
+  if (now > loop_lag_expected_) {
+    stats_.loop_lag_ms_.recordValue(
+        std::chrono::duration_cast<std::chrono::milliseconds>(now - loop_lag_expected_).count());
+  } else {
+    stats_.loop_lag_ms_.recordValue(0);
+  }
+
+  loop_lag_expected_ = now + LOOP_LAG_INTERVAL;
+  loop_lag_timer_->enableTimer(LOOP_LAG_INTERVAL);
+}
+
+void HealthCheckShardPool::Shard::threadRoutine() {
+  thread_id_ = Thread::Thread::currentThreadId();
+  ENVOY_LOG(info, "health check shard {} entering dispatch loop", index_);
+
+  loop_lag_timer_ = dispatcher_->createTimer([this]() -> void { onLoopLagTimer(); });
+  loop_lag_expected_ = parent_.time_source_.currentTime() + LOOP_LAG_INTERVAL;
+  loop_lag_timer_->enableTimer(LOOP_LAG_INTERVAL);
+
+  dispatcher_->run(Event::Dispatcher::RunType::Block);
+  ENVOY_LOG(info, "health check shard {} exited dispatch loop", index_);
+
+  // Same as a worker, anything that lives on this thread must be destroyed on this thread before
+  // it exits. All sessions have already been torn down by their health checkers.
+  loop_lag_timer_.reset();
+  parent_.tls_.shutdownThread();
+}
+
+HealthCheckShardPool::HealthCheckShardPool(uint32_t concurrency, Api::Api& api,
+                                           ThreadLocal::Instance& tls, Stats::Scope& scope,
+                                           MonotonicTimeSource& time_source)
+    : tls_(tls), scope_(scope), time_source_(time_source) {
+  for (uint32_t i = 0; i < concurrency; i++) {
+    shards_.emplace_back(new Shard(*this, i, api.allocateDispatcher()));
+    tls_.registerThread(shards_.back()->dispatcher(), false);
+  }
+
+  // Threads start right away since the first health check round happens during cluster
+  // initialization. Anything posted before the loop starts (TLS slot sets, sessions) is queued.
+  for (std::unique_ptr<Shard>& shard : shards_) {
+    Shard* raw_shard = shard.get();
+    shard->thread_.reset(
+        new Thread::Thread([raw_shard]() -> void { raw_shard->threadRoutine(); }));
+  }
+}
+
+HealthCheckShardPool::~HealthCheckShardPool() { shutdown(); }
+
+HealthCheckShardPool::Shard& HealthCheckShardPool::shardForHost(const Host& host) {
+  ASSERT(!shards_.empty());
+  return *shards_[std::hash<std::string>()(host.address()->asString()) % shards_.size()];
+}
+
+void HealthCheckShardPool::runOnShardAndWait(Shard& shard, std::function<void()> cb) {
+  if (shutdown_ || shard.isShardThread()) {
+    cb();
+    return;
+  }
+
+  std::mutex lock;
+  std::condition_variable cv;
+  bool done = false;
+  shard.dispatcher().post([&]() -> void {
+    cb();
+    std::unique_lock<std::mutex> guard(lock);
+    done = true;
+    cv.notify_one();
+  });
+
+  std::unique_lock<std::mutex> guard(lock);
+  cv.wait(guard, [&done]() -> bool { return done; });
+}
+
+void HealthCheckShardPool::shutdown() {
+  if (shutdown_) {
+    return;
+  }
+
+  shutdown_ = true;
+  for (std::unique_ptr<Shard>& shard : shards_) {
+    shard->dispatcher().exit();
+    shard->thread_->join();
+  }
+}
+
+} // namespace Upstream
+} // namespace Envoy
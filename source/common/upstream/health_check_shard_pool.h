@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "envoy/api/api.h"
+#include "envoy/common/time.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "envoy/stats/stats.h"
+#include "envoy/stats/stats_macros.h"
+#include "envoy/thread_local/thread_local.h"
+#include "envoy/upstream/upstream.h"
+
+#include "common/common/logger.h"
+#include "common/common/thread.h"
+
+namespace Envoy {
+namespace Upstream {
+
+/**
+ * All per shard health check stats. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_HEALTH_CHECK_SHARD_STATS(COUNTER, GAUGE, HISTOGRAM)                                    \
+  COUNTER  (result_batch)                                                                          \
+  COUNTER  (result)                                                                                \
+  GAUGE    (active_sessions)                                                                       \
+  HISTOGRAM(result_batch_lag_ms)                                                                   \
+  HISTOGRAM(loop_lag_ms)
+// clang-format on
+
+/**
+ * Struct definition for all per shard health check stats. @see stats_macros.h
+ */
+struct HealthCheckShardStats {
+  ALL_HEALTH_CHECK_SHARD_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT,
+                               GENERATE_HISTOGRAM_STRUCT)
+};
+
+/**
+ * A fixed pool of dispatcher threads that active health check sessions are sharded across by
+ * host. Health checking a large number of hosts from the main thread makes HC latency (and hence
+ * failure detection) depend on whatever else the main thread is doing, e.g. xDS processing. The
+ * pool is dedicated rather than reusing the workers because the first health check round gates
+ * cluster initialization, which completes before the workers start running their loops.
+ *
+ * Each shard dispatcher is registered for thread local updates so that runtime, stats, etc. work
+ * the same as on a worker. Results are batched by the health checker and posted back to the main
+ * thread; only session I/O and timers run on the shard.
+ */
+class HealthCheckShardPool : Logger::Loggable<Logger::Id::hc> {
+public:
+  class Shard {
+  public:
+    Shard(HealthCheckShardPool& parent, uint32_t index, Event::DispatcherPtr&& dispatcher);
+
+    Event::Dispatcher& dispatcher() { return *dispatcher_; }
+    uint32_t index() const { return index_; }
+
+    /**
+     * @return whether the calling thread is this shard's thread.
+     */
+    bool isShardThread() const;
+
+    HealthCheckShardStats& stats() { return stats_; }
+
+  private:
+    static HealthCheckShardStats generateStats(Stats::Scope& scope, uint32_t index);
+    void onLoopLagTimer();
+    void threadRoutine();
+
+    HealthCheckShardPool& parent_;
+    const uint32_t index_;
+    Event::DispatcherPtr dispatcher_;
+    HealthCheckShardStats stats_;
+    Thread::ThreadPtr thread_;
+    std::atomic<Thread::ThreadId> thread_id_{};
+    Event::TimerPtr loop_lag_timer_;
+    MonotonicTime loop_lag_expected_;
+
+    friend class HealthCheckShardPool;
+  };
+
+  /**
+   * @param concurrency supplies the number of shard threads to run.
+   * @param api supplies the API used to allocate shard dispatchers.
+   * @param tls supplies the thread local instance that shard threads register with. Registration
+   *            must happen before any slots that the health checkers depend on are allocated.
+   * @param scope supplies the scope to allocate per shard stats in.
+   * @param time_source supplies the time source used for loop and batch lag stats.
+   */
+  HealthCheckShardPool(uint32_t concurrency, Api::Api& api, ThreadLocal::Instance& tls,
+                       Stats::Scope& scope, MonotonicTimeSource& time_source);
+  ~HealthCheckShardPool();
+
+  /**
+   * @return the shard that owns health checking for a host. A host always maps to the same shard.
+   */
+  Shard& shardForHost(const Host& host);
+
+  /**
+   * Run a callback on a shard and block until it has completed. If the shard thread has already
+   * exited or the caller is the shard thread, the callback is run inline. Shard threads never block
+   * on other threads so this cannot deadlock. This is only used for tearing down per shard state
+   * when a health checker is destroyed.
+   */
+  void runOnShardAndWait(Shard& shard, std::function<void()> cb);
+
+  /**
+   * Exit all shard dispatch loops and join the threads. Must be called after thread local global
+   * shutdown and after all health checkers have been destroyed.
+   */
+  void shutdown();
+
+  Shard& shard(uint32_t index) { return *shards_[index]; }
+  uint32_t size() const { return shards_.size(); }
+  MonotonicTimeSource& timeSource() { return time_source_; }
+
+  static const std::chrono::milliseconds LOOP_LAG_INTERVAL;
+
+private:
+  ThreadLocal::Instance& tls_;
+  Stats::Scope& scope_;
+  MonotonicTimeSource& time_source_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  bool shutdown_{};
+};
+
+typedef std::unique_ptr<HealthCheckShardPool> HealthCheckShardPoolPtr;
+
+} // namespace Upstream
+} // namespace Envoy
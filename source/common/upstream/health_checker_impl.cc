@@ -1,5 +1,6 @@
 #include "common/upstream/health_checker_impl.h"
 
+#include <array>
 #include <chrono>
 #include <cstdint>
 #include <string>
@@ -16,6 +17,8 @@
 #include "common/common/enum_to_int.h"
 #include "common/common/hex.h"
 #include "common/common/utility.h"
+#include "common/grpc/codec.h"
+#include "common/grpc/common.h"
 #include "common/http/codec_client.h"
 #include "common/http/header_map_impl.h"
 #include "common/http/headers.h"
@@ -24,6 +27,8 @@
 #include "common/redis/conn_pool_impl.h"
 #include "common/upstream/host_utility.h"
 
+#include "fmt/format.h"
+
 namespace Envoy {
 namespace Upstream {
 
@@ -31,20 +36,39 @@ HealthCheckerSharedPtr HealthCheckerFactory::create(const envoy::api::v2::Health
                                                     Upstream::Cluster& cluster,
                                                     Runtime::Loader& runtime,
                                                     Runtime::RandomGenerator& random,
-                                                    Event::Dispatcher& dispatcher) {
+                                                    Event::Dispatcher& dispatcher,
+                                                    HealthCheckShardPool* shard_pool) {
+  std::unique_ptr<HealthCheckerImplBase> health_checker;
   switch (hc_config.health_checker_case()) {
   case envoy::api::v2::HealthCheck::HealthCheckerCase::kHttpHealthCheck:
-    return std::make_shared<ProdHttpHealthCheckerImpl>(cluster, hc_config, dispatcher, runtime,
-                                                       random);
+    health_checker.reset(
+        new ProdHttpHealthCheckerImpl(cluster, hc_config, dispatcher, runtime, random));
+    break;
   case envoy::api::v2::HealthCheck::HealthCheckerCase::kTcpHealthCheck:
-    return std::make_shared<TcpHealthCheckerImpl>(cluster, hc_config, dispatcher, runtime, random);
+    health_checker.reset(new TcpHealthCheckerImpl(cluster, hc_config, dispatcher, runtime, random));
+    break;
   case envoy::api::v2::HealthCheck::HealthCheckerCase::kRedisHealthCheck:
-    return std::make_shared<RedisHealthCheckerImpl>(cluster, hc_config, dispatcher, runtime, random,
-                                                    Redis::ConnPool::ClientFactoryImpl::instance_);
+    health_checker.reset(new RedisHealthCheckerImpl(cluster, hc_config, dispatcher, runtime, random,
+                                                    Redis::ConnPool::ClientFactoryImpl::instance_));
+    break;
   default:
     // TODO(htuch): This should be subsumed eventually by the constraint checking in #1308.
     throw EnvoyException("Health checker type not set");
   }
+
+  if (shard_pool == nullptr || shard_pool->size() == 0) {
+    return HealthCheckerSharedPtr{health_checker.release()};
+  }
+
+  // Sharded sessions reference the health checker from the shard threads, so they must be torn
+  // down on their shards before any part of the health checker (including derived members) is
+  // destroyed. That is why this is done in the deleter and not in the destructor.
+  health_checker->setShardPool(*shard_pool);
+  return HealthCheckerSharedPtr{health_checker.release(),
+                                [](HealthCheckerImplBase* health_checker) -> void {
+                                  health_checker->tearDownShards();
+                                  delete health_checker;
+                                }};
 }
 
 const std::chrono::milliseconds HealthCheckerImplBase::NO_TRAFFIC_INTERVAL{60000};
@@ -67,6 +91,40 @@ HealthCheckerImplBase::HealthCheckerImplBase(const Cluster& cluster,
   });
 }
 
+void HealthCheckerImplBase::setShardPool(HealthCheckShardPool& shard_pool) {
+  ASSERT(shard_pool_ == nullptr);
+  shard_pool_ = &shard_pool;
+  for (uint32_t i = 0; i < shard_pool.size(); i++) {
+    shard_states_.emplace_back(new ShardState(shard_pool.shard(i)));
+  }
+}
+
+HealthCheckerImplBase::ShardState* HealthCheckerImplBase::shardStateForHost(const Host& host) {
+  if (shard_pool_ == nullptr) {
+    return nullptr;
+  }
+
+  HealthCheckShardPool::Shard& shard = shard_pool_->shardForHost(host);
+  return shard_states_[shard.index()].get();
+}
+
+Event::Dispatcher& HealthCheckerImplBase::dispatcherForHost(const Host& host) {
+  ShardState* state = shardStateForHost(host);
+  return state != nullptr ? state->shard_.dispatcher() : dispatcher_;
+}
+
+void HealthCheckerImplBase::tearDownShards() {
+  for (std::unique_ptr<ShardState>& state : shard_states_) {
+    ShardState& state_ref = *state;
+    shard_pool_->runOnShardAndWait(state_ref.shard_, [&state_ref]() -> void {
+      state_ref.shard_.stats().active_sessions_.sub(state_ref.sessions_.size());
+      state_ref.sessions_.clear();
+      state_ref.pending_results_.clear();
+      state_ref.flush_timer_.reset();
+    });
+  }
+}
+
 void HealthCheckerImplBase::decHealthy() {
   ASSERT(local_process_healthy_ > 0);
   local_process_healthy_--;
@@ -110,6 +168,11 @@ std::chrono::milliseconds HealthCheckerImplBase::interval() const {
 }
 
 void HealthCheckerImplBase::addHosts(const std::vector<HostSharedPtr>& hosts) {
+  if (shard_pool_ != nullptr) {
+    addShardedHosts(hosts);
+    return;
+  }
+
   for (const HostSharedPtr& host : hosts) {
     active_sessions_[host] = makeSession(host);
     host->setHealthChecker(
@@ -118,9 +181,54 @@ void HealthCheckerImplBase::addHosts(const std::vector<HostSharedPtr>& hosts) {
   }
 }
 
+void HealthCheckerImplBase::addShardedHosts(const std::vector<HostSharedPtr>& hosts) {
+  if (weak_this_.expired()) {
+    weak_this_ = shared_from_this();
+  }
+
+  // Group the new hosts by shard so that each shard gets a single post. Capturing this is safe
+  // because the deleter tears down every shard, which runs after anything already posted.
+  std::vector<std::vector<HostSharedPtr>> hosts_per_shard(shard_states_.size());
+  for (const HostSharedPtr& host : hosts) {
+    host->setHealthChecker(
+        HealthCheckHostMonitorPtr{new HealthCheckHostMonitorImpl(shared_from_this(), host)});
+    hosts_per_shard[shard_pool_->shardForHost(*host).index()].push_back(host);
+  }
+
+  for (size_t i = 0; i < hosts_per_shard.size(); i++) {
+    if (hosts_per_shard[i].empty()) {
+      continue;
+    }
+
+    ShardState& state = *shard_states_[i];
+    std::vector<HostSharedPtr> shard_hosts = std::move(hosts_per_shard[i]);
+    state.shard_.dispatcher().post([this, &state, shard_hosts]() -> void {
+      for (const HostSharedPtr& host : shard_hosts) {
+        ActiveHealthCheckSessionPtr& session = state.sessions_[host];
+        session = makeSession(host);
+        state.shard_.stats().active_sessions_.inc();
+        session->start();
+      }
+    });
+  }
+}
+
 void HealthCheckerImplBase::onClusterMemberUpdate(const std::vector<HostSharedPtr>& hosts_added,
                                                   const std::vector<HostSharedPtr>& hosts_removed) {
   addHosts(hosts_added);
+  if (shard_pool_ != nullptr) {
+    for (const HostSharedPtr& host : hosts_removed) {
+      ShardState& state = *shardStateForHost(*host);
+      state.shard_.dispatcher().post([&state, host]() -> void {
+        auto session_iter = state.sessions_.find(host);
+        ASSERT(state.sessions_.end() != session_iter);
+        state.sessions_.erase(session_iter);
+        state.shard_.stats().active_sessions_.dec();
+      });
+    }
+    return;
+  }
+
   for (const HostSharedPtr& host : hosts_removed) {
     auto session_iter = active_sessions_.find(host);
     ASSERT(active_sessions_.end() != session_iter);
@@ -162,6 +270,8 @@ void HealthCheckerImplBase::setUnhealthyCrossThread(const HostSharedPtr& host) {
   //    thread.
   // 2) On the main thread, we make sure it is still valid (as the cluster may have been destroyed).
   // 3) Additionally, the host/session may also be gone by then so we check that also.
+  // 4) If sessions are sharded, the session lookup happens on the owning shard. Capturing the
+  //    health checker there is safe since the deleter tears down the shard after this post.
   std::weak_ptr<HealthCheckerImplBase> weak_this = shared_from_this();
   dispatcher_.post([weak_this, host]() -> void {
     std::shared_ptr<HealthCheckerImplBase> shared_this = weak_this.lock();
@@ -169,6 +279,21 @@ void HealthCheckerImplBase::setUnhealthyCrossThread(const HostSharedPtr& host) {
       return;
     }
 
+    if (shared_this->shard_pool_ != nullptr) {
+      if (host == nullptr) {
+        return;
+      }
+
+      ShardState& state = *shared_this->shardStateForHost(*host);
+      state.shard_.dispatcher().post([&state, host]() -> void {
+        const auto session = state.sessions_.find(host);
+        if (session != state.sessions_.end()) {
+          session->second->setUnhealthy(ActiveHealthCheckSession::FailureType::Passive);
+        }
+      });
+      return;
+    }
+
     const auto session = shared_this->active_sessions_.find(host);
     if (session == shared_this->active_sessions_.end()) {
       return;
@@ -178,13 +303,61 @@ void HealthCheckerImplBase::setUnhealthyCrossThread(const HostSharedPtr& host) {
   });
 }
 
+void HealthCheckerImplBase::queueShardResult(ShardState& state, const HostSharedPtr& host,
+                                             bool changed_state) {
+  // Runs on the shard thread. Results are held for a short window so that a burst of checks
+  // completing together (e.g. at startup or when a large cluster is added) turns into a single
+  // post and a single round of callbacks/host set updates on the main thread.
+  state.shard_.stats().result_.inc();
+  if (state.pending_results_.empty()) {
+    state.first_pending_result_ = shard_pool_->timeSource().currentTime();
+    if (!state.flush_timer_) {
+      state.flush_timer_ = state.shard_.dispatcher().createTimer(
+          [this, &state]() -> void { flushShardResults(state); });
+    }
+    state.flush_timer_->enableTimer(std::chrono::milliseconds(runtime_.snapshot().getInteger(
+        "health_check.shard_batch_window_ms", DEFAULT_SHARD_BATCH_WINDOW_MS)));
+  }
+
+  state.pending_results_.emplace_back(host, changed_state);
+}
+
+void HealthCheckerImplBase::flushShardResults(ShardState& state) {
+  // Runs on the shard thread. The health checker might be gone by the time the batch gets to the
+  // main thread, so only a weak reference is captured. The shard itself outlives all health
+  // checkers.
+  std::vector<std::pair<HostSharedPtr, bool>> results;
+  results.swap(state.pending_results_);
+  std::weak_ptr<HealthCheckerImplBase> weak_this = weak_this_;
+  HealthCheckShardPool::Shard& shard = state.shard_;
+  MonotonicTimeSource& time_source = shard_pool_->timeSource();
+  const MonotonicTime first_pending_result = state.first_pending_result_;
+  dispatcher_.post([weak_this, &shard, &time_source, results, first_pending_result]() -> void {
+    shard.stats().result_batch_.inc();
+    shard.stats().result_batch_lag_ms_.recordValue(
+        std::chrono::duration_cast<std::chrono::milliseconds>(time_source.currentTime() -
+                                                              first_pending_result)
+            .count());
+
+    std::shared_ptr<HealthCheckerImplBase> shared_this = weak_this.lock();
+    if (shared_this == nullptr) {
+      return;
+    }
+
+    for (const auto& result : results) {
+      shared_this->runCallbacks(result.first, result.second);
+    }
+  });
+}
+
 void HealthCheckerImplBase::start() { addHosts(cluster_.hosts()); }
 
 HealthCheckerImplBase::ActiveHealthCheckSession::ActiveHealthCheckSession(
     HealthCheckerImplBase& parent, HostSharedPtr host)
-    : host_(host), parent_(parent),
-      interval_timer_(parent.dispatcher_.createTimer([this]() -> void { onIntervalBase(); })),
-      timeout_timer_(parent.dispatcher_.createTimer([this]() -> void { onTimeoutBase(); })) {
+    : host_(host), dispatcher_(parent.dispatcherForHost(*host)), parent_(parent),
+      shard_state_(parent.shardStateForHost(*host)),
+      interval_timer_(dispatcher_.createTimer([this]() -> void { onIntervalBase(); })),
+      timeout_timer_(dispatcher_.createTimer([this]() -> void { onTimeoutBase(); })) {
 
   if (!host->healthFlagGet(Host::HealthFlag::FAILED_ACTIVE_HC)) {
     parent.incHealthy();
@@ -215,7 +388,7 @@ void HealthCheckerImplBase::ActiveHealthCheckSession::handleSuccess() {
 
   parent_.stats_.success_.inc();
   first_check_ = false;
-  parent_.runCallbacks(host_, changed_state);
+  reportResult(changed_state);
 
   timeout_timer_->disableTimer();
   interval_timer_->enableTimer(parent_.interval());
@@ -242,7 +415,15 @@ void HealthCheckerImplBase::ActiveHealthCheckSession::setUnhealthy(FailureType t
   }
 
   first_check_ = false;
-  parent_.runCallbacks(host_, changed_state);
+  reportResult(changed_state);
+}
+
+void HealthCheckerImplBase::ActiveHealthCheckSession::reportResult(bool changed_state) {
+  if (shard_state_ != nullptr) {
+    parent_.queueShardResult(*shard_state_, host_, changed_state);
+  } else {
+    parent_.runCallbacks(host_, changed_state);
+  }
 }
 
 void HealthCheckerImplBase::ActiveHealthCheckSession::handleFailure(FailureType type) {
@@ -268,12 +449,22 @@ HttpHealthCheckerImpl::HttpHealthCheckerImpl(const Cluster& cluster,
                                              Runtime::Loader& runtime,
                                              Runtime::RandomGenerator& random)
     : HealthCheckerImplBase(cluster, config, dispatcher, runtime, random),
-      path_(config.http_health_check().path()) {
+      path_(config.http_health_check().path()), grpc_(path_ == GRPC_HEALTH_CHECK_PATH),
+      codec_client_type_(grpc_ || useHttp2(cluster, runtime) ? Http::CodecClient::Type::HTTP2
+                                                             : Http::CodecClient::Type::HTTP1) {
   if (!config.http_health_check().service_name().empty()) {
     service_name_.value(config.http_health_check().service_name());
   }
 }
 
+const std::string HttpHealthCheckerImpl::GRPC_HEALTH_CHECK_PATH{"/grpc.health.v1.Health/Check"};
+
+bool HttpHealthCheckerImpl::useHttp2(const Cluster& cluster, Runtime::Loader& runtime) {
+  return (cluster.info()->features() & ClusterInfo::Features::HTTP2) &&
+         runtime.snapshot().getInteger(fmt::format("health_check.http2.{}", cluster.info()->name()),
+                                       0) != 0;
+}
+
 HttpHealthCheckerImpl::HttpActiveHealthCheckSession::HttpActiveHealthCheckSession(
     HttpHealthCheckerImpl& parent, HostSharedPtr host)
     : ActiveHealthCheckSession(parent, host), parent_(parent) {}
@@ -295,38 +486,83 @@ void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::decodeHeaders(
   }
 }
 
+void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::decodeData(Buffer::Instance& data,
+                                                                     bool end_stream) {
+  // Only gRPC health checks look at the body.
+  if (parent_.grpc_) {
+    response_body_.move(data);
+  }
+
+  if (end_stream) {
+    onResponseComplete();
+  }
+}
+
+void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::decodeTrailers(
+    Http::HeaderMapPtr&& trailers) {
+  response_trailers_ = std::move(trailers);
+  onResponseComplete();
+}
+
 void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onEvent(Network::ConnectionEvent event) {
   if (event == Network::ConnectionEvent::RemoteClose ||
       event == Network::ConnectionEvent::LocalClose) {
     // For the raw disconnect event, we are either between intervals in which case we already have
     // a timer setup, or we did the close or got a reset, in which case we already setup a new
     // timer. There is nothing to do here other than blow away the client.
-    parent_.dispatcher_.deferredDelete(std::move(client_));
+    dispatcher_.deferredDelete(std::move(client_));
   }
 }
 
 void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onInterval() {
   if (!client_) {
-    Upstream::Host::CreateConnectionData conn = host_->createConnection(parent_.dispatcher_);
+    Upstream::Host::CreateConnectionData conn = host_->createConnection(dispatcher_);
     client_.reset(parent_.createCodecClient(conn));
     client_->addConnectionCallbacks(connection_callback_impl_);
-    expect_reset_ = false;
   }
 
+  // With HTTP/2 the connection outlives timed out streams, so this is reset for every stream.
+  expect_reset_ = false;
   request_encoder_ = &client_->newStream(*this);
   request_encoder_->getStream().addCallbacks(*this);
+  encodeRequest();
+}
 
+void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::encodeRequest() {
   Http::HeaderMapImpl request_headers{
-      {Http::Headers::get().Method, "GET"},
       {Http::Headers::get().Host, parent_.cluster_.info()->name()},
       {Http::Headers::get().Path, parent_.path_},
       {Http::Headers::get().UserAgent, Http::Headers::get().UserAgentValues.EnvoyHealthChecker}};
 
-  request_encoder_->encodeHeaders(request_headers, true);
-  request_encoder_ = nullptr;
+  if (parent_.codec_client_type_ == Http::CodecClient::Type::HTTP2) {
+    request_headers.insertScheme().value().setReference(
+        parent_.cluster_.info()->sslContext() ? Http::Headers::get().SchemeValues.Https
+                                              : Http::Headers::get().SchemeValues.Http);
+  }
+
+  if (!parent_.grpc_) {
+    request_headers.insertMethod().value().setReference(Http::Headers::get().MethodValues.Get);
+    request_encoder_->encodeHeaders(request_headers, true);
+    return;
+  }
+
+  request_headers.insertMethod().value().setReference(Http::Headers::get().MethodValues.Post);
+  request_headers.insertContentType().value().setReference(
+      Http::Headers::get().ContentTypeValues.Grpc);
+  request_headers.insertTE().value().setReference(Http::Headers::get().TEValues.Trailers);
+  request_encoder_->encodeHeaders(request_headers, false);
+
+  Buffer::OwnedImpl body;
+  GrpcHealthCheckCodec::encodeRequest(
+      parent_.service_name_.valid() ? parent_.service_name_.value() : EMPTY_STRING, body);
+  request_encoder_->encodeData(body, true);
 }
 
 void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onResetStream(Http::StreamResetReason) {
+  request_encoder_ = nullptr;
+  response_headers_.reset();
+  response_trailers_.reset();
+  response_body_.drain(response_body_.length());
   if (expect_reset_) {
     return;
   }
@@ -336,6 +572,27 @@ void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onResetStream(Http::St
   handleFailure(FailureType::Network);
 }
 
+bool HttpHealthCheckerImpl::HttpActiveHealthCheckSession::isGrpcHealthCheckSucceeded() {
+  // A trailers only response carries grpc-status in the headers.
+  const Optional<Grpc::Status::GrpcStatus> grpc_status =
+      Grpc::Common::getGrpcStatus(response_trailers_ ? *response_trailers_ : *response_headers_);
+  ENVOY_CONN_LOG(debug, "hc grpc-status={} health_flags={}", *client_,
+                 grpc_status.valid() ? static_cast<int>(grpc_status.value()) : -1,
+                 HostUtility::healthFlagsToString(*host_));
+  if (!grpc_status.valid() || grpc_status.value() != Grpc::Status::GrpcStatus::Ok) {
+    return false;
+  }
+
+  Grpc::Decoder decoder;
+  std::vector<Grpc::Frame> frames;
+  if (!decoder.decode(response_body_, frames) || frames.size() != 1 ||
+      frames[0].flags_ != Grpc::GRPC_FH_DEFAULT) {
+    return false;
+  }
+
+  return GrpcHealthCheckCodec::isServing(*frames[0].data_);
+}
+
 bool HttpHealthCheckerImpl::HttpActiveHealthCheckSession::isHealthCheckSucceeded() {
   uint64_t response_code = Http::Utility::getResponseStatus(*response_headers_);
   ENVOY_CONN_LOG(debug, "hc response={} health_flags={}", *client_, response_code,
@@ -345,6 +602,10 @@ bool HttpHealthCheckerImpl::HttpActiveHealthCheckSession::isHealthCheckSucceeded
     return false;
   }
 
+  if (parent_.grpc_) {
+    return isGrpcHealthCheckSucceeded();
+  }
+
   if (parent_.service_name_.valid() &&
       parent_.runtime_.snapshot().featureEnabled("health_check.verify_cluster", 100UL)) {
     parent_.stats_.verify_cluster_.inc();
@@ -360,6 +621,7 @@ bool HttpHealthCheckerImpl::HttpActiveHealthCheckSession::isHealthCheckSucceeded
 }
 
 void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onResponseComplete() {
+  request_encoder_ = nullptr;
   if (isHealthCheckSucceeded()) {
     handleSuccess();
   } else {
@@ -374,6 +636,8 @@ void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onResponseComplete() {
   }
 
   response_headers_.reset();
+  response_trailers_.reset();
+  response_body_.drain(response_body_.length());
 }
 
 void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onTimeout() {
@@ -382,15 +646,110 @@ void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onTimeout() {
 
   // If there is an active request it will get reset, so make sure we ignore the reset.
   expect_reset_ = true;
-  client_->close();
+  if (parent_.codec_client_type_ == Http::CodecClient::Type::HTTP2 && request_encoder_ != nullptr) {
+    // Only the stream is reset so that the connection (and any TLS session) is reused by the next
+    // check. If the connection itself is gone the connect timeout or a close event handles it.
+    request_encoder_->getStream().resetStream(Http::StreamResetReason::LocalReset);
+  } else {
+    client_->close();
+  }
 }
 
 Http::CodecClient*
 ProdHttpHealthCheckerImpl::createCodecClient(Upstream::Host::CreateConnectionData& data) {
-  return new Http::CodecClientProd(Http::CodecClient::Type::HTTP1, std::move(data.connection_),
+  return new Http::CodecClientProd(codecClientType(), std::move(data.connection_),
                                    data.host_description_);
 }
 
+void GrpcHealthCheckCodec::encodeRequest(const std::string& service, Buffer::Instance& output) {
+  // HealthCheckRequest.service is field 1 with wire type 2 (length delimited). An empty service is
+  // the default value so it is not encoded at all.
+  std::string message;
+  if (!service.empty()) {
+    message.push_back(0x0a);
+    uint64_t length = service.size();
+    while (length >= 0x80) {
+      message.push_back(static_cast<char>((length & 0x7f) | 0x80));
+      length >>= 7;
+    }
+    message.push_back(static_cast<char>(length));
+    message.append(service);
+  }
+
+  std::array<uint8_t, 5> header;
+  Grpc::Encoder().newFrame(Grpc::GRPC_FH_DEFAULT, message.size(), header);
+  output.add(header.data(), header.size());
+  output.add(message);
+}
+
+namespace {
+
+bool readVarint(const uint8_t*& current, const uint8_t* end, uint64_t& value) {
+  value = 0;
+  for (uint32_t shift = 0; current < end && shift < 64; shift += 7) {
+    const uint8_t byte = *current++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+} // namespace
+
+bool GrpcHealthCheckCodec::isServing(Buffer::Instance& message) {
+  static const uint64_t STATUS_TAG = (1 << 3) | 0;
+  static const uint64_t SERVING = 1;
+
+  const uint64_t length = message.length();
+  const uint8_t* current = static_cast<const uint8_t*>(message.linearize(length));
+  const uint8_t* end = current + length;
+  uint64_t status = 0;
+  while (current < end) {
+    uint64_t tag;
+    if (!readVarint(current, end, tag)) {
+      return false;
+    }
+
+    // Unknown fields are skipped per the usual protobuf rules. The last status wins.
+    uint64_t value;
+    switch (tag & 0x7) {
+    case 0:
+      if (!readVarint(current, end, value)) {
+        return false;
+      }
+      if (tag == STATUS_TAG) {
+        status = value;
+      }
+      break;
+    case 1:
+      if (end - current < 8) {
+        return false;
+      }
+      current += 8;
+      break;
+    case 2:
+      if (!readVarint(current, end, value) || static_cast<uint64_t>(end - current) < value) {
+        return false;
+      }
+      current += value;
+      break;
+    case 5:
+      if (end - current < 4) {
+        return false;
+      }
+      current += 4;
+      break;
+    default:
+      return false;
+    }
+  }
+
+  return status == SERVING;
+}
+
 TcpHealthCheckMatcher::MatchSegments TcpHealthCheckMatcher::loadProtoBytes(
     const Protobuf::RepeatedPtrField<envoy::api::v2::HealthCheck::Payload>& byte_array) {
   MatchSegments result;
@@ -451,7 +810,7 @@ void TcpHealthCheckerImpl::TcpActiveHealthCheckSession::onEvent(Network::Connect
 
   if (event == Network::ConnectionEvent::RemoteClose ||
       event == Network::ConnectionEvent::LocalClose) {
-    parent_.dispatcher_.deferredDelete(std::move(client_));
+    dispatcher_.deferredDelete(std::move(client_));
   }
 
   if (event == Network::ConnectionEvent::Connected && parent_.receive_bytes_.empty()) {
@@ -476,7 +835,7 @@ void TcpHealthCheckerImpl::TcpActiveHealthCheckSession::onEvent(Network::Connect
 
 void TcpHealthCheckerImpl::TcpActiveHealthCheckSession::onInterval() {
   if (!client_) {
-    client_ = host_->createConnection(parent_.dispatcher_).connection_;
+    client_ = host_->createConnection(dispatcher_).connection_;
     session_callbacks_.reset(new TcpSessionCallbacks(*this));
     client_->addConnectionCallbacks(*session_callbacks_);
     client_->addReadFilter(session_callbacks_);
@@ -529,13 +888,13 @@ void RedisHealthCheckerImpl::RedisActiveHealthCheckSession::onEvent(
       event == Network::ConnectionEvent::LocalClose) {
     // This should only happen after any active requests have been failed/cancelled.
     ASSERT(!current_request_);
-    parent_.dispatcher_.deferredDelete(std::move(client_));
+    dispatcher_.deferredDelete(std::move(client_));
   }
 }
 
 void RedisHealthCheckerImpl::RedisActiveHealthCheckSession::onInterval() {
   if (!client_) {
-    client_ = parent_.client_factory_.create(host_, parent_.dispatcher_, *this);
+    client_ = parent_.client_factory_.create(host_, dispatcher_, *this);
     client_->addConnectionCallbacks(*this);
   }
 
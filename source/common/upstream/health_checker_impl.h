@@ -1,11 +1,13 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <list>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "envoy/event/timer.h"
@@ -16,10 +18,12 @@
 #include "envoy/runtime/runtime.h"
 #include "envoy/upstream/health_checker.h"
 
+#include "common/buffer/buffer_impl.h"
 #include "common/common/logger.h"
 #include "common/http/codec_client.h"
 #include "common/network/filter_impl.h"
 #include "common/protobuf/protobuf.h"
+#include "common/upstream/health_check_shard_pool.h"
 
 #include "api/health_check.pb.h"
 
@@ -38,12 +42,15 @@ public:
    * @param runtime supplies the runtime loader.
    * @param random supplies the random generator.
    * @param dispatcher supplies the dispatcher.
+   * @param shard_pool supplies the optional pool to shard health check sessions across. If nullptr
+   *        or empty, all sessions run on the dispatcher.
    * @return a health checker.
    */
   static HealthCheckerSharedPtr create(const envoy::api::v2::HealthCheck& hc_config,
                                        Upstream::Cluster& cluster, Runtime::Loader& runtime,
                                        Runtime::RandomGenerator& random,
-                                       Event::Dispatcher& dispatcher);
+                                       Event::Dispatcher& dispatcher,
+                                       HealthCheckShardPool* shard_pool);
 };
 
 /**
@@ -79,6 +86,8 @@ public:
   void start() override;
 
 protected:
+  struct ShardState;
+
   class ActiveHealthCheckSession {
   public:
     enum class FailureType { Active, Passive, Network };
@@ -94,14 +103,18 @@ protected:
     void handleFailure(FailureType type);
 
     HostSharedPtr host_;
+    // The dispatcher the session runs on. This is the owning shard's dispatcher when sharded.
+    Event::Dispatcher& dispatcher_;
 
   private:
     virtual void onInterval() PURE;
     void onIntervalBase();
     virtual void onTimeout() PURE;
     void onTimeoutBase();
+    void reportResult(bool changed_state);
 
     HealthCheckerImplBase& parent_;
+    ShardState* const shard_state_;
     Event::TimerPtr interval_timer_;
     Event::TimerPtr timeout_timer_;
     uint32_t num_unhealthy_{};
@@ -117,6 +130,20 @@ protected:
 
   virtual ActiveHealthCheckSessionPtr makeSession(HostSharedPtr host) PURE;
 
+  /**
+   * Per shard state of a sharded health checker. Everything other than shard_ is only accessed on
+   * the shard's thread.
+   */
+  struct ShardState {
+    ShardState(HealthCheckShardPool::Shard& shard) : shard_(shard) {}
+
+    HealthCheckShardPool::Shard& shard_;
+    std::unordered_map<HostSharedPtr, ActiveHealthCheckSessionPtr> sessions_;
+    std::vector<std::pair<HostSharedPtr, bool>> pending_results_;
+    MonotonicTime first_pending_result_;
+    Event::TimerPtr flush_timer_;
+  };
+
   const Cluster& cluster_;
   Event::Dispatcher& dispatcher_;
   const std::chrono::milliseconds timeout_;
@@ -140,27 +167,72 @@ private:
   };
 
   void addHosts(const std::vector<HostSharedPtr>& hosts);
+  void addShardedHosts(const std::vector<HostSharedPtr>& hosts);
   void decHealthy();
+  Event::Dispatcher& dispatcherForHost(const Host& host);
+  void flushShardResults(ShardState& state);
   HealthCheckerStats generateStats(Stats::Scope& scope);
   void incHealthy();
   std::chrono::milliseconds interval() const;
   void onClusterMemberUpdate(const std::vector<HostSharedPtr>& hosts_added,
                              const std::vector<HostSharedPtr>& hosts_removed);
+  void queueShardResult(ShardState& state, const HostSharedPtr& host, bool changed_state);
   void refreshHealthyStat();
   void runCallbacks(HostSharedPtr host, bool changed_state);
+  void setShardPool(HealthCheckShardPool& shard_pool);
   void setUnhealthyCrossThread(const HostSharedPtr& host);
+  ShardState* shardStateForHost(const Host& host);
+  void tearDownShards();
 
   static const std::chrono::milliseconds NO_TRAFFIC_INTERVAL;
+  static const uint64_t DEFAULT_SHARD_BATCH_WINDOW_MS = 50;
 
   std::list<HostStatusCb> callbacks_;
   const std::chrono::milliseconds interval_;
   const std::chrono::milliseconds interval_jitter_;
   std::unordered_map<HostSharedPtr, ActiveHealthCheckSessionPtr> active_sessions_;
-  uint64_t local_process_healthy_{};
+  // Sessions may run on shard threads so this is updated concurrently.
+  std::atomic<uint64_t> local_process_healthy_{};
+  HealthCheckShardPool* shard_pool_{};
+  std::vector<std::unique_ptr<ShardState>> shard_states_;
+  // Used by shard threads to post result batches back without taking a strong reference.
+  std::weak_ptr<HealthCheckerImplBase> weak_this_;
+
+  friend class HealthCheckerFactory;
 };
 
 /**
- * HTTP health checker implementation. Connection keep alive is used where possible.
+ * Utility class for encoding and decoding the messages of the standard gRPC health checking
+ * protocol (grpc.health.v1.Health/Check). The messages are tiny so they are encoded by hand rather
+ * than pulling in the generated protos:
+ *
+ * message HealthCheckRequest { string service = 1; }
+ * message HealthCheckResponse { enum ServingStatus { UNKNOWN = 0; SERVING = 1; NOT_SERVING = 2; }
+ *                               ServingStatus status = 1; }
+ */
+class GrpcHealthCheckCodec {
+public:
+  /**
+   * Encode a length prefixed HealthCheckRequest gRPC frame.
+   * @param service supplies the service to check. Empty checks the server as a whole.
+   * @param output supplies the buffer to append the frame to.
+   */
+  static void encodeRequest(const std::string& service, Buffer::Instance& output);
+
+  /**
+   * @param message supplies a HealthCheckResponse message (without the gRPC frame header).
+   * @return whether the response is well formed and its status is SERVING.
+   */
+  static bool isServing(Buffer::Instance& message);
+};
+
+/**
+ * HTTP health checker implementation. Connection keep alive is used where possible. If the cluster
+ * speaks HTTP/2 and the health_check.http2.<cluster> runtime key is set when the health checker is
+ * created, health checks are HTTP/2 streams multiplexed over a single long lived connection per
+ * host. Otherwise they are HTTP/1.1, since health check endpoints of HTTP/2 clusters do not
+ * necessarily speak HTTP/2. If the configured path is GRPC_HEALTH_CHECK_PATH, the standard gRPC health checking
+ * protocol is used (always over HTTP/2) and the service name is the gRPC service to check.
  */
 class HttpHealthCheckerImpl : public HealthCheckerImplBase {
 public:
@@ -168,14 +240,23 @@ public:
                         Event::Dispatcher& dispatcher, Runtime::Loader& runtime,
                         Runtime::RandomGenerator& random);
 
+  static const std::string GRPC_HEALTH_CHECK_PATH;
+
+protected:
+  Http::CodecClient::Type codecClientType() const { return codec_client_type_; }
+
 private:
+  static bool useHttp2(const Cluster& cluster, Runtime::Loader& runtime);
+
   struct HttpActiveHealthCheckSession : public ActiveHealthCheckSession,
                                         public Http::StreamDecoder,
                                         public Http::StreamCallbacks {
     HttpActiveHealthCheckSession(HttpHealthCheckerImpl& parent, HostSharedPtr host);
     ~HttpActiveHealthCheckSession();
 
+    void encodeRequest();
     void onResponseComplete();
+    bool isGrpcHealthCheckSucceeded();
     bool isHealthCheckSucceeded();
 
     // ActiveHealthCheckSession
@@ -184,12 +265,8 @@ private:
 
     // Http::StreamDecoder
     void decodeHeaders(Http::HeaderMapPtr&& headers, bool end_stream) override;
-    void decodeData(Buffer::Instance&, bool end_stream) override {
-      if (end_stream) {
-        onResponseComplete();
-      }
-    }
-    void decodeTrailers(Http::HeaderMapPtr&&) override { onResponseComplete(); }
+    void decodeData(Buffer::Instance& data, bool end_stream) override;
+    void decodeTrailers(Http::HeaderMapPtr&& trailers) override;
 
     // Http::StreamCallbacks
     void onResetStream(Http::StreamResetReason reason) override;
@@ -215,6 +292,8 @@ private:
     Http::CodecClientPtr client_;
     Http::StreamEncoder* request_encoder_{};
     Http::HeaderMapPtr response_headers_;
+    Http::HeaderMapPtr response_trailers_;
+    Buffer::OwnedImpl response_body_;
     bool expect_reset_{};
   };
 
@@ -229,6 +308,8 @@ private:
 
   const std::string path_;
   Optional<std::string> service_name_;
+  const bool grpc_;
+  const Http::CodecClient::Type codec_client_type_;
 };
 
 /**
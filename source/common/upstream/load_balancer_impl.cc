@@ -1,7 +1,10 @@
 #include "common/upstream/load_balancer_impl.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <map>
 #include <string>
+#include <tuple>
 #include <vector>
 
 #include "envoy/runtime/runtime.h"
@@ -16,22 +19,89 @@ namespace Upstream {
 static const std::string RuntimeZoneEnabled = "upstream.zone_routing.enabled";
 static const std::string RuntimeMinClusterSize = "upstream.zone_routing.min_cluster_size";
 static const std::string RuntimePanicThreshold = "upstream.healthy_panic_threshold";
+static const std::string RuntimeOverprovisioningFactor = "upstream.overprovisioning_factor";
+
+AliasTable::AliasTable(const std::vector<double>& weights) {
+  const size_t size = weights.size();
+  double sum = 0;
+  for (double weight : weights) {
+    sum += weight;
+  }
+  if (size == 0 || sum <= 0) {
+    return;
+  }
+
+  probability_.resize(size);
+  alias_.resize(size);
+
+  // Scale the weights so that the average is 1. Columns below the average are filled up with the
+  // excess of a column above the average, which becomes their alias.
+  std::vector<double> scaled(size);
+  std::vector<size_t> small;
+  std::vector<size_t> large;
+  for (size_t i = 0; i < size; ++i) {
+    scaled[i] = weights[i] * size / sum;
+    if (scaled[i] < 1.0) {
+      small.push_back(i);
+    } else {
+      large.push_back(i);
+    }
+  }
+
+  while (!small.empty() && !large.empty()) {
+    const size_t less = small.back();
+    small.pop_back();
+    const size_t more = large.back();
+    large.pop_back();
+
+    probability_[less] = scaled[less];
+    alias_[less] = more;
+    scaled[more] = scaled[more] + scaled[less] - 1.0;
+    if (scaled[more] < 1.0) {
+      small.push_back(more);
+    } else {
+      large.push_back(more);
+    }
+  }
+
+  // Whatever is left over is full (modulo floating point error).
+  for (size_t i : large) {
+    probability_[i] = 1.0;
+    alias_[i] = i;
+  }
+  for (size_t i : small) {
+    probability_[i] = 1.0;
+    alias_[i] = i;
+  }
+}
+
+size_t AliasTable::pick(uint64_t random1, uint64_t random2) const {
+  ASSERT(!empty());
+  const size_t column = random1 % probability_.size();
+  const double coin = static_cast<double>(random2 % 1000000) / 1000000;
+  return coin < probability_[column] ? column : alias_[column];
+}
 
 LoadBalancerBase::LoadBalancerBase(const HostSet& host_set, const HostSet* local_host_set,
                                    ClusterStats& stats, Runtime::Loader& runtime,
                                    Runtime::RandomGenerator& random)
     : stats_(stats), runtime_(runtime), random_(random), host_set_(host_set),
       local_host_set_(local_host_set) {
-  if (local_host_set_) {
-    host_set_.addMemberUpdateCb(
-        [this](const std::vector<HostSharedPtr>&, const std::vector<HostSharedPtr>&) -> void {
+  host_set_.addMemberUpdateCb(
+      [this](const std::vector<HostSharedPtr>&, const std::vector<HostSharedPtr>&) -> void {
+        regeneratePriorityStructures();
+        if (local_host_set_) {
           regenerateLocalityRoutingStructures();
-        });
+        }
+      });
+  if (local_host_set_) {
     local_host_set_member_update_cb_handle_ = local_host_set_->addMemberUpdateCb(
         [this](const std::vector<HostSharedPtr>&, const std::vector<HostSharedPtr>&) -> void {
           regenerateLocalityRoutingStructures();
         });
   }
+
+  regeneratePriorityStructures();
 }
 
 LoadBalancerBase::~LoadBalancerBase() {
@@ -106,6 +176,119 @@ void LoadBalancerBase::regenerateLocalityRoutingStructures() {
   }
 };
 
+void LoadBalancerBase::regeneratePriorityStructures() {
+  uint32_t max_priority = 0;
+  bool locality_weighted = false;
+  for (const HostSharedPtr& host : host_set_.hosts()) {
+    max_priority = std::max(max_priority, host->priority());
+    locality_weighted |= host->localityWeight() > 0;
+  }
+
+  priority_states_.clear();
+  priority_load_.clear();
+  priority_routing_ = max_priority > 0 || locality_weighted;
+  if (!priority_routing_) {
+    return;
+  }
+
+  // Group hosts by priority and, if locality weights are in use, by locality within each priority.
+  typedef std::tuple<std::string, std::string, std::string> LocalityKey;
+  std::vector<std::map<LocalityKey, LocalityState>> localities(max_priority + 1);
+  priority_states_.resize(max_priority + 1);
+  for (const HostSharedPtr& host : host_set_.hosts()) {
+    PriorityState& priority_state = priority_states_[host->priority()];
+    priority_state.hosts_.push_back(host);
+    if (host->healthy()) {
+      priority_state.healthy_hosts_.push_back(host);
+    }
+
+    if (locality_weighted) {
+      LocalityState& locality_state = localities[host->priority()][LocalityKey(
+          host->locality().region(), host->locality().zone(), host->locality().sub_zone())];
+      locality_state.hosts_.push_back(host);
+      if (host->healthy()) {
+        locality_state.healthy_hosts_.push_back(host);
+      }
+      locality_state.weight_ = std::max(locality_state.weight_, host->localityWeight());
+    }
+  }
+
+  // A priority level (or locality) is considered able to take its full share of traffic while the
+  // percentage of healthy hosts in it, multiplied by the overprovisioning factor, is at least
+  // 100%. Below that, traffic gradually spills over to the next priority level (or is spread over
+  // the other localities). For example with the default factor of 140%, a level keeps all traffic
+  // until ~72% of its hosts are healthy, and with 50% of hosts healthy it keeps 70% of traffic.
+  const uint64_t overprovisioning_factor =
+      runtime_.snapshot().getInteger(RuntimeOverprovisioningFactor, 140);
+  uint64_t remaining_load = 100;
+  uint64_t accumulated_load = 0;
+  for (size_t i = 0; i < priority_states_.size(); ++i) {
+    PriorityState& priority_state = priority_states_[i];
+    const uint64_t health = priority_state.hosts_.empty()
+                                ? 0
+                                : std::min<uint64_t>(100, overprovisioning_factor *
+                                                              priority_state.healthy_hosts_.size() /
+                                                              priority_state.hosts_.size());
+    const uint64_t load = std::min(remaining_load, health);
+    remaining_load -= load;
+    accumulated_load += load;
+    priority_load_.push_back(accumulated_load);
+
+    std::vector<double> effective_weights;
+    for (auto& entry : localities[i]) {
+      LocalityState& locality_state = entry.second;
+      const double locality_health =
+          std::min<double>(1.0, overprovisioning_factor / 100.0 *
+                                    locality_state.healthy_hosts_.size() /
+                                    locality_state.hosts_.size());
+      effective_weights.push_back(locality_state.weight_ * locality_health);
+      priority_state.localities_.emplace_back(std::move(locality_state));
+    }
+    priority_state.locality_picker_ = AliasTable(effective_weights);
+  }
+}
+
+const std::vector<HostSharedPtr>& LoadBalancerBase::choosePriorityLocalityHosts() {
+  ASSERT(priority_routing_);
+
+  // If no priority level has enough healthy hosts to take any load, there is nothing healthy to
+  // route to. The panic threshold has already been evaluated across all levels at this point.
+  const uint64_t total_load = priority_load_.back();
+  if (total_load == 0) {
+    return host_set_.healthyHosts();
+  }
+
+  // When the overall healthy capacity is below 100% the loads are normalized by picking within the
+  // accumulated total.
+  const uint64_t threshold = random_.random() % total_load;
+  size_t priority = 0;
+  while (threshold >= priority_load_[priority]) {
+    priority++;
+  }
+  if (priority > 0) {
+    stats_.lb_priority_spillover_.inc();
+  }
+
+  const PriorityState& priority_state = priority_states_[priority];
+  if (priority_state.locality_picker_.empty()) {
+    return priority_state.healthy_hosts_;
+  }
+
+  stats_.lb_locality_weighted_.inc();
+  const uint64_t random1 = random_.random();
+  const uint64_t random2 = random_.random();
+  const LocalityState& locality_state =
+      priority_state.localities_[priority_state.locality_picker_.pick(random1, random2)];
+
+  // Localities without healthy hosts have no effective weight, but guard against floating point
+  // error in the alias table.
+  if (locality_state.healthy_hosts_.empty()) {
+    return priority_state.healthy_hosts_;
+  }
+
+  return locality_state.healthy_hosts_;
+}
+
 bool LoadBalancerBase::earlyExitNonLocalityRouting() {
   if (host_set_.healthyHostsPerLocality().size() < 2) {
     return true;
@@ -217,6 +400,11 @@ const std::vector<HostSharedPtr>& LoadBalancerBase::hostsToUse() {
     return host_set_.hosts();
   }
 
+  // Locality weights and priority levels supplied by EDS take precedence over zone aware routing.
+  if (priority_routing_) {
+    return choosePriorityLocalityHosts();
+  }
+
   if (locality_routing_state_ == LocalityRoutingState::NoLocalityRouting) {
     return host_set_.healthyHosts();
   }
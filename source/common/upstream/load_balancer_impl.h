@@ -26,6 +26,34 @@ public:
   static bool isGlobalPanic(const HostSet& host_set, Runtime::Loader& runtime);
 };
 
+/**
+ * Weighted random selection in O(1) using Walker's alias method. The table is built once from a
+ * fixed set of weights in O(N) and each pick costs two random numbers.
+ */
+class AliasTable {
+public:
+  AliasTable() {}
+  AliasTable(const std::vector<double>& weights);
+
+  /**
+   * @return true if there is nothing to pick from, either because no weights were supplied or
+   *         because all of them are 0.
+   */
+  bool empty() const { return probability_.empty(); }
+
+  /**
+   * Pick an index with probability proportional to its weight.
+   * @param random1 supplies a random number used to choose a column.
+   * @param random2 supplies a random number used to choose between the column and its alias.
+   * @return the index of the chosen weight. Must not be called on an empty table.
+   */
+  size_t pick(uint64_t random1, uint64_t random2) const;
+
+private:
+  std::vector<double> probability_;
+  std::vector<size_t> alias_;
+};
+
 /**
  * Base class for all LB implementations.
  */
@@ -47,6 +75,25 @@ protected:
 private:
   enum class LocalityRoutingState { NoLocalityRouting, LocalityDirect, LocalityResidual };
 
+  /**
+   * Hosts of a single locality within a priority level.
+   */
+  struct LocalityState {
+    std::vector<HostSharedPtr> hosts_;
+    std::vector<HostSharedPtr> healthy_hosts_;
+    uint32_t weight_{};
+  };
+
+  /**
+   * Hosts of a single priority level along with the structures needed to pick a locality in O(1).
+   */
+  struct PriorityState {
+    std::vector<HostSharedPtr> hosts_;
+    std::vector<HostSharedPtr> healthy_hosts_;
+    std::vector<LocalityState> localities_;
+    AliasTable locality_picker_;
+  };
+
   /**
    * @return decision on quick exit from locality aware routing based on cluster configuration.
    * This gets recalculated on update callback.
@@ -72,12 +119,28 @@ private:
    */
   void regenerateLocalityRoutingStructures();
 
+  /**
+   * Regenerate per priority level and per locality structures. This is a no-op unless some hosts
+   * have a non-zero priority or a locality weight (as assigned by EDS).
+   */
+  void regeneratePriorityStructures();
+
+  /**
+   * Pick a priority level based on the healthy capacity of each level and then a locality within
+   * that level based on the locality weights.
+   */
+  const std::vector<HostSharedPtr>& choosePriorityLocalityHosts();
+
   const HostSet& host_set_;
   const HostSet* local_host_set_;
   uint64_t local_percent_to_route_{};
   LocalityRoutingState locality_routing_state_{LocalityRoutingState::NoLocalityRouting};
   std::vector<uint64_t> residual_capacity_;
   Common::CallbackHandle* local_host_set_member_update_cb_handle_{};
+  bool priority_routing_{};
+  std::vector<PriorityState> priority_states_;
+  // Accumulated share of traffic for each priority level, indexed like priority_states_.
+  std::vector<uint64_t> priority_load_;
 };
 
 /**
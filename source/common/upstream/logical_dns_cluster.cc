@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 
+#include "common/common/utility.h"
 #include "common/config/utility.h"
 #include "common/network/address_impl.h"
 #include "common/network/utility.h"
@@ -21,10 +22,11 @@ LogicalDnsCluster::LogicalDnsCluster(const envoy::api::v2::Cluster& cluster,
                                      Ssl::ContextManager& ssl_context_manager,
                                      Network::DnsResolverSharedPtr dns_resolver,
                                      ThreadLocal::SlotAllocator& tls, ClusterManager& cm,
-                                     Event::Dispatcher& dispatcher, bool added_via_api)
+                                     Event::Dispatcher& dispatcher,
+                                     Runtime::RandomGenerator& random, bool added_via_api)
     : ClusterImplBase(cluster, cm.sourceAddress(), runtime, stats, ssl_context_manager,
                       added_via_api),
-      dns_resolver_(dns_resolver),
+      dns_resolver_(dns_resolver), random_(random),
       dns_refresh_rate_ms_(
           std::chrono::milliseconds(PROTOBUF_GET_MS_OR_DEFAULT(cluster, dns_refresh_rate, 5000))),
       tls_(tls.allocateSlot()),
@@ -52,6 +54,7 @@ LogicalDnsCluster::LogicalDnsCluster(const envoy::api::v2::Cluster& cluster,
   dns_url_ = fmt::format("tcp://{}:{}", socket_address.address(), socket_address.port_value());
   hostname_ = Network::Utility::hostFromTcpUrl(dns_url_);
   Network::Utility::portFromTcpUrl(dns_url_);
+  dns_stats_.reset(new DnsTargetStats(generateDnsTargetStats(hostname_)));
 
   tls_->set([](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
     return std::make_shared<PerThreadCurrentHostData>();
@@ -70,14 +73,24 @@ void LogicalDnsCluster::startResolve() {
   std::string dns_address = Network::Utility::hostFromTcpUrl(dns_url_);
   ENVOY_LOG(debug, "starting async DNS resolution for {}", dns_address);
   info_->stats().update_attempt_.inc();
+  dns_stats_->resolve_total_.inc();
 
-  active_dns_query_ = dns_resolver_->resolve(
+  const MonotonicTime start_time = ProdMonotonicTimeSource::instance_.currentTime();
+  active_dns_query_ = dns_resolver_->resolveWithTtl(
       dns_address, dns_lookup_family_,
-      [this,
-       dns_address](std::list<Network::Address::InstanceConstSharedPtr>&& address_list) -> void {
+      [this, dns_address,
+       start_time](std::list<Network::Address::InstanceConstSharedPtr>&& address_list,
+                   const Optional<std::chrono::seconds>& ttl) -> void {
         active_dns_query_ = nullptr;
         ENVOY_LOG(debug, "async DNS resolution complete for {}", dns_address);
         info_->stats().update_success_.inc();
+        dns_stats_->resolve_latency_ms_.recordValue(
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                ProdMonotonicTimeSource::instance_.currentTime() - start_time)
+                .count());
+        if (address_list.empty()) {
+          dns_stats_->resolve_failure_.inc();
+        }
 
         if (!address_list.empty()) {
           // TODO(mattklein123): Move port handling into the DNS interface.
@@ -116,7 +129,10 @@ void LogicalDnsCluster::startResolve() {
         }
 
         onPreInitComplete();
-        resolve_timer_->enableTimer(dns_refresh_rate_ms_);
+        const std::chrono::milliseconds interval =
+            dnsRefreshInterval(runtime_, random_, dns_refresh_rate_ms_, ttl);
+        dns_stats_->refresh_interval_ms_.set(interval.count());
+        resolve_timer_->enableTimer(interval);
       });
 }
 
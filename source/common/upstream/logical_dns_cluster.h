@@ -3,6 +3,7 @@
 #include <chrono>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
 
 #include "envoy/thread_local/thread_local.h"
@@ -31,7 +32,8 @@ public:
   LogicalDnsCluster(const envoy::api::v2::Cluster& cluster, Runtime::Loader& runtime,
                     Stats::Store& stats, Ssl::ContextManager& ssl_context_manager,
                     Network::DnsResolverSharedPtr dns_resolver, ThreadLocal::SlotAllocator& tls,
-                    ClusterManager& cm, Event::Dispatcher& dispatcher, bool added_via_api);
+                    ClusterManager& cm, Event::Dispatcher& dispatcher,
+                    Runtime::RandomGenerator& random, bool added_via_api);
 
   ~LogicalDnsCluster();
 
@@ -69,6 +71,7 @@ private:
     Outlier::DetectorHostMonitor& outlierDetector() const override {
       return logical_host_->outlierDetector();
     }
+    LatencyHostMonitor& latencyMonitor() const override { return logical_host_->latencyMonitor(); }
     const HostStats& stats() const override { return logical_host_->stats(); }
     const std::string& hostname() const override { return logical_host_->hostname(); }
     Network::Address::InstanceConstSharedPtr address() const override { return address_; }
@@ -90,6 +93,7 @@ private:
   void startPreInit() override;
 
   Network::DnsResolverSharedPtr dns_resolver_;
+  Runtime::RandomGenerator& random_;
   const std::chrono::milliseconds dns_refresh_rate_ms_;
   Network::DnsLookupFamily dns_lookup_family_;
   ThreadLocal::SlotPtr tls_;
@@ -99,6 +103,7 @@ private:
   Network::Address::InstanceConstSharedPtr current_resolved_address_;
   HostSharedPtr logical_host_;
   Network::ActiveDnsQuery* active_dns_query_{};
+  std::unique_ptr<DnsTargetStats> dns_stats_;
 };
 
 } // namespace Upstream
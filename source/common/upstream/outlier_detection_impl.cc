@@ -1,5 +1,7 @@
 #include "common/upstream/outlier_detection_impl.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <memory>
@@ -41,13 +43,10 @@ void DetectorHostMonitorImpl::uneject(MonotonicTime unejection_time) {
   last_unejection_time_.value(unejection_time);
 }
 
-void DetectorHostMonitorImpl::updateCurrentSuccessRateBucket() {
-  success_rate_accumulator_bucket_.store(success_rate_accumulator_.updateCurrentWriter());
-}
-
 void DetectorHostMonitorImpl::putHttpResponseCode(uint64_t response_code) {
-  success_rate_accumulator_bucket_.load()->total_request_counter_++;
-  if (Http::CodeUtility::is5xx(response_code)) {
+  const bool is_5xx = Http::CodeUtility::is5xx(response_code);
+  accumulator_.recordResponse(!is_5xx);
+  if (is_5xx) {
     std::shared_ptr<DetectorImpl> detector = detector_.lock();
     if (!detector) {
       // It's possible for the cluster/detector to go away while we still have a host in use.
@@ -60,7 +59,6 @@ void DetectorHostMonitorImpl::putHttpResponseCode(uint64_t response_code) {
       detector->onConsecutive5xx(host_.lock());
     }
   } else {
-    success_rate_accumulator_bucket_.load()->success_request_counter_++;
     consecutive_5xx_ = 0;
   }
 }
@@ -136,6 +134,7 @@ void DetectorImpl::initialize(const Cluster& cluster) {
     }
   });
 
+  sub_windows_ = subWindows();
   armIntervalTimer();
 }
 
@@ -147,8 +146,16 @@ void DetectorImpl::addHostMonitor(HostSharedPtr host) {
 }
 
 void DetectorImpl::armIntervalTimer() {
-  interval_timer_->enableTimer(std::chrono::milliseconds(
-      runtime_.snapshot().getInteger("outlier_detection.interval_ms", config_.intervalMs())));
+  // The timer fires once per sub-window. Evaluation happens on every fire, over the full window.
+  const uint64_t interval_ms =
+      runtime_.snapshot().getInteger("outlier_detection.interval_ms", config_.intervalMs());
+  interval_timer_->enableTimer(
+      std::chrono::milliseconds(std::max<uint64_t>(1, interval_ms / sub_windows_)));
+}
+
+uint32_t DetectorImpl::subWindows() {
+  const uint64_t sub_windows = runtime_.snapshot().getInteger("outlier_detection.sub_windows", 1);
+  return std::max<uint64_t>(1, std::min<uint64_t>(MAX_SUB_WINDOWS, sub_windows));
 }
 
 void DetectorImpl::checkHostForUneject(HostSharedPtr host, DetectorHostMonitorImpl* monitor,
@@ -165,6 +172,8 @@ void DetectorImpl::checkHostForUneject(HostSharedPtr host, DetectorHostMonitorIm
     stats_.ejections_active_.dec();
     host->healthFlagClear(Host::HealthFlag::FAILED_OUTLIER_CHECK);
     monitor->uneject(now);
+    // Whatever the host did before or while it was ejected should not count against it again.
+    monitor->accumulator().clear();
     runCallbacks(host);
 
     if (event_logger_) {
@@ -181,6 +190,8 @@ bool DetectorImpl::enforceEjection(EjectionType type) {
   case EjectionType::SuccessRate:
     return runtime_.snapshot().featureEnabled("outlier_detection.enforcing_success_rate",
                                               config_.enforcingSuccessRate());
+  case EjectionType::Latency:
+    return runtime_.snapshot().featureEnabled("outlier_detection.enforcing_latency", 100);
   }
 
   NOT_REACHED;
@@ -312,7 +323,7 @@ void DetectorImpl::processSuccessRateEjections() {
     // Don't do work if the host is already ejected.
     if (!host.first->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK)) {
       Optional<double> host_success_rate =
-          host.second->successRateAccumulator().getSuccessRate(success_rate_request_volume);
+          host.second->accumulator().getSuccessRate(success_rate_request_volume);
 
       if (host_success_rate.valid()) {
         valid_success_rate_hosts.emplace_back(
@@ -341,20 +352,68 @@ void DetectorImpl::processSuccessRateEjections() {
   }
 }
 
+void DetectorImpl::processLatencyEjections() {
+  // Latency ejection has no config in the API yet so it is runtime only and off by default. A host
+  // is ejected if its p99 over the window is more than factor times the median p99 of the cluster.
+  const uint64_t latency_factor =
+      runtime_.snapshot().getInteger("outlier_detection.latency_p99_factor", 0);
+  if (latency_factor == 0) {
+    return;
+  }
+
+  const uint64_t minimum_hosts = runtime_.snapshot().getInteger(
+      "outlier_detection.success_rate_minimum_hosts", config_.successRateMinimumHosts());
+  const uint64_t request_volume = runtime_.snapshot().getInteger(
+      "outlier_detection.success_rate_request_volume", config_.successRateRequestVolume());
+  if (host_monitors_.size() < minimum_hosts) {
+    return;
+  }
+
+  std::vector<std::pair<HostSharedPtr, double>> host_p99s;
+  host_p99s.reserve(host_monitors_.size());
+  for (const auto& host : host_monitors_) {
+    if (!host.first->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK)) {
+      Optional<double> p99 = host.second->accumulator().getLatencyPercentile(0.99, request_volume);
+      if (p99.valid()) {
+        host_p99s.emplace_back(host.first, p99.value());
+      }
+    }
+  }
+
+  if (host_p99s.empty() || host_p99s.size() < minimum_hosts) {
+    return;
+  }
+
+  std::vector<double> p99s;
+  p99s.reserve(host_p99s.size());
+  for (const auto& host_p99 : host_p99s) {
+    p99s.push_back(host_p99.second);
+  }
+  std::nth_element(p99s.begin(), p99s.begin() + p99s.size() / 2, p99s.end());
+  const double threshold = p99s[p99s.size() / 2] * (latency_factor / 1000.0);
+  for (const auto& host_p99 : host_p99s) {
+    if (host_p99.second > threshold) {
+      stats_.ejections_latency_.inc();
+      ejectHost(host_p99.first, EjectionType::Latency);
+    }
+  }
+}
+
 void DetectorImpl::onIntervalTimer() {
   MonotonicTime now = time_source_.currentTime();
+  sub_windows_ = subWindows();
 
   for (auto host : host_monitors_) {
     checkHostForUneject(host.first, host.second, now);
 
-    // Need to update the writer bucket to keep the data valid.
-    host.second->updateCurrentSuccessRateBucket();
+    host.second->accumulator().closeSubWindow(sub_windows_);
     // Refresh host success rate stat for the /clusters endpoint. If there is a new valid value, it
     // will get updated in processSuccessRateEjections().
     host.second->successRate(-1);
   }
 
   processSuccessRateEjections();
+  processLatencyEjections();
 
   armIntervalTimer();
 }
@@ -401,6 +460,7 @@ void EventLoggerImpl::logEject(HostDescriptionConstSharedPtr host, Detector& det
 
   switch (type) {
   case EjectionType::Consecutive5xx:
+  case EjectionType::Latency:
     file_->write(fmt::format(
         json_5xx, AccessLogDateTimeFormatter::fromTime(now),
         secsSinceLastAction(host->outlierDetector().lastUnejectionTime(), monotonic_now),
@@ -445,6 +505,8 @@ std::string EventLoggerImpl::typeToString(EjectionType type) {
     return "5xx";
   case EjectionType::SuccessRate:
     return "SuccessRate";
+  case EjectionType::Latency:
+    return "Latency";
   }
 
   NOT_REACHED;
@@ -458,23 +520,147 @@ int EventLoggerImpl::secsSinceLastAction(const Optional<MonotonicTime>& lastActi
   return -1;
 }
 
-SuccessRateAccumulatorBucket* SuccessRateAccumulator::updateCurrentWriter() {
-  // Right now current is being written to and backup is not. Flush the backup and swap.
-  backup_success_rate_bucket_->success_request_counter_ = 0;
-  backup_success_rate_bucket_->total_request_counter_ = 0;
+void SlidingWindowAccumulator::Window::add(const Window& other) {
+  success_request_counter_ += other.success_request_counter_;
+  total_request_counter_ += other.total_request_counter_;
+  for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+    latency_buckets_[i] += other.latency_buckets_[i];
+  }
+}
+
+void SlidingWindowAccumulator::Window::subtract(const Window& other) {
+  success_request_counter_ -= other.success_request_counter_;
+  total_request_counter_ -= other.total_request_counter_;
+  for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+    latency_buckets_[i] -= other.latency_buckets_[i];
+  }
+}
+
+SlidingWindowAccumulator::~SlidingWindowAccumulator() {
+  for (std::atomic<Stripe*>& stripe : stripes_) {
+    delete stripe.load();
+  }
+}
+
+SlidingWindowAccumulator::Stripe& SlidingWindowAccumulator::threadStripe() {
+  static std::atomic<uint32_t> next_thread{0};
+  static thread_local const uint32_t thread = next_thread++ % MAX_STRIPES;
+  std::atomic<Stripe*>& stripe_ref = stripes_[thread];
+  Stripe* stripe = stripe_ref.load(std::memory_order_acquire);
+  if (stripe == nullptr) {
+    // Only threads that share a number can race to allocate the stripe.
+    Stripe* new_stripe = new Stripe();
+    if (stripe_ref.compare_exchange_strong(stripe, new_stripe, std::memory_order_acq_rel)) {
+      stripe = new_stripe;
+    } else {
+      delete new_stripe;
+    }
+  }
+  return *stripe;
+}
 
-  current_success_rate_bucket_.swap(backup_success_rate_bucket_);
+uint32_t SlidingWindowAccumulator::latencyBucket(uint64_t response_time_ms) {
+  uint32_t bucket = 0;
+  while (response_time_ms > 0 && bucket < LATENCY_BUCKETS - 1) {
+    response_time_ms >>= 1;
+    bucket++;
+  }
 
-  return current_success_rate_bucket_.get();
+  return bucket;
 }
 
-Optional<double> SuccessRateAccumulator::getSuccessRate(uint64_t success_rate_request_volume) {
-  if (backup_success_rate_bucket_->total_request_counter_ < success_rate_request_volume) {
+void SlidingWindowAccumulator::recordResponse(bool success) {
+  Stripe& stripe = threadStripe();
+  stripe.total_request_counter_.fetch_add(1, std::memory_order_relaxed);
+  if (success) {
+    stripe.success_request_counter_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void SlidingWindowAccumulator::recordResponseTime(std::chrono::milliseconds response_time) {
+  const uint32_t bucket = latencyBucket(std::max<int64_t>(0, response_time.count()));
+  threadStripe().latency_buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+SlidingWindowAccumulator::Window SlidingWindowAccumulator::cumulative() const {
+  Window window;
+  for (const std::atomic<Stripe*>& stripe_ref : stripes_) {
+    const Stripe* stripe = stripe_ref.load(std::memory_order_acquire);
+    if (stripe == nullptr) {
+      continue;
+    }
+    window.success_request_counter_ +=
+        stripe->success_request_counter_.load(std::memory_order_relaxed);
+    window.total_request_counter_ += stripe->total_request_counter_.load(std::memory_order_relaxed);
+    for (uint32_t j = 0; j < LATENCY_BUCKETS; j++) {
+      window.latency_buckets_[j] += stripe->latency_buckets_[j].load(std::memory_order_relaxed);
+    }
+  }
+
+  return window;
+}
+
+void SlidingWindowAccumulator::closeSubWindow(uint32_t sub_windows) {
+  ASSERT(sub_windows > 0);
+  Window current = cumulative();
+  Window sub_window = current;
+  sub_window.subtract(last_cumulative_);
+  last_cumulative_ = current;
+
+  // The stripes are updated without ordering between the success and total counters, so a
+  // sub-window could briefly see a success without its total. Clamp rather than report > 100%.
+  sub_window.success_request_counter_ =
+      std::min(sub_window.success_request_counter_, sub_window.total_request_counter_);
+
+  sub_windows_.push_back(sub_window);
+  window_.add(sub_window);
+  while (sub_windows_.size() > sub_windows) {
+    window_.subtract(sub_windows_.front());
+    sub_windows_.pop_front();
+  }
+}
+
+void SlidingWindowAccumulator::clear() {
+  sub_windows_.clear();
+  window_ = Window();
+}
+
+Optional<double>
+SlidingWindowAccumulator::getSuccessRate(uint64_t success_rate_request_volume) const {
+  if (window_.total_request_counter_ == 0 ||
+      window_.total_request_counter_ < success_rate_request_volume) {
+    return Optional<double>();
+  }
+
+  return Optional<double>(window_.success_request_counter_ * 100.0 /
+                          window_.total_request_counter_);
+}
+
+Optional<double> SlidingWindowAccumulator::getLatencyPercentile(double percentile,
+                                                                 uint64_t request_volume) const {
+  uint64_t total = 0;
+  for (uint64_t count : window_.latency_buckets_) {
+    total += count;
+  }
+  if (total == 0 || total < request_volume) {
     return Optional<double>();
   }
 
-  return Optional<double>(backup_success_rate_bucket_->success_request_counter_ * 100.0 /
-                          backup_success_rate_bucket_->total_request_counter_);
+  const double rank = percentile * total;
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+    const uint64_t count = window_.latency_buckets_[i];
+    if (count > 0 && seen + count >= rank) {
+      // Bucket i holds [2^(i-1), 2^i) ms (bucket 0 holds 0 ms). The last bucket is open ended and
+      // is treated as one more doubling.
+      const double lower = i == 0 ? 0 : static_cast<double>(1ULL << (i - 1));
+      const double upper = i == 0 ? 1 : static_cast<double>(1ULL << i);
+      return Optional<double>(lower + (upper - lower) * (rank - seen) / count);
+    }
+    seen += count;
+  }
+
+  NOT_REACHED;
 }
 
 } // namespace Outlier
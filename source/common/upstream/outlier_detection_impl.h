@@ -1,8 +1,10 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <deque>
 #include <list>
 #include <memory>
 #include <string>
@@ -59,41 +61,99 @@ struct HostSuccessRatePair {
   double success_rate_;
 };
 
-struct SuccessRateAccumulatorBucket {
-  std::atomic<uint64_t> success_request_counter_;
-  std::atomic<uint64_t> total_request_counter_;
-};
-
 /**
- * The SuccessRateAccumulator uses the SuccessRateAccumulatorBucket to get per host success rate
- * stats. This implementation has a fixed window size of time, and thus only needs a
- * bucket to write to, and a bucket to accumulate/run stats over.
+ * Sliding window request accumulator for a single host. Workers record responses into per thread
+ * stripes of cumulative counters. A thread's stripe is allocated the first time it records a
+ * response for the host, so there is one stripe per worker whatever the concurrency. Stripes are
+ * padded so that workers recording responses for the same host never write to the same cache
+ * line, and workers never swap or reset anything. The main thread closes a sub-window on every
+ * detector interval by taking the difference of the summed counters since the last close, and
+ * keeps the last N sub-windows. Success rate and latency percentiles are computed over the sum of
+ * those sub-windows.
  */
-class SuccessRateAccumulator {
+class SlidingWindowAccumulator {
 public:
-  SuccessRateAccumulator()
-      : current_success_rate_bucket_(new SuccessRateAccumulatorBucket()),
-        backup_success_rate_bucket_(new SuccessRateAccumulatorBucket()) {}
+  // Threads are numbered the first time they record a response. Up to this many threads each get
+  // a stripe of their own, more share stripes.
+  static const uint32_t MAX_STRIPES = 128;
+  // Response time buckets are powers of two in ms: [0, 1), [1, 2), [2, 4), ..., [16384, inf).
+  static const uint32_t LATENCY_BUCKETS = 16;
+
+  struct Window {
+    void add(const Window& other);
+    void subtract(const Window& other);
+
+    uint64_t success_request_counter_{};
+    uint64_t total_request_counter_{};
+    std::array<uint64_t, LATENCY_BUCKETS> latency_buckets_{};
+  };
+
+  SlidingWindowAccumulator() {}
+  ~SlidingWindowAccumulator();
 
   /**
-   * This function updates the bucket to write data to.
-   * @return a pointer to the SuccessRateAccumulatorBucket.
+   * Record a response. Called from any thread.
+   * @param success supplies whether the response counts as a success.
    */
-  SuccessRateAccumulatorBucket* updateCurrentWriter();
+  void recordResponse(bool success);
+
   /**
-   * This function returns the success rate of a host over a window of time if the request volume is
-   * high enough. The underlying window of time could be dynamically adjusted. In the current
-   * implementation it is a fixed time window.
+   * Record a response time. Called from any thread.
+   */
+  void recordResponseTime(std::chrono::milliseconds response_time);
+
+  /**
+   * Close the current sub-window and drop sub-windows that have fallen out of the window. Called
+   * from the main thread only.
+   * @param sub_windows supplies the number of sub-windows that make up the window.
+   */
+  void closeSubWindow(uint32_t sub_windows);
+
+  /**
+   * Forget all closed sub-windows. Data recorded since the last close is kept.
+   */
+  void clear();
+
+  /**
+   * This function returns the success rate of a host over the window if the request volume is
+   * high enough.
    * @param success_rate_request_volume the threshold of requests an accumulator has to have in
    *                                    order to be able to return a significant success rate value.
    * @return a valid Optional<double> with the success rate. If there were not enough requests, an
    *         invalid Optional<double> is returned.
    */
-  Optional<double> getSuccessRate(uint64_t success_rate_request_volume);
+  Optional<double> getSuccessRate(uint64_t success_rate_request_volume) const;
+
+  /**
+   * @param percentile supplies the percentile to compute, in [0, 1].
+   * @param request_volume supplies the number of response times needed for a significant value.
+   * @return the estimated response time percentile in ms over the window, or an invalid Optional
+   *         if there were not enough response times. The estimate interpolates within a bucket.
+   */
+  Optional<double> getLatencyPercentile(double percentile, uint64_t request_volume) const;
+
+  static uint32_t latencyBucket(uint64_t response_time_ms);
 
 private:
-  std::unique_ptr<SuccessRateAccumulatorBucket> current_success_rate_bucket_;
-  std::unique_ptr<SuccessRateAccumulatorBucket> backup_success_rate_bucket_;
+  static const size_t CACHE_LINE_SIZE = 64;
+
+  struct Stripe {
+    std::atomic<uint64_t> success_request_counter_{};
+    std::atomic<uint64_t> total_request_counter_{};
+    std::array<std::atomic<uint64_t>, LATENCY_BUCKETS> latency_buckets_{};
+    // Keeps the counters of adjacent stripes at least a cache line apart.
+    uint8_t padding_[CACHE_LINE_SIZE];
+  };
+
+  Stripe& threadStripe();
+  Window cumulative() const;
+
+  // Indexed by thread number. A stripe is never freed before the accumulator.
+  std::array<std::atomic<Stripe*>, MAX_STRIPES> stripes_{};
+  // Main thread only.
+  Window last_cumulative_;
+  std::deque<Window> sub_windows_;
+  Window window_;
 };
 
 class DetectorImpl;
@@ -104,22 +164,20 @@ class DetectorImpl;
 class DetectorHostMonitorImpl : public DetectorHostMonitor {
 public:
   DetectorHostMonitorImpl(std::shared_ptr<DetectorImpl> detector, HostSharedPtr host)
-      : detector_(detector), host_(host), success_rate_(-1) {
-    // Point the success_rate_accumulator_bucket_ pointer to a bucket.
-    updateCurrentSuccessRateBucket();
-  }
+      : detector_(detector), host_(host), success_rate_(-1) {}
 
   void eject(MonotonicTime ejection_time);
   void uneject(MonotonicTime ejection_time);
-  void updateCurrentSuccessRateBucket();
-  SuccessRateAccumulator& successRateAccumulator() { return success_rate_accumulator_; }
+  SlidingWindowAccumulator& accumulator() { return accumulator_; }
   void successRate(double new_success_rate) { success_rate_ = new_success_rate; }
   void resetConsecutive5xx() { consecutive_5xx_ = 0; }
 
   // Upstream::Outlier::DetectorHostMonitor
   uint32_t numEjections() override { return num_ejections_; }
   void putHttpResponseCode(uint64_t response_code) override;
-  void putResponseTime(std::chrono::milliseconds) override {}
+  void putResponseTime(std::chrono::milliseconds response_time) override {
+    accumulator_.recordResponseTime(response_time);
+  }
   const Optional<MonotonicTime>& lastEjectionTime() override { return last_ejection_time_; }
   const Optional<MonotonicTime>& lastUnejectionTime() override { return last_unejection_time_; }
   double successRate() const override { return success_rate_; }
@@ -131,8 +189,7 @@ private:
   Optional<MonotonicTime> last_ejection_time_;
   Optional<MonotonicTime> last_unejection_time_;
   uint32_t num_ejections_{};
-  SuccessRateAccumulator success_rate_accumulator_;
-  std::atomic<SuccessRateAccumulatorBucket*> success_rate_accumulator_bucket_;
+  SlidingWindowAccumulator accumulator_;
   double success_rate_;
 };
 
@@ -145,7 +202,8 @@ private:
   GAUGE  (ejections_active)                                                                        \
   COUNTER(ejections_overflow)                                                                      \
   COUNTER(ejections_consecutive_5xx)                                                               \
-  COUNTER(ejections_success_rate)
+  COUNTER(ejections_success_rate)                                                                  \
+  COUNTER(ejections_latency)
 // clang-format on
 
 /**
@@ -211,6 +269,9 @@ private:
                Event::Dispatcher& dispatcher, Runtime::Loader& runtime,
                MonotonicTimeSource& time_source, EventLoggerSharedPtr event_logger);
 
+  // Upper bound for the "outlier_detection.sub_windows" runtime key.
+  static const uint32_t MAX_SUB_WINDOWS = 60;
+
   void addHostMonitor(HostSharedPtr host);
   void armIntervalTimer();
   void checkHostForUneject(HostSharedPtr host, DetectorHostMonitorImpl* monitor, MonotonicTime now);
@@ -222,6 +283,8 @@ private:
   void runCallbacks(HostSharedPtr host);
   bool enforceEjection(EjectionType type);
   void processSuccessRateEjections();
+  void processLatencyEjections();
+  uint32_t subWindows();
 
   DetectorConfig config_;
   Event::Dispatcher& dispatcher_;
@@ -234,6 +297,7 @@ private:
   EventLoggerSharedPtr event_logger_;
   double success_rate_average_;
   double success_rate_ejection_threshold_;
+  uint32_t sub_windows_{1};
 };
 
 class EventLoggerImpl : public EventLogger {
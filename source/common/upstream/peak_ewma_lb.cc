@@ -0,0 +1,72 @@
+#include "common/upstream/peak_ewma_lb.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Envoy {
+namespace Upstream {
+
+static const std::string RuntimePenalty = "upstream.peak_ewma.penalty_ms";
+
+const std::chrono::milliseconds PeakEwmaLatencyMonitor::DEFAULT_DECAY_TIME{10000};
+
+double PeakEwmaLatencyMonitor::decayWeight(MonotonicTime now) {
+  const int64_t elapsed_ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(now - last_update_).count();
+  return elapsed_ms > 0 ? std::exp(-elapsed_ms / decay_time_ms_) : 1.0;
+}
+
+void PeakEwmaLatencyMonitor::putResponseTime(std::chrono::milliseconds time) {
+  const MonotonicTime now = time_source_.currentTime();
+  const double rtt = time.count();
+
+  std::unique_lock<std::mutex> lock(lock_);
+  if (rtt > ewma_) {
+    // Peak sensitivity: a slower response immediately becomes the new estimate.
+    ewma_ = rtt;
+  } else {
+    const double w = decayWeight(now);
+    ewma_ = ewma_ * w + rtt * (1.0 - w);
+  }
+  last_update_ = now;
+}
+
+double PeakEwmaLatencyMonitor::latencyEstimate() {
+  const MonotonicTime now = time_source_.currentTime();
+
+  std::unique_lock<std::mutex> lock(lock_);
+  return ewma_ * decayWeight(now);
+}
+
+double PeakEwmaLoadBalancer::cost(const Host& host, uint64_t penalty) {
+  const uint64_t active = host.stats().rq_active_.value();
+  double latency = host.latencyMonitor().latencyEstimate();
+  if (latency == 0 && active > 0) {
+    latency = penalty;
+  }
+
+  // The +1 keeps hosts without a latency estimate comparable by their outstanding requests.
+  return (latency + 1) * (active + 1);
+}
+
+HostConstSharedPtr PeakEwmaLoadBalancer::chooseHost(LoadBalancerContext*) {
+  const std::vector<HostSharedPtr>& hosts_to_use = hostsToUse();
+  if (hosts_to_use.empty()) {
+    return nullptr;
+  }
+
+  const uint64_t penalty = runtime_.snapshot().getInteger(RuntimePenalty, 1000);
+  const HostSharedPtr& host1 = hosts_to_use[random_.random() % hosts_to_use.size()];
+  const HostSharedPtr& host2 = hosts_to_use[random_.random() % hosts_to_use.size()];
+  if (cost(*host1, penalty) <= cost(*host2, penalty)) {
+    return host1;
+  } else {
+    return host2;
+  }
+}
+
+} // namespace Upstream
+} // namespace Envoy
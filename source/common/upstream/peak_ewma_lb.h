@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+#include "envoy/common/time.h"
+#include "envoy/runtime/runtime.h"
+#include "envoy/upstream/latency_host_monitor.h"
+#include "envoy/upstream/load_balancer.h"
+#include "envoy/upstream/upstream.h"
+
+#include "common/upstream/load_balancer_impl.h"
+
+namespace Envoy {
+namespace Upstream {
+
+/**
+ * Implementation of LatencyHostMonitor that keeps a peak sensitive exponentially weighted moving
+ * average ("peak EWMA") of observed response times. A response time larger than the current
+ * estimate replaces it immediately, so slow hosts are penalized right away, while smaller response
+ * times are blended in with a weight that depends on the time elapsed since the last observation.
+ * When no response times are observed the estimate decays towards 0 so that idle hosts are
+ * eventually probed again.
+ */
+class PeakEwmaLatencyMonitor : public LatencyHostMonitor {
+public:
+  PeakEwmaLatencyMonitor(MonotonicTimeSource& time_source,
+                         std::chrono::milliseconds decay_time = DEFAULT_DECAY_TIME)
+      : time_source_(time_source), decay_time_ms_(decay_time.count()) {}
+
+  // Upstream::LatencyHostMonitor
+  void putResponseTime(std::chrono::milliseconds time) override;
+  double latencyEstimate() override;
+
+  static const std::chrono::milliseconds DEFAULT_DECAY_TIME;
+
+private:
+  double decayWeight(MonotonicTime now);
+
+  MonotonicTimeSource& time_source_;
+  const double decay_time_ms_;
+  std::mutex lock_;
+  double ewma_{};
+  MonotonicTime last_update_;
+};
+
+/**
+ * Latency aware load balancer. Two healthy hosts are picked at random and the one with the lowest
+ * cost is chosen ("power of two choices"). The cost of a host is its peak EWMA latency estimate
+ * (@see PeakEwmaLatencyMonitor) weighted by the number of outstanding requests to it. Hosts that
+ * have outstanding requests but no latency estimate yet are charged a configurable penalty so that
+ * newly added hosts are not flooded before the first response comes back.
+ *
+ * Host weights are not taken into account.
+ */
+class PeakEwmaLoadBalancer : public LoadBalancer, LoadBalancerBase {
+public:
+  PeakEwmaLoadBalancer(const HostSet& host_set, const HostSet* local_host_set, ClusterStats& stats,
+                       Runtime::Loader& runtime, Runtime::RandomGenerator& random)
+      : LoadBalancerBase(host_set, local_host_set, stats, runtime, random) {}
+
+  // Upstream::LoadBalancer
+  HostConstSharedPtr chooseHost(LoadBalancerContext* context) override;
+
+private:
+  double cost(const Host& host, uint64_t penalty);
+};
+
+} // namespace Upstream
+} // namespace Envoy
@@ -9,6 +9,7 @@
 #include "common/config/well_known_names.h"
 #include "common/protobuf/utility.h"
 #include "common/upstream/load_balancer_impl.h"
+#include "common/upstream/peak_ewma_lb.h"
 #include "common/upstream/ring_hash_lb.h"
 
 #include "api/cds.pb.h"
@@ -325,6 +326,11 @@ void SubsetLoadBalancer::LbSubsetEntry::initLoadBalancer(const SubsetLoadBalance
                                            subset_lb.random_));
     break;
 
+  case LoadBalancerType::PeakEwma:
+    lb_.reset(new PeakEwmaLoadBalancer(*host_subset_, subset_lb.original_local_host_set_,
+                                       subset_lb.stats_, subset_lb.runtime_, subset_lb.random_));
+    break;
+
   case LoadBalancerType::Random:
     lb_.reset(new RandomLoadBalancer(*host_subset_, subset_lb.original_local_host_set_,
                                      subset_lb.stats_, subset_lb.runtime_, subset_lb.random_));
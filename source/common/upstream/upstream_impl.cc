@@ -1,10 +1,12 @@
 #include "common/upstream/upstream_impl.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <list>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -82,12 +84,26 @@ ClusterInfoImpl::ClusterInfoImpl(const envoy::api::v2::Cluster& config,
     : runtime_(runtime), name_(config.name()),
       max_requests_per_connection_(
           PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, max_requests_per_connection, 0)),
+      // The v2 cluster config has no connection lifetime or prefetch settings yet so they come
+      // from runtime.
+      idle_timeout_(
+          runtime.snapshot().getInteger(fmt::format("upstream.idle_timeout_ms.{}", name_), 0)),
+      max_connection_duration_(runtime.snapshot().getInteger(
+          fmt::format("upstream.max_connection_duration_ms.{}", name_), 0)),
+      prefetch_min_idle_connections_(
+          runtime.snapshot().getInteger("upstream.prefetch.min_idle_connections", 0)),
+      prefetch_ratio_percent_(runtime.snapshot().getInteger("upstream.prefetch.ratio_percent", 0)),
       connect_timeout_(
           std::chrono::milliseconds(PROTOBUF_GET_MS_REQUIRED(config, connect_timeout))),
       per_connection_buffer_limit_bytes_(
           PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, per_connection_buffer_limit_bytes, 1024 * 1024)),
       stats_scope_(stats.createScope(fmt::format("cluster.{}.", name_))),
-      stats_(generateStats(*stats_scope_)),
+      compact_stats_scope_(
+          runtime.snapshot().featureEnabled("upstream.compact_cluster_stats", 0)
+              ? new Stats::LazyScopeImpl(
+                    *stats_scope_, stats.gauge("cluster_manager.compact_cluster_stats_pending"))
+              : nullptr),
+      stats_(generateStats(compact_stats_scope_ ? *compact_stats_scope_ : *stats_scope_)),
       load_report_stats_(generateLoadReportStats(load_report_stats_store_)),
       features_(parseFeatures(config)),
       http2_settings_(Http::Utility::parseHttp2Settings(config.http2_protocol_options())),
@@ -106,7 +122,13 @@ ClusterInfoImpl::ClusterInfoImpl(const envoy::api::v2::Cluster& config,
     lb_type_ = LoadBalancerType::RoundRobin;
     break;
   case envoy::api::v2::Cluster::LEAST_REQUEST:
-    lb_type_ = LoadBalancerType::LeastRequest;
+    // Latency aware balancing is a refinement of least request balancing and is opted into per
+    // cluster via runtime. The key is only read when the cluster is created, since hosts only
+    // track latency in clusters that balance on it. Changing it takes effect on the next update of
+    // the cluster.
+    lb_type_ = runtime.snapshot().getInteger(fmt::format("upstream.peak_ewma.{}", name_), 0) != 0
+                   ? LoadBalancerType::PeakEwma
+                   : LoadBalancerType::LeastRequest;
     break;
   case envoy::api::v2::Cluster::RANDOM:
     lb_type_ = LoadBalancerType::Random;
@@ -137,7 +159,8 @@ ClusterSharedPtr ClusterImplBase::create(const envoy::api::v2::Cluster& cluster,
                                          Event::Dispatcher& dispatcher,
                                          const LocalInfo::LocalInfo& local_info,
                                          Outlier::EventLoggerSharedPtr outlier_event_logger,
-                                         bool added_via_api) {
+                                         bool added_via_api,
+                                         HealthCheckShardPool* health_check_shard_pool) {
   std::unique_ptr<ClusterImplBase> new_cluster;
 
   // We make this a shared pointer to deal with the distinct ownership
@@ -164,12 +187,12 @@ ClusterSharedPtr ClusterImplBase::create(const envoy::api::v2::Cluster& cluster,
     break;
   case envoy::api::v2::Cluster::STRICT_DNS:
     new_cluster.reset(new StrictDnsClusterImpl(cluster, runtime, stats, ssl_context_manager,
-                                               selected_dns_resolver, cm, dispatcher,
+                                               selected_dns_resolver, cm, dispatcher, random,
                                                added_via_api));
     break;
   case envoy::api::v2::Cluster::LOGICAL_DNS:
     new_cluster.reset(new LogicalDnsCluster(cluster, runtime, stats, ssl_context_manager,
-                                            selected_dns_resolver, tls, cm, dispatcher,
+                                            selected_dns_resolver, tls, cm, dispatcher, random,
                                             added_via_api));
     break;
   case envoy::api::v2::Cluster::ORIGINAL_DST:
@@ -200,8 +223,9 @@ ClusterSharedPtr ClusterImplBase::create(const envoy::api::v2::Cluster& cluster,
   if (!cluster.health_checks().empty()) {
     // TODO(htuch): Need to support multiple health checks in v2.
     ASSERT(cluster.health_checks().size() == 1);
-    new_cluster->setHealthChecker(HealthCheckerFactory::create(
-        cluster.health_checks()[0], *new_cluster, runtime, random, dispatcher));
+    new_cluster->setHealthChecker(
+        HealthCheckerFactory::create(cluster.health_checks()[0], *new_cluster, runtime, random,
+                                     dispatcher, health_check_shard_pool));
   }
 
   new_cluster->setOutlierDetector(Outlier::DetectorImplFactory::createForCluster(
@@ -292,6 +316,39 @@ void ClusterImplBase::onPreInitComplete() {
   }
 }
 
+DnsTargetStats ClusterImplBase::generateDnsTargetStats(const std::string& dns_address) {
+  // Dots would otherwise split the name across stat path components.
+  std::string name = dns_address;
+  std::replace(name.begin(), name.end(), '.', '_');
+  const std::string prefix = fmt::format("dns.{}.", name);
+  Stats::Scope& scope = info_->statsScope();
+  return {ALL_DNS_TARGET_STATS(POOL_COUNTER_PREFIX(scope, prefix), POOL_GAUGE_PREFIX(scope, prefix),
+                               POOL_HISTOGRAM_PREFIX(scope, prefix))};
+}
+
+std::chrono::milliseconds
+ClusterImplBase::dnsRefreshInterval(Runtime::Loader& runtime, Runtime::RandomGenerator& random,
+                                    std::chrono::milliseconds refresh_rate,
+                                    const Optional<std::chrono::seconds>& ttl) {
+  const Runtime::Snapshot& snapshot = runtime.snapshot();
+  uint64_t interval_ms = refresh_rate.count();
+  if (ttl.valid()) {
+    const uint64_t min_ms = snapshot.getInteger("upstream.dns_refresh_min_ms", 1000);
+    const uint64_t max_ms =
+        snapshot.getInteger("upstream.dns_refresh_max_ms", refresh_rate.count());
+    interval_ms = std::chrono::duration_cast<std::chrono::milliseconds>(ttl.value()).count();
+    interval_ms = std::max(min_ms, std::min(max_ms, interval_ms));
+  }
+
+  const uint64_t jitter_percent = snapshot.getInteger("upstream.dns_refresh_jitter_percent",
+                                                      DEFAULT_DNS_REFRESH_JITTER_PERCENT);
+  if (jitter_percent > 0) {
+    interval_ms += random.random() % (interval_ms * jitter_percent / 100 + 1);
+  }
+
+  return std::chrono::milliseconds(interval_ms);
+}
+
 void ClusterImplBase::finishInitialization() {
   ASSERT(initialization_complete_callback_ != nullptr);
   ASSERT(initialization_started_);
@@ -353,10 +410,8 @@ void ClusterImplBase::reloadHealthyHosts() {
     return;
   }
 
-  HostVectorConstSharedPtr hosts_copy(new std::vector<HostSharedPtr>(hosts()));
-  HostListsConstSharedPtr hosts_per_locality_copy(
-      new std::vector<std::vector<HostSharedPtr>>(hostsPerLocality()));
-  updateHosts(hosts_copy, createHealthyHostList(hosts()), hosts_per_locality_copy,
+  // Membership is unchanged so the existing host vectors are reused as is.
+  updateHosts(hostsPtr(), createHealthyHostList(hosts()), hostsPerLocalityPtr(),
               createHealthyHostLists(hostsPerLocality()), {}, {});
 }
 
@@ -450,41 +505,47 @@ bool BaseDynamicClusterImpl::updateDynamicHostList(const std::vector<HostSharedP
   uint64_t max_host_weight = 1;
 
   // Go through and see if the list we have is different from what we just got. If it is, we
-  // make a new host list and raise a change notification. This uses an N^2 search given that
-  // this does not happen very often and the list sizes should be small. We also check for
-  // duplicates here. It's possible for DNS to return the same address multiple times, and a bad
-  // SDS implementation could do the same thing.
+  // make a new host list and raise a change notification. Current hosts are indexed by address so
+  // that the diff is linear in the size of both lists; EDS clusters can have many thousands of
+  // hosts. We also check for duplicates here. It's possible for DNS to return the same address
+  // multiple times, and a bad SDS implementation could do the same thing.
+  std::unordered_map<std::string, size_t> current_index;
+  current_index.reserve(current_hosts.size());
+  for (size_t i = 0; i < current_hosts.size(); i++) {
+    current_index.emplace(current_hosts[i]->address()->asString(), i);
+  }
+  std::vector<bool> kept(current_hosts.size());
+
   std::unordered_set<std::string> host_addresses;
   std::vector<HostSharedPtr> final_hosts;
+  bool lb_attributes_changed = false;
   for (const HostSharedPtr& host : new_hosts) {
-    if (host_addresses.count(host->address()->asString())) {
+    const std::string address = host->address()->asString();
+    if (!host_addresses.emplace(address).second) {
       continue;
     }
-    host_addresses.emplace(host->address()->asString());
-
-    bool found = false;
-    for (auto i = current_hosts.begin(); i != current_hosts.end();) {
-      // If we find a host matched based on address, we keep it. However we do change weight inline
-      // so do that here.
-      if (*(*i)->address() == *host->address()) {
-        if (host->weight() > max_host_weight) {
-          max_host_weight = host->weight();
-        }
 
-        (*i)->weight(host->weight());
-        final_hosts.push_back(*i);
-        i = current_hosts.erase(i);
-        found = true;
-      } else {
-        i++;
-      }
+    if (host->weight() > max_host_weight) {
+      max_host_weight = host->weight();
     }
 
-    if (!found) {
-      if (host->weight() > max_host_weight) {
-        max_host_weight = host->weight();
+    auto existing = current_index.find(address);
+    if (existing != current_index.end()) {
+      // If we find a host matched based on address, we keep it. However we do change weight inline
+      // so do that here. Priority and locality weight are also changed inline, but since load
+      // balancers derive their priority and locality structures from them we must raise a change
+      // notification if they differ.
+      const HostSharedPtr& current_host = current_hosts[existing->second];
+      current_host->weight(host->weight());
+      if (current_host->priority() != host->priority() ||
+          current_host->localityWeight() != host->localityWeight()) {
+        current_host->priority(host->priority());
+        current_host->localityWeight(host->localityWeight());
+        lb_attributes_changed = true;
       }
-
+      final_hosts.push_back(current_host);
+      kept[existing->second] = true;
+    } else {
       final_hosts.push_back(host);
       hosts_added.push_back(host);
 
@@ -495,32 +556,31 @@ bool BaseDynamicClusterImpl::updateDynamicHostList(const std::vector<HostSharedP
     }
   }
 
-  // If there are removed hosts, check to see if we should only delete if unhealthy.
-  if (!current_hosts.empty() && depend_on_hc) {
-    for (auto i = current_hosts.begin(); i != current_hosts.end();) {
-      if (!(*i)->healthFlagGet(Host::HealthFlag::FAILED_ACTIVE_HC)) {
-        if ((*i)->weight() > max_host_weight) {
-          max_host_weight = (*i)->weight();
-        }
-
-        final_hosts.push_back(*i);
-        i = current_hosts.erase(i);
-      } else {
-        i++;
+  // Hosts that were not matched are removed. If we are depending on a health checker, only
+  // delete them once they are unhealthy.
+  std::vector<HostSharedPtr> removed;
+  for (size_t i = 0; i < current_hosts.size(); i++) {
+    if (kept[i]) {
+      continue;
+    }
+    if (depend_on_hc && !current_hosts[i]->healthFlagGet(Host::HealthFlag::FAILED_ACTIVE_HC)) {
+      if (current_hosts[i]->weight() > max_host_weight) {
+        max_host_weight = current_hosts[i]->weight();
       }
+
+      final_hosts.push_back(current_hosts[i]);
+    } else {
+      removed.push_back(current_hosts[i]);
     }
   }
 
   info_->stats().max_host_weight_.set(max_host_weight);
 
-  if (!hosts_added.empty() || !current_hosts.empty()) {
-    hosts_removed = std::move(current_hosts);
-    current_hosts = std::move(final_hosts);
+  current_hosts = std::move(final_hosts);
+  if (!hosts_added.empty() || !removed.empty() || lb_attributes_changed) {
+    hosts_removed = std::move(removed);
     return true;
   } else {
-    // During the search we moved all of the hosts from hosts_ into final_hosts so just
-    // move them back.
-    current_hosts = std::move(final_hosts);
     return false;
   }
 }
@@ -530,10 +590,10 @@ StrictDnsClusterImpl::StrictDnsClusterImpl(const envoy::api::v2::Cluster& cluste
                                            Ssl::ContextManager& ssl_context_manager,
                                            Network::DnsResolverSharedPtr dns_resolver,
                                            ClusterManager& cm, Event::Dispatcher& dispatcher,
-                                           bool added_via_api)
+                                           Runtime::RandomGenerator& random, bool added_via_api)
     : BaseDynamicClusterImpl(cluster, cm.sourceAddress(), runtime, stats, ssl_context_manager,
                              added_via_api),
-      dns_resolver_(dns_resolver),
+      dns_resolver_(dns_resolver), random_(random),
       dns_refresh_rate_ms_(
           std::chrono::milliseconds(PROTOBUF_GET_MS_OR_DEFAULT(cluster, dns_refresh_rate, 5000))) {
   switch (cluster.dns_lookup_family()) {
@@ -583,7 +643,8 @@ StrictDnsClusterImpl::ResolveTarget::ResolveTarget(StrictDnsClusterImpl& parent,
                                                    const std::string& url)
     : parent_(parent), dns_address_(Network::Utility::hostFromTcpUrl(url)),
       port_(Network::Utility::portFromTcpUrl(url)),
-      resolve_timer_(dispatcher.createTimer([this]() -> void { startResolve(); })) {}
+      resolve_timer_(dispatcher.createTimer([this]() -> void { startResolve(); })),
+      stats_(parent.generateDnsTargetStats(dns_address_)) {}
 
 StrictDnsClusterImpl::ResolveTarget::~ResolveTarget() {
   if (active_query_) {
@@ -594,13 +655,23 @@ StrictDnsClusterImpl::ResolveTarget::~ResolveTarget() {
 void StrictDnsClusterImpl::ResolveTarget::startResolve() {
   ENVOY_LOG(debug, "starting async DNS resolution for {}", dns_address_);
   parent_.info_->stats().update_attempt_.inc();
+  stats_.resolve_total_.inc();
 
-  active_query_ = parent_.dns_resolver_->resolve(
+  const MonotonicTime start_time = ProdMonotonicTimeSource::instance_.currentTime();
+  active_query_ = parent_.dns_resolver_->resolveWithTtl(
       dns_address_, parent_.dns_lookup_family_,
-      [this](std::list<Network::Address::InstanceConstSharedPtr>&& address_list) -> void {
+      [this, start_time](std::list<Network::Address::InstanceConstSharedPtr>&& address_list,
+                         const Optional<std::chrono::seconds>& ttl) -> void {
         active_query_ = nullptr;
         ENVOY_LOG(debug, "async DNS resolution complete for {}", dns_address_);
         parent_.info_->stats().update_success_.inc();
+        stats_.resolve_latency_ms_.recordValue(
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                ProdMonotonicTimeSource::instance_.currentTime() - start_time)
+                .count());
+        if (address_list.empty()) {
+          stats_.resolve_failure_.inc();
+        }
 
         std::vector<HostSharedPtr> new_hosts;
         for (const Network::Address::InstanceConstSharedPtr& address : address_list) {
@@ -626,7 +697,10 @@ void StrictDnsClusterImpl::ResolveTarget::startResolve() {
         // This is not perfect but is easier to code and unclear if the extra complexity is needed
         // so will start with this.
         parent_.onPreInitComplete();
-        resolve_timer_->enableTimer(parent_.dns_refresh_rate_ms_);
+        const std::chrono::milliseconds interval = dnsRefreshInterval(
+            parent_.runtime_, parent_.random_, parent_.dns_refresh_rate_ms_, ttl);
+        stats_.refresh_interval_ms_.set(interval.count());
+        resolve_timer_->enableTimer(interval);
       });
 }
 
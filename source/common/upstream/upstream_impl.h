@@ -11,6 +11,7 @@
 #include <utility>
 #include <vector>
 
+#include "envoy/common/optional.h"
 #include "envoy/event/timer.h"
 #include "envoy/local_info/local_info.h"
 #include "envoy/network/dns.h"
@@ -25,11 +26,15 @@
 #include "common/common/callback_impl.h"
 #include "common/common/enum_to_int.h"
 #include "common/common/logger.h"
+#include "common/common/utility.h"
 #include "common/config/metadata.h"
 #include "common/config/well_known_names.h"
+#include "common/stats/lazy_scope_impl.h"
 #include "common/stats/stats_impl.h"
+#include "common/upstream/health_check_shard_pool.h"
 #include "common/upstream/load_balancer_impl.h"
 #include "common/upstream/outlier_detection_impl.h"
+#include "common/upstream/peak_ewma_lb.h"
 #include "common/upstream/resource_manager_impl.h"
 
 #include "api/base.pb.h"
@@ -61,6 +66,17 @@ public:
   void setUnhealthy() override {}
 };
 
+/**
+ * Null implementation of LatencyHostMonitor, used by hosts of clusters that do not balance on
+ * latency.
+ */
+class LatencyHostMonitorNullImpl : public LatencyHostMonitor {
+public:
+  // Upstream::LatencyHostMonitor
+  void putResponseTime(std::chrono::milliseconds) override {}
+  double latencyEstimate() override { return 0; }
+};
+
 /**
  * Implementation of Upstream::HostDescription.
  */
@@ -75,8 +91,10 @@ public:
                                                 Config::MetadataEnvoyLbKeys::get().CANARY)
                     .bool_value()),
         metadata_(metadata), locality_(locality), stats_{ALL_HOST_STATS(POOL_COUNTER(stats_store_),
-                                                                        POOL_GAUGE(stats_store_))} {
-  }
+                                                                        POOL_GAUGE(stats_store_))},
+        latency_monitor_(cluster_->lbType() == LoadBalancerType::PeakEwma
+                             ? new PeakEwmaLatencyMonitor(ProdMonotonicTimeSource::instance_)
+                             : nullptr) {}
 
   // Upstream::HostDescription
   bool canary() const override { return canary_; }
@@ -100,6 +118,14 @@ public:
       return *null_outlier_detector;
     }
   }
+  LatencyHostMonitor& latencyMonitor() const override {
+    if (latency_monitor_) {
+      return *latency_monitor_;
+    } else {
+      static LatencyHostMonitorNullImpl* null_latency_monitor = new LatencyHostMonitorNullImpl();
+      return *null_latency_monitor;
+    }
+  }
   const HostStats& stats() const override { return stats_; }
   const std::string& hostname() const override { return hostname_; }
   Network::Address::InstanceConstSharedPtr address() const override { return address_; }
@@ -116,6 +142,7 @@ protected:
   HostStats stats_;
   Outlier::DetectorHostMonitorPtr outlier_detector_;
   HealthCheckHostMonitorPtr health_checker_;
+  LatencyHostMonitorPtr latency_monitor_;
 };
 
 /**
@@ -149,6 +176,12 @@ public:
   bool healthy() const override { return !health_flags_; }
   uint32_t weight() const override { return weight_; }
   void weight(uint32_t new_weight) override;
+  uint32_t priority() const override { return priority_; }
+  void priority(uint32_t new_priority) override { priority_ = new_priority; }
+  uint32_t localityWeight() const override { return locality_weight_; }
+  void localityWeight(uint32_t new_locality_weight) override {
+    locality_weight_ = new_locality_weight;
+  }
   bool used() const override { return used_; }
   void used(bool new_used) override { used_ = new_used; }
 
@@ -160,13 +193,13 @@ protected:
 private:
   std::atomic<uint64_t> health_flags_{};
   std::atomic<uint32_t> weight_;
+  std::atomic<uint32_t> priority_{};
+  std::atomic<uint32_t> locality_weight_{};
   std::atomic<bool> used_;
 };
 
 typedef std::shared_ptr<std::vector<HostSharedPtr>> HostVectorSharedPtr;
-typedef std::shared_ptr<const std::vector<HostSharedPtr>> HostVectorConstSharedPtr;
 typedef std::shared_ptr<std::vector<std::vector<HostSharedPtr>>> HostListsSharedPtr;
-typedef std::shared_ptr<const std::vector<std::vector<HostSharedPtr>>> HostListsConstSharedPtr;
 
 /**
  * Base class for all clusters as well as thread local host sets.
@@ -202,6 +235,13 @@ public:
   Common::CallbackHandle* addMemberUpdateCb(MemberUpdateCb callback) const override {
     return member_update_cb_helper_.add(callback);
   }
+  // The vectors are replaced, never modified, by updateHosts().
+  HostVectorConstSharedPtr hostsPtr() const override { return hosts_; }
+  HostVectorConstSharedPtr healthyHostsPtr() const override { return healthy_hosts_; }
+  HostListsConstSharedPtr hostsPerLocalityPtr() const override { return hosts_per_locality_; }
+  HostListsConstSharedPtr healthyHostsPerLocalityPtr() const override {
+    return healthy_hosts_per_locality_;
+  }
 
 protected:
   virtual void runUpdateCallbacks(const std::vector<HostSharedPtr>& hosts_added,
@@ -246,11 +286,20 @@ public:
   LoadBalancerType lbType() const override { return lb_type_; }
   bool maintenanceMode() const override;
   uint64_t maxRequestsPerConnection() const override { return max_requests_per_connection_; }
+  std::chrono::milliseconds idleTimeout() const override { return idle_timeout_; }
+  std::chrono::milliseconds maxConnectionDuration() const override {
+    return max_connection_duration_;
+  }
+  uint64_t prefetchMinIdleConnections() const override { return prefetch_min_idle_connections_; }
+  uint64_t prefetchRatioPercent() const override { return prefetch_ratio_percent_; }
   const std::string& name() const override { return name_; }
   ResourceManager& resourceManager(ResourcePriority priority) const override;
   Ssl::ClientContext* sslContext() const override { return ssl_ctx_.get(); }
   ClusterStats& stats() const override { return stats_; }
   Stats::Scope& statsScope() const override { return *stats_scope_; }
+  uint64_t pendingStats() const override {
+    return compact_stats_scope_ ? compact_stats_scope_->pendingStats() : 0;
+  }
   ClusterLoadReportStats& loadReportStats() const override { return load_report_stats_; }
   const Network::Address::InstanceConstSharedPtr& sourceAddress() const override {
     return source_address_;
@@ -275,9 +324,15 @@ private:
   Runtime::Loader& runtime_;
   const std::string name_;
   const uint64_t max_requests_per_connection_;
+  const std::chrono::milliseconds idle_timeout_;
+  const std::chrono::milliseconds max_connection_duration_;
+  const uint64_t prefetch_min_idle_connections_;
+  const uint64_t prefetch_ratio_percent_;
   const std::chrono::milliseconds connect_timeout_;
   const uint32_t per_connection_buffer_limit_bytes_;
   Stats::ScopePtr stats_scope_;
+  // Set when the fixed cluster stats are only allocated on first use.
+  std::unique_ptr<Stats::LazyScopeImpl> compact_stats_scope_;
   mutable ClusterStats stats_;
   Stats::IsolatedStoreImpl load_report_stats_store_;
   mutable ClusterLoadReportStats load_report_stats_;
@@ -292,6 +347,24 @@ private:
   LoadBalancerSubsetInfoImpl lb_subset_;
 };
 
+/**
+ * All per DNS target stats. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_DNS_TARGET_STATS(COUNTER, GAUGE, HISTOGRAM)                                            \
+  COUNTER  (resolve_total)                                                                         \
+  COUNTER  (resolve_failure)                                                                       \
+  GAUGE    (refresh_interval_ms)                                                                   \
+  HISTOGRAM(resolve_latency_ms)
+// clang-format on
+
+/**
+ * Struct definition for all per DNS target stats. @see stats_macros.h
+ */
+struct DnsTargetStats {
+  ALL_DNS_TARGET_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT, GENERATE_HISTOGRAM_STRUCT)
+};
+
 /**
  * Base class all primary clusters.
  */
@@ -307,7 +380,8 @@ public:
                                  Runtime::RandomGenerator& random, Event::Dispatcher& dispatcher,
                                  const LocalInfo::LocalInfo& local_info,
                                  Outlier::EventLoggerSharedPtr outlier_event_logger,
-                                 bool added_via_api);
+                                 bool added_via_api,
+                                 HealthCheckShardPool* health_check_shard_pool);
 
   /**
    * Optionally set the health checker for the primary cluster. This is done after cluster
@@ -353,6 +427,26 @@ protected:
    */
   void onPreInitComplete();
 
+  /**
+   * @return stats for a DNS name resolved by this cluster, rooted at "dns.<name>." in the cluster
+   *         scope.
+   */
+  DnsTargetStats generateDnsTargetStats(const std::string& dns_address);
+
+  /**
+   * Compute when a DNS name should next be resolved. Without a record TTL (failure, hosts file, IP
+   * literal or a resolver that cannot report one) this is the configured refresh rate. With a TTL
+   * it is the TTL bounded by "upstream.dns_refresh_min_ms" and "upstream.dns_refresh_max_ms",
+   * where the max defaults to the configured refresh rate. "upstream.dns_refresh_jitter_percent"
+   * (default DEFAULT_DNS_REFRESH_JITTER_PERCENT) adds up to that percentage of random delay so
+   * that a fleet does not re-resolve in lockstep.
+   */
+  static std::chrono::milliseconds dnsRefreshInterval(Runtime::Loader& runtime,
+                                                      Runtime::RandomGenerator& random,
+                                                      std::chrono::milliseconds refresh_rate,
+                                                      const Optional<std::chrono::seconds>& ttl);
+
+  static const uint64_t DEFAULT_DNS_REFRESH_JITTER_PERCENT = 10;
   static const HostListsConstSharedPtr empty_host_lists_;
 
   Runtime::Loader& runtime_;
@@ -413,7 +507,8 @@ public:
   StrictDnsClusterImpl(const envoy::api::v2::Cluster& cluster, Runtime::Loader& runtime,
                        Stats::Store& stats, Ssl::ContextManager& ssl_context_manager,
                        Network::DnsResolverSharedPtr dns_resolver, ClusterManager& cm,
-                       Event::Dispatcher& dispatcher, bool added_via_api);
+                       Event::Dispatcher& dispatcher, Runtime::RandomGenerator& random,
+                       bool added_via_api);
 
   // Upstream::Cluster
   InitializePhase initializePhase() const override { return InitializePhase::Primary; }
@@ -431,6 +526,7 @@ private:
     uint32_t port_;
     Event::TimerPtr resolve_timer_;
     std::vector<HostSharedPtr> hosts_;
+    DnsTargetStats stats_;
   };
 
   typedef std::unique_ptr<ResolveTarget> ResolveTargetPtr;
@@ -442,6 +538,7 @@ private:
   void startPreInit() override;
 
   Network::DnsResolverSharedPtr dns_resolver_;
+  Runtime::RandomGenerator& random_;
   std::list<ResolveTargetPtr> resolve_targets_;
   const std::chrono::milliseconds dns_refresh_rate_ms_;
   Network::DnsLookupFamily dns_lookup_family_;
@@ -23,8 +23,13 @@ Stats::SinkPtr StatsdSinkFactory::createStatsSink(const Protobuf::Message& confi
     Network::Address::InstanceConstSharedPtr address =
         Network::Address::resolveProtoAddress(statsd_sink.address());
     ENVOY_LOG(info, "statsd UDP ip address: {}", address->asString());
-    return Stats::SinkPtr(
-        new Stats::Statsd::UdpStatsdSink(server.threadLocal(), std::move(address)));
+    // The datagram size and the tag format are taken from runtime when the sink is created.
+    Runtime::Snapshot& snapshot = server.runtime().snapshot();
+    return Stats::SinkPtr(new Stats::Statsd::UdpStatsdSink(
+        server.threadLocal(), std::move(address),
+        snapshot.getInteger("stats.statsd.max_datagram_bytes",
+                            Stats::Statsd::UdpStatsdSink::DEFAULT_MAX_DATAGRAM_BYTES),
+        snapshot.getInteger("stats.statsd.dogstatsd_tags", 0) > 0));
     break;
   }
   case envoy::api::v2::StatsdSink::kTcpClusterName:
@@ -9,7 +9,7 @@ ValidationClusterManagerFactory::ValidationClusterManagerFactory(
     Ssl::ContextManager& ssl_context_manager, Event::Dispatcher& primary_dispatcher,
     const LocalInfo::LocalInfo& local_info)
     : ProdClusterManagerFactory(runtime, stats, tls, random, dns_resolver, ssl_context_manager,
-                                primary_dispatcher, local_info) {}
+                                primary_dispatcher, local_info, nullptr, nullptr) {}
 
 ClusterManagerPtr ValidationClusterManagerFactory::clusterManagerFromProto(
     const envoy::api::v2::Bootstrap& bootstrap, Stats::Store& stats, ThreadLocal::Instance& tls,
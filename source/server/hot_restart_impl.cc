@@ -5,7 +5,9 @@
 #include <sys/types.h>
 #include <sys/un.h>
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <string>
 
 #include "envoy/event/dispatcher.h"
@@ -23,11 +25,100 @@ namespace Server {
 
 // Increment this whenever there is a shared memory / RPC change that will prevent a hot restart
 // from working. Operations code can then cope with this and do a full restart.
-const uint64_t SharedMemory::VERSION = 9;
+const uint64_t SharedMemory::VERSION = 10;
+
+StatNameTable::StatNameTable(uint8_t* memory, uint64_t size, uint64_t& used)
+    : memory_(memory), size_(size), used_(used) {
+  ASSERT(size_ % 4 == 0);
+}
+
+uint64_t StatNameTable::recordSize(uint64_t name_length) {
+  return sizeof(Record) + ((name_length + 3) & ~3ULL);
+}
+
+uint64_t StatNameTable::add(const std::string& name) {
+  ASSERT(!name.empty());
+  if (name.size() > MAX_CAPACITY) {
+    return NO_SPACE;
+  }
+
+  // First fit over the existing records.
+  uint64_t offset = 0;
+  while (offset < used_) {
+    Record& record = recordAt(offset);
+    if (record.length_ == 0) {
+      // Merge the free records that follow into this one.
+      uint64_t next = offset + sizeof(Record) + record.capacity_;
+      while (next < used_ && recordAt(next).length_ == 0 &&
+             record.capacity_ + recordSize(recordAt(next).capacity_) <= MAX_CAPACITY) {
+        record.capacity_ += recordSize(recordAt(next).capacity_);
+        next = offset + sizeof(Record) + record.capacity_;
+      }
+
+      if (next >= used_) {
+        // Free space at the end of the table is not kept in a record.
+        used_ = offset;
+        break;
+      }
+
+      if (record.capacity_ >= name.size()) {
+        // Split off what this name does not need if that is enough for another record.
+        const uint64_t needed = recordSize(name.size()) - sizeof(Record);
+        if (record.capacity_ - needed >= recordSize(1)) {
+          Record& remainder = recordAt(offset + sizeof(Record) + needed);
+          remainder.capacity_ = record.capacity_ - needed - sizeof(Record);
+          remainder.length_ = 0;
+          record.capacity_ = needed;
+        }
+
+        record.length_ = name.size();
+        memcpy(record.name_, name.data(), name.size());
+        return offset;
+      }
+    }
+
+    offset += sizeof(Record) + record.capacity_;
+  }
+
+  if (used_ + recordSize(name.size()) > size_) {
+    return NO_SPACE;
+  }
+
+  offset = used_;
+  Record& record = recordAt(offset);
+  record.capacity_ = recordSize(name.size()) - sizeof(Record);
+  record.length_ = name.size();
+  memcpy(record.name_, name.data(), name.size());
+  used_ += recordSize(name.size());
+  return offset;
+}
+
+void StatNameTable::remove(uint64_t offset) {
+  ASSERT(offset < used_);
+  Record& record = recordAt(offset);
+  ASSERT(record.length_ != 0);
+  record.length_ = 0;
+  if (offset + sizeof(Record) + record.capacity_ == used_) {
+    used_ = offset;
+  }
+}
+
+bool StatNameTable::equals(uint64_t offset, const std::string& name) const {
+  const Record& record = recordAt(offset);
+  return record.length_ == name.size() && memcmp(record.name_, name.data(), name.size()) == 0;
+}
+
+std::string StatNameTable::get(uint64_t offset) const {
+  const Record& record = recordAt(offset);
+  return std::string(record.name_, record.length_);
+}
 
 SharedMemory& SharedMemory::initialize(Options& options, Api::OsSysCalls& os_sys_calls) {
-  const uint64_t entry_size = Stats::RawStatData::size();
-  const uint64_t total_size = sizeof(SharedMemory) + (entry_size * options.maxStats());
+  const uint64_t entry_size = sizeof(SharedStatSlot);
+  // Name offsets are stored in 32 bits.
+  const uint64_t name_table_size = nameTableSize(options.statsNameTableBytes());
+  const uint64_t total_size =
+      sizeof(SharedMemory) + (entry_size * options.maxStats()) + name_table_size;
 
   int flags = O_RDWR;
   const std::string shmem_name = fmt::format("/envoy_shared_memory_{}", options.baseId());
@@ -60,6 +151,8 @@ SharedMemory& SharedMemory::initialize(Options& options, Api::OsSysCalls& os_sys
     shmem->version_ = VERSION;
     shmem->num_stats_ = options.maxStats();
     shmem->entry_size_ = entry_size;
+    shmem->name_table_size_ = name_table_size;
+    shmem->name_table_used_ = 0;
     shmem->initializeMutex(shmem->log_lock_);
     shmem->initializeMutex(shmem->access_log_lock_);
     shmem->initializeMutex(shmem->stat_lock_);
@@ -69,11 +162,11 @@ SharedMemory& SharedMemory::initialize(Options& options, Api::OsSysCalls& os_sys
     RELEASE_ASSERT(shmem->version_ == VERSION);
     RELEASE_ASSERT(shmem->num_stats_ == options.maxStats());
     RELEASE_ASSERT(shmem->entry_size_ == entry_size);
+    RELEASE_ASSERT(shmem->name_table_size_ == name_table_size);
   }
 
   // Stats::RawStatData must be naturally aligned for atomics to work properly.
-  RELEASE_ASSERT((reinterpret_cast<uintptr_t>(shmem->stats_slots_) % alignof(Stats::RawStatData)) ==
-                 0);
+  RELEASE_ASSERT((reinterpret_cast<uintptr_t>(shmem->stats_slots_) % alignof(SharedStatSlot)) == 0);
 
   // Here we catch the case where a new Envoy starts up when the current Envoy has not yet fully
   // initialized. The startup logic is quite complicated, and it's not worth trying to handle this
@@ -96,17 +189,20 @@ void SharedMemory::initializeMutex(pthread_mutex_t& mutex) {
   pthread_mutex_init(&mutex, &attribute);
 }
 
-std::string SharedMemory::version(size_t max_num_stats, size_t max_stat_name_len) {
-  return fmt::format("{}.{}.{}.{}", VERSION, sizeof(SharedMemory), max_num_stats,
-                     max_stat_name_len);
+std::string SharedMemory::version(uint64_t max_num_stats, uint64_t max_stat_name_len,
+                                  uint64_t stats_name_table_bytes) {
+  return fmt::format("{}.{}.{}.{}.{}", VERSION, sizeof(SharedMemory), max_num_stats,
+                     max_stat_name_len, nameTableSize(stats_name_table_bytes));
 }
 
 std::string SharedMemory::version() {
-  return version(num_stats_, Stats::RawStatData::maxNameLength());
+  return version(num_stats_, Stats::RawStatData::maxNameLength(), name_table_size_);
 }
 
 HotRestartImpl::HotRestartImpl(Options& options, Api::OsSysCalls& os_sys_calls)
     : options_(options), shmem_(SharedMemory::initialize(options, os_sys_calls)),
+      name_table_(shmem_.stats_slots_ + shmem_.entry_size_ * shmem_.num_stats_,
+                  shmem_.name_table_size_, shmem_.name_table_used_),
       log_lock_(shmem_.log_lock_), access_log_lock_(shmem_.access_log_lock_),
       stat_lock_(shmem_.stat_lock_), init_lock_(shmem_.init_lock_) {
 
@@ -126,25 +222,40 @@ HotRestartImpl::HotRestartImpl(Options& options, Api::OsSysCalls& os_sys_calls)
 
 Stats::RawStatData* HotRestartImpl::alloc(const std::string& name) {
   // Try to find the existing slot in shared memory, otherwise allocate a new one.
-  Stats::RawStatData* unused = nullptr;
+  SharedStatSlot* unused = nullptr;
   std::unique_lock<Thread::BasicLockable> lock(stat_lock_);
   for (uint64_t i = 0; i < shmem_.num_stats_; i++) {
-    const size_t offset = shmem_.entry_size_ * i;
-    Stats::RawStatData* data = reinterpret_cast<Stats::RawStatData*>(shmem_.stats_slots_ + offset);
-    if (!data->initialized()) {
-      unused = data;
-    } else if (data->matches(name)) {
-      data->ref_count_++;
-      return data;
+    SharedStatSlot& slot = slotAt(i);
+    if (slot.name_length_ == 0) {
+      unused = &slot;
+    } else if (slot.name_length_ == name.size() && name_table_.equals(slot.name_offset_, name)) {
+      slot.data_.ref_count_++;
+      return &slot.data_;
     }
   }
 
-  if (unused != nullptr) {
-    unused->initialize(name);
-    return unused;
+  if (unused == nullptr || name.empty()) {
+    return nullptr;
+  }
+
+  const uint64_t name_offset = name_table_.add(name);
+  if (name_offset == StatNameTable::NO_SPACE) {
+    // Log the first time and then with exponential back off so that a full table is visible
+    // without flooding the log.
+    name_table_full_count_++;
+    if ((name_table_full_count_ & (name_table_full_count_ - 1)) == 0) {
+      ENVOY_LOG(warn,
+                "stat name table of {} bytes is full, {} stats were allocated on the heap instead "
+                "(see --stats-name-table-bytes)",
+                shmem_.name_table_size_, name_table_full_count_);
+    }
+    return nullptr;
   }
 
-  return nullptr;
+  unused->name_offset_ = name_offset;
+  unused->name_length_ = name.size();
+  unused->data_.initialize();
+  return &unused->data_;
 }
 
 void HotRestartImpl::free(Stats::RawStatData& data) {
@@ -155,7 +266,10 @@ void HotRestartImpl::free(Stats::RawStatData& data) {
     return;
   }
 
-  memset(&data, 0, Stats::RawStatData::size());
+  // data_ is the first member of the slot.
+  SharedStatSlot& slot = reinterpret_cast<SharedStatSlot&>(data);
+  name_table_.remove(slot.name_offset_);
+  memset(&slot, 0, sizeof(SharedStatSlot));
 }
 
 int HotRestartImpl::bindDomainSocket(uint64_t id, Api::OsSysCalls& os_sys_calls) {
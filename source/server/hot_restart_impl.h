@@ -3,6 +3,7 @@
 #include <fcntl.h>
 #include <sys/un.h>
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cstdint>
@@ -18,6 +19,90 @@
 namespace Envoy {
 namespace Server {
 
+/**
+ * Variable-length storage for stat names, laid into shared memory after the stat slots. Each name
+ * is kept in a record made of a 4 byte header and the name's characters, padded to a multiple of
+ * 4 bytes. A removed name leaves a free record that is reused (and split if it is much larger) by
+ * a later name that fits. Runs of adjacent free records are merged while searching, and free
+ * records at the end of the table are handed back to the unused space.
+ *
+ * This class is not thread safe. It only holds pointers into the shared memory, so the parent and
+ * child processes each create their own instance over the same memory.
+ */
+class StatNameTable {
+public:
+  /**
+   * @param memory supplies the start of the table.
+   * @param size supplies the size of the table in bytes. Must be a multiple of 4.
+   * @param used supplies the number of bytes at the start of the table that hold records. It is
+   *        updated as records are added and removed.
+   */
+  StatNameTable(uint8_t* memory, uint64_t size, uint64_t& used);
+
+  /**
+   * Stores a name.
+   * @param name supplies the name, which must not be empty.
+   * @return uint64_t the offset of the name in the table, or NO_SPACE if the name is too long or
+   *         there is no room left for it.
+   */
+  uint64_t add(const std::string& name);
+
+  /**
+   * Removes a name previously returned by add().
+   * @param offset supplies the offset of the name.
+   */
+  void remove(uint64_t offset);
+
+  /**
+   * @return true if the name stored at offset equals name.
+   */
+  bool equals(uint64_t offset, const std::string& name) const;
+
+  /**
+   * @return std::string the name stored at offset.
+   */
+  std::string get(uint64_t offset) const;
+
+  /**
+   * @return uint64_t the number of bytes a record holding a name of the given length takes.
+   */
+  static uint64_t recordSize(uint64_t name_length);
+
+  static const uint64_t NO_SPACE = UINT64_MAX;
+
+private:
+  struct Record {
+    // Number of bytes available for the name.
+    uint16_t capacity_;
+    // Length of the stored name. 0 if the record is free.
+    uint16_t length_;
+    char name_[];
+  };
+
+  static const uint64_t MAX_CAPACITY = UINT16_MAX & ~3ULL;
+
+  Record& recordAt(uint64_t offset) const { return *reinterpret_cast<Record*>(memory_ + offset); }
+
+  uint8_t* memory_;
+  const uint64_t size_;
+  uint64_t& used_;
+};
+
+/**
+ * A stat's value slot in shared memory. The name is kept in the StatNameTable.
+ */
+struct SharedStatSlot {
+  SharedStatSlot() = delete;
+  ~SharedStatSlot() = delete;
+
+  Stats::RawStatData data_;
+  // Offset of the name in the StatNameTable. Only valid if name_length_ is not 0.
+  uint32_t name_offset_;
+  // Length of the name, 0 if the slot is free. Kept here so that most name comparisons fail
+  // without reading the table.
+  uint32_t name_length_;
+};
+
 /**
  * Shared memory segment. This structure is laid directly into shared memory and is used amongst
  * all running envoy processes.
@@ -25,9 +110,18 @@ namespace Server {
 class SharedMemory {
 public:
   static void configure(size_t max_num_stats, size_t max_stat_name_len);
-  static std::string version(uint64_t max_num_stats, uint64_t max_stat_name_len);
+  static std::string version(uint64_t max_num_stats, uint64_t max_stat_name_len,
+                             uint64_t stats_name_table_bytes);
   std::string version();
 
+  /**
+   * @return uint64_t the size of the StatNameTable for --stats-name-table-bytes. Offsets into the
+   *         table are 32 bits and records are 4 byte aligned.
+   */
+  static uint64_t nameTableSize(uint64_t stats_name_table_bytes) {
+    return std::min<uint64_t>(stats_name_table_bytes, UINT32_MAX) & ~3ULL;
+  }
+
 private:
   struct Flags {
     static const uint64_t INITIALIZING = 0x1;
@@ -55,14 +149,15 @@ private:
   uint64_t version_;
   uint64_t num_stats_;
   uint64_t entry_size_;
+  uint64_t name_table_size_;
+  uint64_t name_table_used_;
   std::atomic<uint64_t> flags_;
   pthread_mutex_t log_lock_;
   pthread_mutex_t access_log_lock_;
   pthread_mutex_t stat_lock_;
   pthread_mutex_t init_lock_;
-  alignas(Stats::RawStatData) uint8_t
-      stats_slots_[]; // array of Stats::RawStatData, which has a flexible-array-length member
-                      // so non-fixed size
+  // Array of num_stats_ SharedStatSlot followed by name_table_size_ bytes of StatNameTable.
+  alignas(SharedStatSlot) uint8_t stats_slots_[];
 
   friend class HotRestartImpl;
 };
@@ -197,8 +292,13 @@ private:
   RpcBase* receiveRpc(bool block);
   void sendMessage(sockaddr_un& address, RpcBase& rpc);
 
+  SharedStatSlot& slotAt(uint64_t index) {
+    return *reinterpret_cast<SharedStatSlot*>(shmem_.stats_slots_ + shmem_.entry_size_ * index);
+  }
+
   Options& options_;
   SharedMemory& shmem_;
+  StatNameTable name_table_;
   ProcessSharedMutex log_lock_;
   ProcessSharedMutex access_log_lock_;
   ProcessSharedMutex stat_lock_;
@@ -210,6 +310,8 @@ private:
   std::array<uint8_t, 4096> rpc_buffer_;
   Server::Instance* server_{};
   bool parent_terminated_{};
+  // Number of stats that did not fit into the name table. Protected by stat_lock_.
+  uint64_t name_table_full_count_{};
 };
 
 } // namespace Server
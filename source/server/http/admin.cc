@@ -1,6 +1,10 @@
 #include "server/http/admin.h"
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <string>
 #include <unordered_set>
@@ -25,9 +29,11 @@
 #include "common/http/headers.h"
 #include "common/http/http1/codec_impl.h"
 #include "common/json/json_loader.h"
+#include "common/memory/stats.h"
 #include "common/network/listen_socket_impl.h"
 #include "common/profiler/profiler.h"
 #include "common/router/config_impl.h"
+#include "common/stats/stats_impl.h"
 #include "common/upstream/host_utility.h"
 
 #include "fmt/format.h"
@@ -71,6 +77,390 @@ Http::FilterTrailersStatus AdminFilter::decodeTrailers(Http::HeaderMap&) {
   return Http::FilterTrailersStatus::StopIteration;
 }
 
+void AdminFilter::onDestroy() {
+  if (chunk_timer_) {
+    chunk_timer_->disableTimer();
+  }
+  stopWatermarkCallbacks();
+}
+
+void AdminFilter::onBelowWriteBufferLowWatermark() {
+  above_high_watermark_ = false;
+  // Do not send from under the watermark callback, the last chunk removes the callbacks.
+  if (chunked_response_) {
+    chunk_timer_->enableTimer(std::chrono::milliseconds(0));
+  }
+}
+
+void AdminFilter::sendChunk() {
+  Buffer::OwnedImpl chunk;
+  if (!chunked_response_->nextChunk(chunk)) {
+    chunked_response_.reset();
+    stopWatermarkCallbacks();
+    callbacks_->encodeData(chunk, true);
+    return;
+  }
+
+  callbacks_->encodeData(chunk, false);
+  if (!above_high_watermark_) {
+    chunk_timer_->enableTimer(std::chrono::milliseconds(0));
+  }
+}
+
+void AdminFilter::stopWatermarkCallbacks() {
+  if (watermark_callbacks_added_) {
+    callbacks_->removeDownstreamWatermarkCallbacks(*this);
+    watermark_callbacks_added_ = false;
+  }
+}
+
+PrometheusStatsFormatter::PrometheusStatsFormatter(
+    const std::list<Stats::CounterSharedPtr>& counters,
+    const std::list<Stats::GaugeSharedPtr>& gauges,
+    const std::list<Stats::ParentHistogramSharedPtr>& histograms, uint64_t chunk_bytes)
+    : chunk_bytes_(chunk_bytes) {
+  for (const Stats::CounterSharedPtr& counter : counters) {
+    addToFamily(counters_, counter);
+  }
+  for (const Stats::GaugeSharedPtr& gauge : gauges) {
+    addToFamily(gauges_, gauge);
+  }
+  for (const Stats::ParentHistogramSharedPtr& histogram : histograms) {
+    addToFamily(histograms_, histogram);
+  }
+}
+
+template <class StatType>
+void PrometheusStatsFormatter::addToFamily(Families<StatType>& families,
+                                           const std::shared_ptr<StatType>& stat) {
+  families[metricName(stat->tagExtractedName())].push_back(stat);
+}
+
+bool PrometheusStatsFormatter::nextChunk(Buffer::Instance& response) {
+  const uint64_t chunk_end = response.length() + chunk_bytes_;
+  const bool done = render(counters_, "counter", response, chunk_end) &&
+                    render(gauges_, "gauge", response, chunk_end) &&
+                    render(histograms_, "histogram", response, chunk_end);
+  return !done;
+}
+
+template <class StatType>
+bool PrometheusStatsFormatter::render(Families<StatType>& families, const std::string& type,
+                                      Buffer::Instance& response, uint64_t chunk_end) {
+  while (!families.empty() && response.length() < chunk_end) {
+    auto family = families.begin();
+    if (series_index_ == 0) {
+      response.add(fmt::format("# TYPE {} {}\n", family->first, type));
+    }
+    while (series_index_ < family->second.size() && response.length() < chunk_end) {
+      renderSeries(family->first, *family->second[series_index_++], response);
+    }
+    if (series_index_ == family->second.size()) {
+      families.erase(family);
+      series_index_ = 0;
+    }
+  }
+  return families.empty();
+}
+
+void PrometheusStatsFormatter::renderSeries(const std::string& name,
+                                            const Stats::Counter& counter,
+                                            Buffer::Instance& response) {
+  const std::string tags = formattedTags(counter.tags());
+  response.add(fmt::format(tags.empty() ? "{0} {2}\n" : "{0}{{{1}}} {2}\n", name, tags,
+                           counter.value()));
+}
+
+void PrometheusStatsFormatter::renderSeries(const std::string& name, const Stats::Gauge& gauge,
+                                            Buffer::Instance& response) {
+  const std::string tags = formattedTags(gauge.tags());
+  response.add(
+      fmt::format(tags.empty() ? "{0} {2}\n" : "{0}{{{1}}} {2}\n", name, tags, gauge.value()));
+}
+
+void PrometheusStatsFormatter::renderSeries(const std::string& name,
+                                            const Stats::ParentHistogram& histogram,
+                                            Buffer::Instance& response) {
+  const std::string tags = formattedTags(histogram.tags());
+  const std::string bucket_tags = tags.empty() ? "" : tags + ",";
+  const Stats::HistogramStatistics& statistics = histogram.cumulativeStatistics();
+  const std::vector<double>& buckets = statistics.supportedBuckets();
+  for (size_t i = 0; i < buckets.size(); i++) {
+    response.add(fmt::format("{}_bucket{{{}le=\"{:.17g}\"}} {}\n", name, bucket_tags, buckets[i],
+                             statistics.computedBuckets()[i]));
+  }
+  response.add(fmt::format("{}_bucket{{{}le=\"+Inf\"}} {}\n", name, bucket_tags,
+                           statistics.sampleCount()));
+  response.add(fmt::format(tags.empty() ? "{0}_sum {2}\n" : "{0}_sum{{{1}}} {2}\n", name, tags,
+                           statistics.sampleSum()));
+  response.add(fmt::format(tags.empty() ? "{0}_count {2}\n" : "{0}_count{{{1}}} {2}\n", name,
+                           tags, statistics.sampleCount()));
+}
+
+std::string PrometheusStatsFormatter::metricName(const std::string& extracted_name) {
+  // Metric names may only contain [a-zA-Z0-9_:], so '.' and anything else becomes '_'.
+  std::string name = "envoy_" + extracted_name;
+  for (char& c : name) {
+    if (!isalnum(static_cast<unsigned char>(c)) && c != '_' && c != ':') {
+      c = '_';
+    }
+  }
+  return name;
+}
+
+std::string PrometheusStatsFormatter::formattedTags(const std::vector<Stats::Tag>& tags) {
+  std::string formatted;
+  for (const Stats::Tag& tag : tags) {
+    if (!formatted.empty()) {
+      formatted += ",";
+    }
+    // Label names may only contain [a-zA-Z0-9_], label values escape '\\', '"' and newlines.
+    for (char c : tag.name_) {
+      formatted += isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    }
+    formatted += "=\"";
+    for (char c : tag.value_) {
+      if (c == '\\' || c == '"') {
+        formatted += '\\';
+        formatted += c;
+      } else if (c == '\n') {
+        formatted += "\\n";
+      } else {
+        formatted += c;
+      }
+    }
+    formatted += "\"";
+  }
+  return formatted;
+}
+
+BinaryStatsSnapshots::BinaryStatsSnapshots(uint32_t max_snapshots)
+    : max_snapshots_(max_snapshots) {}
+
+uint64_t BinaryStatsSnapshots::encode(uint64_t base_cursor,
+                                      const std::list<Stats::CounterSharedPtr>& counters,
+                                      const std::list<Stats::GaugeSharedPtr>& gauges,
+                                      const std::list<Stats::ParentHistogramSharedPtr>& histograms,
+                                      Buffer::Instance& response) {
+  const Snapshot* base = nullptr;
+  for (const Snapshot& snapshot : snapshots_) {
+    if (snapshot.cursor_ == base_cursor) {
+      base = &snapshot;
+    }
+  }
+
+  std::vector<Entry> entries;
+  entries.reserve(counters.size() + gauges.size() + histograms.size());
+  for (const Stats::CounterSharedPtr& counter : counters) {
+    entries.push_back({statId(StatType::Counter, *counter), StatType::Counter, counter.get(),
+                       counter->value(), nullptr});
+  }
+  for (const Stats::GaugeSharedPtr& gauge : gauges) {
+    entries.push_back({statId(StatType::Gauge, *gauge), StatType::Gauge, gauge.get(),
+                       gauge->value(), nullptr});
+  }
+  for (const Stats::ParentHistogramSharedPtr& histogram : histograms) {
+    entries.push_back({statId(StatType::Histogram, *histogram), StatType::Histogram,
+                       histogram.get(), 0, histogram.get()});
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& lhs, const Entry& rhs) -> bool { return lhs.id_ < rhs.id_; });
+
+  Snapshot snapshot;
+  snapshot.cursor_ = next_cursor_++;
+  snapshot.present_.resize(stat_names_.size());
+  snapshot.values_.resize(stat_names_.size());
+
+  std::string stats;
+  std::string values;
+  uint64_t num_stats = 0;
+  uint64_t num_values = 0;
+  uint32_t last_stat_id = 0;
+  uint32_t last_value_id = 0;
+  auto add_value_id = [&](uint32_t id) -> void {
+    addVarint(id - last_value_id, values);
+    last_value_id = id;
+    num_values++;
+  };
+  for (const Entry& entry : entries) {
+    if (snapshot.present_[entry.id_]) {
+      // Overlapping scopes return the same stat more than once.
+      continue;
+    }
+    snapshot.present_[entry.id_] = true;
+
+    const bool added =
+        base == nullptr || entry.id_ >= base->present_.size() || !base->present_[entry.id_];
+    if (added) {
+      addVarint(entry.id_ - last_stat_id, stats);
+      addDefinition(entry, stats);
+      last_stat_id = entry.id_;
+      num_stats++;
+    }
+
+    if (entry.type_ == StatType::Histogram) {
+      const Stats::HistogramStatistics& statistics = entry.histogram_->cumulativeStatistics();
+      std::vector<uint64_t> histogram_values{statistics.sampleCount(), statistics.sampleSum()};
+      histogram_values.insert(histogram_values.end(), statistics.computedBuckets().begin(),
+                              statistics.computedBuckets().end());
+      if (added || base->histograms_.at(entry.id_) != histogram_values) {
+        add_value_id(entry.id_);
+        for (uint64_t value : histogram_values) {
+          addVarint(value, values);
+        }
+      }
+      snapshot.histograms_.emplace(entry.id_, std::move(histogram_values));
+    } else {
+      if (added || base->values_[entry.id_] != entry.value_) {
+        add_value_id(entry.id_);
+        addVarint(entry.value_, values);
+      }
+      snapshot.values_[entry.id_] = entry.value_;
+    }
+  }
+
+  std::string removed;
+  uint64_t num_removed = 0;
+  uint32_t last_removed_id = 0;
+  if (base != nullptr) {
+    for (uint32_t id = 0; id < base->present_.size(); id++) {
+      if (base->present_[id] && !snapshot.present_[id]) {
+        addVarint(id - last_removed_id, removed);
+        last_removed_id = id;
+        num_removed++;
+      }
+    }
+  }
+
+  // Definitions add strings, so the strings section is built last.
+  const uint32_t first_string = base != nullptr ? base->strings_sent_ : 0;
+  snapshot.strings_sent_ = strings_.size();
+  std::string encoded = "ESS1";
+  addVarint(snapshot.cursor_, encoded);
+  addVarint(base != nullptr ? base->cursor_ : 0, encoded);
+  addVarint(first_string, encoded);
+  addVarint(strings_.size() - first_string, encoded);
+  for (uint32_t id = first_string; id < strings_.size(); id++) {
+    addString(*strings_[id], encoded);
+  }
+  addVarint(num_stats, encoded);
+  encoded += stats;
+  addVarint(num_values, encoded);
+  encoded += values;
+  addVarint(num_removed, encoded);
+  encoded += removed;
+  response.add(encoded);
+
+  const uint64_t cursor = snapshot.cursor_;
+  snapshots_.push_back(std::move(snapshot));
+  if (snapshots_.size() > max_snapshots_) {
+    snapshots_.pop_front();
+    expireStatIds();
+  }
+  return cursor;
+}
+
+uint32_t BinaryStatsSnapshots::statId(StatType type, const Stats::Metric& metric) {
+  // Stats of the stores are looked up by the name they keep encoded, without decoding it. Other
+  // metrics have to be encoded first.
+  Stats::StatNameStoragePtr storage;
+  Stats::StatName name;
+  const Stats::MetricImpl* metric_impl = dynamic_cast<const Stats::MetricImpl*>(&metric);
+  if (metric_impl != nullptr) {
+    name = metric_impl->statName();
+  } else {
+    storage.reset(new Stats::StatNameStorage(metric.name(), Stats::SymbolTable::global()));
+    name = storage->statName();
+  }
+
+  Stats::StatNameHashMap<uint32_t>& ids = stat_ids_[enumToInt(type)];
+  auto existing = ids.find(name);
+  if (existing != ids.end()) {
+    return existing->second;
+  }
+
+  uint32_t id;
+  if (!free_stat_ids_.empty()) {
+    id = free_stat_ids_.back();
+    free_stat_ids_.pop_back();
+  } else {
+    id = stat_names_.size();
+    stat_names_.emplace_back();
+  }
+  if (storage == nullptr) {
+    storage.reset(new Stats::StatNameStorage(metric.name(), Stats::SymbolTable::global()));
+  }
+  ids.emplace(storage->statName(), id);
+  stat_names_[id] = {type, std::move(storage)};
+  return id;
+}
+
+void BinaryStatsSnapshots::expireStatIds() {
+  std::vector<bool> kept(stat_names_.size());
+  for (const Snapshot& snapshot : snapshots_) {
+    for (uint32_t id = 0; id < snapshot.present_.size(); id++) {
+      if (snapshot.present_[id]) {
+        kept[id] = true;
+      }
+    }
+  }
+
+  for (uint32_t id = 0; id < stat_names_.size(); id++) {
+    StatId& stat = stat_names_[id];
+    if (stat.name_ != nullptr && !kept[id]) {
+      stat_ids_[enumToInt(stat.type_)].erase(stat.name_->statName());
+      stat.name_.reset();
+      free_stat_ids_.push_back(id);
+    }
+  }
+}
+
+uint32_t BinaryStatsSnapshots::stringId(const std::string& string) {
+  auto result = string_ids_.emplace(string, strings_.size());
+  if (result.second) {
+    strings_.push_back(&result.first->first);
+  }
+  return result.first->second;
+}
+
+void BinaryStatsSnapshots::addDefinition(const Entry& entry, std::string& out) {
+  addVarint(enumToInt(entry.type_), out);
+  addString(entry.metric_->name(), out);
+  addVarint(stringId(entry.metric_->tagExtractedName()), out);
+  const std::vector<Stats::Tag> tags = entry.metric_->tags();
+  addVarint(tags.size(), out);
+  for (const Stats::Tag& tag : tags) {
+    addVarint(stringId(tag.name_), out);
+    addVarint(stringId(tag.value_), out);
+  }
+
+  if (entry.type_ == StatType::Histogram) {
+    const std::vector<double>& bounds = entry.histogram_->cumulativeStatistics().supportedBuckets();
+    addVarint(bounds.size(), out);
+    for (double bound : bounds) {
+      uint64_t bits;
+      static_assert(sizeof(bits) == sizeof(bound), "double must be 64 bits");
+      memcpy(&bits, &bound, sizeof(bits));
+      for (uint32_t i = 0; i < sizeof(bits); i++) {
+        out += static_cast<char>(bits >> (8 * i));
+      }
+    }
+  }
+}
+
+void BinaryStatsSnapshots::addVarint(uint64_t value, std::string& out) {
+  while (value >= 0x80) {
+    out += static_cast<char>(value | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+void BinaryStatsSnapshots::addString(const std::string& value, std::string& out) {
+  addVarint(value.size(), out);
+  out += value;
+}
+
 bool AdminImpl::changeLogLevel(const Http::Utility::QueryParams& params) {
   if (params.size() != 1) {
     return false;
@@ -268,6 +658,19 @@ Http::Code AdminImpl::handlerResetCounters(const std::string&, Buffer::Instance&
   return Http::Code::OK;
 }
 
+Http::Code AdminImpl::handlerMemory(const std::string&, Buffer::Instance& response) {
+  // Cluster stats that compact cluster stats have not allocated yet take no stat memory and no
+  // --max-stats slot.
+  uint64_t pending_stats = 0;
+  for (auto& cluster : server_.clusterManager().clusters()) {
+    pending_stats += cluster.second.get().info()->pendingStats();
+  }
+  response.add(fmt::format("allocated: {}\n", Memory::Stats::totalCurrentlyAllocated()));
+  response.add(fmt::format("heap_size: {}\n", Memory::Stats::totalCurrentlyReserved()));
+  response.add(fmt::format("compact_cluster_stats_pending: {}\n", pending_stats));
+  return Http::Code::OK;
+}
+
 Http::Code AdminImpl::handlerServerInfo(const std::string&, Buffer::Instance& response) {
   time_t current_time = time(nullptr);
   response.add(fmt::format("envoy {} {} {} {} {}\n", VersionInfo::version(),
@@ -279,10 +682,37 @@ Http::Code AdminImpl::handlerServerInfo(const std::string&, Buffer::Instance& re
 }
 
 Http::Code AdminImpl::handlerStats(const std::string& url, Buffer::Instance& response) {
-  // We currently don't support timers locally (only via statsd) so just group all the counters
-  // and gauges together, alpha sort them, and spit them out.
+  // Group all the counters and gauges together, alpha sort them, and spit them out. Histograms
+  // follow with the quantiles of the last flush interval and cumulative ones.
   Http::Code rc = Http::Code::OK;
   const Http::Utility::QueryParams params = Http::Utility::parseQueryString(url);
+  if (params.size() == 1 && params.begin()->first == "format" &&
+      params.begin()->second == "prometheus") {
+    // AdminFilter streams this response through createChunkedResponse(). Other callers get all of
+    // it at once.
+    PrometheusStatsFormatter formatter(server_.stats().counters(), server_.stats().gauges(),
+                                       server_.stats().histograms());
+    while (formatter.nextChunk(response)) {
+    }
+    return rc;
+  }
+
+  auto format = params.find("format");
+  if (format != params.end() && format->second == "binary") {
+    // The snapshot is a delta against the client's previous snapshot if it passes its cursor.
+    uint64_t cursor = 0;
+    auto cursor_param = params.find("cursor");
+    const bool valid =
+        cursor_param == params.end()
+            ? params.size() == 1
+            : params.size() == 2 && StringUtil::atoul(cursor_param->second.c_str(), cursor);
+    if (valid) {
+      stats_snapshots_.encode(cursor, server_.stats().counters(), server_.stats().gauges(),
+                              server_.stats().histograms(), response);
+      return rc;
+    }
+  }
+
   std::map<std::string, uint64_t> all_stats;
   for (const Stats::CounterSharedPtr& counter : server_.stats().counters()) {
     all_stats.emplace(counter->name(), counter->value());
@@ -292,18 +722,27 @@ Http::Code AdminImpl::handlerStats(const std::string& url, Buffer::Instance& res
     all_stats.emplace(gauge->name(), gauge->value());
   }
 
+  std::map<std::string, Stats::ParentHistogramSharedPtr> all_histograms;
+  for (const Stats::ParentHistogramSharedPtr& histogram : server_.stats().histograms()) {
+    all_histograms.emplace(histogram->name(), histogram);
+  }
+
   if (params.size() == 0) {
     // No Arguments so use the standard.
     for (auto stat : all_stats) {
       response.add(fmt::format("{}: {}\n", stat.first, stat.second));
     }
+    for (auto histogram : all_histograms) {
+      response.add(fmt::format("{}: {}\n", histogram.first, histogramSummary(*histogram.second)));
+    }
   } else {
     const std::string format_key = params.begin()->first;
     const std::string format_value = params.begin()->second;
     if (format_key == "format" && format_value == "json") {
-      response.add(statsAsJson(all_stats));
+      response.add(statsAsJson(all_stats, all_histograms));
     } else {
-      response.add("usage: /stats?format=json \n");
+      response.add("usage: /stats?format=(json|prometheus) or "
+                   "/stats?format=binary[&cursor=<cursor>] \n");
       response.add("\n");
       rc = Http::Code::NotFound;
     }
@@ -311,7 +750,29 @@ Http::Code AdminImpl::handlerStats(const std::string& url, Buffer::Instance& res
   return rc;
 }
 
-std::string AdminImpl::statsAsJson(const std::map<std::string, uint64_t>& all_stats) {
+std::string AdminImpl::histogramSummary(const Stats::ParentHistogram& histogram) {
+  if (!histogram.used()) {
+    return "No recorded values";
+  }
+
+  // P<quantile>(<interval value>,<cumulative value>) for each supported quantile.
+  std::string summary;
+  const Stats::HistogramStatistics& interval = histogram.intervalStatistics();
+  const Stats::HistogramStatistics& cumulative = histogram.cumulativeStatistics();
+  const std::vector<double>& quantiles = interval.supportedQuantiles();
+  for (size_t i = 0; i < quantiles.size(); i++) {
+    if (i > 0) {
+      summary += " ";
+    }
+    summary += fmt::format("P{:g}({},{})", quantiles[i] * 100, interval.computedQuantiles()[i],
+                           cumulative.computedQuantiles()[i]);
+  }
+  return summary;
+}
+
+std::string AdminImpl::statsAsJson(
+    const std::map<std::string, uint64_t>& all_stats,
+    const std::map<std::string, Stats::ParentHistogramSharedPtr>& all_histograms) {
   rapidjson::Document document;
   document.SetObject();
   rapidjson::Value stats_array(rapidjson::kArrayType);
@@ -328,6 +789,29 @@ std::string AdminImpl::statsAsJson(const std::map<std::string, uint64_t>& all_st
     stats_array.PushBack(stat_obj, allocator);
   }
   document.AddMember("stats", stats_array, allocator);
+
+  rapidjson::Value histograms_array(rapidjson::kArrayType);
+  for (auto histogram : all_histograms) {
+    Value histogram_obj;
+    histogram_obj.SetObject();
+    Value histogram_name;
+    histogram_name.SetString(histogram.first.c_str(), allocator);
+    histogram_obj.AddMember("name", histogram_name, allocator);
+    Value quantiles_array(rapidjson::kArrayType);
+    const Stats::HistogramStatistics& interval = histogram.second->intervalStatistics();
+    const Stats::HistogramStatistics& cumulative = histogram.second->cumulativeStatistics();
+    for (size_t i = 0; i < interval.supportedQuantiles().size(); i++) {
+      Value quantile_obj;
+      quantile_obj.SetObject();
+      quantile_obj.AddMember("quantile", interval.supportedQuantiles()[i], allocator);
+      quantile_obj.AddMember("interval", interval.computedQuantiles()[i], allocator);
+      quantile_obj.AddMember("cumulative", cumulative.computedQuantiles()[i], allocator);
+      quantiles_array.PushBack(quantile_obj, allocator);
+    }
+    histogram_obj.AddMember("quantiles", quantiles_array, allocator);
+    histograms_array.PushBack(histogram_obj, allocator);
+  }
+  document.AddMember("histograms", histograms_array, allocator);
   rapidjson::StringBuffer strbuf;
   rapidjson::PrettyWriter<StringBuffer> writer(strbuf);
   document.Accept(writer);
@@ -371,6 +855,19 @@ void AdminFilter::onComplete() {
   std::string path = request_headers_->Path()->value().c_str();
   ENVOY_STREAM_LOG(info, "request complete: path: {}", *callbacks_, path);
 
+  chunked_response_ = parent_.createChunkedResponse(path);
+  if (chunked_response_) {
+    Http::HeaderMapPtr headers{new Http::HeaderMapImpl{
+        {Http::Headers::get().Status, std::to_string(enumToInt(Http::Code::OK))},
+        {Http::Headers::get().ContentType, "text/plain; version=0.0.4"}}};
+    callbacks_->encodeHeaders(std::move(headers), false);
+    callbacks_->addDownstreamWatermarkCallbacks(*this);
+    watermark_callbacks_added_ = true;
+    chunk_timer_ = callbacks_->dispatcher().createTimer([this]() -> void { sendChunk(); });
+    sendChunk();
+    return;
+  }
+
   Buffer::OwnedImpl response;
   Http::Code code = parent_.runCallback(path, response);
 
@@ -406,6 +903,8 @@ AdminImpl::AdminImpl(const std::string& access_log_path, const std::string& prof
           {"/hot_restart_version", "print the hot restart compatability version",
            MAKE_ADMIN_HANDLER(handlerHotRestartVersion), false},
           {"/logging", "query/change logging levels", MAKE_ADMIN_HANDLER(handlerLogging), false},
+          {"/memory", "print current allocation/heap usage and pending compact cluster stats",
+           MAKE_ADMIN_HANDLER(handlerMemory), false},
           {"/quitquitquit", "exit the server", MAKE_ADMIN_HANDLER(handlerQuitQuitQuit), false},
           {"/reset_counters", "reset all counters to zero",
            MAKE_ADMIN_HANDLER(handlerResetCounters), false},
@@ -479,6 +978,21 @@ Http::Code AdminImpl::runCallback(const std::string& path, Buffer::Instance& res
   return code;
 }
 
+ChunkedResponsePtr AdminImpl::createChunkedResponse(const std::string& path) {
+  if (path.find("/stats") != 0) {
+    return nullptr;
+  }
+
+  const Http::Utility::QueryParams params = Http::Utility::parseQueryString(path);
+  if (params.size() != 1 || params.begin()->first != "format" ||
+      params.begin()->second != "prometheus") {
+    return nullptr;
+  }
+
+  return ChunkedResponsePtr{new PrometheusStatsFormatter(
+      server_.stats().counters(), server_.stats().gauges(), server_.stats().histograms())};
+}
+
 const Network::Address::Instance& AdminImpl::localAddress() {
   return *server_.localInfo().address();
 }
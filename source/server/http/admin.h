@@ -1,13 +1,21 @@
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <deque>
 #include <list>
+#include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
+#include "envoy/event/timer.h"
 #include "envoy/http/filter.h"
 #include "envoy/network/listen_socket.h"
 #include "envoy/server/admin.h"
 #include "envoy/server/instance.h"
+#include "envoy/stats/stats.h"
 #include "envoy/upstream/outlier_detection.h"
 #include "envoy/upstream/resource_manager.h"
 
@@ -16,12 +24,190 @@
 #include "common/http/conn_manager_impl.h"
 #include "common/http/date_provider_impl.h"
 #include "common/http/utility.h"
+#include "common/stats/symbol_table_impl.h"
 
 #include "server/config/network/http_connection_manager.h"
 
 namespace Envoy {
 namespace Server {
 
+/**
+ * An admin response that is too large to build in one go, e.g. the stats of a server with many
+ * clusters. It is produced one chunk at a time so that the response can be streamed without
+ * holding all of it in memory or blocking the event loop while it is rendered.
+ */
+class ChunkedResponse {
+public:
+  virtual ~ChunkedResponse() {}
+
+  /**
+   * Appends the next chunk of the response.
+   * @param response supplies the buffer to append to.
+   * @return bool true if more chunks follow, false if this was the last one.
+   */
+  virtual bool nextChunk(Buffer::Instance& response) PURE;
+};
+
+typedef std::unique_ptr<ChunkedResponse> ChunkedResponsePtr;
+
+/**
+ * Renders stats in the Prometheus text exposition format (version 0.0.4). The tag extracted name
+ * of a stat becomes the metric name and its tags become labels, so that e.g. the upstream_rq_total
+ * counters of all clusters are a single metric family. Histograms are exported as Prometheus
+ * histograms with the cumulative bucket counts of the supported buckets.
+ */
+class PrometheusStatsFormatter : public ChunkedResponse {
+public:
+  PrometheusStatsFormatter(const std::list<Stats::CounterSharedPtr>& counters,
+                           const std::list<Stats::GaugeSharedPtr>& gauges,
+                           const std::list<Stats::ParentHistogramSharedPtr>& histograms,
+                           uint64_t chunk_bytes = DEFAULT_CHUNK_BYTES);
+
+  // Server::ChunkedResponse
+  bool nextChunk(Buffer::Instance& response) override;
+
+  /**
+   * @return std::string the Prometheus metric name of a tag extracted stat name.
+   */
+  static std::string metricName(const std::string& extracted_name);
+
+  /**
+   * @return std::string the comma separated Prometheus labels of tags, without the braces.
+   */
+  static std::string formattedTags(const std::vector<Stats::Tag>& tags);
+
+  // A chunk is closed once it grows past this many bytes.
+  static const uint64_t DEFAULT_CHUNK_BYTES = 64 * 1024;
+
+private:
+  template <class StatType>
+  using Families = std::map<std::string, std::vector<std::shared_ptr<StatType>>>;
+
+  template <class StatType>
+  static void addToFamily(Families<StatType>& families, const std::shared_ptr<StatType>& stat);
+
+  /**
+   * Renders series of families until the chunk is full, removing the families that are done.
+   * @return bool true if all families were rendered.
+   */
+  template <class StatType>
+  bool render(Families<StatType>& families, const std::string& type, Buffer::Instance& response,
+              uint64_t chunk_end);
+
+  static void renderSeries(const std::string& name, const Stats::Counter& counter,
+                           Buffer::Instance& response);
+  static void renderSeries(const std::string& name, const Stats::Gauge& gauge,
+                           Buffer::Instance& response);
+  static void renderSeries(const std::string& name, const Stats::ParentHistogram& histogram,
+                           Buffer::Instance& response);
+
+  const uint64_t chunk_bytes_;
+  Families<Stats::Counter> counters_;
+  Families<Stats::Gauge> gauges_;
+  Families<Stats::ParentHistogram> histograms_;
+  // Index of the next series of the first remaining family.
+  size_t series_index_{};
+};
+
+/**
+ * Encodes stats in a compact binary format for local agents that scrape every few seconds. Each
+ * snapshot gets a cursor, and a client that passes the cursor of its previous snapshot gets a delta
+ * with only the stats that were added, changed or removed since. The last few snapshots are kept;
+ * a client with an unknown or expired cursor gets a full snapshot.
+ *
+ * Integers are unsigned LEB128 varints and strings are a varint length followed by the bytes.
+ * Stats and strings are referred to by ids. String ids stay the same for the life of the server. A
+ * stat keeps its id while it is in one of the kept snapshots, after that the id may be reused for
+ * another stat, which is then defined again. Stat ids within a section are ascending and each is
+ * encoded as the difference to the previous one.
+ *
+ *   snapshot := "ESS1" cursor base strings stats values removed
+ *   cursor   := the cursor to pass as the cursor parameter of the next request
+ *   base     := the cursor of the snapshot this is a delta against, or 0 for a full snapshot, in
+ *               which case the client drops everything it had
+ *   strings  := first_id count string*, the strings with ids first_id to first_id + count - 1
+ *               that the client has not been sent yet
+ *   stats    := count (stat_id type name extracted_name_id tag_count (name_id value_id)* bounds)*,
+ *               one for each stat that is not in base. type is 0 for counters, 1 for gauges and
+ *               2 for histograms. Only histograms have bounds := count double*, the upper bounds of
+ *               their buckets as 8 byte little endian IEEE 754 values.
+ *   values   := count (stat_id value)*, one for each stat that is new or changed since base. The
+ *               value of a counter or gauge is its value, that of a histogram is the cumulative
+ *               sample_count sample_sum bucket_count*.
+ *   removed  := count stat_id*, the stats of base that no longer exist.
+ */
+class BinaryStatsSnapshots {
+public:
+  BinaryStatsSnapshots(uint32_t max_snapshots = DEFAULT_MAX_SNAPSHOTS);
+
+  /**
+   * Takes a snapshot of stats and encodes it.
+   * @param base supplies the cursor of the client's previous snapshot, or 0 for a full snapshot.
+   * @param response supplies the buffer to append the encoded snapshot to.
+   * @return uint64_t the cursor of the new snapshot.
+   */
+  uint64_t encode(uint64_t base, const std::list<Stats::CounterSharedPtr>& counters,
+                  const std::list<Stats::GaugeSharedPtr>& gauges,
+                  const std::list<Stats::ParentHistogramSharedPtr>& histograms,
+                  Buffer::Instance& response);
+
+  // The number of snapshots kept to compute deltas against. Each takes about 8 bytes per stat.
+  static const uint32_t DEFAULT_MAX_SNAPSHOTS = 4;
+
+private:
+  enum class StatType : uint8_t { Counter = 0, Gauge = 1, Histogram = 2 };
+
+  struct Snapshot {
+    uint64_t cursor_;
+    // Strings with smaller ids have been sent to the client of this snapshot.
+    uint32_t strings_sent_;
+    // Indexed by stat id.
+    std::vector<bool> present_;
+    std::vector<uint64_t> values_;
+    std::unordered_map<uint32_t, std::vector<uint64_t>> histograms_;
+  };
+
+  /**
+   * A stat of the snapshot being encoded.
+   */
+  struct Entry {
+    uint32_t id_;
+    StatType type_;
+    const Stats::Metric* metric_;
+    // The value of a counter or gauge.
+    uint64_t value_;
+    const Stats::ParentHistogram* histogram_;
+  };
+
+  struct StatId {
+    StatType type_;
+    // The encoded name of the stat, nullptr if the id is free.
+    Stats::StatNameStoragePtr name_;
+  };
+
+  uint32_t statId(StatType type, const Stats::Metric& metric);
+  void expireStatIds();
+  uint32_t stringId(const std::string& string);
+  void addDefinition(const Entry& entry, std::string& out);
+  static void addVarint(uint64_t value, std::string& out);
+  static void addString(const std::string& value, std::string& out);
+
+  const uint32_t max_snapshots_;
+  uint64_t next_cursor_{1};
+  // Ids of stats that are in none of the kept snapshots are reused, since no client with a valid
+  // cursor knows them. The stat tables only grow with the number of stats that exist at once.
+  // Indexed by StatType, the keys point into the names of stat_names_.
+  std::array<Stats::StatNameHashMap<uint32_t>, 3> stat_ids_;
+  // Indexed by stat id.
+  std::vector<StatId> stat_names_;
+  std::vector<uint32_t> free_stat_ids_;
+  // String ids are never reused. Strings are extracted names and tags, which are few.
+  std::unordered_map<std::string, uint32_t> string_ids_;
+  // Indexed by string id, points to the keys of string_ids_.
+  std::vector<const std::string*> strings_;
+  std::deque<Snapshot> snapshots_;
+};
+
 /**
  * Implementation of Server::admin.
  */
@@ -36,6 +222,12 @@ public:
             Server::Instance& server);
 
   Http::Code runCallback(const std::string& path, Buffer::Instance& response);
+
+  /**
+   * @return ChunkedResponsePtr a response to stream for path, or nullptr if the response of path
+   *         is built by runCallback().
+   */
+  ChunkedResponsePtr createChunkedResponse(const std::string& path);
   const Network::ListenSocket& socket() override { return *socket_; }
   Network::ListenSocket& mutable_socket() { return *socket_; }
 
@@ -113,7 +305,10 @@ private:
   void addOutlierInfo(const std::string& cluster_name,
                       const Upstream::Outlier::Detector* outlier_detector,
                       Buffer::Instance& response);
-  std::string statsAsJson(const std::map<std::string, uint64_t>& all_stats);
+  static std::string histogramSummary(const Stats::ParentHistogram& histogram);
+  std::string
+  statsAsJson(const std::map<std::string, uint64_t>& all_stats,
+              const std::map<std::string, Stats::ParentHistogramSharedPtr>& all_histograms);
 
   /**
    * URL handlers.
@@ -125,6 +320,7 @@ private:
   Http::Code handlerHealthcheckOk(const std::string& url, Buffer::Instance& response);
   Http::Code handlerHotRestartVersion(const std::string& url, Buffer::Instance& response);
   Http::Code handlerLogging(const std::string& url, Buffer::Instance& response);
+  Http::Code handlerMemory(const std::string& url, Buffer::Instance& response);
   Http::Code handlerResetCounters(const std::string& url, Buffer::Instance& response);
   Http::Code handlerServerInfo(const std::string& url, Buffer::Instance& response);
   Http::Code handlerStats(const std::string& url, Buffer::Instance& response);
@@ -144,17 +340,20 @@ private:
   Http::SlowDateProviderImpl date_provider_;
   std::vector<Http::ClientCertDetailsType> set_current_client_cert_details_;
   Http::ConnectionManagerListenerStats listener_stats_;
+  BinaryStatsSnapshots stats_snapshots_;
 };
 
 /**
  * A terminal HTTP filter that implements server admin functionality.
  */
-class AdminFilter : public Http::StreamDecoderFilter, Logger::Loggable<Logger::Id::admin> {
+class AdminFilter : public Http::StreamDecoderFilter,
+                    public Http::DownstreamWatermarkCallbacks,
+                    Logger::Loggable<Logger::Id::admin> {
 public:
   AdminFilter(AdminImpl& parent);
 
   // Http::StreamFilterBase
-  void onDestroy() override {}
+  void onDestroy() override;
 
   // Http::StreamDecoderFilter
   Http::FilterHeadersStatus decodeHeaders(Http::HeaderMap& headers, bool end_stream) override;
@@ -164,15 +363,30 @@ public:
     callbacks_ = &callbacks;
   }
 
+  // Http::DownstreamWatermarkCallbacks
+  void onAboveWriteBufferHighWatermark() override { above_high_watermark_ = true; }
+  void onBelowWriteBufferLowWatermark() override;
+
 private:
   /**
    * Called when an admin request has been completely received.
    */
   void onComplete();
 
+  /**
+   * Sends the next chunk of chunked_response_. Chunks are sent one per event loop iteration, and
+   * not at all while the downstream connection is above its high watermark.
+   */
+  void sendChunk();
+  void stopWatermarkCallbacks();
+
   AdminImpl& parent_;
   Http::StreamDecoderFilterCallbacks* callbacks_{};
   Http::HeaderMap* request_headers_{};
+  ChunkedResponsePtr chunked_response_;
+  Event::TimerPtr chunk_timer_;
+  bool watermark_callbacks_added_{};
+  bool above_high_watermark_{};
 };
 
 } // namespace Server
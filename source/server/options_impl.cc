@@ -1,5 +1,6 @@
 #include "server/options_impl.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <iostream>
@@ -25,6 +26,12 @@
 #define ENVOY_DEFAULT_MAX_OBJ_NAME_LENGTH 60
 #endif
 
+// Names are rarely longer than 60 characters, and the name table is shared by all stats so a
+// longer name only needs a shorter one elsewhere.
+#ifndef ENVOY_DEFAULT_STATS_NAME_BYTES_PER_STAT
+#define ENVOY_DEFAULT_STATS_NAME_BYTES_PER_STAT 64
+#endif
+
 #if ENVOY_DEFAULT_MAX_OBJ_NAME_LENGTH < 60
 #error "ENVOY_DEFAULT_MAX_OBJ_NAME_LENGTH must be >= 60"
 #endif
@@ -46,6 +53,12 @@ OptionsImpl::OptionsImpl(int argc, char** argv, const HotRestartVersionCb& hot_r
       "uint32_t", cmd);
   TCLAP::ValueArg<uint32_t> concurrency("", "concurrency", "# of worker threads to run", false,
                                         std::thread::hardware_concurrency(), "uint32_t", cmd);
+  TCLAP::ValueArg<uint32_t> health_check_concurrency(
+      "", "health-check-concurrency",
+      "# of dedicated threads to shard active health checking across (0 for main thread)", false,
+      0, "uint32_t", cmd);
+  TCLAP::SwitchArg config_worker("", "config-worker",
+                                 "decode ADS responses on a dedicated thread", cmd);
   TCLAP::ValueArg<std::string> config_path("c", "config-path", "Path to configuration file", false,
                                            "", "string", cmd);
   TCLAP::ValueArg<std::string> admin_address_path("", "admin-address-path", "Admin address path",
@@ -91,6 +104,22 @@ OptionsImpl::OptionsImpl(int argc, char** argv, const HotRestartVersionCb& hot_r
                                              " the cluster name)",
                                              false, ENVOY_DEFAULT_MAX_OBJ_NAME_LENGTH, "uint64_t",
                                              cmd);
+  TCLAP::ValueArg<uint64_t> stats_name_table_bytes(
+      "", "stats-name-table-bytes",
+      fmt::format("Bytes of shared memory reserved for the names of the stats allocated in shared "
+                  "memory (default: {} per --max-stats, at most 4GiB)",
+                  ENVOY_DEFAULT_STATS_NAME_BYTES_PER_STAT),
+      false, 0, "uint64_t", cmd);
+  TCLAP::MultiArg<std::string> stats_include(
+      "", "stats-include",
+      "only export stats that match one of these prefix:<value>, suffix:<value> or "
+      "regex:<value> patterns",
+      false, "string", cmd);
+  TCLAP::MultiArg<std::string> stats_exclude(
+      "", "stats-exclude",
+      "do not export stats that match one of these prefix:<value>, suffix:<value> or "
+      "regex:<value> patterns",
+      false, "string", cmd);
 
   try {
     cmd.parse(argc, argv);
@@ -105,10 +134,24 @@ OptionsImpl::OptionsImpl(int argc, char** argv, const HotRestartVersionCb& hot_r
     exit(1);
   }
 
+  // Name offsets in the table are 32 bits.
+  if (stats_name_table_bytes.getValue() > UINT32_MAX) {
+    std::cerr << "error: the 'stats-name-table-bytes' value specified ("
+              << stats_name_table_bytes.getValue() << ") is more than the maximum value of "
+              << UINT32_MAX << std::endl;
+    exit(1);
+  }
+  stats_name_table_bytes_ = stats_name_table_bytes.isSet()
+                                ? stats_name_table_bytes.getValue()
+                                : std::min<uint64_t>(ENVOY_DEFAULT_STATS_NAME_BYTES_PER_STAT *
+                                                         max_stats.getValue(),
+                                                     UINT32_MAX);
+
   if (hot_restart_version_option.getValue()) {
     std::cerr << hot_restart_version_cb(max_stats.getValue(),
                                         max_obj_name_len.getValue() +
-                                            Stats::RawStatData::maxStatSuffixLength());
+                                            Stats::RawStatData::maxStatSuffixLength(),
+                                        stats_name_table_bytes_);
     exit(0);
   }
 
@@ -141,6 +184,8 @@ OptionsImpl::OptionsImpl(int argc, char** argv, const HotRestartVersionCb& hot_r
   // For base ID, scale what the user inputs by 10 so that we have spread for domain sockets.
   base_id_ = base_id.getValue() * 10;
   concurrency_ = concurrency.getValue();
+  health_check_concurrency_ = health_check_concurrency.getValue();
+  config_worker_ = config_worker.getValue();
   config_path_ = config_path.getValue();
   admin_address_path_ = admin_address_path.getValue();
   log_path_ = log_path.getValue();
@@ -153,5 +198,7 @@ OptionsImpl::OptionsImpl(int argc, char** argv, const HotRestartVersionCb& hot_r
   parent_shutdown_time_ = std::chrono::seconds(parent_shutdown_time_s.getValue());
   max_stats_ = max_stats.getValue();
   max_obj_name_length_ = max_obj_name_len.getValue();
+  stats_inclusions_ = stats_include.getValue();
+  stats_exclusions_ = stats_exclude.getValue();
 }
 } // namespace Envoy
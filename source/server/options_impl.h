@@ -3,6 +3,7 @@
 #include <chrono>
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "envoy/server/options.h"
 
@@ -14,7 +15,7 @@ namespace Envoy {
  */
 class OptionsImpl : public Server::Options {
 public:
-  typedef std::function<std::string(uint64_t, uint64_t)> HotRestartVersionCb;
+  typedef std::function<std::string(uint64_t, uint64_t, uint64_t)> HotRestartVersionCb;
 
   OptionsImpl(int argc, char** argv, const HotRestartVersionCb& hot_restart_version_cb,
               spdlog::level::level_enum default_log_level);
@@ -22,6 +23,8 @@ public:
   // Server::Options
   uint64_t baseId() override { return base_id_; }
   uint32_t concurrency() override { return concurrency_; }
+  uint32_t healthCheckConcurrency() override { return health_check_concurrency_; }
+  bool configWorker() override { return config_worker_; }
   const std::string& configPath() override { return config_path_; }
   const std::string& adminAddressPath() override { return admin_address_path_; }
   Network::Address::IpVersion localAddressIpVersion() override { return local_address_ip_version_; }
@@ -37,10 +40,15 @@ public:
   const std::string& serviceZone() override { return service_zone_; }
   uint64_t maxStats() override { return max_stats_; }
   uint64_t maxObjNameLength() override { return max_obj_name_length_; }
+  uint64_t statsNameTableBytes() override { return stats_name_table_bytes_; }
+  const std::vector<std::string>& statsInclusions() override { return stats_inclusions_; }
+  const std::vector<std::string>& statsExclusions() override { return stats_exclusions_; }
 
 private:
   uint64_t base_id_;
   uint32_t concurrency_;
+  uint32_t health_check_concurrency_;
+  bool config_worker_;
   std::string config_path_;
   std::string admin_address_path_;
   Network::Address::IpVersion local_address_ip_version_;
@@ -56,5 +64,8 @@ private:
   Server::Mode mode_;
   uint64_t max_stats_;
   uint64_t max_obj_name_length_;
+  uint64_t stats_name_table_bytes_;
+  std::vector<std::string> stats_inclusions_;
+  std::vector<std::string> stats_exclusions_;
 };
 } // namespace Envoy
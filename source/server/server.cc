@@ -98,8 +98,8 @@ void InstanceImpl::failHealthcheck(bool fail) {
   server_stats_->live_.set(!fail);
 }
 
-void InstanceUtil::flushCountersAndGaugesToSinks(const std::list<Stats::SinkPtr>& sinks,
-                                                 Stats::Store& store) {
+void InstanceUtil::flushMetricsToSinks(const std::list<Stats::SinkPtr>& sinks,
+                                       Stats::Store& store) {
   for (const auto& sink : sinks) {
     sink->beginFlush();
   }
@@ -126,6 +126,25 @@ void InstanceUtil::flushCountersAndGaugesToSinks(const std::list<Stats::SinkPtr>
   }
 }
 
+void InstanceUtil::flushHistogramsToSinks(const std::list<Stats::SinkPtr>& sinks,
+                                          Stats::Store& store) {
+  for (const auto& sink : sinks) {
+    sink->beginFlush();
+  }
+
+  for (const Stats::ParentHistogramSharedPtr& histogram : store.histograms()) {
+    if (histogram->used()) {
+      for (const auto& sink : sinks) {
+        sink->flushHistogram(*histogram);
+      }
+    }
+  }
+
+  for (const auto& sink : sinks) {
+    sink->endFlush();
+  }
+}
+
 void InstanceImpl::flushStats() {
   ENVOY_LOG(debug, "flushing stats");
   HotRestart::GetParentStatsInfo info;
@@ -139,10 +158,26 @@ void InstanceImpl::flushStats() {
   server_stats_->days_until_first_cert_expiring_.set(
       sslContextManager().daysUntilFirstCertExpires());
 
-  InstanceUtil::flushCountersAndGaugesToSinks(config_->statsSinks(), stats_store_);
+  InstanceUtil::flushMetricsToSinks(config_->statsSinks(), stats_store_);
+
+  // Histograms are merged asynchronously since every worker has to hand over its values first.
+  // A worker that is stuck only holds back the histograms: counters and gauges keep being flushed
+  // on schedule, and no further merge is started until the pending one completes.
+  if (histogram_merge_pending_) {
+    ENVOY_LOG(debug, "histogram merge still pending, not flushing histograms");
+  } else {
+    histogram_merge_pending_ = true;
+    stats_store_.mergeHistograms([this]() -> void { flushHistograms(); });
+  }
+
   stat_flush_timer_->enableTimer(config_->statsFlushInterval());
 }
 
+void InstanceImpl::flushHistograms() {
+  histogram_merge_pending_ = false;
+  InstanceUtil::flushHistogramsToSinks(config_->statsSinks(), stats_store_);
+}
+
 void InstanceImpl::getParentStats(HotRestart::GetParentStatsInfo& info) {
   info.memory_allocated_ = Memory::Stats::totalCurrentlyAllocated();
   info.num_connections_ = numConnections();
@@ -173,6 +208,9 @@ void InstanceImpl::initialize(Options& options,
   // stats.
   tag_extractors_ = Config::Utility::createTagExtractors(bootstrap);
   stats_store_.setTagExtractors(tag_extractors_);
+  stats_matcher_.reset(
+      new Stats::StatsMatcherImpl(options.statsInclusions(), options.statsExclusions()));
+  stats_store_.setStatsMatcher(*stats_matcher_);
 
   server_stats_.reset(
       new ServerStats{ALL_SERVER_STATS(POOL_GAUGE_PREFIX(stats_store_, "server."))});
@@ -212,6 +250,14 @@ void InstanceImpl::initialize(Options& options,
   listener_manager_.reset(
       new ListenerManagerImpl(*this, listener_component_factory_, worker_factory_));
 
+  // Health check shards also register for thread local updates and start running right away since
+  // the first health check round happens during cluster initialization.
+  if (options.healthCheckConcurrency() > 0) {
+    health_check_shard_pool_.reset(new Upstream::HealthCheckShardPool(
+        options.healthCheckConcurrency(), *api_, thread_local_, stats_store_,
+        ProdMonotonicTimeSource::instance_));
+  }
+
   // The main thread is also registered for thread local updates so that code that does not care
   // whether it runs on the main thread or on workers can still use TLS.
   thread_local_.registerThread(*dispatcher_, true);
@@ -226,9 +272,14 @@ void InstanceImpl::initialize(Options& options,
   // Once we have runtime we can initialize the SSL context manager.
   ssl_context_manager_.reset(new Ssl::ContextManagerImpl(*runtime_loader_));
 
+  if (options.configWorker()) {
+    config_worker_.reset(new Config::ConfigWorkerImpl(*dispatcher_, stats_store_,
+                                                      ProdMonotonicTimeSource::instance_));
+  }
+
   cluster_manager_factory_.reset(new Upstream::ProdClusterManagerFactory(
       runtime(), stats(), threadLocal(), random(), dnsResolver(), sslContextManager(), dispatcher(),
-      localInfo()));
+      localInfo(), health_check_shard_pool_.get(), config_worker_.get()));
 
   // Now the configuration gets parsed. The configuration may start setting thread local data
   // per above. See MainImpl::initialize() for why we do this pointer dance.
@@ -364,6 +415,17 @@ void InstanceImpl::run() {
   }
 
   config_->clusterManager().shutdown();
+
+  // All health checkers are gone at this point so the health check shards can exit.
+  if (health_check_shard_pool_) {
+    health_check_shard_pool_->shutdown();
+  }
+
+  // Anything the config worker posts from here on is never committed.
+  if (config_worker_) {
+    config_worker_->shutdown();
+  }
+
   handler_.reset();
   thread_local_.shutdownThread();
   ENVOY_LOG(warn, "exiting");
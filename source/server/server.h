@@ -18,8 +18,10 @@
 #include "envoy/tracing/http_tracer.h"
 
 #include "common/access_log/access_log_manager_impl.h"
+#include "common/config/config_worker_impl.h"
 #include "common/runtime/runtime_impl.h"
 #include "common/ssl/context_manager_impl.h"
+#include "common/upstream/health_check_shard_pool.h"
 
 #include "server/http/admin.h"
 #include "server/init_manager_impl.h"
@@ -79,13 +81,21 @@ public:
   static Runtime::LoaderPtr createRuntime(Instance& server, Server::Configuration::Initial& config);
 
   /**
-   * Helper for flushing counters and gauges to sinks. This takes care of calling beginFlush(),
-   * latching of counters and flushing, flushing of gauges, and calling endFlush(), on each sink.
+   * Helper for flushing metrics to sinks. This takes care of calling beginFlush(), latching of
+   * counters and flushing, flushing of gauges, and calling endFlush(), on each sink.
    * @param sinks supplies the list of sinks.
    * @param store supplies the store to flush.
    */
-  static void flushCountersAndGaugesToSinks(const std::list<Stats::SinkPtr>& sinks,
-                                            Stats::Store& store);
+  static void flushMetricsToSinks(const std::list<Stats::SinkPtr>& sinks, Stats::Store& store);
+
+  /**
+   * Helper for flushing the used merged histograms to sinks between beginFlush() and endFlush().
+   * Histograms are flushed on their own since merging them waits for every worker.
+   * @param sinks supplies the list of sinks.
+   * @param store supplies the store to flush.
+   */
+  static void flushHistogramsToSinks(const std::list<Stats::SinkPtr>& sinks,
+                                     Stats::Store& store);
 };
 
 /**
@@ -154,6 +164,7 @@ public:
 
 private:
   void flushStats();
+  void flushHistograms();
   void initialize(Options& options, Network::Address::InstanceConstSharedPtr local_address,
                   ComponentFactory& component_factory);
   void loadServerFlags(const Optional<std::string>& flags_path);
@@ -166,6 +177,7 @@ private:
   time_t original_start_time_;
   Stats::StoreRoot& stats_store_;
   std::vector<Stats::TagExtractorPtr> tag_extractors_;
+  Stats::StatsMatcherPtr stats_matcher_;
   std::unique_ptr<ServerStats> server_stats_;
   ThreadLocal::Instance& thread_local_;
   Api::ApiPtr api_;
@@ -179,10 +191,14 @@ private:
   ProdListenerComponentFactory listener_component_factory_;
   ProdWorkerFactory worker_factory_;
   std::unique_ptr<ListenerManager> listener_manager_;
+  Upstream::HealthCheckShardPoolPtr health_check_shard_pool_;
+  std::unique_ptr<Config::ConfigWorkerImpl> config_worker_;
   std::unique_ptr<Configuration::Main> config_;
   Stats::ScopePtr admin_scope_;
   Network::DnsResolverSharedPtr dns_resolver_;
   Event::TimerPtr stat_flush_timer_;
+  // Whether a histogram merge was started and has not completed yet.
+  bool histogram_merge_pending_{};
   LocalInfo::LocalInfoPtr local_info_;
   DrainManagerPtr drain_manager_;
   AccessLog::AccessLogManagerImpl access_log_manager_;
@@ -0,0 +1,68 @@
+#include <vector>
+
+#include "common/common/thread.h"
+#include "common/common/utility.h"
+#include "common/config/config_worker_impl.h"
+#include "common/event/dispatcher_impl.h"
+#include "common/stats/stats_impl.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Config {
+namespace {
+
+TEST(ConfigWorkerImplTest, WorkAndCommitOrder) {
+  Event::DispatcherImpl dispatcher;
+  Stats::IsolatedStoreImpl stats_store;
+  ConfigWorkerImpl config_worker(dispatcher, stats_store, ProdMonotonicTimeSource::instance_);
+
+  const Thread::ThreadId main_thread_id = Thread::Thread::currentThreadId();
+  std::vector<int> worked;
+  std::vector<int> committed;
+  const int items = 10;
+  for (int i = 0; i < items; i++) {
+    config_worker.post(
+        [&worked, i, main_thread_id]() -> void {
+          EXPECT_NE(main_thread_id, Thread::Thread::currentThreadId());
+          worked.push_back(i);
+        },
+        [&, i]() -> void {
+          EXPECT_EQ(main_thread_id, Thread::Thread::currentThreadId());
+          committed.push_back(i);
+          if (i == items - 1) {
+            dispatcher.exit();
+          }
+        });
+  }
+  dispatcher.run(Event::Dispatcher::RunType::Block);
+
+  std::vector<int> expected;
+  for (int i = 0; i < items; i++) {
+    expected.push_back(i);
+  }
+  EXPECT_EQ(expected, worked);
+  EXPECT_EQ(expected, committed);
+  EXPECT_EQ(10UL, stats_store.counter("config_worker.work_total").value());
+  EXPECT_EQ(0UL, stats_store.gauge("config_worker.work_pending").value());
+
+  // After shutdown both callbacks run inline.
+  config_worker.shutdown();
+  bool ran_work = false;
+  bool ran_commit = false;
+  config_worker.post(
+      [&]() -> void {
+        EXPECT_EQ(main_thread_id, Thread::Thread::currentThreadId());
+        ran_work = true;
+      },
+      [&]() -> void {
+        EXPECT_TRUE(ran_work);
+        ran_commit = true;
+      });
+  EXPECT_TRUE(ran_commit);
+  EXPECT_EQ(11UL, stats_store.counter("config_worker.work_total").value());
+}
+
+} // namespace
+} // namespace Config
+} // namespace Envoy
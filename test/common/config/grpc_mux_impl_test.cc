@@ -280,6 +280,121 @@ TEST_F(GrpcMuxImplTest, WatchDemux) {
   expectSendMessage(type_url, {}, "2");
 }
 
+// Keeps the resources the mux unpacked.
+class UnpackedGrpcMuxCallbacks : public MockGrpcMuxCallbacks {
+public:
+  void onUnpackedConfigUpdate(const Protobuf::RepeatedPtrField<ProtobufWkt::Any>& resources,
+                              std::vector<ProtobufTypes::MessagePtr>&& unpacked,
+                              const std::string& version_info) override {
+    unpacked_ = std::move(unpacked);
+    onConfigUpdate(resources, version_info);
+  }
+
+  std::vector<ProtobufTypes::MessagePtr> unpacked_;
+};
+
+// Validate that resources are unpacked once and handed to the first watch that wants them. Later
+// watches for the same resource get it packed.
+TEST_F(GrpcMuxImplTest, UnpackedResources) {
+  InSequence s;
+  UnpackedGrpcMuxCallbacks foo_callbacks;
+  UnpackedGrpcMuxCallbacks bar_callbacks;
+  const std::string& type_url = Config::TypeUrl::get().ClusterLoadAssignment;
+  auto foo_sub = grpc_mux_->subscribe(type_url, {"x"}, foo_callbacks);
+  auto bar_sub = grpc_mux_->subscribe(type_url, {"x"}, bar_callbacks);
+  EXPECT_CALL(*async_client_, start(_, _)).WillOnce(Return(&async_stream_));
+  expectSendMessage(type_url, {"x"}, "");
+  grpc_mux_->start();
+
+  envoy::api::v2::ClusterLoadAssignment load_assignment;
+  load_assignment.set_cluster_name("x");
+  std::unique_ptr<envoy::api::v2::DiscoveryResponse> response(
+      new envoy::api::v2::DiscoveryResponse());
+  response->set_type_url(type_url);
+  response->set_version_info("1");
+  response->add_resources()->PackFrom(load_assignment);
+  // Watches are delivered to in reverse order of subscription.
+  EXPECT_CALL(bar_callbacks, onConfigUpdate(_, "1"));
+  EXPECT_CALL(foo_callbacks, onConfigUpdate(_, "1"));
+  expectSendMessage(type_url, {"x"}, "1");
+  grpc_mux_->onReceiveMessage(std::move(response));
+
+  ASSERT_EQ(1UL, bar_callbacks.unpacked_.size());
+  EXPECT_EQ("x", dynamic_cast<envoy::api::v2::ClusterLoadAssignment&>(*bar_callbacks.unpacked_[0])
+                     .cluster_name());
+  EXPECT_TRUE(foo_callbacks.unpacked_.empty());
+
+  expectSendMessage(type_url, {"x"}, "1");
+  expectSendMessage(type_url, {}, "1");
+}
+
+// Validate that with a config worker, callbacks only run on commit and that commits for a replaced
+// stream are dropped.
+TEST_F(GrpcMuxImplTest, ConfigWorker) {
+  InSequence s;
+  MockConfigWorker config_worker;
+  UnpackedGrpcMuxCallbacks callbacks;
+  std::function<void()> work;
+  std::function<void()> commit;
+  grpc_mux_->setConfigWorker(config_worker);
+  const std::string& type_url = Config::TypeUrl::get().ClusterLoadAssignment;
+  auto foo_sub = grpc_mux_->subscribe(type_url, {"x"}, callbacks);
+  EXPECT_CALL(*async_client_, start(_, _)).WillOnce(Return(&async_stream_));
+  expectSendMessage(type_url, {"x"}, "");
+  grpc_mux_->start();
+
+  envoy::api::v2::ClusterLoadAssignment load_assignment;
+  load_assignment.set_cluster_name("x");
+  {
+    std::unique_ptr<envoy::api::v2::DiscoveryResponse> response(
+        new envoy::api::v2::DiscoveryResponse());
+    response->set_type_url(type_url);
+    response->set_version_info("1");
+    response->add_resources()->PackFrom(load_assignment);
+    EXPECT_CALL(config_worker, post(_, _))
+        .WillOnce(Invoke([&](std::function<void()> w, std::function<void()> c) -> void {
+          work = w;
+          commit = c;
+        }));
+    grpc_mux_->onReceiveMessage(std::move(response));
+  }
+
+  work();
+  EXPECT_CALL(callbacks, onConfigUpdate(_, "1"))
+      .WillOnce(Invoke([](const Protobuf::RepeatedPtrField<ProtobufWkt::Any>& resources,
+                          const std::string&) { EXPECT_EQ(1, resources.size()); }));
+  expectSendMessage(type_url, {"x"}, "1");
+  commit();
+  EXPECT_EQ(1UL, callbacks.unpacked_.size());
+
+  {
+    std::unique_ptr<envoy::api::v2::DiscoveryResponse> response(
+        new envoy::api::v2::DiscoveryResponse());
+    response->set_type_url(type_url);
+    response->set_version_info("2");
+    response->add_resources()->PackFrom(load_assignment);
+    EXPECT_CALL(config_worker, post(_, _))
+        .WillOnce(Invoke([&](std::function<void()> w, std::function<void()> c) -> void {
+          work = w;
+          commit = c;
+        }));
+    grpc_mux_->onReceiveMessage(std::move(response));
+  }
+
+  EXPECT_CALL(callbacks, onConfigUpdateFailed(_));
+  EXPECT_CALL(*timer_, enableTimer(_));
+  grpc_mux_->onRemoteClose(Grpc::Status::GrpcStatus::Canceled, "");
+  EXPECT_CALL(*async_client_, start(_, _)).WillOnce(Return(&async_stream_));
+  expectSendMessage(type_url, {"x"}, "1");
+  timer_cb_();
+
+  // The update arrived on the old stream, so neither the callbacks nor the version see it.
+  work();
+  commit();
+
+  expectSendMessage(type_url, {}, "1");
+}
+
 } // namespace
 } // namespace Config
 } // namespace Envoy
@@ -262,6 +262,84 @@ TEST_F(Http1ConnPoolImplTest, MultipleRequestAndResponse) {
   dispatcher_.clearDeferredDeleteList();
 }
 
+/**
+ * Test that min idle prefetching opens a spare connection, that the spare is used by whichever
+ * request gets to it first, and that a remotely closed connection is replaced.
+ */
+TEST_F(Http1ConnPoolImplTest, PrefetchMinIdle) {
+  cluster_->prefetch_min_idle_connections_ = 1;
+  InSequence s;
+
+  // The request opens a connection and the pool prefetches one more.
+  NiceMock<Http::MockStreamDecoder> outer_decoder;
+  ConnPoolCallbacks callbacks;
+  conn_pool_.expectClientCreate();
+  conn_pool_.expectClientCreate();
+  Http::ConnectionPool::Cancellable* handle = conn_pool_.newStream(outer_decoder, callbacks);
+  EXPECT_NE(nullptr, handle);
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_prefetch_.value());
+
+  // The prefetched connection comes up first and takes the request.
+  NiceMock<Http::MockStreamEncoder> request_encoder;
+  Http::StreamDecoder* inner_decoder;
+  EXPECT_CALL(*conn_pool_.test_clients_[1].connect_timer_, disableTimer());
+  EXPECT_CALL(*conn_pool_.test_clients_[1].codec_, newStream(_))
+      .WillOnce(DoAll(SaveArgAddress(&inner_decoder), ReturnRef(request_encoder)));
+  EXPECT_CALL(callbacks.pool_ready_, ready());
+  conn_pool_.test_clients_[1].connection_->raiseEvent(Network::ConnectionEvent::Connected);
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_prefetch_used_.value());
+
+  // The other one stays idle.
+  EXPECT_CALL(*conn_pool_.test_clients_[0].connect_timer_, disableTimer());
+  conn_pool_.test_clients_[0].connection_->raiseEvent(Network::ConnectionEvent::Connected);
+
+  // When the upstream closes the idle connection it is replaced.
+  conn_pool_.expectClientCreate();
+  conn_pool_.test_clients_[0].connection_->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  EXPECT_CALL(conn_pool_, onClientDestroy());
+  dispatcher_.clearDeferredDeleteList();
+  EXPECT_EQ(2U, cluster_->stats_.upstream_cx_prefetch_.value());
+
+  // The replacement never gets used.
+  conn_pool_.closeConnections();
+  EXPECT_CALL(conn_pool_, onClientDestroy()).Times(2);
+  dispatcher_.clearDeferredDeleteList();
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_prefetch_used_.value());
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_prefetch_unused_.value());
+}
+
+/**
+ * Test that a prefetched connection failing to connect does not fail pending requests.
+ */
+TEST_F(Http1ConnPoolImplTest, PrefetchConnectFailure) {
+  cluster_->prefetch_min_idle_connections_ = 1;
+  InSequence s;
+
+  NiceMock<Http::MockStreamDecoder> outer_decoder;
+  ConnPoolCallbacks callbacks;
+  conn_pool_.expectClientCreate();
+  conn_pool_.expectClientCreate();
+  Http::ConnectionPool::Cancellable* handle = conn_pool_.newStream(outer_decoder, callbacks);
+  EXPECT_NE(nullptr, handle);
+
+  // The prefetched connection fails. The request keeps waiting for the other one.
+  EXPECT_CALL(callbacks.pool_failure_, ready()).Times(0);
+  EXPECT_CALL(*conn_pool_.test_clients_[1].connect_timer_, disableTimer());
+  conn_pool_.test_clients_[1].connection_->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  EXPECT_CALL(conn_pool_, onClientDestroy());
+  dispatcher_.clearDeferredDeleteList();
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_connect_fail_.value());
+  EXPECT_EQ(0U, cluster_->stats_.upstream_rq_pending_failure_eject_.value());
+
+  // The request's own connection failing still fails it.
+  EXPECT_CALL(callbacks.pool_failure_, ready());
+  EXPECT_CALL(*conn_pool_.test_clients_[0].connect_timer_, disableTimer());
+  conn_pool_.test_clients_[0].connection_->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  EXPECT_CALL(conn_pool_, onClientDestroy());
+  dispatcher_.clearDeferredDeleteList();
+  EXPECT_EQ(1U, cluster_->stats_.upstream_rq_pending_failure_eject_.value());
+}
+
 /**
  * Test when we overflow max pending requests.
  */
@@ -517,6 +595,56 @@ TEST_F(Http1ConnPoolImplTest, MaxRequestsPerConnection) {
   EXPECT_EQ(1U, cluster_->stats_.upstream_cx_max_requests_.value());
 }
 
+/**
+ * Test that a connection in the ready list is closed after the cluster's idle timeout and that the
+ * timer is stopped while the connection is in use.
+ */
+TEST_F(Http1ConnPoolImplTest, IdleTimeout) {
+  InSequence s;
+  cluster_->idle_timeout_ = std::chrono::milliseconds(5000);
+
+  ActiveTestRequest r1(*this, 0, ActiveTestRequest::Type::CreateConnection);
+  r1.startRequest();
+  Event::MockTimer* idle_timer = new Event::MockTimer(&dispatcher_);
+  EXPECT_CALL(*idle_timer, enableTimer(std::chrono::milliseconds(5000)));
+  r1.completeResponse(false);
+
+  EXPECT_CALL(*idle_timer, disableTimer());
+  ActiveTestRequest r2(*this, 0, ActiveTestRequest::Type::Immediate);
+  r2.startRequest();
+  EXPECT_CALL(*idle_timer, enableTimer(std::chrono::milliseconds(5000)));
+  r2.completeResponse(false);
+
+  EXPECT_CALL(*idle_timer, disableTimer());
+  idle_timer->callback_();
+  EXPECT_CALL(conn_pool_, onClientDestroy());
+  dispatcher_.clearDeferredDeleteList();
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_idle_timeout_.value());
+}
+
+/**
+ * Test that a connection reaching the cluster's max connection duration is closed once its active
+ * request is complete.
+ */
+TEST_F(Http1ConnPoolImplTest, MaxConnectionDuration) {
+  cluster_->max_connection_duration_ = std::chrono::milliseconds(60000);
+
+  // Created on connect, after the connect timer.
+  Event::MockTimer* duration_timer = new Event::MockTimer(&dispatcher_);
+  EXPECT_CALL(*duration_timer, enableTimer(std::chrono::milliseconds(60000)));
+  ActiveTestRequest r1(*this, 0, ActiveTestRequest::Type::CreateConnection);
+  r1.startRequest();
+
+  duration_timer->callback_();
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_max_duration_reached_.value());
+
+  EXPECT_CALL(*duration_timer, disableTimer());
+  EXPECT_CALL(conn_pool_, onClientDestroy());
+  r1.completeResponse(false);
+  dispatcher_.clearDeferredDeleteList();
+  EXPECT_EQ(0U, cluster_->stats_.upstream_cx_destroy_with_active_rq_.value());
+}
+
 TEST_F(Http1ConnPoolImplTest, ConcurrentConnections) {
   InSequence s;
 
@@ -162,6 +162,34 @@ TEST_F(Http2ConnPoolImplTest, VerifyConnectionTimingStats) {
   dispatcher_.clearDeferredDeleteList();
 }
 
+/**
+ * Test that prefetching opens the primary client ahead of the first stream, which then uses it.
+ */
+TEST_F(Http2ConnPoolImplTest, Prefetch) {
+  InSequence s;
+
+  expectClientCreate();
+  pool_.prefetch();
+  expectClientConnect(0);
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_prefetch_.value());
+
+  // Prefetching again is a no-op while there is a primary client.
+  pool_.prefetch();
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_prefetch_.value());
+
+  ActiveTestRequest r1(*this, 0);
+  EXPECT_CALL(r1.inner_encoder_, encodeHeaders(_, true));
+  r1.callbacks_.outer_encoder_->encodeHeaders(HeaderMapImpl{}, true);
+  EXPECT_CALL(r1.decoder_, decodeHeaders_(_, true));
+  r1.inner_decoder_->decodeHeaders(HeaderMapPtr{new HeaderMapImpl{}}, true);
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_prefetch_used_.value());
+
+  test_clients_[0].connection_->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  EXPECT_CALL(*this, onClientDestroy());
+  dispatcher_.clearDeferredDeleteList();
+  EXPECT_EQ(0U, cluster_->stats_.upstream_cx_prefetch_unused_.value());
+}
+
 /**
  * Test that buffer limits are set.
  */
@@ -354,6 +382,78 @@ TEST_F(Http2ConnPoolImplTest, DrainPrimaryNoActiveRequest) {
   dispatcher_.clearDeferredDeleteList();
 }
 
+/**
+ * Test that the primary client is closed after being idle for the cluster's idle timeout, and that
+ * the timer does not run while the client has streams.
+ */
+TEST_F(Http2ConnPoolImplTest, IdleTimeout) {
+  InSequence s;
+  cluster_->idle_timeout_ = std::chrono::milliseconds(5000);
+
+  expectClientCreate();
+  ActiveTestRequest r1(*this, 0);
+  EXPECT_CALL(r1.inner_encoder_, encodeHeaders(_, true));
+  r1.callbacks_.outer_encoder_->encodeHeaders(HeaderMapImpl{}, true);
+  expectClientConnect(0);
+
+  Event::MockTimer* idle_timer = new Event::MockTimer(&dispatcher_);
+  EXPECT_CALL(*idle_timer, enableTimer(std::chrono::milliseconds(5000)));
+  EXPECT_CALL(r1.decoder_, decodeHeaders_(_, true));
+  r1.inner_decoder_->decodeHeaders(HeaderMapPtr{new HeaderMapImpl{}}, true);
+
+  EXPECT_CALL(*idle_timer, disableTimer());
+  ActiveTestRequest r2(*this, 0);
+  EXPECT_CALL(r2.inner_encoder_, encodeHeaders(_, true));
+  r2.callbacks_.outer_encoder_->encodeHeaders(HeaderMapImpl{}, true);
+  EXPECT_CALL(*idle_timer, enableTimer(std::chrono::milliseconds(5000)));
+  EXPECT_CALL(r2.decoder_, decodeHeaders_(_, true));
+  r2.inner_decoder_->decodeHeaders(HeaderMapPtr{new HeaderMapImpl{}}, true);
+
+  EXPECT_CALL(*idle_timer, disableTimer());
+  idle_timer->callback_();
+  EXPECT_CALL(*this, onClientDestroy());
+  dispatcher_.clearDeferredDeleteList();
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_idle_timeout_.value());
+}
+
+/**
+ * Test that reaching the max connection duration drains the primary client. Its stream completes
+ * and new streams go to a new connection.
+ */
+TEST_F(Http2ConnPoolImplTest, MaxConnectionDuration) {
+  InSequence s;
+  cluster_->max_connection_duration_ = std::chrono::milliseconds(60000);
+
+  expectClientCreate();
+  ActiveTestRequest r1(*this, 0);
+  EXPECT_CALL(r1.inner_encoder_, encodeHeaders(_, true));
+  r1.callbacks_.outer_encoder_->encodeHeaders(HeaderMapImpl{}, true);
+  EXPECT_CALL(*test_clients_[0].connect_timer_, disableTimer());
+  Event::MockTimer* duration_timer = new Event::MockTimer(&dispatcher_);
+  EXPECT_CALL(*duration_timer, enableTimer(std::chrono::milliseconds(60000)));
+  test_clients_[0].connection_->raiseEvent(Network::ConnectionEvent::Connected);
+
+  duration_timer->callback_();
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_max_duration_reached_.value());
+
+  expectClientCreate();
+  ActiveTestRequest r2(*this, 1);
+  EXPECT_CALL(r2.inner_encoder_, encodeHeaders(_, true));
+  r2.callbacks_.outer_encoder_->encodeHeaders(HeaderMapImpl{}, true);
+
+  EXPECT_CALL(*duration_timer, disableTimer());
+  EXPECT_CALL(r1.decoder_, decodeHeaders_(_, true));
+  r1.inner_decoder_->decodeHeaders(HeaderMapPtr{new HeaderMapImpl{}}, true);
+  EXPECT_CALL(*this, onClientDestroy());
+  dispatcher_.clearDeferredDeleteList();
+
+  EXPECT_CALL(r2.decoder_, decodeHeaders_(_, true));
+  r2.inner_decoder_->decodeHeaders(HeaderMapPtr{new HeaderMapImpl{}}, true);
+  test_clients_[1].connection_->raiseEvent(Network::ConnectionEvent::RemoteClose);
+  EXPECT_CALL(*this, onClientDestroy());
+  dispatcher_.clearDeferredDeleteList();
+}
+
 TEST_F(Http2ConnPoolImplTest, ConnectTimeout) {
   InSequence s;
 
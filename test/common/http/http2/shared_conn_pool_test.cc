@@ -0,0 +1,448 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/common/thread.h"
+#include "common/event/dispatcher_impl.h"
+#include "common/http/header_map_impl.h"
+#include "common/http/http2/shared_conn_pool.h"
+
+#include "test/common/http/common.h"
+#include "test/common/upstream/utility.h"
+#include "test/mocks/buffer/mocks.h"
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/http/mocks.h"
+#include "test/mocks/upstream/mocks.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::InSequence;
+using testing::Invoke;
+using testing::NiceMock;
+using testing::Return;
+using testing::_;
+
+namespace Envoy {
+namespace Http {
+namespace Http2 {
+
+class SharedConnPoolTest : public testing::Test {
+public:
+  SharedConnPoolTest()
+      : host_(Upstream::makeTestHost(cluster_, "tcp://127.0.0.1:80")),
+        factory_([this]() -> ConnectionPool::InstancePtr {
+          pools_created_++;
+          pool_ = new NiceMock<ConnectionPool::MockInstance>();
+          return ConnectionPool::InstancePtr{pool_};
+        }) {
+    // Posts are queued and run by runPosted() so that each worker only ever runs one callback at a
+    // time, like a real dispatcher.
+    for (Event::MockDispatcher* dispatcher : {&owner_dispatcher_, &remote_dispatcher_}) {
+      ON_CALL(*dispatcher, post(_)).WillByDefault(Invoke([this](Event::PostCb cb) -> void {
+        posted_.push_back(cb);
+      }));
+    }
+  }
+
+  ConnectionPool::InstancePtr allocate(Event::Dispatcher& dispatcher) {
+    return registry_.allocate(dispatcher, host_, Upstream::ResourcePriority::Default, factory_);
+  }
+
+  void runPosted() {
+    while (!posted_.empty()) {
+      Event::PostCb cb = posted_.front();
+      posted_.pop_front();
+      cb();
+    }
+  }
+
+  // Start a stream from the remote worker and make it ready on the owner's pool.
+  void startRemoteStream(ConnectionPool::Instance& pool) {
+    EXPECT_CALL(*pool_, newStream(_, _))
+        .WillOnce(Invoke([this](StreamDecoder& decoder, ConnectionPool::Callbacks& callbacks)
+                             -> ConnectionPool::Cancellable* {
+                               inner_decoder_ = &decoder;
+                               inner_callbacks_ = &callbacks;
+                               return &cancellable_;
+                             }));
+    EXPECT_NE(nullptr, pool.newStream(outer_decoder_, outer_callbacks_));
+    runPosted();
+    EXPECT_CALL(outer_callbacks_.pool_ready_, ready());
+    inner_callbacks_->onPoolReady(inner_encoder_, host_);
+    runPosted();
+  }
+
+  NiceMock<Event::MockDispatcher> owner_dispatcher_;
+  NiceMock<Event::MockDispatcher> remote_dispatcher_;
+  std::list<Event::PostCb> posted_;
+  std::shared_ptr<Upstream::MockClusterInfo> cluster_{new NiceMock<Upstream::MockClusterInfo>()};
+  Upstream::HostSharedPtr host_;
+  SharedConnPoolRegistry registry_;
+  SharedConnPoolRegistry::PoolFactory factory_;
+  uint32_t pools_created_{};
+  ConnectionPool::MockInstance* pool_{};
+  ConnectionPool::MockCancellable cancellable_;
+  StreamDecoder* inner_decoder_{};
+  ConnectionPool::Callbacks* inner_callbacks_{};
+  MockStreamEncoder inner_encoder_;
+  MockStreamDecoder outer_decoder_;
+  ConnPoolCallbacks outer_callbacks_;
+};
+
+TEST_F(SharedConnPoolTest, OwnerDelegates) {
+  ConnectionPool::InstancePtr owner = allocate(owner_dispatcher_);
+  ConnectionPool::InstancePtr remote = allocate(remote_dispatcher_);
+  EXPECT_EQ(1U, pools_created_);
+  EXPECT_TRUE(dynamic_cast<SharedConnPool&>(*owner).isOwner());
+  EXPECT_FALSE(dynamic_cast<SharedConnPool&>(*remote).isOwner());
+  EXPECT_EQ(Protocol::Http2, remote->protocol());
+
+  EXPECT_CALL(*pool_, newStream(_, _)).WillOnce(Return(&cancellable_));
+  EXPECT_EQ(&cancellable_, owner->newStream(outer_decoder_, outer_callbacks_));
+  EXPECT_EQ(0U, cluster_->stats_.upstream_rq_shared_pool_remote_.value());
+
+  // Only the owner closes connections. Prefetch from another worker runs on the owner's pool.
+  EXPECT_CALL(*pool_, closeConnections()).Times(1);
+  remote->closeConnections();
+  owner->closeConnections();
+  EXPECT_CALL(*pool_, prefetch()).Times(2);
+  remote->prefetch();
+  owner->prefetch();
+  runPosted();
+}
+
+TEST_F(SharedConnPoolTest, RemoteStream) {
+  ConnectionPool::InstancePtr owner = allocate(owner_dispatcher_);
+  ConnectionPool::InstancePtr remote = allocate(remote_dispatcher_);
+  startRemoteStream(*remote);
+  EXPECT_EQ(1U, cluster_->stats_.upstream_rq_shared_pool_remote_.value());
+
+  TestHeaderMapImpl request_headers{{":method", "GET"}};
+  EXPECT_CALL(inner_encoder_, encodeHeaders(HeaderMapEqualRef(&request_headers), false));
+  outer_callbacks_.outer_encoder_->encodeHeaders(request_headers, false);
+  Buffer::OwnedImpl request_data("hello");
+  EXPECT_CALL(inner_encoder_, encodeData(BufferStringEqual("hello"), true));
+  outer_callbacks_.outer_encoder_->encodeData(request_data, true);
+  EXPECT_EQ(0U, request_data.length());
+
+  EXPECT_CALL(inner_encoder_.stream_, readDisable(true));
+  outer_callbacks_.outer_encoder_->getStream().readDisable(true);
+  runPosted();
+
+  EXPECT_CALL(outer_decoder_, decodeHeaders_(_, false));
+  inner_decoder_->decodeHeaders(HeaderMapPtr{new TestHeaderMapImpl{{":status", "200"}}}, false);
+  Buffer::OwnedImpl response_data("world");
+  EXPECT_CALL(outer_decoder_, decodeData(BufferStringEqual("world"), true));
+  inner_decoder_->decodeData(response_data, true);
+  runPosted();
+
+  // The stream is complete so the remote handle drains right away.
+  ReadyWatcher drained;
+  EXPECT_CALL(drained, ready());
+  remote->addDrainedCallback([&]() -> void { drained.ready(); });
+}
+
+TEST_F(SharedConnPoolTest, RemoteCancel) {
+  ConnectionPool::InstancePtr owner = allocate(owner_dispatcher_);
+  ConnectionPool::InstancePtr remote = allocate(remote_dispatcher_);
+
+  EXPECT_CALL(*pool_, newStream(_, _)).WillOnce(Return(&cancellable_));
+  ConnectionPool::Cancellable* handle = remote->newStream(outer_decoder_, outer_callbacks_);
+  ASSERT_NE(nullptr, handle);
+  runPosted();
+  EXPECT_CALL(cancellable_, cancel());
+  handle->cancel();
+  runPosted();
+
+  ReadyWatcher drained;
+  EXPECT_CALL(drained, ready());
+  remote->addDrainedCallback([&]() -> void { drained.ready(); });
+}
+
+TEST_F(SharedConnPoolTest, RemoteResets) {
+  ConnectionPool::InstancePtr owner = allocate(owner_dispatcher_);
+  ConnectionPool::InstancePtr remote = allocate(remote_dispatcher_);
+
+  // Upstream reset is delivered to the remote worker's stream callbacks.
+  startRemoteStream(*remote);
+  MockStreamCallbacks outer_stream_callbacks;
+  outer_callbacks_.outer_encoder_->getStream().addCallbacks(outer_stream_callbacks);
+  EXPECT_CALL(outer_stream_callbacks, onResetStream(StreamResetReason::RemoteReset));
+  inner_encoder_.stream_.resetStream(StreamResetReason::RemoteReset);
+  runPosted();
+
+  // Local reset is forwarded to the owner's stream.
+  inner_encoder_.stream_.callbacks_.clear();
+  startRemoteStream(*remote);
+  EXPECT_CALL(inner_encoder_.stream_, resetStream(StreamResetReason::LocalReset));
+  outer_callbacks_.outer_encoder_->getStream().resetStream(StreamResetReason::LocalReset);
+  runPosted();
+
+  // Destroying the remote handle resets whatever is still running on the owner.
+  inner_encoder_.stream_.callbacks_.clear();
+  startRemoteStream(*remote);
+  EXPECT_CALL(inner_encoder_.stream_, resetStream(StreamResetReason::LocalReset));
+  remote.reset();
+  runPosted();
+}
+
+TEST_F(SharedConnPoolTest, OwnerDrain) {
+  ConnectionPool::InstancePtr owner = allocate(owner_dispatcher_);
+  ConnectionPool::InstancePtr remote = allocate(remote_dispatcher_);
+  ConnectionPool::MockInstance* old_pool = pool_;
+
+  ConnectionPool::Instance::DrainedCb inner_drained;
+  EXPECT_CALL(*old_pool, addDrainedCallback(_))
+      .WillOnce(Invoke(
+          [&](ConnectionPool::Instance::DrainedCb cb) -> void { inner_drained = cb; }));
+  ReadyWatcher drained;
+  owner->addDrainedCallback([&]() -> void { drained.ready(); });
+
+  // The next stream from the other worker makes it the new owner instead of going to the draining
+  // pool.
+  EXPECT_CALL(*old_pool, newStream(_, _)).Times(0);
+  remote->newStream(outer_decoder_, outer_callbacks_);
+  EXPECT_TRUE(dynamic_cast<SharedConnPool&>(*remote).isOwner());
+  EXPECT_EQ(2U, pools_created_);
+  EXPECT_NE(old_pool, pool_);
+  EXPECT_EQ(0U, cluster_->stats_.upstream_rq_shared_pool_remote_.value());
+
+  EXPECT_CALL(drained, ready());
+  inner_drained();
+}
+
+// Remote streams fail when the owner's pool goes away, without waiting for the pool to reset them.
+TEST_F(SharedConnPoolTest, OwnerGone) {
+  ConnectionPool::InstancePtr owner = allocate(owner_dispatcher_);
+  ConnectionPool::InstancePtr remote = allocate(remote_dispatcher_);
+  startRemoteStream(*remote);
+  MockStreamCallbacks outer_stream_callbacks;
+  outer_callbacks_.outer_encoder_->getStream().addCallbacks(outer_stream_callbacks);
+
+  EXPECT_CALL(inner_encoder_.stream_, resetStream(StreamResetReason::LocalReset));
+  EXPECT_CALL(outer_stream_callbacks, onResetStream(StreamResetReason::ConnectionFailure));
+  owner.reset();
+  runPosted();
+}
+
+TEST_F(SharedConnPoolTest, GuardedDispatcher) {
+  GuardedDispatcher dispatcher(owner_dispatcher_);
+  EXPECT_CALL(owner_dispatcher_, post(_));
+  EXPECT_TRUE(dispatcher.post([]() -> void {}));
+
+  dispatcher.close();
+  EXPECT_CALL(owner_dispatcher_, post(_)).Times(0);
+  EXPECT_FALSE(dispatcher.post([]() -> void {}));
+}
+
+// Write buffer watermarks of the owner's stream reach the remote stream's callbacks.
+TEST_F(SharedConnPoolTest, ForwardWatermarks) {
+  cluster_->per_connection_buffer_limit_bytes_ = 1024;
+  ConnectionPool::InstancePtr owner = allocate(owner_dispatcher_);
+  ConnectionPool::InstancePtr remote = allocate(remote_dispatcher_);
+  startRemoteStream(*remote);
+  EXPECT_EQ(1024U, outer_callbacks_.outer_encoder_->getStream().bufferLimit());
+
+  InSequence s;
+  MockStreamCallbacks outer_stream_callbacks;
+  outer_callbacks_.outer_encoder_->getStream().addCallbacks(outer_stream_callbacks);
+  EXPECT_CALL(outer_stream_callbacks, onAboveWriteBufferHighWatermark());
+  EXPECT_CALL(outer_stream_callbacks, onBelowWriteBufferLowWatermark());
+  inner_encoder_.stream_.runHighWatermarkCallbacks();
+  inner_encoder_.stream_.runLowWatermarkCallbacks();
+  runPosted();
+}
+
+// Request data queued for the owner past the buffer limit raises a high watermark on the remote
+// stream until the owner has encoded it.
+TEST_F(SharedConnPoolTest, BoundedRequestData) {
+  cluster_->per_connection_buffer_limit_bytes_ = 1024;
+  ConnectionPool::InstancePtr owner = allocate(owner_dispatcher_);
+  ConnectionPool::InstancePtr remote = allocate(remote_dispatcher_);
+  startRemoteStream(*remote);
+  MockStreamCallbacks outer_stream_callbacks;
+  outer_callbacks_.outer_encoder_->getStream().addCallbacks(outer_stream_callbacks);
+
+  Buffer::OwnedImpl small_data(std::string(1000, 'a'));
+  EXPECT_CALL(outer_stream_callbacks, onAboveWriteBufferHighWatermark()).Times(0);
+  outer_callbacks_.outer_encoder_->encodeData(small_data, false);
+
+  Buffer::OwnedImpl large_data(std::string(1000, 'b'));
+  EXPECT_CALL(outer_stream_callbacks, onAboveWriteBufferHighWatermark());
+  outer_callbacks_.outer_encoder_->encodeData(large_data, false);
+
+  EXPECT_CALL(inner_encoder_, encodeData(_, false)).Times(2);
+  EXPECT_CALL(outer_stream_callbacks, onBelowWriteBufferLowWatermark());
+  runPosted();
+}
+
+// Response data queued for the remote worker past the buffer limit read disables the owner's
+// stream until the remote worker has decoded it.
+TEST_F(SharedConnPoolTest, BoundedResponseData) {
+  cluster_->per_connection_buffer_limit_bytes_ = 1024;
+  ConnectionPool::InstancePtr owner = allocate(owner_dispatcher_);
+  ConnectionPool::InstancePtr remote = allocate(remote_dispatcher_);
+  startRemoteStream(*remote);
+
+  EXPECT_CALL(inner_encoder_.stream_, readDisable(_)).Times(0);
+  inner_decoder_->decodeHeaders(HeaderMapPtr{new TestHeaderMapImpl{{":status", "200"}}}, false);
+  Buffer::OwnedImpl small_data(std::string(900, 'a'));
+  inner_decoder_->decodeData(small_data, false);
+
+  EXPECT_CALL(inner_encoder_.stream_, readDisable(true));
+  Buffer::OwnedImpl large_data(std::string(900, 'b'));
+  inner_decoder_->decodeData(large_data, false);
+
+  EXPECT_CALL(outer_decoder_, decodeHeaders_(_, false));
+  EXPECT_CALL(outer_decoder_, decodeData(_, false)).Times(2);
+  EXPECT_CALL(inner_encoder_.stream_, readDisable(false));
+  runPosted();
+}
+
+/**
+ * A pool that hands out a ready stream inline, for running the shared pool on real workers.
+ */
+class ReadyPool : public ConnectionPool::Instance {
+public:
+  ReadyPool(Upstream::HostSharedPtr host) : host_(host) {}
+
+  // Http::ConnectionPool::Instance
+  Http::Protocol protocol() const override { return Http::Protocol::Http2; }
+  void addDrainedCallback(DrainedCb) override {}
+  void closeConnections() override {}
+  ConnectionPool::Cancellable* newStream(Http::StreamDecoder& response_decoder,
+                                         ConnectionPool::Callbacks& callbacks) override {
+    decoder_ = &response_decoder;
+    callbacks.onPoolReady(encoder_, host_);
+    return nullptr;
+  }
+  void prefetch() override {}
+
+  Upstream::HostSharedPtr host_;
+  NiceMock<MockStreamEncoder> encoder_;
+  StreamDecoder* decoder_{};
+};
+
+/**
+ * Runs a real dispatcher on its own thread.
+ */
+class TestWorker {
+public:
+  TestWorker() {
+    thread_.reset(new Thread::Thread([this]() -> void {
+      // Keeps the event loop from exiting while nothing else is scheduled.
+      Event::TimerPtr keep_alive = dispatcher_.createTimer([]() -> void {});
+      keep_alive->enableTimer(std::chrono::hours(1));
+      thread_id_ = Thread::Thread::currentThreadId();
+      dispatcher_.run(Event::Dispatcher::RunType::Block);
+    }));
+  }
+
+  ~TestWorker() {
+    dispatcher_.exit();
+    thread_->join();
+  }
+
+  void runAndWait(std::function<void()> cb) {
+    std::mutex lock;
+    std::condition_variable cv;
+    bool done = false;
+    dispatcher_.post([&]() -> void {
+      cb();
+      std::unique_lock<std::mutex> guard(lock);
+      done = true;
+      cv.notify_one();
+    });
+    std::unique_lock<std::mutex> guard(lock);
+    cv.wait(guard, [&]() -> bool { return done; });
+  }
+
+  Event::DispatcherImpl dispatcher_;
+  Thread::ThreadPtr thread_;
+  std::atomic<Thread::ThreadId> thread_id_{};
+};
+
+// Run a stream from one real worker on another worker's pool.
+TEST(SharedConnPoolWorkersTest, RemoteStream) {
+  std::shared_ptr<Upstream::MockClusterInfo> cluster{new NiceMock<Upstream::MockClusterInfo>()};
+  cluster->per_connection_buffer_limit_bytes_ = 1024;
+  Upstream::HostSharedPtr host = Upstream::makeTestHost(cluster, "tcp://127.0.0.1:80");
+  SharedConnPoolRegistry registry;
+  ReadyPool* ready_pool{};
+  SharedConnPoolRegistry::PoolFactory factory = [&]() -> ConnectionPool::InstancePtr {
+    ready_pool = new ReadyPool(host);
+    return ConnectionPool::InstancePtr{ready_pool};
+  };
+
+  TestWorker owner_worker;
+  TestWorker remote_worker;
+  ConnectionPool::InstancePtr owner;
+  ConnectionPool::InstancePtr remote;
+  owner_worker.runAndWait([&]() -> void {
+    owner = registry.allocate(owner_worker.dispatcher_, host,
+                              Upstream::ResourcePriority::Default, factory);
+  });
+
+  // Each step is checked on the worker it is supposed to run on.
+  std::mutex lock;
+  std::condition_variable cv;
+  uint32_t step = 0;
+  auto nextStep = [&](const TestWorker& worker) -> void {
+    EXPECT_EQ(worker.thread_id_, Thread::Thread::currentThreadId());
+    std::unique_lock<std::mutex> guard(lock);
+    step++;
+    cv.notify_one();
+  };
+  auto waitForStep = [&](uint32_t wanted) -> void {
+    std::unique_lock<std::mutex> guard(lock);
+    cv.wait(guard, [&]() -> bool { return step >= wanted; });
+  };
+
+  NiceMock<MockStreamDecoder> outer_decoder;
+  ConnPoolCallbacks outer_callbacks;
+  EXPECT_CALL(outer_callbacks.pool_ready_, ready()).WillOnce(Invoke([&]() {
+    nextStep(remote_worker);
+  }));
+  EXPECT_CALL(ready_pool->encoder_, encodeData(BufferStringEqual("hello"), true))
+      .WillOnce(Invoke([&](Buffer::Instance&, bool) { nextStep(owner_worker); }));
+  EXPECT_CALL(outer_decoder, decodeData(BufferStringEqual("world"), true))
+      .WillOnce(Invoke([&](Buffer::Instance&, bool) { nextStep(remote_worker); }));
+
+  remote_worker.runAndWait([&]() -> void {
+    remote = registry.allocate(remote_worker.dispatcher_, host,
+                               Upstream::ResourcePriority::Default, factory);
+    EXPECT_NE(nullptr, remote->newStream(outer_decoder, outer_callbacks));
+  });
+  waitForStep(1);
+  StreamEncoder* outer_encoder = outer_callbacks.outer_encoder_;
+  EXPECT_EQ(1024U, outer_encoder->getStream().bufferLimit());
+
+  remote_worker.runAndWait([&]() -> void {
+    TestHeaderMapImpl request_headers{{":method", "GET"}};
+    outer_encoder->encodeHeaders(request_headers, false);
+    Buffer::OwnedImpl request_data("hello");
+    outer_encoder->encodeData(request_data, true);
+  });
+  waitForStep(2);
+
+  owner_worker.runAndWait([&]() -> void {
+    ready_pool->decoder_->decodeHeaders(HeaderMapPtr{new TestHeaderMapImpl{{":status", "200"}}},
+                                        false);
+    Buffer::OwnedImpl response_data("world");
+    ready_pool->decoder_->decodeData(response_data, true);
+  });
+  waitForStep(3);
+
+  remote_worker.runAndWait([&]() -> void { remote.reset(); });
+  owner_worker.runAndWait([&]() -> void { owner.reset(); });
+}
+
+} // namespace Http2
+} // namespace Http
+} // namespace Envoy
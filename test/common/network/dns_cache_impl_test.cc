@@ -0,0 +1,261 @@
+#include <chrono>
+#include <list>
+#include <memory>
+#include <string>
+
+#include "common/network/dns_cache_impl.h"
+#include "common/network/utility.h"
+#include "common/stats/stats_impl.h"
+
+#include "test/mocks/common.h"
+#include "test/mocks/network/mocks.h"
+#include "test/mocks/runtime/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::DoAll;
+using testing::Invoke;
+using testing::NiceMock;
+using testing::Return;
+using testing::ReturnPointee;
+using testing::SaveArg;
+using testing::_;
+
+namespace Envoy {
+namespace Network {
+
+class CachingDnsResolverImplTest : public testing::Test {
+public:
+  CachingDnsResolverImplTest()
+      : resolver_(new MockDnsResolver()),
+        cache_(resolver_, runtime_, stats_store_, time_source_) {
+    ON_CALL(time_source_, currentTime()).WillByDefault(ReturnPointee(&now_));
+  }
+
+  void setTtls(uint64_t ttl_ms, uint64_t stale_ms, uint64_t negative_ttl_ms) {
+    ON_CALL(runtime_.snapshot_, getInteger("dns_cache.ttl_ms", _)).WillByDefault(Return(ttl_ms));
+    ON_CALL(runtime_.snapshot_, getInteger("dns_cache.stale_ms", _))
+        .WillByDefault(Return(stale_ms));
+    ON_CALL(runtime_.snapshot_, getInteger("dns_cache.negative_ttl_ms", _))
+        .WillByDefault(Return(negative_ttl_ms));
+  }
+
+  ActiveDnsQuery* resolve(std::list<Address::InstanceConstSharedPtr>& result) {
+    return cache_.resolve("foo.com", DnsLookupFamily::V4Only,
+                          [&result](std::list<Address::InstanceConstSharedPtr>&& address_list) {
+                            result = std::move(address_list);
+                          });
+  }
+
+  std::list<Address::InstanceConstSharedPtr> addresses(const std::string& ip) {
+    return {Utility::parseInternetAddress(ip)};
+  }
+
+  MonotonicTime now_;
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  NiceMock<Runtime::MockLoader> runtime_;
+  Stats::IsolatedStoreImpl stats_store_;
+  std::shared_ptr<MockDnsResolver> resolver_;
+  MockActiveDnsQuery active_query_;
+  CachingDnsResolverImpl cache_;
+};
+
+TEST_F(CachingDnsResolverImplTest, CoalesceWithoutCaching) {
+  DnsResolver::ResolveCb callback;
+  EXPECT_CALL(*resolver_, resolve("foo.com", DnsLookupFamily::V4Only, _))
+      .WillOnce(DoAll(SaveArg<2>(&callback), Return(&active_query_)));
+
+  std::list<Address::InstanceConstSharedPtr> result1;
+  std::list<Address::InstanceConstSharedPtr> result2;
+  std::list<Address::InstanceConstSharedPtr> result3;
+  EXPECT_NE(nullptr, resolve(result1));
+  EXPECT_NE(nullptr, resolve(result2));
+  resolve(result3)->cancel();
+  EXPECT_EQ(1UL, stats_store_.counter("dns_cache.query").value());
+  EXPECT_EQ(2UL, stats_store_.counter("dns_cache.coalesced").value());
+
+  callback(addresses("127.0.0.1"));
+  EXPECT_EQ(1UL, result1.size());
+  EXPECT_EQ(1UL, result2.size());
+  EXPECT_TRUE(result3.empty());
+
+  // Nothing is cached by default.
+  EXPECT_CALL(*resolver_, resolve("foo.com", DnsLookupFamily::V4Only, _))
+      .WillOnce(Return(&active_query_));
+  EXPECT_NE(nullptr, resolve(result1));
+  EXPECT_EQ(2UL, stats_store_.counter("dns_cache.miss").value());
+  EXPECT_EQ(0UL, stats_store_.counter("dns_cache.hit").value());
+
+  // Destroying the cache cancels the outstanding query.
+  EXPECT_CALL(active_query_, cancel());
+}
+
+TEST_F(CachingDnsResolverImplTest, TtlAndStale) {
+  setTtls(1000, 5000, 0);
+  DnsResolver::ResolveCb callback;
+  EXPECT_CALL(*resolver_, resolve("foo.com", DnsLookupFamily::V4Only, _))
+      .WillOnce(DoAll(SaveArg<2>(&callback), Return(&active_query_)));
+
+  std::list<Address::InstanceConstSharedPtr> result;
+  EXPECT_NE(nullptr, resolve(result));
+  callback(addresses("127.0.0.1"));
+  EXPECT_EQ("127.0.0.1:0", result.front()->asString());
+
+  // Fresh hits complete inline.
+  result.clear();
+  now_ += std::chrono::milliseconds(999);
+  EXPECT_EQ(nullptr, resolve(result));
+  EXPECT_EQ(1UL, result.size());
+  EXPECT_EQ(1UL, stats_store_.counter("dns_cache.hit").value());
+
+  // Stale hits complete inline with the old result and refresh in the background.
+  EXPECT_CALL(*resolver_, resolve("foo.com", DnsLookupFamily::V4Only, _))
+      .WillOnce(DoAll(SaveArg<2>(&callback), Return(&active_query_)));
+  result.clear();
+  now_ += std::chrono::milliseconds(1);
+  EXPECT_EQ(nullptr, resolve(result));
+  EXPECT_EQ("127.0.0.1:0", result.front()->asString());
+  EXPECT_EQ(nullptr, resolve(result));
+  EXPECT_EQ(2UL, stats_store_.counter("dns_cache.stale_hit").value());
+  EXPECT_EQ(2UL, stats_store_.counter("dns_cache.query").value());
+
+  callback(addresses("127.0.0.2"));
+  EXPECT_EQ(nullptr, resolve(result));
+  EXPECT_EQ("127.0.0.2:0", result.front()->asString());
+
+  // Past the stale window the resolution waits for a new query.
+  EXPECT_CALL(*resolver_, resolve("foo.com", DnsLookupFamily::V4Only, _))
+      .WillOnce(DoAll(SaveArg<2>(&callback), Return(&active_query_)));
+  now_ += std::chrono::milliseconds(6000);
+  result.clear();
+  EXPECT_NE(nullptr, resolve(result));
+  EXPECT_TRUE(result.empty());
+  callback(addresses("127.0.0.3"));
+  EXPECT_EQ("127.0.0.3:0", result.front()->asString());
+}
+
+TEST_F(CachingDnsResolverImplTest, RecordTtl) {
+  DnsResolver::ResolveWithTtlCb callback;
+  EXPECT_CALL(*resolver_, resolveWithTtl("foo.com", DnsLookupFamily::V4Only, _))
+      .WillOnce(DoAll(SaveArg<2>(&callback), Return(&active_query_)));
+
+  std::list<Address::InstanceConstSharedPtr> result;
+  resolve(result);
+  callback(addresses("127.0.0.1"), std::chrono::seconds(2));
+
+  // Results are served for their record TTL by default.
+  result.clear();
+  now_ += std::chrono::milliseconds(1999);
+  EXPECT_EQ(nullptr, resolve(result));
+  EXPECT_EQ(1UL, result.size());
+  EXPECT_EQ(1UL, stats_store_.counter("dns_cache.hit").value());
+
+  EXPECT_CALL(*resolver_, resolveWithTtl("foo.com", DnsLookupFamily::V4Only, _))
+      .WillOnce(DoAll(SaveArg<2>(&callback), Return(&active_query_)));
+  now_ += std::chrono::milliseconds(1);
+  EXPECT_NE(nullptr, resolve(result));
+  callback(addresses("127.0.0.1"), std::chrono::seconds(2));
+
+  // The runtime override takes precedence over the record TTL.
+  setTtls(500, 0, 0);
+  EXPECT_CALL(*resolver_, resolveWithTtl("foo.com", DnsLookupFamily::V4Only, _))
+      .WillOnce(DoAll(SaveArg<2>(&callback), Return(&active_query_)));
+  now_ += std::chrono::milliseconds(500);
+  EXPECT_NE(nullptr, resolve(result));
+  callback(addresses("127.0.0.1"), std::chrono::seconds(2));
+  EXPECT_EQ(1UL, stats_store_.counter("dns_cache.hit").value());
+  EXPECT_EQ(3UL, stats_store_.counter("dns_cache.miss").value());
+}
+
+TEST_F(CachingDnsResolverImplTest, NegativeCaching) {
+  setTtls(1000, 0, 500);
+  DnsResolver::ResolveCb callback;
+  EXPECT_CALL(*resolver_, resolve("foo.com", DnsLookupFamily::V4Only, _))
+      .WillOnce(DoAll(SaveArg<2>(&callback), Return(&active_query_)));
+
+  std::list<Address::InstanceConstSharedPtr> result;
+  resolve(result);
+  callback({});
+  EXPECT_EQ(1UL, stats_store_.counter("dns_cache.query_failure").value());
+
+  result = addresses("127.0.0.1");
+  EXPECT_EQ(nullptr, resolve(result));
+  EXPECT_TRUE(result.empty());
+  EXPECT_EQ(1UL, stats_store_.counter("dns_cache.negative_hit").value());
+
+  // Inline completion by the wrapped resolver.
+  now_ += std::chrono::milliseconds(500);
+  EXPECT_CALL(*resolver_, resolve("foo.com", DnsLookupFamily::V4Only, _))
+      .WillOnce(Invoke([this](const std::string&, DnsLookupFamily,
+                              DnsResolver::ResolveCb cb) -> ActiveDnsQuery* {
+        cb(addresses("127.0.0.1"));
+        return nullptr;
+      }));
+  EXPECT_EQ(nullptr, resolve(result));
+  EXPECT_EQ(1UL, result.size());
+  EXPECT_EQ(1UL, stats_store_.gauge("dns_cache.entries").value());
+}
+
+TEST_F(CachingDnsResolverImplTest, Eviction) {
+  DnsResolver::ResolveCb callback;
+  EXPECT_CALL(*resolver_, resolve("foo.com", DnsLookupFamily::V4Only, _))
+      .WillOnce(DoAll(SaveArg<2>(&callback), Return(&active_query_)));
+  std::list<Address::InstanceConstSharedPtr> result;
+  resolve(result);
+  callback(addresses("127.0.0.1"));
+
+  // Resolving another name evicts entries that have not been used for long enough, without waiting
+  // for a query to complete.
+  now_ += std::chrono::milliseconds(CachingDnsResolverImpl::MIN_EVICTION_AGE_MS);
+  EXPECT_CALL(*resolver_, resolve("bar.com", DnsLookupFamily::Auto, _))
+      .WillOnce(DoAll(SaveArg<2>(&callback), Return(&active_query_)));
+  cache_.resolve("bar.com", DnsLookupFamily::Auto,
+                 [](std::list<Address::InstanceConstSharedPtr>&&) -> void {});
+  EXPECT_EQ(1UL, stats_store_.counter("dns_cache.evicted").value());
+  EXPECT_EQ(1UL, stats_store_.gauge("dns_cache.entries").value());
+
+  // An entry with a query in flight is kept until the query completes.
+  now_ += std::chrono::milliseconds(CachingDnsResolverImpl::MIN_EVICTION_AGE_MS);
+  EXPECT_CALL(*resolver_, resolve("foo.com", DnsLookupFamily::V4Only, _))
+      .WillOnce(Return(&active_query_));
+  resolve(result);
+  EXPECT_EQ(1UL, stats_store_.counter("dns_cache.evicted").value());
+  EXPECT_EQ(2UL, stats_store_.gauge("dns_cache.entries").value());
+  callback({});
+  EXPECT_EQ(1UL, stats_store_.counter("dns_cache.evicted").value());
+}
+
+TEST_F(CachingDnsResolverImplTest, EvictionByLastAccess) {
+  DnsResolver::ResolveWithTtlCb callback;
+  EXPECT_CALL(*resolver_, resolveWithTtl("foo.com", DnsLookupFamily::V4Only, _))
+      .WillOnce(DoAll(SaveArg<2>(&callback), Return(&active_query_)));
+  std::list<Address::InstanceConstSharedPtr> result;
+  resolve(result);
+  callback(addresses("127.0.0.1"), std::chrono::seconds(3600));
+
+  // A cache hit keeps the entry even though its result is older than the eviction age.
+  now_ += std::chrono::milliseconds(CachingDnsResolverImpl::MIN_EVICTION_AGE_MS - 1);
+  EXPECT_EQ(nullptr, resolve(result));
+  now_ += std::chrono::milliseconds(1);
+  EXPECT_CALL(*resolver_, resolveWithTtl("bar.com", DnsLookupFamily::Auto, _))
+      .WillOnce(DoAll(SaveArg<2>(&callback), Return(&active_query_)));
+  cache_.resolve("bar.com", DnsLookupFamily::Auto,
+                 [](std::list<Address::InstanceConstSharedPtr>&&) -> void {});
+  callback({}, {});
+  EXPECT_EQ(0UL, stats_store_.counter("dns_cache.evicted").value());
+  EXPECT_EQ(2UL, stats_store_.gauge("dns_cache.entries").value());
+
+  // Once it goes unused for long enough it is evicted.
+  now_ += std::chrono::milliseconds(CachingDnsResolverImpl::MIN_EVICTION_AGE_MS);
+  EXPECT_CALL(*resolver_, resolveWithTtl("bar.com", DnsLookupFamily::Auto, _))
+      .WillOnce(DoAll(SaveArg<2>(&callback), Return(&active_query_)));
+  cache_.resolve("bar.com", DnsLookupFamily::Auto,
+                 [](std::list<Address::InstanceConstSharedPtr>&&) -> void {});
+  callback({}, {});
+  EXPECT_EQ(1UL, stats_store_.counter("dns_cache.evicted").value());
+  EXPECT_EQ(1UL, stats_store_.gauge("dns_cache.entries").value());
+}
+
+} // namespace Network
+} // namespace Envoy
@@ -246,6 +246,30 @@ private:
   DnsResolverImpl* resolver_;
 };
 
+// Resolvers that cannot report TTLs only implement resolve().
+TEST(DnsResolverTest, DefaultResolveWithTtl) {
+  class LiteralResolver : public DnsResolver {
+  public:
+    ActiveDnsQuery* resolve(const std::string& dns_name, DnsLookupFamily,
+                            ResolveCb callback) override {
+      callback({Utility::parseInternetAddress(dns_name)});
+      return nullptr;
+    }
+  } resolver;
+
+  std::list<Address::InstanceConstSharedPtr> address_list;
+  Optional<std::chrono::seconds> ttl(std::chrono::seconds(1));
+  EXPECT_EQ(nullptr, resolver.resolveWithTtl(
+                         "127.0.0.1", DnsLookupFamily::V4Only,
+                         [&](std::list<Address::InstanceConstSharedPtr>&& results,
+                             const Optional<std::chrono::seconds>& result_ttl) -> void {
+                           address_list = results;
+                           ttl = result_ttl;
+                         }));
+  EXPECT_EQ(1UL, address_list.size());
+  EXPECT_FALSE(ttl.valid());
+}
+
 TEST(DnsImplConstructor, SupportsCustomResolvers) {
   Event::DispatcherImpl dispatcher;
   char addr4str[INET_ADDRSTRLEN];
@@ -483,6 +507,39 @@ TEST_P(DnsImplTest, RemoteAsyncLookup) {
   EXPECT_TRUE(hasAddress(address_list, "201.134.56.7"));
 }
 
+// Validate that the record TTL is reported for remote lookups. TestDnsServer answers with a zero
+// TTL.
+TEST_P(DnsImplTest, RemoteAsyncLookupWithTtl) {
+  server_->addHosts("some.good.domain", {"201.134.56.7", "123.4.5.6"}, A);
+  std::list<Address::InstanceConstSharedPtr> address_list;
+  Optional<std::chrono::seconds> ttl;
+  EXPECT_NE(nullptr, resolver_->resolveWithTtl(
+                         "some.good.domain", DnsLookupFamily::V4Only,
+                         [&](std::list<Address::InstanceConstSharedPtr>&& results,
+                             const Optional<std::chrono::seconds>& result_ttl) -> void {
+                           address_list = results;
+                           ttl = result_ttl;
+                           dispatcher_.exit();
+                         }));
+
+  dispatcher_.run(Event::Dispatcher::RunType::Block);
+  EXPECT_TRUE(hasAddress(address_list, "201.134.56.7"));
+  EXPECT_TRUE(hasAddress(address_list, "123.4.5.6"));
+  ASSERT_TRUE(ttl.valid());
+  EXPECT_EQ(std::chrono::seconds(0), ttl.value());
+
+  // IP literals are resolved locally and have no TTL.
+  EXPECT_EQ(nullptr, resolver_->resolveWithTtl(
+                         "127.0.0.1", DnsLookupFamily::V4Only,
+                         [&](std::list<Address::InstanceConstSharedPtr>&& results,
+                             const Optional<std::chrono::seconds>& result_ttl) -> void {
+                           address_list = results;
+                           ttl = result_ttl;
+                         }));
+  EXPECT_TRUE(hasAddress(address_list, "127.0.0.1"));
+  EXPECT_FALSE(ttl.valid());
+}
+
 // Validate that multiple A records are correctly passed to the callback.
 TEST_P(DnsImplTest, MultiARecordLookup) {
   server_->addHosts("some.good.domain", {"201.134.56.7", "123.4.5.6", "6.5.4.3"}, A);
@@ -500,6 +557,27 @@ TEST_P(DnsImplTest, MultiARecordLookup) {
   EXPECT_TRUE(hasAddress(address_list, "6.5.4.3"));
 }
 
+// Validate that every A record of a large response is passed to the callback.
+TEST_P(DnsImplTest, ManyARecordLookup) {
+  IpList ips;
+  for (int i = 0; i < 200; i++) {
+    ips.push_back("10.0." + std::to_string(i / 100) + "." + std::to_string(i % 100));
+  }
+  server_->addHosts("some.good.domain", ips, A);
+  std::list<Address::InstanceConstSharedPtr> address_list;
+  EXPECT_NE(nullptr,
+            resolver_->resolve("some.good.domain", DnsLookupFamily::V4Only,
+                               [&](std::list<Address::InstanceConstSharedPtr>&& results) -> void {
+                                 address_list = results;
+                                 dispatcher_.exit();
+                               }));
+
+  dispatcher_.run(Event::Dispatcher::RunType::Block);
+  EXPECT_EQ(200UL, address_list.size());
+  EXPECT_TRUE(hasAddress(address_list, "10.0.0.0"));
+  EXPECT_TRUE(hasAddress(address_list, "10.0.1.99"));
+}
+
 TEST_P(DnsImplTest, MultiARecordLookupWithV6) {
   server_->addHosts("some.good.domain", {"201.134.56.7", "123.4.5.6", "6.5.4.3"}, A);
   server_->addHosts("some.good.domain", {"1::2", "1::2:3", "1::2:3:4"}, AAAA);
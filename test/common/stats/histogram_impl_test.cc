@@ -0,0 +1,116 @@
+#include "common/stats/histogram_impl.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Stats {
+
+TEST(LogLinearHistogramTest, Buckets) {
+  // Values below 100 are exact.
+  EXPECT_EQ(0U, LogLinearHistogram::bucketIndex(0));
+  EXPECT_EQ(99U, LogLinearHistogram::bucketIndex(99));
+  EXPECT_EQ(99, LogLinearHistogram::bucketLowerBound(99));
+  EXPECT_EQ(0, LogLinearHistogram::bucketWidth(99));
+
+  // Larger values keep two significant digits.
+  EXPECT_EQ(100U, LogLinearHistogram::bucketIndex(100));
+  EXPECT_EQ(100U, LogLinearHistogram::bucketIndex(109));
+  EXPECT_EQ(101U, LogLinearHistogram::bucketIndex(110));
+  EXPECT_EQ(189U, LogLinearHistogram::bucketIndex(999));
+  EXPECT_EQ(190U, LogLinearHistogram::bucketIndex(1000));
+  EXPECT_EQ(12000, LogLinearHistogram::bucketLowerBound(LogLinearHistogram::bucketIndex(12345)));
+  EXPECT_EQ(1000, LogLinearHistogram::bucketWidth(LogLinearHistogram::bucketIndex(12345)));
+
+  const uint32_t max_index = LogLinearHistogram::bucketIndex(UINT64_MAX);
+  EXPECT_EQ(1.8e19, LogLinearHistogram::bucketLowerBound(max_index));
+}
+
+TEST(LogLinearHistogramTest, Quantiles) {
+  LogLinearHistogram histogram;
+  EXPECT_EQ(0, histogram.quantile(0.5));
+
+  for (uint64_t value = 1; value <= 100; value++) {
+    histogram.recordValue(value);
+  }
+  EXPECT_EQ(100U, histogram.sampleCount());
+  EXPECT_EQ(5050U, histogram.sampleSum());
+  EXPECT_EQ(1, histogram.quantile(0));
+  EXPECT_EQ(50, histogram.quantile(0.5));
+  EXPECT_EQ(99, histogram.quantile(0.99));
+  // 100 is in the [100, 110) bucket.
+  EXPECT_EQ(110, histogram.quantile(1));
+
+  // Quantiles of larger values are within 10%.
+  LogLinearHistogram latencies;
+  for (uint64_t value = 1000; value < 100000; value += 7) {
+    latencies.recordValue(value);
+  }
+  EXPECT_NEAR(50500, latencies.quantile(0.5), 5050);
+  EXPECT_NEAR(99010, latencies.quantile(0.99), 9901);
+}
+
+TEST(LogLinearHistogramTest, CountLessOrEqual) {
+  LogLinearHistogram histogram;
+  EXPECT_EQ(0U, histogram.countLessOrEqual(100));
+
+  for (uint64_t value = 1; value <= 100; value++) {
+    histogram.recordValue(value);
+  }
+  EXPECT_EQ(0U, histogram.countLessOrEqual(0.5));
+  EXPECT_EQ(1U, histogram.countLessOrEqual(1));
+  EXPECT_EQ(50U, histogram.countLessOrEqual(50));
+  EXPECT_EQ(99U, histogram.countLessOrEqual(99.5));
+  // Half of the [100, 110) bucket, rounded.
+  EXPECT_EQ(100U, histogram.countLessOrEqual(105));
+  EXPECT_EQ(100U, histogram.countLessOrEqual(1000));
+}
+
+TEST(LogLinearHistogramTest, Merge) {
+  LogLinearHistogram first;
+  LogLinearHistogram second;
+  LogLinearHistogram all;
+  for (uint64_t value = 0; value < 10000; value += 3) {
+    (value % 2 ? first : second).recordValue(value);
+    all.recordValue(value);
+  }
+
+  first.merge(second);
+  EXPECT_EQ(all.sampleCount(), first.sampleCount());
+  EXPECT_EQ(all.sampleSum(), first.sampleSum());
+  for (double quantile : {0.0, 0.25, 0.5, 0.9, 0.999, 1.0}) {
+    EXPECT_EQ(all.quantile(quantile), first.quantile(quantile));
+  }
+
+  first.clear();
+  EXPECT_EQ(0U, first.sampleCount());
+  EXPECT_EQ(0, first.quantile(1));
+}
+
+TEST(HistogramStatisticsImplTest, Summary) {
+  LogLinearHistogram histogram;
+  HistogramStatisticsImpl statistics(histogram);
+  EXPECT_EQ(statistics.supportedQuantiles().size(), statistics.computedQuantiles().size());
+  EXPECT_EQ("P0: 0, P25: 0, P50: 0, P75: 0, P90: 0, P95: 0, P99: 0, P99.9: 0, P100: 0",
+            statistics.summary());
+
+  histogram.recordValue(5);
+  histogram.recordValue(7);
+  statistics.refresh(histogram);
+  EXPECT_EQ(2U, statistics.sampleCount());
+  EXPECT_EQ(12U, statistics.sampleSum());
+  EXPECT_EQ("P0: 5, P25: 5, P50: 5, P75: 7, P90: 7, P95: 7, P99: 7, P99.9: 7, P100: 7",
+            statistics.summary());
+
+  // The buckets are cumulative.
+  ASSERT_EQ(statistics.supportedBuckets().size(), statistics.computedBuckets().size());
+  EXPECT_EQ(1, statistics.supportedBuckets()[1]);
+  EXPECT_EQ(0U, statistics.computedBuckets()[1]);
+  EXPECT_EQ(5, statistics.supportedBuckets()[2]);
+  EXPECT_EQ(1U, statistics.computedBuckets()[2]);
+  EXPECT_EQ(10, statistics.supportedBuckets()[3]);
+  EXPECT_EQ(2U, statistics.computedBuckets()[3]);
+  EXPECT_EQ(2U, statistics.computedBuckets().back());
+}
+
+} // namespace Stats
+} // namespace Envoy
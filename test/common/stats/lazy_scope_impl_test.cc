@@ -0,0 +1,95 @@
+#include <string>
+
+#include "envoy/stats/stats_macros.h"
+
+#include "common/stats/lazy_scope_impl.h"
+#include "common/stats/stats_impl.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Stats {
+
+// clang-format off
+#define LAZY_TEST_STATS(COUNTER, GAUGE, HISTOGRAM)                                                 \
+  COUNTER  (c1)                                                                                    \
+  COUNTER  (c2)                                                                                    \
+  GAUGE    (g1)                                                                                    \
+  HISTOGRAM(h1)
+// clang-format on
+
+struct LazyTestStats {
+  LAZY_TEST_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT, GENERATE_HISTOGRAM_STRUCT)
+};
+
+TEST(LazyScopeImplTest, AllocateOnFirstWrite) {
+  IsolatedStoreImpl store;
+  ScopePtr parent = store.createScope("scope.");
+  Gauge& pending = store.gauge("pending");
+
+  {
+    LazyScopeImpl scope(*parent, pending);
+    LazyTestStats stats{LAZY_TEST_STATS(POOL_COUNTER(scope), POOL_GAUGE(scope),
+                                        POOL_HISTOGRAM(scope))};
+    EXPECT_EQ(&stats.c1_, &scope.counter("c1"));
+    EXPECT_EQ(4UL, scope.pendingStats());
+    EXPECT_EQ(4UL, pending.value());
+    EXPECT_EQ(0UL, store.counters().size());
+
+    // Reads do not allocate.
+    EXPECT_EQ("c1", stats.c1_.name());
+    EXPECT_EQ(0UL, stats.c1_.value());
+    EXPECT_FALSE(stats.c1_.used());
+    EXPECT_EQ(0UL, stats.g1_.value());
+    EXPECT_EQ(0UL, stats.c1_.latch());
+    EXPECT_EQ(0UL, store.counters().size());
+
+    stats.c1_.inc();
+    stats.c1_.add(2);
+    EXPECT_EQ(3UL, stats.c1_.value());
+    EXPECT_TRUE(stats.c1_.used());
+    EXPECT_EQ("scope.c1", stats.c1_.name());
+    EXPECT_EQ(3UL, store.counter("scope.c1").value());
+    EXPECT_EQ(1UL, store.counters().size());
+
+    stats.g1_.set(5);
+    stats.g1_.dec();
+    EXPECT_EQ(4UL, store.gauge("scope.g1").value());
+    stats.h1_.recordValue(10);
+    EXPECT_EQ("scope.h1", stats.h1_.name());
+    EXPECT_EQ(1UL, scope.pendingStats());
+    EXPECT_EQ(1UL, pending.value());
+  }
+
+  // Stats that were never written to are no longer pending once the scope is gone.
+  EXPECT_EQ(0UL, pending.value());
+  EXPECT_EQ(3UL, store.counter("scope.c1").value());
+}
+
+TEST(LazyScopeImplTest, NestedScope) {
+  IsolatedStoreImpl store;
+  ScopePtr parent = store.createScope("scope.");
+  Gauge& pending = store.gauge("pending");
+
+  {
+    LazyScopeImpl scope(*parent, pending);
+    ScopePtr nested = scope.createScope("nested.");
+    Counter& c1 = nested->counter("c1");
+    EXPECT_EQ("c1", c1.name());
+    EXPECT_EQ(1UL, pending.value());
+    EXPECT_EQ(0UL, store.counters().size());
+
+    c1.inc();
+    EXPECT_EQ("scope.nested.c1", c1.name());
+    EXPECT_EQ(1UL, store.counter("scope.nested.c1").value());
+    EXPECT_EQ(0UL, pending.value());
+
+    nested->gauge("g1");
+    EXPECT_EQ(1UL, pending.value());
+  }
+
+  EXPECT_EQ(0UL, pending.value());
+}
+
+} // namespace Stats
+} // namespace Envoy
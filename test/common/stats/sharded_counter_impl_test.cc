@@ -0,0 +1,161 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "envoy/common/time.h"
+
+#include "common/common/thread.h"
+#include "common/stats/sharded_counter_impl.h"
+
+#include "fmt/format.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Stats {
+
+// Heap allocator that reference counts data the way the shared memory allocator does, so that
+// counters can share it as they do in overlapping scopes.
+class RefCountingAllocator : public HeapRawStatDataAllocator {
+public:
+  void free(RawStatData& data) override {
+    if (--data.ref_count_ == 0) {
+      data.ref_count_ = 1;
+      HeapRawStatDataAllocator::free(data);
+    }
+  }
+};
+
+class ShardedCounterImplTest : public testing::Test {
+public:
+  std::unique_ptr<ShardedCounterImpl> makeCounter(RawStatData& data) {
+    return std::unique_ptr<ShardedCounterImpl>{
+        new ShardedCounterImpl(data, alloc_, "c", "c", std::vector<Tag>{})};
+  }
+
+  RefCountingAllocator alloc_;
+};
+
+TEST_F(ShardedCounterImplTest, FoldOnRead) {
+  RawStatData& data = *alloc_.alloc("c");
+  std::unique_ptr<ShardedCounterImpl> counter = makeCounter(data);
+  EXPECT_FALSE(counter->used());
+
+  // Increments only reach the RawStatData when the counter is read.
+  counter->inc();
+  counter->add(4);
+  EXPECT_EQ(0UL, data.value_);
+  EXPECT_EQ(5UL, counter->value());
+  EXPECT_EQ(5UL, data.value_);
+  EXPECT_TRUE(counter->used());
+
+  counter->inc();
+  EXPECT_EQ(6UL, counter->latch());
+  EXPECT_EQ(0UL, counter->latch());
+  counter->inc();
+  counter->reset();
+  EXPECT_EQ(0UL, counter->value());
+  EXPECT_EQ(1UL, counter->latch());
+}
+
+TEST_F(ShardedCounterImplTest, SharedData) {
+  // Counters of overlapping scopes share their RawStatData, and with it their shards.
+  RawStatData& data = *alloc_.alloc("c");
+  data.ref_count_++;
+  std::unique_ptr<ShardedCounterImpl> counter1 = makeCounter(data);
+  std::unique_ptr<ShardedCounterImpl> counter2 = makeCounter(data);
+  counter1->inc();
+  EXPECT_EQ(1UL, counter2->value());
+  counter2->inc();
+  EXPECT_EQ(2UL, counter1->value());
+  EXPECT_EQ(2UL, counter2->latch());
+  EXPECT_EQ(0UL, counter1->latch());
+
+  // Increments that were not read yet are folded when a counter is destroyed.
+  counter1->add(3);
+  counter1.reset();
+  EXPECT_EQ(5UL, data.value_);
+  EXPECT_EQ(5UL, counter2->value());
+}
+
+TEST_F(ShardedCounterImplTest, ReusedSlot) {
+  RawStatData& data1 = *alloc_.alloc("c1");
+  std::unique_ptr<ShardedCounterImpl> counter1 = makeCounter(data1);
+  counter1->add(10);
+  counter1.reset();
+
+  // A new counter starts at zero whichever slot it gets.
+  RawStatData& data2 = *alloc_.alloc("c2");
+  std::unique_ptr<ShardedCounterImpl> counter2 = makeCounter(data2);
+  EXPECT_EQ(0UL, counter2->value());
+  counter2->inc();
+  EXPECT_EQ(1UL, counter2->value());
+}
+
+TEST_F(ShardedCounterImplTest, Threads) {
+  RawStatData& data = *alloc_.alloc("c");
+  std::unique_ptr<ShardedCounterImpl> counter = makeCounter(data);
+  const size_t shards = CounterShards::global().activeShards();
+
+  std::vector<Thread::ThreadPtr> threads;
+  for (uint32_t i = 0; i < 4; i++) {
+    threads.emplace_back(new Thread::Thread([&counter]() -> void {
+      for (uint32_t j = 0; j < 1000; j++) {
+        counter->inc();
+      }
+    }));
+  }
+  // Reading while the threads start and increment takes no lock. It must not lose or double count
+  // anything, so the value never goes down.
+  uint64_t last = 0;
+  for (uint32_t i = 0; i < 100; i++) {
+    const uint64_t value = counter->value();
+    EXPECT_LE(last, value);
+    last = value;
+  }
+  for (Thread::ThreadPtr& thread : threads) {
+    thread->join();
+  }
+
+  EXPECT_EQ(4000UL, counter->value());
+  EXPECT_EQ(4000UL, counter->latch());
+  // The shards of exited threads are kept for new threads.
+  EXPECT_EQ(shards, CounterShards::global().activeShards());
+}
+
+// Measures incrementing one counter from many threads at once, as workers do with counters such as
+// http.<stat_prefix>.downstream_rq_total, with and without sharding.
+TEST(ShardedCounterImplBenchmark, DISABLED_ContendedIncrement) {
+  const uint32_t num_threads = 32;
+  const uint32_t num_increments = 1000000;
+
+  HeapRawStatDataAllocator alloc;
+  auto run = [&](Counter& counter) -> std::chrono::milliseconds {
+    const MonotonicTime start = std::chrono::steady_clock::now();
+    std::vector<Thread::ThreadPtr> threads;
+    for (uint32_t i = 0; i < num_threads; i++) {
+      threads.emplace_back(new Thread::Thread([&counter]() -> void {
+        for (uint32_t j = 0; j < num_increments; j++) {
+          counter.inc();
+        }
+      }));
+    }
+    for (Thread::ThreadPtr& thread : threads) {
+      thread->join();
+    }
+    EXPECT_EQ(num_threads * num_increments, counter.value());
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                 start);
+  };
+
+  CounterImpl atomic_counter(*alloc.alloc("atomic"), alloc, "atomic", "atomic", {});
+  ShardedCounterImpl sharded_counter(*alloc.alloc("sharded"), alloc, "sharded", "sharded", {});
+  std::cout << fmt::format("{} threads x {} increments: atomic {} ms, sharded {} ms", num_threads,
+                           num_increments, run(atomic_counter).count(),
+                           run(sharded_counter).count())
+            << std::endl;
+}
+
+} // namespace Stats
+} // namespace Envoy
@@ -83,6 +83,28 @@ TEST(StatsMacros, All) {
   EXPECT_EQ("test.test_histogram", histogram.name());
 }
 
+TEST(MetricImplTest, SymbolizedNames) {
+  HeapRawStatDataAllocator alloc;
+  std::vector<Tag> tags = {{"envoy.cluster_name", "foo.bar"}, {"envoy.response_code", "200"}};
+  {
+    CounterImpl counter(*alloc.alloc(""), alloc, "cluster.foo.bar.upstream_rq_200",
+                        "cluster.upstream_rq", std::vector<Tag>(tags));
+    EXPECT_EQ("cluster.foo.bar.upstream_rq_200", counter.name());
+    EXPECT_EQ("cluster.upstream_rq", counter.tagExtractedName());
+    ASSERT_EQ(2, counter.tags().size());
+    EXPECT_EQ("envoy.cluster_name", counter.tags()[0].name_);
+    EXPECT_EQ("foo.bar", counter.tags()[0].value_);
+    EXPECT_EQ("envoy.response_code", counter.tags()[1].name_);
+    EXPECT_EQ("200", counter.tags()[1].value_);
+  }
+
+  // Names that only differ in a token are still distinct after the first stat is released.
+  GaugeImpl gauge(*alloc.alloc(""), alloc, "cluster.foo.baz.upstream_rq_200", "", {});
+  EXPECT_EQ("cluster.foo.baz.upstream_rq_200", gauge.name());
+  EXPECT_EQ("", gauge.tagExtractedName());
+  EXPECT_TRUE(gauge.tags().empty());
+}
+
 TEST(TagExtractorTest, TwoSubexpressions) {
   TagExtractorImpl tag_extractor("cluster_name", "^cluster\\.((.+?)\\.)");
   std::string name = "cluster.test_cluster.upstream_cx_total";
@@ -105,11 +127,89 @@ TEST(TagExtractorTest, SingleSubexpression) {
   EXPECT_EQ("listner_port", tags.at(0).name_);
 }
 
+TEST(TagExtractorTest, RequiredLiteral) {
+  EXPECT_EQ("cluster.", TagExtractorImpl::requiredLiteral("^cluster\\.((.+?)\\.)"));
+  EXPECT_EQ("cluster.", TagExtractorImpl::requiredLiteral("^cluster(?=\\.).*?\\.grpc\\."));
+  EXPECT_EQ("auth.clientssl.", TagExtractorImpl::requiredLiteral("^auth\\.clientssl\\.((.*?)\\.)"));
+  EXPECT_EQ("_rq", TagExtractorImpl::requiredLiteral("_rq(_(\\d{3}))$"));
+  EXPECT_EQ("listener", TagExtractorImpl::requiredLiteral("^listener\\d"));
+  // Quantified characters are optional.
+  EXPECT_EQ("liste", TagExtractorImpl::requiredLiteral("^listen?er\\."));
+  EXPECT_EQ("listener", TagExtractorImpl::requiredLiteral("^listener\\.*"));
+  // Alternations only make the literal optional outside of a group.
+  EXPECT_EQ("", TagExtractorImpl::requiredLiteral("^cluster\\.(.+)|^listener\\.(.+)"));
+  EXPECT_EQ("http.", TagExtractorImpl::requiredLiteral("^http\\.(?:a|b)\\.(.+)"));
+  EXPECT_EQ("http.", TagExtractorImpl::requiredLiteral("^http\\.[|](.+)"));
+  EXPECT_EQ("", TagExtractorImpl::requiredLiteral("^(?:|listener(?=\\.).*?\\.)http\\.((.*?)\\.)"));
+  EXPECT_EQ("", TagExtractorImpl::requiredLiteral(""));
+}
+
+TEST(TagExtractorTest, LiteralPrefilter) {
+  TagExtractorImpl anchored("cluster_name", "^cluster\\.((.+?)\\.)");
+  EXPECT_TRUE(anchored.anchored());
+  EXPECT_EQ("cluster.", anchored.literal());
+  std::vector<Tag> tags;
+  EXPECT_EQ("http.cluster.foo.rq", anchored.extractTag("http.cluster.foo.rq", tags));
+  EXPECT_EQ("cluster.rq", anchored.extractTag("cluster.foo.rq", tags));
+  ASSERT_EQ(1, tags.size());
+  EXPECT_EQ("foo", tags.at(0).value_);
+
+  tags.clear();
+  TagExtractorImpl unanchored("response_code", "_rq(_(\\d{3}))$");
+  EXPECT_FALSE(unanchored.anchored());
+  EXPECT_EQ("_rq", unanchored.literal());
+  EXPECT_EQ("cluster.foo.upstream_cx_total",
+            unanchored.extractTag("cluster.foo.upstream_cx_total", tags));
+  EXPECT_EQ("cluster.foo.upstream_rq", unanchored.extractTag("cluster.foo.upstream_rq_200", tags));
+  ASSERT_EQ(1, tags.size());
+  EXPECT_EQ("200", tags.at(0).value_);
+}
+
 TEST(TagExtractorTest, EmptyName) {
   EXPECT_THROW_WITH_MESSAGE(TagExtractorImpl::createTagExtractor("", "^listener\\.(\\d+?\\.)"),
                             EnvoyException, "tag_name cannot be empty");
 }
 
+TEST(StatsMatcherTest, NoPatterns) {
+  StatsMatcherImpl matcher({}, {});
+  EXPECT_FALSE(matcher.rejects("cluster.foo.upstream_rq_total"));
+  EXPECT_FALSE(matcher.rejects(""));
+}
+
+TEST(StatsMatcherTest, Inclusions) {
+  StatsMatcherImpl matcher({"prefix:cluster.", "suffix:.downstream_rq_total"}, {});
+  EXPECT_FALSE(matcher.rejects("cluster.foo.upstream_rq_total"));
+  EXPECT_FALSE(matcher.rejects("http.admin.downstream_rq_total"));
+  EXPECT_TRUE(matcher.rejects("http.admin.downstream_rq_time"));
+  EXPECT_TRUE(matcher.rejects("server.cluster."));
+}
+
+TEST(StatsMatcherTest, Exclusions) {
+  StatsMatcherImpl matcher({}, {"regex:cluster\\.[^.]+\\.upstream_rq_\\d{3}"});
+  EXPECT_TRUE(matcher.rejects("cluster.foo.upstream_rq_200"));
+  EXPECT_FALSE(matcher.rejects("cluster.foo.upstream_rq_2xx"));
+  // Regexes must match the whole name.
+  EXPECT_FALSE(matcher.rejects("cluster.foo.upstream_rq_2000"));
+}
+
+TEST(StatsMatcherTest, InclusionsAndExclusions) {
+  StatsMatcherImpl matcher({"prefix:cluster."}, {"prefix:cluster.foo."});
+  EXPECT_FALSE(matcher.rejects("cluster.bar.upstream_rq_total"));
+  EXPECT_TRUE(matcher.rejects("cluster.foo.upstream_rq_total"));
+  EXPECT_TRUE(matcher.rejects("listener.admin.downstream_cx_total"));
+}
+
+TEST(StatsMatcherTest, InvalidPatterns) {
+  EXPECT_THROW_WITH_MESSAGE(StatsMatcherImpl({"cluster."}, {}), EnvoyException,
+                            "invalid stats matcher 'cluster.'");
+  EXPECT_THROW_WITH_MESSAGE(StatsMatcherImpl({}, {"prefix:"}), EnvoyException,
+                            "invalid stats matcher 'prefix:'");
+  EXPECT_THROW_WITH_MESSAGE(
+      StatsMatcherImpl({"exact:cluster.foo"}, {}), EnvoyException,
+      "invalid stats matcher 'exact:cluster.foo': type must be prefix, suffix or regex");
+  EXPECT_THROW(StatsMatcherImpl({}, {"regex:cluster.(foo"}), EnvoyException);
+}
+
 class DefaultTagRegexTester {
 public:
   DefaultTagRegexTester() {
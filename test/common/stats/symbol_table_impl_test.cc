@@ -0,0 +1,139 @@
+#include <string>
+#include <vector>
+
+#include "common/common/thread.h"
+#include "common/stats/symbol_table_impl.h"
+
+#include "fmt/format.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Stats {
+
+class SymbolTableTest : public testing::Test {
+public:
+  std::vector<uint8_t> encode(const std::string& name) {
+    std::vector<uint8_t> encoding;
+    table_.encode(name, encoding);
+    return encoding;
+  }
+
+  std::string decode(const std::vector<uint8_t>& encoding) {
+    const uint8_t* data = encoding.data();
+    std::string name = table_.decode(data);
+    EXPECT_EQ(encoding.data() + encoding.size(), data);
+    return name;
+  }
+
+  void free(const std::vector<uint8_t>& encoding) {
+    const uint8_t* data = encoding.data();
+    table_.free(data);
+    EXPECT_EQ(encoding.data() + encoding.size(), data);
+  }
+
+  SymbolTable table_;
+};
+
+TEST_F(SymbolTableTest, RoundTrip) {
+  for (const std::string& name :
+       {"cluster.foo.upstream_rq_200", "", ".", "a..b", ".leading", "trailing.", "no_dots",
+        "listener.127.0.0.1_80.downstream_cx_total"}) {
+    std::vector<uint8_t> encoding = encode(name);
+    EXPECT_EQ(name, decode(encoding));
+    free(encoding);
+  }
+  EXPECT_EQ(0, table_.size());
+}
+
+TEST_F(SymbolTableTest, SharedTokens) {
+  std::vector<uint8_t> foo = encode("cluster.foo.upstream_rq_200");
+  std::vector<uint8_t> bar = encode("cluster.bar.upstream_rq_200");
+  // One count byte and one byte per symbol.
+  EXPECT_EQ(4, foo.size());
+  EXPECT_EQ(4, table_.size());
+
+  free(foo);
+  EXPECT_EQ(3, table_.size());
+  EXPECT_EQ("cluster.bar.upstream_rq_200", decode(bar));
+
+  // The freed symbol is reused.
+  std::vector<uint8_t> baz = encode("cluster.baz.upstream_rq_200");
+  EXPECT_EQ(foo, baz);
+  free(bar);
+  free(baz);
+  EXPECT_EQ(0, table_.size());
+}
+
+TEST_F(SymbolTableTest, ManySymbols) {
+  std::vector<std::vector<uint8_t>> encodings;
+  for (uint32_t i = 0; i < 1000; i++) {
+    encodings.push_back(encode(fmt::format("cluster.c{}.upstream_rq_total", i)));
+  }
+  for (uint32_t i = 0; i < 1000; i++) {
+    EXPECT_EQ(fmt::format("cluster.c{}.upstream_rq_total", i), decode(encodings[i]));
+  }
+  EXPECT_EQ(1002, table_.size());
+  for (const std::vector<uint8_t>& encoding : encodings) {
+    free(encoding);
+  }
+  EXPECT_EQ(0, table_.size());
+}
+
+TEST_F(SymbolTableTest, StatName) {
+  StatNameStorage foo("cluster.foo", table_);
+  StatNameStorage foo2("cluster.foo", table_);
+  StatNameStorage bar("cluster.bar", table_);
+  EXPECT_EQ(3, foo.statName().size());
+  EXPECT_EQ(foo.statName(), foo2.statName());
+  EXPECT_NE(foo.statName(), bar.statName());
+  EXPECT_EQ(StatNameHash()(foo.statName()), StatNameHash()(foo2.statName()));
+
+  StatNameHashSet names{foo.statName(), bar.statName()};
+  EXPECT_EQ(1, names.count(foo2.statName()));
+  StatNameStorage bar2("cluster.bar", table_);
+  EXPECT_EQ(1, names.count(bar2.statName()));
+  EXPECT_EQ(3, table_.size());
+}
+
+TEST_F(SymbolTableTest, StatNameStorageReleasesSymbols) {
+  { StatNameStorage foo("cluster.foo", table_); }
+  EXPECT_EQ(0, table_.size());
+}
+
+// Threads encode, decode and free names that share tokens with names owned by other threads.
+TEST_F(SymbolTableTest, Multithreaded) {
+  std::vector<Thread::ThreadPtr> threads;
+  for (uint32_t i = 0; i < 8; i++) {
+    threads.emplace_back(new Thread::Thread([this, i]() -> void {
+      for (uint32_t j = 0; j < 1000; j++) {
+        const std::string name = fmt::format("cluster.c{}.upstream_rq_{}", j % 10, i);
+        std::vector<uint8_t> encoding = encode(name);
+        EXPECT_EQ(name, decode(encoding));
+        free(encoding);
+      }
+    }));
+  }
+  for (Thread::ThreadPtr& thread : threads) {
+    thread->join();
+  }
+  EXPECT_EQ(0, table_.size());
+}
+
+TEST(SymbolTableVarintTest, RoundTrip) {
+  for (uint64_t value : {0UL, 1UL, 127UL, 128UL, 300UL, 16383UL, 16384UL, UINT64_MAX}) {
+    std::vector<uint8_t> encoding;
+    SymbolTable::encodeVarint(value, encoding);
+    const uint8_t* data = encoding.data();
+    EXPECT_EQ(value, SymbolTable::decodeVarint(data));
+    EXPECT_EQ(encoding.data() + encoding.size(), data);
+  }
+
+  std::vector<uint8_t> encoding;
+  SymbolTable::encodeVarint(127, encoding);
+  EXPECT_EQ(1, encoding.size());
+  SymbolTable::encodeVarint(128, encoding);
+  EXPECT_EQ(3, encoding.size());
+}
+
+} // namespace Stats
+} // namespace Envoy
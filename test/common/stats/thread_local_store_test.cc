@@ -1,11 +1,15 @@
 #include <chrono>
+#include <iostream>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "common/common/c_smart_ptr.h"
+#include "common/common/thread.h"
 #include "common/stats/thread_local_store.h"
 
+#include "test/mocks/common.h"
 #include "test/mocks/event/mocks.h"
 #include "test/mocks/stats/mocks.h"
 #include "test/mocks/thread_local/mocks.h"
@@ -36,7 +40,7 @@ public:
     CSmartPtr<RawStatData, freeAdapter>& stat_ref = stats_[name];
     if (!stat_ref) {
       stat_ref.reset(static_cast<RawStatData*>(::calloc(RawStatData::size(), 1)));
-      stat_ref->initialize(name);
+      stat_ref->initialize();
     } else {
       stat_ref->ref_count_++;
     }
@@ -107,6 +111,13 @@ TEST_F(StatsThreadLocalStoreTest, NoTls) {
   EXPECT_CALL(sink_, onHistogramComplete(Ref(h1), 100));
   store_->deliverHistogramToSinks(h1, 100);
 
+  // Without TLS values are recorded into the parent histogram and merged synchronously.
+  ReadyWatcher merged;
+  EXPECT_CALL(merged, ready());
+  store_->mergeHistograms([&merged]() -> void { merged.ready(); });
+  EXPECT_EQ(1UL, store_->histograms().size());
+  EXPECT_EQ(1UL, store_->histograms().front()->cumulativeStatistics().sampleCount());
+
   EXPECT_EQ(2UL, store_->counters().size());
   EXPECT_EQ(&c1, store_->counters().front().get());
   EXPECT_EQ(2L, store_->counters().front().use_count());
@@ -156,6 +167,110 @@ TEST_F(StatsThreadLocalStoreTest, Tls) {
   EXPECT_CALL(*this, free(_)).Times(3);
 }
 
+TEST_F(StatsThreadLocalStoreTest, HistogramMerge) {
+  InSequence s;
+  store_->initializeThreading(main_thread_dispatcher_, tls_);
+
+  // Values recorded on a thread are only visible in the parent once merged.
+  Histogram& h1 = store_->histogram("h1");
+  EXPECT_CALL(sink_, onHistogramComplete(Ref(h1), _)).Times(3);
+  h1.recordValue(1);
+  h1.recordValue(2);
+  h1.recordValue(3);
+  ASSERT_EQ(1UL, store_->histograms().size());
+  ParentHistogramSharedPtr parent = store_->histograms().front();
+  EXPECT_EQ("h1", parent->name());
+  EXPECT_FALSE(parent->used());
+
+  ReadyWatcher merged;
+  EXPECT_CALL(tls_, runOnAllThreads(_));
+  EXPECT_CALL(merged, ready());
+  store_->mergeHistograms([&merged]() -> void { merged.ready(); });
+  EXPECT_TRUE(parent->used());
+  EXPECT_EQ(3UL, parent->intervalStatistics().sampleCount());
+  EXPECT_EQ(6UL, parent->intervalStatistics().sampleSum());
+  EXPECT_EQ(1, parent->intervalStatistics().computedQuantiles().front());
+  EXPECT_EQ(3, parent->intervalStatistics().computedQuantiles().back());
+
+  // The interval statistics only cover values recorded since the previous merge.
+  EXPECT_CALL(sink_, onHistogramComplete(Ref(h1), _)).Times(3);
+  h1.recordValue(10);
+  h1.recordValue(1234);
+  h1.recordValue(1299);
+  EXPECT_CALL(tls_, runOnAllThreads(_));
+  EXPECT_CALL(merged, ready());
+  store_->mergeHistograms([&merged]() -> void { merged.ready(); });
+  EXPECT_EQ(3UL, parent->intervalStatistics().sampleCount());
+  EXPECT_EQ(10, parent->intervalStatistics().computedQuantiles().front());
+  EXPECT_EQ(6UL, parent->cumulativeStatistics().sampleCount());
+  EXPECT_EQ(2549UL, parent->cumulativeStatistics().sampleSum());
+
+  // Nothing is merged during shutdown but the callback still runs so that stats are flushed.
+  store_->shutdownThreading();
+  EXPECT_CALL(merged, ready());
+  store_->mergeHistograms([&merged]() -> void { merged.ready(); });
+  tls_.shutdownThread();
+
+  // Includes overflow stat.
+  EXPECT_CALL(*this, free(_));
+}
+
+TEST_F(StatsThreadLocalStoreTest, StatsMatcher) {
+  InSequence s;
+  StatsMatcherImpl matcher({}, {"prefix:cluster.", "suffix:_time"});
+  store_->setStatsMatcher(matcher);
+
+  // Rejected counters and gauges take no stat memory and have no name, but they keep their values
+  // for code that reads them, with or without TLS.
+  Gauge& g1 = store_->gauge("cluster.foo.membership_total");
+  g1.set(5);
+  EXPECT_EQ(5UL, g1.value());
+  EXPECT_EQ("", g1.name());
+
+  store_->initializeThreading(main_thread_dispatcher_, tls_);
+  EXPECT_EQ(&g1, &store_->gauge("cluster.foo.membership_total"));
+  EXPECT_NE(&g1, &store_->gauge("cluster.bar.membership_total"));
+  Counter& c1 = store_->counter("cluster.foo.upstream_rq_total");
+  EXPECT_EQ(&c1, &store_->counter("cluster.foo.upstream_rq_total"));
+  c1.inc();
+  EXPECT_EQ(1UL, c1.value());
+  EXPECT_EQ(0UL, store_->counter("cluster.bar.upstream_rq_total").value());
+
+  ScopePtr scope = store_->createScope("cluster.");
+  Counter& c2 = scope->counter("foo.upstream_rq_total");
+  EXPECT_EQ(&c2, &scope->counter("foo.upstream_rq_total"));
+
+  // Rejected histograms share one histogram that drops all values.
+  Histogram& h1 = store_->histogram("http.admin.downstream_rq_time");
+  EXPECT_EQ(&h1, &store_->histogram("http.admin.downstream_rq_time"));
+  EXPECT_EQ(&h1, &store_->histogram("http.admin.downstream_cx_length_time"));
+  EXPECT_CALL(sink_, onHistogramComplete(_, _)).Times(0);
+  h1.recordValue(100);
+
+  // Accepted stats are unaffected.
+  EXPECT_CALL(*this, alloc("server.live"));
+  Counter& c3 = store_->counter("server.live");
+  c3.inc();
+  EXPECT_EQ(1UL, c3.value());
+
+  // Rejected stats are never listed, so they are never flushed.
+  EXPECT_EQ(2UL, store_->counters().size());
+  EXPECT_EQ(0UL, store_->gauges().size());
+  EXPECT_EQ(0UL, store_->histograms().size());
+
+  scope.reset();
+  ReadyWatcher merged;
+  EXPECT_CALL(tls_, runOnAllThreads(_));
+  EXPECT_CALL(merged, ready());
+  store_->mergeHistograms([&merged]() -> void { merged.ready(); });
+
+  store_->shutdownThreading();
+  tls_.shutdownThread();
+
+  // Includes overflow stat.
+  EXPECT_CALL(*this, free(_)).Times(2);
+}
+
 TEST_F(StatsThreadLocalStoreTest, BasicScope) {
   InSequence s;
   store_->initializeThreading(main_thread_dispatcher_, tls_);
@@ -343,5 +458,78 @@ TEST_F(StatsThreadLocalStoreTest, ShuttingDown) {
   EXPECT_CALL(*this, free(_)).Times(5);
 }
 
+TEST(ShardedStatMapTest, CreateRace) {
+  MockStore store;
+  ShardedStatMap<ParentHistogramImplSharedPtr> map;
+  auto make_stat = [&store]() -> ParentHistogramImplSharedPtr {
+    return std::make_shared<ParentHistogramImpl>("a", store, "a", std::vector<Tag>());
+  };
+
+  // Another thread adds the same stat while ours is being created. The first one added wins.
+  StatNameStorage name("a", SymbolTable::global());
+  ParentHistogramImplSharedPtr other;
+  ParentHistogramImplSharedPtr stat =
+      map.getOrCreate(name.statName(), [&map, &name, &other, &make_stat]() {
+        other = map.getOrCreate(name.statName(), make_stat);
+        return make_stat();
+      });
+  EXPECT_EQ(other, stat);
+  EXPECT_EQ(stat, map.getOrCreate(name.statName(),
+                                  []() -> ParentHistogramImplSharedPtr { return nullptr; }));
+
+  uint32_t count = 0;
+  map.forEach(
+      [&count, &name](StatName stat_name, const ParentHistogramImplSharedPtr& stat) -> void {
+        EXPECT_EQ(name.statName(), stat_name);
+        EXPECT_EQ("a", stat->name());
+        count++;
+      });
+  EXPECT_EQ(1U, count);
+}
+
+// Measures creating stats from many threads at once, which is what happens on the central cache
+// when new scopes are created and every worker fills its cache. Without TLS every lookup goes to
+// the central cache.
+TEST(StatsThreadLocalStoreBenchmark, DISABLED_MultithreadedStatCreation) {
+  const uint32_t num_threads = 8;
+  const uint32_t num_scopes = 100;
+  const uint32_t num_stats = 1000;
+
+  HeapRawStatDataAllocator alloc;
+  ThreadLocalStoreImpl store(alloc);
+  std::vector<ScopePtr> scopes;
+  for (uint32_t i = 0; i < num_scopes; i++) {
+    scopes.push_back(store.createScope(fmt::format("cluster.cluster_{}.", i)));
+  }
+
+  const MonotonicTime start = std::chrono::steady_clock::now();
+  std::vector<Thread::ThreadPtr> threads;
+  for (uint32_t i = 0; i < num_threads; i++) {
+    threads.emplace_back(new Thread::Thread([&scopes, i]() -> void {
+      // Each thread walks the scopes in a different order.
+      for (uint32_t j = 0; j < num_scopes; j++) {
+        Scope& scope = *scopes[(i + j) % num_scopes];
+        for (uint32_t k = 0; k < num_stats; k++) {
+          scope.counter(fmt::format("upstream_rq_{}", k)).inc();
+        }
+      }
+    }));
+  }
+  for (Thread::ThreadPtr& thread : threads) {
+    thread->join();
+  }
+
+  std::cout << fmt::format("{} threads created {} stats in {} ms", num_threads,
+                           num_scopes * num_stats,
+                           std::chrono::duration_cast<std::chrono::milliseconds>(
+                               std::chrono::steady_clock::now() - start)
+                               .count())
+            << std::endl;
+  EXPECT_EQ(num_threads, store.counter("cluster.cluster_0.upstream_rq_0").value());
+
+  store.shutdownThreading();
+  scopes.clear();
+}
+
 } // namespace Stats
 } // namespace Envoy
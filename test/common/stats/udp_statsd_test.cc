@@ -1,4 +1,9 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
 #include <chrono>
+#include <string>
+#include <vector>
 
 #include "common/network/address_impl.h"
 #include "common/network/utility.h"
@@ -13,23 +18,68 @@
 #include "gtest/gtest.h"
 #include "spdlog/spdlog.h"
 
+using testing::Invoke;
 using testing::NiceMock;
+using testing::Return;
+using testing::ReturnPointee;
+using testing::_;
 
 namespace Envoy {
 namespace Stats {
 namespace Statsd {
 
-class UdpStatsdSinkTest : public testing::TestWithParam<Network::Address::IpVersion> {};
+class UdpStatsdSinkTest : public testing::TestWithParam<Network::Address::IpVersion> {
+public:
+  UdpStatsdSinkTest() {
+    // Hold on to posted callbacks so that the tests decide when the end of loop flush happens.
+    ON_CALL(tls_.dispatcher_, post(_)).WillByDefault(Invoke([this](Event::PostCb cb) -> void {
+      posted_.push_back(cb);
+    }));
+  }
+
+  ~UdpStatsdSinkTest() {
+    if (server_fd_ != -1) {
+      ::close(server_fd_);
+    }
+  }
+
+  std::unique_ptr<UdpStatsdSink> createSink(uint64_t max_datagram_bytes, bool use_tags) {
+    auto bound = Network::Test::bindFreeLoopbackPort(GetParam(),
+                                                     Network::Address::SocketType::Datagram);
+    server_fd_ = bound.second;
+    return std::unique_ptr<UdpStatsdSink>(
+        new UdpStatsdSink(tls_, bound.first, max_datagram_bytes, use_tags));
+  }
+
+  // Returns the next datagram received by the statsd server, or "" if there is none.
+  std::string receive() {
+    char buffer[2048];
+    const ssize_t rc = ::recv(server_fd_, buffer, sizeof(buffer), MSG_DONTWAIT);
+    return rc > 0 ? std::string(buffer, rc) : "";
+  }
+
+  void runPosted() {
+    std::vector<Event::PostCb> posted;
+    posted.swap(posted_);
+    for (const Event::PostCb& cb : posted) {
+      cb();
+    }
+  }
+
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  std::vector<Event::PostCb> posted_;
+  int server_fd_{-1};
+};
+
 INSTANTIATE_TEST_CASE_P(IpVersions, UdpStatsdSinkTest,
                         testing::ValuesIn(TestEnvironment::getIpVersionsForTest()));
 
 TEST_P(UdpStatsdSinkTest, InitWithIpAddress) {
-  NiceMock<ThreadLocal::MockInstance> tls_;
   // UDP statsd server address.
   Network::Address::InstanceConstSharedPtr server_address =
       Network::Utility::parseInternetAddressAndPort(
           fmt::format("{}:8125", Network::Test::getLoopbackAddressUrlString(GetParam())));
-  UdpStatsdSink sink(tls_, server_address);
+  UdpStatsdSink sink(tls_, server_address, UdpStatsdSink::DEFAULT_MAX_DATAGRAM_BYTES, false);
   int fd = sink.getFdForTests();
   EXPECT_NE(fd, -1);
 
@@ -45,6 +95,7 @@ TEST_P(UdpStatsdSinkTest, InitWithIpAddress) {
   NiceMock<MockHistogram> timer;
   timer.name_ = "test_timer";
   sink.onHistogramComplete(timer, 5);
+  sink.endFlush();
 
   EXPECT_EQ(fd, sink.getFdForTests());
 
@@ -56,6 +107,80 @@ TEST_P(UdpStatsdSinkTest, InitWithIpAddress) {
   tls_.shutdownThread();
 }
 
+TEST_P(UdpStatsdSinkTest, PackDatagrams) {
+  std::unique_ptr<UdpStatsdSink> sink = createSink(30, false);
+
+  NiceMock<MockCounter> counter;
+  NiceMock<MockGauge> gauge;
+  sink->beginFlush();
+  counter.name_ = "c1";
+  sink->flushCounter(counter, 1);
+  counter.name_ = "c2";
+  sink->flushCounter(counter, 2);
+  // Does not fit into the first datagram.
+  gauge.name_ = "g1";
+  sink->flushGauge(gauge, 3);
+  EXPECT_EQ("", receive());
+
+  sink->endFlush();
+  EXPECT_EQ("envoy.c1:1|c\nenvoy.c2:2|c", receive());
+  EXPECT_EQ("envoy.g1:3|g", receive());
+  EXPECT_EQ("", receive());
+
+  // Nothing is left for the end of loop flush.
+  runPosted();
+  EXPECT_EQ("", receive());
+
+  // Timings recorded in one loop iteration are sent together at the end of it.
+  NiceMock<MockHistogram> timer;
+  timer.name_ = "t";
+  sink->onHistogramComplete(timer, 5);
+  sink->onHistogramComplete(timer, 6);
+  EXPECT_EQ("", receive());
+  EXPECT_EQ(1U, posted_.size());
+  runPosted();
+  EXPECT_EQ("envoy.t:5|ms\nenvoy.t:6|ms", receive());
+
+  tls_.shutdownThread();
+}
+
+TEST_P(UdpStatsdSinkTest, OneMessagePerDatagram) {
+  std::unique_ptr<UdpStatsdSink> sink = createSink(0, false);
+
+  NiceMock<MockCounter> counter;
+  counter.name_ = "c1";
+  sink->flushCounter(counter, 1);
+  sink->flushCounter(counter, 2);
+  sink->endFlush();
+  EXPECT_EQ("envoy.c1:1|c", receive());
+  EXPECT_EQ("envoy.c1:2|c", receive());
+
+  tls_.shutdownThread();
+}
+
+TEST_P(UdpStatsdSinkTest, DogStatsdTags) {
+  std::unique_ptr<UdpStatsdSink> sink = createSink(UdpStatsdSink::DEFAULT_MAX_DATAGRAM_BYTES, true);
+
+  NiceMock<MockCounter> counter;
+  counter.name_ = "cluster.foo.upstream_rq_total";
+  const std::string tag_extracted_name = "cluster.upstream_rq_total";
+  const std::vector<Tag> tags = {{"envoy.cluster_name", "foo"}, {"a", "b"}};
+  ON_CALL(counter, tagExtractedName()).WillByDefault(Return(tag_extracted_name));
+  ON_CALL(counter, tags()).WillByDefault(Return(tags));
+  sink->flushCounter(counter, 1);
+
+  NiceMock<MockGauge> gauge;
+  gauge.name_ = "untagged";
+  ON_CALL(gauge, tagExtractedName()).WillByDefault(ReturnPointee(&gauge.name_));
+  sink->flushGauge(gauge, 2);
+
+  sink->endFlush();
+  EXPECT_EQ("envoy.cluster.upstream_rq_total:1|c|#envoy.cluster_name:foo,a:b\nenvoy.untagged:2|g",
+            receive());
+
+  tls_.shutdownThread();
+}
+
 } // namespace Statsd
 } // namespace Stats
 } // namespace Envoy
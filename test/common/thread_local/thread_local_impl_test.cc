@@ -79,5 +79,28 @@ TEST_F(ThreadLocalInstanceImplTest, All) {
   tls_.shutdownThread();
 }
 
+TEST_F(ThreadLocalInstanceImplTest, RunOnAllThreadsWithCompletion) {
+  InSequence s;
+
+  SlotPtr slot = tls_.allocateSlot();
+
+  // The callback runs on the main thread and then on the worker, which posts the completion back
+  // to the main thread.
+  uint32_t runs = 0;
+  bool complete = false;
+  EXPECT_CALL(thread_dispatcher_, post(_));
+  EXPECT_CALL(main_dispatcher_, post(_));
+  slot->runOnAllThreads([&runs]() -> void { runs++; },
+                        [&runs, &complete]() -> void {
+                          EXPECT_EQ(2U, runs);
+                          complete = true;
+                        });
+  EXPECT_TRUE(complete);
+
+  tls_.shutdownGlobalThreading();
+  slot.reset();
+  tls_.shutdownThread();
+}
+
 } // namespace ThreadLocal
 } // namespace Envoy
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <memory>
 #include <string>
 
@@ -50,7 +51,8 @@ public:
                                   bool added_via_api) -> ClusterSharedPtr {
           return ClusterImplBase::create(cluster, cm, stats_, tls_, dns_resolver_,
                                          ssl_context_manager_, runtime_, random_, dispatcher_,
-                                         local_info_, outlier_event_logger, added_via_api);
+                                         local_info_, outlier_event_logger, added_via_api,
+                                         nullptr);
         }));
   }
 
@@ -70,6 +72,8 @@ public:
     return CdsApiPtr{createCds_()};
   }
 
+  Config::ConfigWorker* configWorker() override { return nullptr; }
+
   ClusterManagerPtr clusterManagerFromProto(const envoy::api::v2::Bootstrap& bootstrap,
                                             Stats::Store& stats, ThreadLocal::Instance& tls,
                                             Runtime::Loader& runtime,
@@ -676,6 +680,54 @@ TEST_F(ClusterManagerImplTest, DynamicAddRemove) {
   EXPECT_TRUE(Mock::VerifyAndClearExpectations(cluster2.get()));
 }
 
+TEST_F(ClusterManagerImplTest, LazyCdsCluster) {
+  const std::string json = R"EOF(
+  {
+    "clusters": []
+  }
+  )EOF";
+
+  ON_CALL(factory_.runtime_.snapshot_, featureEnabled("upstream.lazy_cds_clusters", 0))
+      .WillByDefault(Return(true));
+  create(parseBootstrapFromJson(json));
+
+  std::shared_ptr<MockCluster> cluster1(new NiceMock<MockCluster>());
+  EXPECT_CALL(factory_, clusterFromProto_(_, _, _, _)).WillOnce(Return(cluster1));
+  EXPECT_CALL(*cluster1, initialize(_));
+  EXPECT_TRUE(cluster_manager_->addOrUpdatePrimaryCluster(defaultStaticCluster("fake_cluster")));
+  EXPECT_EQ(1UL, factory_.stats_.gauge("cluster_manager.lazy_clusters").value());
+  EXPECT_EQ(0UL, factory_.stats_.gauge("cluster_manager.worker_clusters_active").value());
+
+  // The first use materializes the cluster on the worker and arms the idle sweep.
+  Event::MockTimer* sweep_timer = new Event::MockTimer(&factory_.dispatcher_);
+  EXPECT_CALL(*sweep_timer, enableTimer(std::chrono::milliseconds(300000)));
+  EXPECT_EQ(cluster1->info_, cluster_manager_->get("fake_cluster")->info());
+  EXPECT_EQ(1UL, factory_.stats_.gauge("cluster_manager.worker_clusters_active").value());
+  EXPECT_EQ(1UL, factory_.stats_.counter("cluster_manager.lazy_cluster_materialized").value());
+
+  // Used since the last sweep so it is kept.
+  EXPECT_CALL(*sweep_timer, enableTimer(std::chrono::milliseconds(300000)));
+  sweep_timer->callback_();
+  EXPECT_EQ(1UL, factory_.stats_.gauge("cluster_manager.worker_clusters_active").value());
+
+  // Idle for a whole sweep period so it is collected, and nothing is left to sweep.
+  sweep_timer->callback_();
+  EXPECT_EQ(0UL, factory_.stats_.gauge("cluster_manager.worker_clusters_active").value());
+  EXPECT_EQ(1UL, factory_.stats_.counter("cluster_manager.lazy_cluster_collected").value());
+
+  // The cluster is still known and materializes again on demand.
+  EXPECT_CALL(*sweep_timer, enableTimer(std::chrono::milliseconds(300000)));
+  EXPECT_NE(nullptr, cluster_manager_->get("fake_cluster"));
+  EXPECT_EQ(2UL, factory_.stats_.counter("cluster_manager.lazy_cluster_materialized").value());
+
+  EXPECT_TRUE(cluster_manager_->removePrimaryCluster("fake_cluster"));
+  EXPECT_EQ(nullptr, cluster_manager_->get("fake_cluster"));
+  EXPECT_EQ(0UL, factory_.stats_.gauge("cluster_manager.lazy_clusters").value());
+  EXPECT_EQ(0UL, factory_.stats_.gauge("cluster_manager.worker_clusters_active").value());
+
+  EXPECT_TRUE(Mock::VerifyAndClearExpectations(cluster1.get()));
+}
+
 TEST_F(ClusterManagerImplTest, AddOrUpdatePrimaryClusterStaticExists) {
   const std::string json =
       fmt::sprintf("{%s}", clustersJson({defaultStaticClusterJson("some_cluster")}));
@@ -756,6 +808,67 @@ TEST_F(ClusterManagerImplTest, CloseConnectionsOnHealthFailure) {
   EXPECT_TRUE(Mock::VerifyAndClearExpectations(cluster1.get()));
 }
 
+// Test that updates without membership changes are merged before going to the workers, and that a
+// membership change cancels any pending merged update.
+TEST_F(ClusterManagerImplTest, MergedHealthUpdates) {
+  const std::string json =
+      fmt::sprintf("{%s}", clustersJson({defaultStaticClusterJson("some_cluster")}));
+
+  std::shared_ptr<MockCluster> cluster1(new NiceMock<MockCluster>());
+  cluster1->info_->name_ = "some_cluster";
+  HostSharedPtr host1 = makeTestHost(cluster1->info_, "tcp://127.0.0.1:80");
+  HostSharedPtr host2 = makeTestHost(cluster1->info_, "tcp://127.0.0.1:81");
+  cluster1->hosts_ = {host1, host2};
+  cluster1->healthy_hosts_ = {host1, host2};
+  ON_CALL(*cluster1, initializePhase()).WillByDefault(Return(Cluster::InitializePhase::Primary));
+  EXPECT_CALL(factory_, clusterFromProto_(_, _, _, _)).WillOnce(Return(cluster1));
+  EXPECT_CALL(*cluster1, initialize(_));
+  create(parseBootstrapFromJson(json));
+  cluster1->initialize_callback_();
+
+  const HostSet& worker_host_set = cluster_manager_->get("some_cluster")->hostSet();
+  EXPECT_EQ(2UL, worker_host_set.healthyHosts().size());
+  EXPECT_EQ(1UL, factory_.stats_.counter("cluster_manager.cluster_updated").value());
+
+  // A burst of health changes only arms the merge timer once.
+  Event::MockTimer* merge_timer = new Event::MockTimer(&factory_.dispatcher_);
+  EXPECT_CALL(*merge_timer, enableTimer(std::chrono::milliseconds(50)));
+  cluster1->healthy_hosts_ = {host1};
+  cluster1->runCallbacks({}, {});
+  cluster1->healthy_hosts_ = {};
+  cluster1->runCallbacks({}, {});
+  EXPECT_EQ(2UL, worker_host_set.healthyHosts().size());
+  EXPECT_EQ(1UL, factory_.stats_.counter("cluster_manager.update_merged").value());
+
+  merge_timer->callback_();
+  EXPECT_EQ(0UL, worker_host_set.healthyHosts().size());
+  EXPECT_EQ(2UL, factory_.stats_.counter("cluster_manager.cluster_updated").value());
+  EXPECT_EQ(1UL, factory_.stats_.counter("cluster_manager.cluster_updated_via_merge").value());
+
+  // A membership change goes out right away and carries the pending health state with it.
+  EXPECT_CALL(*merge_timer, enableTimer(std::chrono::milliseconds(50)));
+  cluster1->healthy_hosts_ = {host1};
+  cluster1->runCallbacks({}, {});
+  EXPECT_CALL(*merge_timer, disableTimer());
+  cluster1->hosts_ = {host1};
+  cluster1->runCallbacks({}, {host2});
+  EXPECT_EQ(1UL, worker_host_set.hosts().size());
+  EXPECT_EQ(1UL, worker_host_set.healthyHosts().size());
+  EXPECT_EQ(3UL, factory_.stats_.counter("cluster_manager.cluster_updated").value());
+  EXPECT_EQ(1UL, factory_.stats_.counter("cluster_manager.update_merge_cancelled").value());
+
+  // With a zero window every update is posted right away.
+  ON_CALL(factory_.runtime_.snapshot_, getInteger("upstream.update_merge_window_ms", _))
+      .WillByDefault(Return(0));
+  cluster1->healthy_hosts_ = {};
+  cluster1->runCallbacks({}, {});
+  EXPECT_EQ(0UL, worker_host_set.healthyHosts().size());
+  EXPECT_EQ(4UL, factory_.stats_.counter("cluster_manager.cluster_updated").value());
+
+  factory_.tls_.shutdownThread();
+  EXPECT_TRUE(Mock::VerifyAndClearExpectations(cluster1.get()));
+}
+
 TEST_F(ClusterManagerImplTest, DynamicHostRemove) {
   const std::string json = R"EOF(
   {
@@ -848,6 +961,59 @@ TEST_F(ClusterManagerImplTest, DynamicHostRemove) {
   factory_.tls_.shutdownThread();
 }
 
+TEST_F(ClusterManagerImplTest, WarmNewHosts) {
+  const std::string json = R"EOF(
+  {
+    "clusters": [
+    {
+      "name": "cluster_1",
+      "connect_timeout_ms": 250,
+      "type": "strict_dns",
+      "dns_resolvers": [ "1.2.3.4:80" ],
+      "lb_type": "round_robin",
+      "hosts": [{"url": "tcp://localhost:11001"}]
+    }]
+  }
+  )EOF";
+
+  std::shared_ptr<Network::MockDnsResolver> dns_resolver(new Network::MockDnsResolver());
+  EXPECT_CALL(factory_.dispatcher_, createDnsResolver(_)).WillOnce(Return(dns_resolver));
+
+  Network::DnsResolver::ResolveCb dns_callback;
+  Event::MockTimer* dns_timer_ = new NiceMock<Event::MockTimer>(&factory_.dispatcher_);
+  Network::MockActiveDnsQuery active_dns_query;
+  EXPECT_CALL(*dns_resolver, resolve(_, _, _))
+      .WillRepeatedly(DoAll(SaveArg<2>(&dns_callback), Return(&active_dns_query)));
+  ON_CALL(factory_.runtime_.snapshot_, featureEnabled("upstream.prefetch.warm_new_hosts", 0))
+      .WillByDefault(Return(true));
+  create(parseBootstrapFromJson(json));
+
+  // Every added host gets a default priority pool that is asked to prefetch.
+  std::vector<Http::ConnectionPool::MockInstance*> pools;
+  EXPECT_CALL(factory_, allocateConnPool_(_))
+      .Times(3)
+      .WillRepeatedly(Invoke([&](HostConstSharedPtr) -> Http::ConnectionPool::Instance* {
+        Http::ConnectionPool::MockInstance* pool = new Http::ConnectionPool::MockInstance();
+        EXPECT_CALL(*pool, prefetch());
+        pools.push_back(pool);
+        return pool;
+      }));
+  dns_callback(TestUtility::makeDnsResponse({"127.0.0.1", "127.0.0.2"}));
+  EXPECT_EQ(2U, pools.size());
+
+  // Requests use the warmed pools.
+  Http::ConnectionPool::Instance* cp =
+      cluster_manager_->httpConnPoolForCluster("cluster_1", ResourcePriority::Default, nullptr);
+  EXPECT_NE(pools.end(), std::find(pools.begin(), pools.end(), cp));
+
+  // Only the new host is warmed on the next update.
+  dns_timer_->callback_();
+  dns_callback(TestUtility::makeDnsResponse({"127.0.0.1", "127.0.0.2", "127.0.0.3"}));
+  EXPECT_EQ(3U, pools.size());
+
+  factory_.tls_.shutdownThread();
+}
+
 // This is a regression test for a use-after-free in
 // ClusterManagerImpl::ThreadLocalClusterManagerImpl::drainConnPools(), where a removal at one
 // priority from the ConnPoolsContainer would delete the ConnPoolsContainer mid-iteration over the
@@ -204,6 +204,117 @@ TEST_F(EdsTest, EndpointLocality) {
   }
 }
 
+// Validate that onConfigUpdate() propagates priority and locality weight to hosts, and that a
+// change of either on an existing host raises a membership update.
+TEST_F(EdsTest, EndpointPriorityAndLocalityWeight) {
+  Protobuf::RepeatedPtrField<envoy::api::v2::ClusterLoadAssignment> resources;
+  auto* cluster_load_assignment = resources.Add();
+  cluster_load_assignment->set_cluster_name("fare");
+  auto* endpoints = cluster_load_assignment->add_endpoints();
+  endpoints->set_priority(1);
+  endpoints->mutable_load_balancing_weight()->set_value(30);
+  endpoints->add_lb_endpoints()
+      ->mutable_endpoint()
+      ->mutable_address()
+      ->mutable_socket_address()
+      ->set_address("1.2.3.4");
+
+  bool initialized = false;
+  cluster_->initialize([&initialized] { initialized = true; });
+  EXPECT_NO_THROW(cluster_->onConfigUpdate(resources));
+  EXPECT_TRUE(initialized);
+
+  HostSharedPtr host = cluster_->hosts()[0];
+  EXPECT_EQ(1U, host->priority());
+  EXPECT_EQ(30U, host->localityWeight());
+
+  uint32_t membership_updates = 0;
+  cluster_->addMemberUpdateCb(
+      [&membership_updates](const std::vector<HostSharedPtr>& hosts_added,
+                            const std::vector<HostSharedPtr>& hosts_removed) -> void {
+        EXPECT_TRUE(hosts_added.empty());
+        EXPECT_TRUE(hosts_removed.empty());
+        membership_updates++;
+      });
+
+  // Same assignment does not raise an update.
+  EXPECT_NO_THROW(cluster_->onConfigUpdate(resources));
+  EXPECT_EQ(0U, membership_updates);
+
+  endpoints->set_priority(0);
+  EXPECT_NO_THROW(cluster_->onConfigUpdate(resources));
+  EXPECT_EQ(1U, membership_updates);
+  EXPECT_EQ(host, cluster_->hosts()[0]);
+  EXPECT_EQ(0U, host->priority());
+}
+
+// Validate that an unchanged assignment skips the rebuild, and that a change only creates hosts for
+// the endpoints that changed.
+TEST_F(EdsTest, IncrementalUpdate) {
+  Protobuf::RepeatedPtrField<envoy::api::v2::ClusterLoadAssignment> resources;
+  auto* cluster_load_assignment = resources.Add();
+  cluster_load_assignment->set_cluster_name("fare");
+  auto* endpoints = cluster_load_assignment->add_endpoints();
+  auto add_endpoint = [endpoints](const std::string& address, uint32_t port) {
+    auto* socket_address = endpoints->add_lb_endpoints()
+                               ->mutable_endpoint()
+                               ->mutable_address()
+                               ->mutable_socket_address();
+    socket_address->set_address(address);
+    socket_address->set_port_value(port);
+  };
+  add_endpoint("1.2.3.4", 80);
+  add_endpoint("1.2.3.5", 80);
+
+  bool initialized = false;
+  cluster_->initialize([&initialized] { initialized = true; });
+  EXPECT_NO_THROW(cluster_->onConfigUpdate(resources));
+  EXPECT_TRUE(initialized);
+  const std::vector<HostSharedPtr> initial_hosts = cluster_->hosts();
+  EXPECT_EQ(2UL, initial_hosts.size());
+
+  std::vector<HostSharedPtr> added;
+  std::vector<HostSharedPtr> removed;
+  uint32_t membership_updates = 0;
+  cluster_->addMemberUpdateCb([&](const std::vector<HostSharedPtr>& hosts_added,
+                                  const std::vector<HostSharedPtr>& hosts_removed) -> void {
+    added = hosts_added;
+    removed = hosts_removed;
+    membership_updates++;
+  });
+
+  EXPECT_NO_THROW(cluster_->onConfigUpdate(resources));
+  EXPECT_EQ(1UL, stats_.counter("cluster.name.update_no_rebuild").value());
+  EXPECT_EQ(0U, membership_updates);
+
+  // Replace one endpoint. The untouched one keeps its host.
+  endpoints->mutable_lb_endpoints()->RemoveLast();
+  add_endpoint("1.2.3.6", 80);
+  EXPECT_NO_THROW(cluster_->onConfigUpdate(resources));
+  EXPECT_EQ(1U, membership_updates);
+  ASSERT_EQ(2UL, cluster_->hosts().size());
+  EXPECT_EQ(initial_hosts[0], cluster_->hosts()[0]);
+  ASSERT_EQ(1UL, added.size());
+  EXPECT_EQ("1.2.3.6:80", added[0]->address()->asString());
+  ASSERT_EQ(1UL, removed.size());
+  EXPECT_EQ(initial_hosts[1], removed[0]);
+
+  // A weight change is applied to the existing host without a membership update.
+  endpoints->mutable_lb_endpoints(0)->mutable_load_balancing_weight()->set_value(10);
+  EXPECT_NO_THROW(cluster_->onConfigUpdate(resources));
+  EXPECT_EQ(1U, membership_updates);
+  EXPECT_EQ(initial_hosts[0], cluster_->hosts()[0]);
+  EXPECT_EQ(10U, initial_hosts[0]->weight());
+  EXPECT_EQ(1UL, stats_.counter("cluster.name.update_no_rebuild").value());
+
+  // Duplicate endpoints share a host, which does not prevent skipping the next rebuild.
+  add_endpoint("1.2.3.6", 80);
+  EXPECT_NO_THROW(cluster_->onConfigUpdate(resources));
+  EXPECT_EQ(2UL, cluster_->hosts().size());
+  EXPECT_NO_THROW(cluster_->onConfigUpdate(resources));
+  EXPECT_EQ(2UL, stats_.counter("cluster.name.update_no_rebuild").value());
+}
+
 // Validate that onConfigUpdate() updates bins hosts per locality as expected.
 TEST_F(EdsTest, EndpointHostsPerLocality) {
   Protobuf::RepeatedPtrField<envoy::api::v2::ClusterLoadAssignment> resources;
@@ -0,0 +1,148 @@
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_set>
+
+#include "common/api/api_impl.h"
+#include "common/common/utility.h"
+#include "common/config/cds_json.h"
+#include "common/event/dispatcher_impl.h"
+#include "common/json/json_loader.h"
+#include "common/network/listen_socket_impl.h"
+#include "common/stats/stats_impl.h"
+#include "common/upstream/health_check_shard_pool.h"
+#include "common/upstream/health_checker_impl.h"
+
+#include "test/common/upstream/utility.h"
+#include "test/mocks/runtime/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+#include "test/mocks/upstream/mocks.h"
+#include "test/test_common/network_utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::NiceMock;
+using testing::_;
+
+namespace Envoy {
+namespace Upstream {
+namespace {
+
+class HealthCheckShardPoolTest : public testing::Test {
+public:
+  HealthCheckShardPoolTest() : api_(std::chrono::milliseconds(10000)) {}
+
+  void createPool(uint32_t concurrency) {
+    EXPECT_CALL(tls_, registerThread(_, false)).Times(concurrency);
+    pool_.reset(new HealthCheckShardPool(concurrency, api_, tls_, stats_store_,
+                                         ProdMonotonicTimeSource::instance_));
+  }
+
+  Api::Impl api_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  Stats::IsolatedStoreImpl stats_store_;
+  HealthCheckShardPoolPtr pool_;
+};
+
+TEST_F(HealthCheckShardPoolTest, ShardForHost) {
+  createPool(4);
+  EXPECT_EQ(4U, pool_->size());
+
+  std::shared_ptr<MockClusterInfo> info{new NiceMock<MockClusterInfo>()};
+  std::unordered_set<uint32_t> used_shards;
+  for (uint32_t i = 0; i < 64; i++) {
+    HostSharedPtr host = makeTestHost(info, fmt::format("tcp://127.0.0.1:{}", 1000 + i));
+    HealthCheckShardPool::Shard& shard = pool_->shardForHost(*host);
+    EXPECT_LT(shard.index(), 4U);
+    EXPECT_EQ(&shard, &pool_->shard(shard.index()));
+
+    // The same address always maps to the same shard.
+    HostSharedPtr same_host = makeTestHost(info, fmt::format("tcp://127.0.0.1:{}", 1000 + i));
+    EXPECT_EQ(&shard, &pool_->shardForHost(*same_host));
+    used_shards.insert(shard.index());
+  }
+  EXPECT_LT(1U, used_shards.size());
+}
+
+TEST_F(HealthCheckShardPoolTest, RunOnShardAndWait) {
+  createPool(2);
+  HealthCheckShardPool::Shard& shard = pool_->shard(1);
+  EXPECT_FALSE(shard.isShardThread());
+
+  bool ran_on_shard = false;
+  pool_->runOnShardAndWait(shard, [&]() -> void { ran_on_shard = shard.isShardThread(); });
+  EXPECT_TRUE(ran_on_shard);
+
+  // After shutdown callbacks run inline.
+  EXPECT_CALL(tls_, shutdownThread()).Times(2);
+  pool_->shutdown();
+  pool_->runOnShardAndWait(shard, [&]() -> void { ran_on_shard = shard.isShardThread(); });
+  EXPECT_FALSE(ran_on_shard);
+
+  EXPECT_EQ(0U, stats_store_.gauge("health_check_shard.0.active_sessions").value());
+  EXPECT_EQ(0U, stats_store_.gauge("health_check_shard.1.active_sessions").value());
+}
+
+TEST_F(HealthCheckShardPoolTest, ShardedTcpHealthCheck) {
+  createPool(2);
+
+  // Bind without listening so that connections are refused right away.
+  Network::TcpListenSocket socket(
+      Network::Test::getCanonicalLoopbackAddress(Network::Address::IpVersion::v4), true);
+
+  std::string json = R"EOF(
+  {
+    "type": "tcp",
+    "timeout_ms": 1000,
+    "interval_ms": 1000,
+    "unhealthy_threshold": 1,
+    "healthy_threshold": 1,
+    "send": [],
+    "receive": []
+  }
+  )EOF";
+
+  envoy::api::v2::HealthCheck health_check;
+  Config::CdsJson::translateHealthCheck(*Json::Factory::loadFromString(json), health_check);
+
+  Event::DispatcherImpl dispatcher;
+  NiceMock<MockCluster> cluster;
+  NiceMock<Runtime::MockLoader> runtime;
+  NiceMock<Runtime::MockRandomGenerator> random;
+  HostSharedPtr host = makeTestHost(cluster.info_, "tcp://" + socket.localAddress()->asString());
+  cluster.hosts_ = {host};
+
+  HealthCheckerSharedPtr health_checker = HealthCheckerFactory::create(
+      health_check, cluster, runtime, random, dispatcher, pool_.get());
+
+  // Result callbacks run on the main thread even though the session runs on a shard.
+  Event::TimerPtr timeout = dispatcher.createTimer([&]() -> void {
+    ADD_FAILURE() << "timed out waiting for health check result";
+    dispatcher.exit();
+  });
+  timeout->enableTimer(std::chrono::seconds(10));
+  health_checker->addHostCheckCompleteCb([&](HostSharedPtr result_host, bool changed_state) {
+    EXPECT_EQ(host, result_host);
+    EXPECT_TRUE(changed_state);
+    EXPECT_FALSE(pool_->shardForHost(*host).isShardThread());
+    dispatcher.exit();
+  });
+  health_checker->start();
+  dispatcher.run(Event::Dispatcher::RunType::Block);
+
+  EXPECT_TRUE(host->healthFlagGet(Host::HealthFlag::FAILED_ACTIVE_HC));
+  const std::string prefix =
+      fmt::format("health_check_shard.{}.", pool_->shardForHost(*host).index());
+  EXPECT_EQ(1U, stats_store_.gauge(prefix + "active_sessions").value());
+  EXPECT_EQ(1U, stats_store_.counter(prefix + "result_batch").value());
+  EXPECT_LE(1U, stats_store_.counter(prefix + "result").value());
+
+  // Destroying the health checker tears down the session on its shard.
+  health_checker.reset();
+  EXPECT_EQ(0U, stats_store_.gauge(prefix + "active_sessions").value());
+}
+
+} // namespace
+} // namespace Upstream
+} // namespace Envoy
@@ -1,3 +1,4 @@
+#include <array>
 #include <chrono>
 #include <memory>
 #include <string>
@@ -5,6 +6,7 @@
 
 #include "common/buffer/buffer_impl.h"
 #include "common/config/cds_json.h"
+#include "common/grpc/codec.h"
 #include "common/http/headers.h"
 #include "common/json/json_loader.h"
 #include "common/network/utility.h"
@@ -63,7 +65,7 @@ TEST(HealthCheckerFactoryTest, createRedis) {
   Event::MockDispatcher dispatcher;
   EXPECT_NE(nullptr, dynamic_cast<RedisHealthCheckerImpl*>(
                          HealthCheckerFactory::create(parseHealthCheckFromJson(json), cluster,
-                                                      runtime, random, dispatcher)
+                                                      runtime, random, dispatcher, nullptr)
                              .get()));
 }
 
@@ -77,17 +79,20 @@ TEST(HealthCheckerFactoryTest, MissingFieldiException) {
   Event::MockDispatcher dispatcher;
   envoy::api::v2::HealthCheck health_check;
   // No health checker type set
-  EXPECT_THROW(HealthCheckerFactory::create(health_check, cluster, runtime, random, dispatcher),
-               EnvoyException);
+  EXPECT_THROW(
+      HealthCheckerFactory::create(health_check, cluster, runtime, random, dispatcher, nullptr),
+      EnvoyException);
   health_check.mutable_http_health_check();
   // No timeout field set.
-  EXPECT_THROW(HealthCheckerFactory::create(health_check, cluster, runtime, random, dispatcher),
-               MissingFieldException);
+  EXPECT_THROW(
+      HealthCheckerFactory::create(health_check, cluster, runtime, random, dispatcher, nullptr),
+      MissingFieldException);
 }
 
 class TestHttpHealthCheckerImpl : public HttpHealthCheckerImpl {
 public:
   using HttpHealthCheckerImpl::HttpHealthCheckerImpl;
+  using HttpHealthCheckerImpl::codecClientType;
 
   Http::CodecClient* createCodecClient(Upstream::Host::CreateConnectionData& conn_data) override {
     return createCodecClient_(conn_data);
@@ -156,6 +161,26 @@ public:
     });
   }
 
+  void setupGrpcHC() {
+    std::string json = R"EOF(
+    {
+      "type": "http",
+      "timeout_ms": 1000,
+      "interval_ms": 1000,
+      "service_name": "locations",
+      "unhealthy_threshold": 2,
+      "healthy_threshold": 2,
+      "path": "/grpc.health.v1.Health/Check"
+    }
+    )EOF";
+
+    health_checker_.reset(new TestHttpHealthCheckerImpl(*cluster_, parseHealthCheckFromJson(json),
+                                                        dispatcher_, runtime_, random_));
+    health_checker_->addHostCheckCompleteCb([this](HostSharedPtr host, bool changed_state) -> void {
+      onHostStatus(host, changed_state);
+    });
+  }
+
   void expectSessionCreate() {
     // Expectations are in LIFO order.
     TestSessionPtr new_test_session(new TestSession());
@@ -213,6 +238,25 @@ public:
     }
   }
 
+  void respondGrpc(size_t index, uint8_t serving_status, const std::string& grpc_status) {
+    test_sessions_[index]->stream_response_callbacks_->decodeHeaders(
+        Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"},
+                                                       {"content-type", "application/grpc"}}},
+        false);
+
+    // HealthCheckResponse{status: serving_status}
+    const uint8_t message[] = {0x08, serving_status};
+    std::array<uint8_t, 5> header;
+    Grpc::Encoder().newFrame(Grpc::GRPC_FH_DEFAULT, sizeof(message), header);
+    Buffer::OwnedImpl response_data;
+    response_data.add(header.data(), header.size());
+    response_data.add(message, sizeof(message));
+    test_sessions_[index]->stream_response_callbacks_->decodeData(response_data, false);
+
+    test_sessions_[index]->stream_response_callbacks_->decodeTrailers(
+        Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{"grpc-status", grpc_status}}});
+  }
+
   MOCK_METHOD2(onHostStatus, void(HostSharedPtr host, bool changed_state));
 
   std::shared_ptr<MockCluster> cluster_;
@@ -654,6 +698,143 @@ TEST_F(HttpHealthCheckerImplTest, ConnectionReachesWatermarkDuringCheck) {
   EXPECT_TRUE(cluster_->hosts_[0]->healthy());
 }
 
+TEST_F(HttpHealthCheckerImplTest, Http2IsOptIn) {
+  ON_CALL(*cluster_->info_, features()).WillByDefault(Return(ClusterInfo::Features::HTTP2));
+  setupNoServiceValidationHC();
+  EXPECT_EQ(Http::CodecClient::Type::HTTP1, health_checker_->codecClientType());
+
+  ON_CALL(runtime_.snapshot_, getInteger("health_check.http2.fake_cluster", 0))
+      .WillByDefault(Return(1));
+  setupNoServiceValidationHC();
+  EXPECT_EQ(Http::CodecClient::Type::HTTP2, health_checker_->codecClientType());
+
+  ON_CALL(*cluster_->info_, features()).WillByDefault(Return(0));
+  setupNoServiceValidationHC();
+  EXPECT_EQ(Http::CodecClient::Type::HTTP1, health_checker_->codecClientType());
+}
+
+TEST_F(HttpHealthCheckerImplTest, Http2TimeoutResetsStreamOnly) {
+  ON_CALL(*cluster_->info_, features()).WillByDefault(Return(ClusterInfo::Features::HTTP2));
+  ON_CALL(runtime_.snapshot_, getInteger("health_check.http2.fake_cluster", 0))
+      .WillByDefault(Return(1));
+  setupNoServiceValidationHC();
+  cluster_->hosts_ = {makeTestHost(cluster_->info_, "tcp://127.0.0.1:80")};
+  expectSessionCreate();
+  expectStreamCreate(0);
+  EXPECT_CALL(test_sessions_[0]->request_encoder_, encodeHeaders(_, true))
+      .WillOnce(Invoke([](const Http::HeaderMap& headers, bool) -> void {
+        EXPECT_STREQ("GET", headers.Method()->value().c_str());
+        EXPECT_STREQ("http", headers.Scheme()->value().c_str());
+      }));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  health_checker_->start();
+
+  // The timed out stream is reset but the connection is kept for the next check.
+  EXPECT_CALL(*this, onHostStatus(_, true));
+  EXPECT_CALL(*test_sessions_[0]->client_connection_, close(_)).Times(0);
+  EXPECT_CALL(test_sessions_[0]->request_encoder_.stream_,
+              resetStream(Http::StreamResetReason::LocalReset));
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(_));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  test_sessions_[0]->timeout_timer_->callback_();
+  EXPECT_TRUE(cluster_->hosts_[0]->healthFlagGet(Host::HealthFlag::FAILED_ACTIVE_HC));
+
+  expectStreamCreate(0);
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  test_sessions_[0]->interval_timer_->callback_();
+
+  EXPECT_CALL(*this, onHostStatus(_, false));
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(_));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  respond(0, "200", false);
+  EXPECT_TRUE(cluster_->hosts_[0]->healthFlagGet(Host::HealthFlag::FAILED_ACTIVE_HC));
+}
+
+TEST_F(HttpHealthCheckerImplTest, GrpcSuccess) {
+  setupGrpcHC();
+  EXPECT_CALL(*this, onHostStatus(_, false));
+
+  cluster_->hosts_ = {makeTestHost(cluster_->info_, "tcp://127.0.0.1:80")};
+  expectSessionCreate();
+  expectStreamCreate(0);
+  EXPECT_CALL(test_sessions_[0]->request_encoder_, encodeHeaders(_, false))
+      .WillOnce(Invoke([](const Http::HeaderMap& headers, bool) -> void {
+        EXPECT_STREQ("POST", headers.Method()->value().c_str());
+        EXPECT_STREQ("/grpc.health.v1.Health/Check", headers.Path()->value().c_str());
+        EXPECT_STREQ("application/grpc", headers.ContentType()->value().c_str());
+        EXPECT_STREQ("trailers", headers.TE()->value().c_str());
+        EXPECT_STREQ("http", headers.Scheme()->value().c_str());
+      }));
+  EXPECT_CALL(test_sessions_[0]->request_encoder_, encodeData(_, true))
+      .WillOnce(Invoke([](Buffer::Instance& data, bool) -> void {
+        Buffer::OwnedImpl expected;
+        GrpcHealthCheckCodec::encodeRequest("locations", expected);
+        EXPECT_EQ(TestUtility::bufferToString(expected), TestUtility::bufferToString(data));
+      }));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  health_checker_->start();
+
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(_));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  respondGrpc(0, 1, "0");
+  EXPECT_TRUE(cluster_->hosts_[0]->healthy());
+}
+
+TEST_F(HttpHealthCheckerImplTest, GrpcFail) {
+  setupGrpcHC();
+  cluster_->hosts_ = {makeTestHost(cluster_->info_, "tcp://127.0.0.1:80")};
+  expectSessionCreate();
+  expectStreamCreate(0);
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  health_checker_->start();
+
+  // NOT_SERVING.
+  EXPECT_CALL(*this, onHostStatus(_, true));
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(_));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  respondGrpc(0, 2, "0");
+  EXPECT_TRUE(cluster_->hosts_[0]->healthFlagGet(Host::HealthFlag::FAILED_ACTIVE_HC));
+
+  // SERVING but with a non OK grpc-status.
+  expectStreamCreate(0);
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  test_sessions_[0]->interval_timer_->callback_();
+
+  EXPECT_CALL(*this, onHostStatus(_, false));
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(_));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  respondGrpc(0, 1, "14");
+  EXPECT_TRUE(cluster_->hosts_[0]->healthFlagGet(Host::HealthFlag::FAILED_ACTIVE_HC));
+  EXPECT_EQ(0UL, cluster_->info_->stats_store_.counter("health_check.success").value());
+}
+
+TEST(GrpcHealthCheckCodecTest, EncodeRequest) {
+  Buffer::OwnedImpl empty;
+  GrpcHealthCheckCodec::encodeRequest("", empty);
+  EXPECT_EQ(std::string("\0\0\0\0\0", 5), TestUtility::bufferToString(empty));
+
+  Buffer::OwnedImpl service;
+  GrpcHealthCheckCodec::encodeRequest("foo", service);
+  EXPECT_EQ(std::string("\0\0\0\0\x05\x0a\x03" "foo", 10), TestUtility::bufferToString(service));
+}
+
+TEST(GrpcHealthCheckCodecTest, IsServing) {
+  auto is_serving = [](const std::string& message) -> bool {
+    Buffer::OwnedImpl buffer(message);
+    return GrpcHealthCheckCodec::isServing(buffer);
+  };
+
+  EXPECT_TRUE(is_serving(std::string("\x08\x01", 2)));
+  EXPECT_FALSE(is_serving(std::string("\x08\x02", 2)));
+  // UNKNOWN is the default value and is encoded as an empty message.
+  EXPECT_FALSE(is_serving(""));
+  // Unknown fields are skipped.
+  EXPECT_TRUE(is_serving(std::string("\x12\x02hi\x08\x01\x1d\0\0\0\0", 11)));
+  // Truncated.
+  EXPECT_FALSE(is_serving(std::string("\x08", 1)));
+  EXPECT_FALSE(is_serving(std::string("\x12\x05hi\x08\x01", 6)));
+}
+
 TEST(TcpHealthCheckMatcher, loadJsonBytes) {
   {
     Protobuf::RepeatedPtrField<envoy::api::v2::HealthCheck::Payload> repeated_payload;
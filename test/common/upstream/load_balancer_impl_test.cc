@@ -382,6 +382,86 @@ TEST_F(RoundRobinLoadBalancerTest, NoZoneAwareRoutingLocalEmpty) {
   EXPECT_EQ(1U, stats_.lb_local_cluster_not_ok_.value());
 }
 
+HostSharedPtr makeLocalityTestHost(ClusterInfoConstSharedPtr cluster, const std::string& url,
+                                   const std::string& zone, uint32_t priority,
+                                   uint32_t locality_weight) {
+  envoy::api::v2::Locality locality;
+  locality.set_zone(zone);
+  HostSharedPtr host{new HostImpl(cluster, "", Network::Utility::resolveUrl(url),
+                                  envoy::api::v2::Metadata::default_instance(), 1, locality)};
+  host->priority(priority);
+  host->localityWeight(locality_weight);
+  return host;
+}
+
+TEST_F(RoundRobinLoadBalancerTest, PriorityFailover) {
+  init(false);
+  cluster_.hosts_ = {makeLocalityTestHost(cluster_.info_, "tcp://127.0.0.1:80", "", 0, 0),
+                     makeLocalityTestHost(cluster_.info_, "tcp://127.0.0.1:81", "", 0, 0),
+                     makeLocalityTestHost(cluster_.info_, "tcp://127.0.0.1:82", "", 1, 0),
+                     makeLocalityTestHost(cluster_.info_, "tcp://127.0.0.1:83", "", 1, 0)};
+  cluster_.hosts_[1]->healthFlagSet(Host::HealthFlag::FAILED_ACTIVE_HC);
+  cluster_.healthy_hosts_ = {cluster_.hosts_[0], cluster_.hosts_[2], cluster_.hosts_[3]};
+  cluster_.runCallbacks({}, {});
+
+  // Priority 0 has 50% healthy hosts, with the default overprovisioning factor of 140% it keeps
+  // 70% of the traffic and the rest spills over to priority 1.
+  EXPECT_CALL(random_, random()).WillOnce(Return(69));
+  EXPECT_EQ(cluster_.hosts_[0], lb_->chooseHost(nullptr));
+  EXPECT_EQ(0U, stats_.lb_priority_spillover_.value());
+
+  EXPECT_CALL(random_, random()).WillOnce(Return(70));
+  EXPECT_EQ(cluster_.hosts_[3], lb_->chooseHost(nullptr));
+  EXPECT_EQ(1U, stats_.lb_priority_spillover_.value());
+
+  // Once priority 0 is healthy again it takes all traffic.
+  cluster_.hosts_[1]->healthFlagClear(Host::HealthFlag::FAILED_ACTIVE_HC);
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  cluster_.runCallbacks({}, {});
+  EXPECT_CALL(random_, random()).WillOnce(Return(99));
+  EXPECT_EQ(cluster_.hosts_[0], lb_->chooseHost(nullptr));
+  EXPECT_EQ(1U, stats_.lb_priority_spillover_.value());
+}
+
+TEST_F(RoundRobinLoadBalancerTest, LocalityWeighted) {
+  init(false);
+  cluster_.hosts_ = {makeLocalityTestHost(cluster_.info_, "tcp://127.0.0.1:80", "a", 0, 1),
+                     makeLocalityTestHost(cluster_.info_, "tcp://127.0.0.1:81", "b", 0, 3),
+                     makeLocalityTestHost(cluster_.info_, "tcp://127.0.0.1:82", "b", 0, 3)};
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  cluster_.runCallbacks({}, {});
+
+  // With weights 1 and 3 the alias table gives locality "a" half of the first column and
+  // locality "b" everything else.
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+  EXPECT_EQ(cluster_.hosts_[0], lb_->chooseHost(nullptr));
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(600000));
+  EXPECT_EQ(cluster_.hosts_[2], lb_->chooseHost(nullptr));
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1)).WillOnce(Return(0));
+  EXPECT_EQ(cluster_.hosts_[1], lb_->chooseHost(nullptr));
+  EXPECT_EQ(3U, stats_.lb_locality_weighted_.value());
+}
+
+TEST(AliasTableTest, Empty) {
+  EXPECT_TRUE(AliasTable().empty());
+  EXPECT_TRUE(AliasTable({0, 0}).empty());
+}
+
+TEST(AliasTableTest, Distribution) {
+  AliasTable table({1, 0, 2, 5});
+  std::vector<uint64_t> picks(4);
+  for (uint64_t column = 0; column < 4; column++) {
+    for (uint64_t coin = 0; coin < 1000000; coin += 1000) {
+      picks[table.pick(column, coin)]++;
+    }
+  }
+
+  EXPECT_EQ(500U, picks[0]);
+  EXPECT_EQ(0U, picks[1]);
+  EXPECT_EQ(1000U, picks[2]);
+  EXPECT_EQ(2500U, picks[3]);
+}
+
 class LeastRequestLoadBalancerTest : public testing::Test {
 public:
   LeastRequestLoadBalancerTest() : stats_(ClusterInfoImpl::generateStats(stats_store_)) {}
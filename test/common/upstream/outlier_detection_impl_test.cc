@@ -7,6 +7,7 @@
 #include "envoy/common/optional.h"
 #include "envoy/common/time.h"
 
+#include "common/common/thread.h"
 #include "common/network/utility.h"
 #include "common/upstream/outlier_detection_impl.h"
 #include "common/upstream/upstream_impl.h"
@@ -505,6 +506,135 @@ TEST_F(OutlierDetectorImplTest, Consecutive5xxAlreadyEjected) {
   loadRq(cluster_.hosts_[0], 5, 503);
 }
 
+TEST_F(OutlierDetectorImplTest, SubWindowsAndLatency) {
+  EXPECT_CALL(cluster_, addMemberUpdateCb(_));
+  addHosts({
+      "tcp://127.0.0.1:80",
+      "tcp://127.0.0.1:81",
+      "tcp://127.0.0.1:82",
+      "tcp://127.0.0.1:83",
+      "tcp://127.0.0.1:84",
+  });
+
+  ON_CALL(runtime_.snapshot_, getInteger("outlier_detection.sub_windows", 1))
+      .WillByDefault(Return(2));
+  ON_CALL(runtime_.snapshot_, getInteger("outlier_detection.latency_p99_factor", 0))
+      .WillByDefault(Return(3000));
+  ON_CALL(runtime_.snapshot_, featureEnabled("outlier_detection.enforcing_latency", 100))
+      .WillByDefault(Return(true));
+  EXPECT_CALL(*interval_timer_, enableTimer(std::chrono::milliseconds(5000)));
+  std::shared_ptr<DetectorImpl> detector(DetectorImpl::create(
+      cluster_, empty_outlier_detection_, dispatcher_, runtime_, time_source_, event_logger_));
+  detector->addChangedStateCb([&](HostSharedPtr host) -> void { checker_.check(host); });
+  EXPECT_CALL(time_source_, currentTime())
+      .WillRepeatedly(Return(MonotonicTime(std::chrono::milliseconds(5000))));
+
+  // Half of the request volume in each sub-window. Nothing happens until both are in the window.
+  for (uint32_t i = 0; i < 2; i++) {
+    for (uint64_t j = 0; j < 50; j++) {
+      for (uint64_t k = 0; k < 4; k++) {
+        cluster_.hosts_[k]->outlierDetector().putResponseTime(std::chrono::milliseconds(10));
+      }
+      cluster_.hosts_[4]->outlierDetector().putResponseTime(std::chrono::milliseconds(1000));
+    }
+
+    if (i == 1) {
+      EXPECT_CALL(checker_, check(cluster_.hosts_[4]));
+      EXPECT_CALL(*event_logger_,
+                  logEject(std::static_pointer_cast<const HostDescription>(cluster_.hosts_[4]), _,
+                           EjectionType::Latency, true));
+    }
+    EXPECT_CALL(*interval_timer_, enableTimer(std::chrono::milliseconds(5000)));
+    interval_timer_->callback_();
+  }
+
+  EXPECT_TRUE(cluster_.hosts_[4]->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK));
+  EXPECT_EQ(1UL,
+            cluster_.info_->stats_store_.counter("outlier_detection.ejections_latency").value());
+}
+
+TEST(SlidingWindowAccumulatorTest, SuccessRate) {
+  SlidingWindowAccumulator accumulator;
+  EXPECT_FALSE(accumulator.getSuccessRate(0).valid());
+
+  // Three sub-windows: 100% (10 rq), 0% (10 rq), 50% (20 rq).
+  for (uint32_t i = 0; i < 10; i++) {
+    accumulator.recordResponse(true);
+  }
+  accumulator.closeSubWindow(3);
+  EXPECT_EQ(100.0, accumulator.getSuccessRate(10).value());
+  EXPECT_FALSE(accumulator.getSuccessRate(11).valid());
+
+  for (uint32_t i = 0; i < 10; i++) {
+    accumulator.recordResponse(false);
+  }
+  accumulator.closeSubWindow(3);
+  EXPECT_EQ(50.0, accumulator.getSuccessRate(20).value());
+
+  for (uint32_t i = 0; i < 10; i++) {
+    accumulator.recordResponse(true);
+    accumulator.recordResponse(false);
+  }
+  accumulator.closeSubWindow(3);
+  EXPECT_EQ(50.0, accumulator.getSuccessRate(40).value());
+
+  // The first sub-window slides out.
+  accumulator.closeSubWindow(3);
+  EXPECT_EQ(100.0 / 3, accumulator.getSuccessRate(30).value());
+
+  // Shrinking the window drops the oldest sub-windows right away.
+  accumulator.closeSubWindow(1);
+  EXPECT_FALSE(accumulator.getSuccessRate(1).valid());
+
+  accumulator.recordResponse(true);
+  accumulator.clear();
+  accumulator.closeSubWindow(1);
+  EXPECT_EQ(100.0, accumulator.getSuccessRate(1).value());
+}
+
+TEST(SlidingWindowAccumulatorTest, ManyThreads) {
+  // More threads than the old fixed stripe count, each recording into its own stripe.
+  SlidingWindowAccumulator accumulator;
+  std::vector<Thread::ThreadPtr> threads;
+  for (uint32_t i = 0; i < 32; i++) {
+    threads.emplace_back(new Thread::Thread([&accumulator]() -> void {
+      for (uint32_t j = 0; j < 1000; j++) {
+        accumulator.recordResponse(j % 4 != 0);
+      }
+    }));
+  }
+  for (Thread::ThreadPtr& thread : threads) {
+    thread->join();
+  }
+  accumulator.closeSubWindow(1);
+  EXPECT_EQ(75.0, accumulator.getSuccessRate(32000).value());
+  EXPECT_FALSE(accumulator.getSuccessRate(32001).valid());
+}
+
+TEST(SlidingWindowAccumulatorTest, Latency) {
+  EXPECT_EQ(0U, SlidingWindowAccumulator::latencyBucket(0));
+  EXPECT_EQ(1U, SlidingWindowAccumulator::latencyBucket(1));
+  EXPECT_EQ(2U, SlidingWindowAccumulator::latencyBucket(2));
+  EXPECT_EQ(2U, SlidingWindowAccumulator::latencyBucket(3));
+  EXPECT_EQ(11U, SlidingWindowAccumulator::latencyBucket(1024));
+  EXPECT_EQ(SlidingWindowAccumulator::LATENCY_BUCKETS - 1,
+            SlidingWindowAccumulator::latencyBucket(1ULL << 40));
+
+  SlidingWindowAccumulator accumulator;
+  for (uint32_t i = 0; i < 99; i++) {
+    accumulator.recordResponseTime(std::chrono::milliseconds(5));
+  }
+  accumulator.recordResponseTime(std::chrono::milliseconds(1000));
+  accumulator.closeSubWindow(1);
+
+  EXPECT_FALSE(accumulator.getLatencyPercentile(0.99, 101).valid());
+  // [4, 8) holds 99 of the 100 samples.
+  EXPECT_DOUBLE_EQ(6.0, accumulator.getLatencyPercentile(0.495, 100).value());
+  EXPECT_DOUBLE_EQ(8.0, accumulator.getLatencyPercentile(0.99, 100).value());
+  // [512, 1024) holds the last one.
+  EXPECT_DOUBLE_EQ(1024.0, accumulator.getLatencyPercentile(1, 100).value());
+}
+
 TEST(DetectorHostMonitorNullImplTest, All) {
   DetectorHostMonitorNullImpl null_sink;
 
@@ -0,0 +1,136 @@
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "common/upstream/peak_ewma_lb.h"
+#include "common/upstream/upstream_impl.h"
+
+#include "test/common/upstream/utility.h"
+#include "test/mocks/common.h"
+#include "test/mocks/runtime/mocks.h"
+#include "test/mocks/upstream/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::NiceMock;
+using testing::Return;
+
+namespace Envoy {
+namespace Upstream {
+
+class PeakEwmaLatencyMonitorTest : public testing::Test {
+public:
+  PeakEwmaLatencyMonitorTest() : monitor_(time_source_, std::chrono::milliseconds(1000)) {}
+
+  void advance(std::chrono::milliseconds ms) {
+    now_ += ms;
+    EXPECT_CALL(time_source_, currentTime()).WillRepeatedly(Return(now_));
+  }
+
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  MonotonicTime now_;
+  PeakEwmaLatencyMonitor monitor_;
+};
+
+TEST_F(PeakEwmaLatencyMonitorTest, NoSamples) {
+  advance(std::chrono::milliseconds(0));
+  EXPECT_EQ(0, monitor_.latencyEstimate());
+}
+
+TEST_F(PeakEwmaLatencyMonitorTest, PeakIsTakenImmediately) {
+  advance(std::chrono::milliseconds(0));
+  monitor_.putResponseTime(std::chrono::milliseconds(10));
+  EXPECT_DOUBLE_EQ(10, monitor_.latencyEstimate());
+
+  advance(std::chrono::milliseconds(1));
+  monitor_.putResponseTime(std::chrono::milliseconds(200));
+  EXPECT_DOUBLE_EQ(200, monitor_.latencyEstimate());
+}
+
+TEST_F(PeakEwmaLatencyMonitorTest, FasterResponsesAreBlended) {
+  advance(std::chrono::milliseconds(0));
+  monitor_.putResponseTime(std::chrono::milliseconds(100));
+
+  // One decay period later the old estimate is weighted by 1/e.
+  advance(std::chrono::milliseconds(1000));
+  monitor_.putResponseTime(std::chrono::milliseconds(10));
+  const double w = std::exp(-1.0);
+  EXPECT_NEAR(100 * w + 10 * (1 - w), monitor_.latencyEstimate(), 0.0001);
+}
+
+TEST_F(PeakEwmaLatencyMonitorTest, EstimateDecaysWhenIdle) {
+  advance(std::chrono::milliseconds(0));
+  monitor_.putResponseTime(std::chrono::milliseconds(100));
+
+  advance(std::chrono::milliseconds(1000));
+  EXPECT_NEAR(100 * std::exp(-1.0), monitor_.latencyEstimate(), 0.0001);
+
+  advance(std::chrono::milliseconds(60000));
+  EXPECT_NEAR(0, monitor_.latencyEstimate(), 0.0001);
+}
+
+class PeakEwmaLoadBalancerTest : public testing::Test {
+public:
+  PeakEwmaLoadBalancerTest()
+      : stats_(ClusterInfoImpl::generateStats(stats_store_)),
+        lb_(cluster_, nullptr, stats_, runtime_, random_) {
+    cluster_.info_->lb_type_ = LoadBalancerType::PeakEwma;
+  }
+
+  NiceMock<MockCluster> cluster_;
+  NiceMock<Runtime::MockLoader> runtime_;
+  NiceMock<Runtime::MockRandomGenerator> random_;
+  Stats::IsolatedStoreImpl stats_store_;
+  ClusterStats stats_;
+  PeakEwmaLoadBalancer lb_;
+};
+
+TEST_F(PeakEwmaLoadBalancerTest, NoHosts) { EXPECT_EQ(nullptr, lb_.chooseHost(nullptr)); }
+
+TEST_F(PeakEwmaLoadBalancerTest, PrefersLowerLatency) {
+  cluster_.healthy_hosts_ = {makeTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                             makeTestHost(cluster_.info_, "tcp://127.0.0.1:81")};
+  cluster_.hosts_ = cluster_.healthy_hosts_;
+
+  cluster_.hosts_[0]->latencyMonitor().putResponseTime(std::chrono::milliseconds(500));
+  cluster_.hosts_[1]->latencyMonitor().putResponseTime(std::chrono::milliseconds(5));
+
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1));
+  EXPECT_EQ(cluster_.hosts_[1], lb_.chooseHost(nullptr));
+  EXPECT_CALL(random_, random()).WillOnce(Return(1)).WillOnce(Return(0));
+  EXPECT_EQ(cluster_.hosts_[1], lb_.chooseHost(nullptr));
+}
+
+TEST_F(PeakEwmaLoadBalancerTest, OutstandingRequestsScaleLatency) {
+  cluster_.healthy_hosts_ = {makeTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                             makeTestHost(cluster_.info_, "tcp://127.0.0.1:81")};
+  cluster_.hosts_ = cluster_.healthy_hosts_;
+
+  cluster_.hosts_[0]->latencyMonitor().putResponseTime(std::chrono::milliseconds(20));
+  cluster_.hosts_[1]->latencyMonitor().putResponseTime(std::chrono::milliseconds(10));
+  cluster_.hosts_[1]->stats().rq_active_.set(5);
+
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1));
+  EXPECT_EQ(cluster_.hosts_[0], lb_.chooseHost(nullptr));
+}
+
+TEST_F(PeakEwmaLoadBalancerTest, PenaltyForHostsWithoutEstimate) {
+  cluster_.healthy_hosts_ = {makeTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                             makeTestHost(cluster_.info_, "tcp://127.0.0.1:81")};
+  cluster_.hosts_ = cluster_.healthy_hosts_;
+
+  // Host 0 has never responded but already has a request in flight.
+  cluster_.hosts_[0]->stats().rq_active_.set(1);
+  cluster_.hosts_[1]->latencyMonitor().putResponseTime(std::chrono::milliseconds(100));
+  cluster_.hosts_[1]->stats().rq_active_.set(2);
+
+  EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.peak_ewma.penalty_ms", 1000))
+      .WillOnce(Return(1000));
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1));
+  EXPECT_EQ(cluster_.hosts_[1], lb_.chooseHost(nullptr));
+}
+
+} // namespace Upstream
+} // namespace Envoy
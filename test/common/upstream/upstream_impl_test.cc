@@ -25,9 +25,11 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+using testing::AnyNumber;
 using testing::ContainerEq;
 using testing::Invoke;
 using testing::NiceMock;
+using testing::Return;
 using testing::_;
 
 namespace Envoy {
@@ -105,6 +107,7 @@ TEST_P(StrictDnsParamTest, ImmediateResolve) {
   auto dns_resolver = std::make_shared<NiceMock<Network::MockDnsResolver>>();
   NiceMock<Event::MockDispatcher> dispatcher;
   NiceMock<Runtime::MockLoader> runtime;
+  NiceMock<Runtime::MockRandomGenerator> random;
   ReadyWatcher initialized;
 
   const std::string json = R"EOF(
@@ -127,7 +130,7 @@ TEST_P(StrictDnsParamTest, ImmediateResolve) {
       }));
   NiceMock<MockClusterManager> cm;
   StrictDnsClusterImpl cluster(parseClusterFromJson(json), runtime, stats, ssl_context_manager,
-                               dns_resolver, cm, dispatcher, false);
+                               dns_resolver, cm, dispatcher, random, false);
   cluster.initialize([&]() -> void { initialized.ready(); });
   EXPECT_EQ(2UL, cluster.hosts().size());
   EXPECT_EQ(2UL, cluster.healthyHosts().size());
@@ -140,6 +143,7 @@ TEST(StrictDnsClusterImplTest, ZeroHostsHealthChecker) {
   auto dns_resolver = std::make_shared<Network::MockDnsResolver>();
   NiceMock<Event::MockDispatcher> dispatcher;
   NiceMock<Runtime::MockLoader> runtime;
+  NiceMock<Runtime::MockRandomGenerator> random;
   NiceMock<MockClusterManager> cm;
   ReadyWatcher initialized;
 
@@ -153,7 +157,7 @@ TEST(StrictDnsClusterImplTest, ZeroHostsHealthChecker) {
 
   ResolverData resolver(*dns_resolver, dispatcher);
   StrictDnsClusterImpl cluster(parseClusterFromV2Yaml(yaml), runtime, stats, ssl_context_manager,
-                               dns_resolver, cm, dispatcher, false);
+                               dns_resolver, cm, dispatcher, random, false);
   std::shared_ptr<MockHealthChecker> health_checker(new MockHealthChecker());
   EXPECT_CALL(*health_checker, start());
   EXPECT_CALL(*health_checker, addHostCheckCompleteCb(_));
@@ -174,6 +178,7 @@ TEST(StrictDnsClusterImplTest, Basic) {
   auto dns_resolver = std::make_shared<NiceMock<Network::MockDnsResolver>>();
   NiceMock<Event::MockDispatcher> dispatcher;
   NiceMock<Runtime::MockLoader> runtime;
+  NiceMock<Runtime::MockRandomGenerator> random;
 
   // gmock matches in LIFO order which is why these are swapped.
   ResolverData resolver2(*dns_resolver, dispatcher);
@@ -211,7 +216,9 @@ TEST(StrictDnsClusterImplTest, Basic) {
 
   NiceMock<MockClusterManager> cm;
   StrictDnsClusterImpl cluster(parseClusterFromJson(json), runtime, stats, ssl_context_manager,
-                               dns_resolver, cm, dispatcher, false);
+                               dns_resolver, cm, dispatcher, random, false);
+  // Refresh scheduling reads runtime after every resolution.
+  EXPECT_CALL(runtime.snapshot_, getInteger(_, _)).Times(AnyNumber());
   EXPECT_CALL(runtime.snapshot_, getInteger("circuit_breakers.name.default.max_connections", 43));
   EXPECT_EQ(43U, cluster.info()->resourceManager(ResourcePriority::Default).connections().max());
   EXPECT_CALL(runtime.snapshot_,
@@ -302,6 +309,69 @@ TEST(StrictDnsClusterImplTest, Basic) {
   EXPECT_CALL(resolver2.active_dns_query_, cancel());
 }
 
+// Record TTLs drive the refresh interval within runtime bounds, with jitter.
+TEST(StrictDnsClusterImplTest, TtlRefresh) {
+  Stats::IsolatedStoreImpl stats;
+  Ssl::MockContextManager ssl_context_manager;
+  auto dns_resolver = std::make_shared<NiceMock<Network::MockDnsResolver>>();
+  NiceMock<Event::MockDispatcher> dispatcher;
+  NiceMock<Runtime::MockLoader> runtime;
+  NiceMock<Runtime::MockRandomGenerator> random;
+  NiceMock<MockClusterManager> cm;
+
+  const std::string yaml = R"EOF(
+    name: name
+    connect_timeout: 0.25s
+    type: STRICT_DNS
+    lb_policy: ROUND_ROBIN
+    dns_refresh_rate: 60s
+    hosts: [{ socket_address: { address: foo.bar.com, port_value: 443 }}]
+  )EOF";
+
+  Event::MockTimer* timer = new Event::MockTimer(&dispatcher);
+  Network::DnsResolver::ResolveWithTtlCb dns_callback;
+  EXPECT_CALL(*dns_resolver, resolveWithTtl("foo.bar.com", _, _))
+      .Times(4)
+      .WillRepeatedly(
+          Invoke([&](const std::string&, Network::DnsLookupFamily,
+                     Network::DnsResolver::ResolveWithTtlCb cb) -> Network::ActiveDnsQuery* {
+            dns_callback = cb;
+            return nullptr;
+          }));
+  StrictDnsClusterImpl cluster(parseClusterFromV2Yaml(yaml), runtime, stats, ssl_context_manager,
+                               dns_resolver, cm, dispatcher, random, false);
+  cluster.initialize([] {});
+
+  // A TTL below the minimum is raised to it.
+  EXPECT_CALL(*timer, enableTimer(std::chrono::milliseconds(1000)));
+  dns_callback(TestUtility::makeDnsResponse({"127.0.0.1"}), std::chrono::seconds(0));
+  EXPECT_EQ(1000U, stats.gauge("cluster.name.dns.foo_bar_com.refresh_interval_ms").value());
+
+  // A TTL within the bounds is used, plus up to 10% jitter by default.
+  timer->callback_();
+  EXPECT_CALL(random, random()).WillOnce(Return(1500));
+  EXPECT_CALL(*timer, enableTimer(std::chrono::milliseconds(31500)));
+  dns_callback(TestUtility::makeDnsResponse({"127.0.0.1"}), std::chrono::seconds(30));
+
+  // A TTL above the maximum is capped at the configured refresh rate.
+  timer->callback_();
+  EXPECT_CALL(random, random()).WillOnce(Return(0));
+  EXPECT_CALL(*timer, enableTimer(std::chrono::milliseconds(60000)));
+  dns_callback(TestUtility::makeDnsResponse({"127.0.0.1"}), std::chrono::seconds(3600));
+
+  // Failures have no TTL and use the configured refresh rate. Jitter can be turned off.
+  ON_CALL(runtime.snapshot_, getInteger("upstream.dns_refresh_jitter_percent", _))
+      .WillByDefault(Return(0));
+  timer->callback_();
+  EXPECT_CALL(random, random()).Times(0);
+  EXPECT_CALL(*timer, enableTimer(std::chrono::milliseconds(60000)));
+  dns_callback({}, {});
+
+  EXPECT_EQ(4U, stats.counter("cluster.name.dns.foo_bar_com.resolve_total").value());
+  EXPECT_EQ(1U, stats.counter("cluster.name.dns.foo_bar_com.resolve_failure").value());
+  EXPECT_EQ(0U, cluster.hosts().size());
+}
+
 TEST(HostImplTest, HostCluster) {
   MockCluster cluster;
   HostSharedPtr host = makeTestHost(cluster.info_, "tcp://10.0.0.1:1234", 1);
@@ -548,6 +618,112 @@ TEST(StaticClusterImplTest, UrlConfig) {
   cluster.hosts()[0]->healthChecker().setUnhealthy();
 }
 
+TEST(StaticClusterImplTest, PeakEwmaLBType) {
+  Stats::IsolatedStoreImpl stats;
+  Ssl::MockContextManager ssl_context_manager;
+  NiceMock<Runtime::MockLoader> runtime;
+  const std::string json = R"EOF(
+  {
+    "name": "latency",
+    "connect_timeout_ms": 250,
+    "type": "static",
+    "lb_type": "least_request",
+    "hosts": [{"url": "tcp://10.0.0.1:11001"}]
+  }
+  )EOF";
+
+  EXPECT_CALL(runtime.snapshot_, getInteger("upstream.peak_ewma.latency", 0)).WillOnce(Return(1));
+  NiceMock<MockClusterManager> cm;
+  StaticClusterImpl cluster(parseClusterFromJson(json), runtime, stats, ssl_context_manager, cm,
+                            false);
+  EXPECT_EQ(LoadBalancerType::PeakEwma, cluster.info()->lbType());
+  cluster.hosts()[0]->latencyMonitor().putResponseTime(std::chrono::milliseconds(10));
+  EXPECT_LT(0, cluster.hosts()[0]->latencyMonitor().latencyEstimate());
+}
+
+TEST(StaticClusterImplTest, NoLatencyMonitorWithoutPeakEwma) {
+  Stats::IsolatedStoreImpl stats;
+  Ssl::MockContextManager ssl_context_manager;
+  NiceMock<Runtime::MockLoader> runtime;
+  const std::string json = R"EOF(
+  {
+    "name": "latency",
+    "connect_timeout_ms": 250,
+    "type": "static",
+    "lb_type": "least_request",
+    "hosts": [{"url": "tcp://10.0.0.1:11001"}]
+  }
+  )EOF";
+
+  NiceMock<MockClusterManager> cm;
+  StaticClusterImpl cluster(parseClusterFromJson(json), runtime, stats, ssl_context_manager, cm,
+                            false);
+  EXPECT_EQ(LoadBalancerType::LeastRequest, cluster.info()->lbType());
+  cluster.hosts()[0]->latencyMonitor().putResponseTime(std::chrono::milliseconds(10));
+  EXPECT_EQ(0, cluster.hosts()[0]->latencyMonitor().latencyEstimate());
+}
+
+TEST(StaticClusterImplTest, ConnectionLifetime) {
+  Stats::IsolatedStoreImpl stats;
+  Ssl::MockContextManager ssl_context_manager;
+  NiceMock<Runtime::MockLoader> runtime;
+  const std::string json = R"EOF(
+  {
+    "name": "lifetime",
+    "connect_timeout_ms": 250,
+    "type": "static",
+    "lb_type": "random",
+    "hosts": [{"url": "tcp://10.0.0.1:11001"}]
+  }
+  )EOF";
+
+  ON_CALL(runtime.snapshot_, getInteger("upstream.idle_timeout_ms.lifetime", 0))
+      .WillByDefault(Return(30000));
+  ON_CALL(runtime.snapshot_, getInteger("upstream.max_connection_duration_ms.lifetime", 0))
+      .WillByDefault(Return(600000));
+  NiceMock<MockClusterManager> cm;
+  StaticClusterImpl cluster(parseClusterFromJson(json), runtime, stats, ssl_context_manager, cm,
+                            false);
+  EXPECT_EQ(std::chrono::milliseconds(30000), cluster.info()->idleTimeout());
+  EXPECT_EQ(std::chrono::milliseconds(600000), cluster.info()->maxConnectionDuration());
+}
+
+TEST(StaticClusterImplTest, CompactStats) {
+  Stats::IsolatedStoreImpl stats;
+  Ssl::MockContextManager ssl_context_manager;
+  NiceMock<Runtime::MockLoader> runtime;
+  const std::string json = R"EOF(
+  {
+    "name": "compact",
+    "connect_timeout_ms": 250,
+    "type": "static",
+    "lb_type": "random",
+    "hosts": [{"url": "tcp://10.0.0.1:11001"}]
+  }
+  )EOF";
+
+  ON_CALL(runtime.snapshot_, featureEnabled("upstream.compact_cluster_stats", 0))
+      .WillByDefault(Return(true));
+  NiceMock<MockClusterManager> cm;
+  const size_t counters_before = stats.counters().size();
+  {
+    StaticClusterImpl cluster(parseClusterFromJson(json), runtime, stats, ssl_context_manager, cm,
+                              false);
+    cluster.initialize([] {});
+    Stats::Gauge& pending = stats.gauge("cluster_manager.compact_cluster_stats_pending");
+    const uint64_t pending_before = pending.value();
+    EXPECT_LT(0UL, pending_before);
+    EXPECT_EQ(pending_before, cluster.info()->pendingStats());
+
+    cluster.info()->stats().upstream_cx_total_.inc();
+    EXPECT_EQ(1UL, stats.counter("cluster.compact.upstream_cx_total").value());
+    EXPECT_EQ(pending_before - 1, pending.value());
+    EXPECT_EQ(pending_before - 1, cluster.info()->pendingStats());
+    EXPECT_GT(counters_before + 10, stats.counters().size());
+  }
+  EXPECT_EQ(0UL, stats.gauge("cluster_manager.compact_cluster_stats_pending").value());
+}
+
 TEST(StaticClusterImplTest, UnsupportedLBType) {
   Stats::IsolatedStoreImpl stats;
   Ssl::MockContextManager ssl_context_manager;
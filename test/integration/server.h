@@ -35,6 +35,8 @@ public:
   // Server::Options
   uint64_t baseId() override { return 0; }
   uint32_t concurrency() override { return 1; }
+  uint32_t healthCheckConcurrency() override { return 0; }
+  bool configWorker() override { return false; }
   const std::string& configPath() override { return config_path_; }
   const std::string& adminAddressPath() override { return admin_address_path_; }
   Network::Address::IpVersion localAddressIpVersion() override { return local_address_ip_version_; }
@@ -52,10 +54,14 @@ public:
   const std::string& serviceZone() override { return service_zone_; }
   uint64_t maxStats() override { return 16384; }
   uint64_t maxObjNameLength() override { return 60; }
+  uint64_t statsNameTableBytes() override { return 16384 * 64; }
+  const std::vector<std::string>& statsInclusions() override { return stats_matchers_; }
+  const std::vector<std::string>& statsExclusions() override { return stats_matchers_; }
 
 private:
   const std::string config_path_;
   const std::string admin_address_path_;
+  const std::vector<std::string> stats_matchers_;
   const Network::Address::IpVersion local_address_ip_version_;
   const std::string service_cluster_name_;
   const std::string service_node_name_;
@@ -161,12 +167,18 @@ public:
     std::unique_lock<std::mutex> lock(lock_);
     return store_.gauges();
   }
+  std::list<ParentHistogramSharedPtr> histograms() const override {
+    std::unique_lock<std::mutex> lock(lock_);
+    return store_.histograms();
+  }
 
   // Stats::StoreRoot
   void addSink(Sink&) override {}
   void setTagExtractors(const std::vector<TagExtractorPtr>&) override {}
+  void setStatsMatcher(const StatsMatcher&) override {}
   void initializeThreading(Event::Dispatcher&, ThreadLocal::Instance&) override {}
   void shutdownThreading() override {}
+  void mergeHistograms(PostMergeCb merge_complete_cb) override { merge_complete_cb(); }
 
 private:
   mutable std::mutex lock_;
@@ -18,5 +18,8 @@ GrpcMuxWatchPtr MockGrpcMux::subscribe(const std::string& type_url,
 MockGrpcMuxCallbacks::MockGrpcMuxCallbacks() {}
 MockGrpcMuxCallbacks::~MockGrpcMuxCallbacks() {}
 
+MockConfigWorker::MockConfigWorker() {}
+MockConfigWorker::~MockConfigWorker() {}
+
 } // namespace Config
 } // namespace Envoy
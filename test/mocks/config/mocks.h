@@ -1,5 +1,6 @@
 #pragma once
 
+#include "envoy/config/config_worker.h"
 #include "envoy/config/grpc_mux.h"
 #include "envoy/config/subscription.h"
 
@@ -59,5 +60,13 @@ public:
   MOCK_METHOD1(onConfigUpdateFailed, void(const EnvoyException* e));
 };
 
+class MockConfigWorker : public ConfigWorker {
+public:
+  MockConfigWorker();
+  virtual ~MockConfigWorker();
+
+  MOCK_METHOD2(post, void(std::function<void()> work, std::function<void()> commit));
+};
+
 } // namespace Config
 } // namespace Envoy
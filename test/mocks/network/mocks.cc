@@ -89,6 +89,16 @@ MockActiveDnsQuery::~MockActiveDnsQuery() {}
 
 MockDnsResolver::MockDnsResolver() {
   ON_CALL(*this, resolve(_, _, _)).WillByDefault(Return(&active_query_));
+  // By default TTL aware resolutions go through resolve() with no TTL so that tests only need to
+  // set expectations on resolve().
+  ON_CALL(*this, resolveWithTtl(_, _, _))
+      .WillByDefault(Invoke([this](const std::string& dns_name, DnsLookupFamily dns_lookup_family,
+                                   ResolveWithTtlCb callback) -> ActiveDnsQuery* {
+        return resolve(dns_name, dns_lookup_family,
+                       [callback](std::list<Address::InstanceConstSharedPtr>&& address_list) {
+                         callback(std::move(address_list), {});
+                       });
+      }));
 }
 
 MockDnsResolver::~MockDnsResolver() {}
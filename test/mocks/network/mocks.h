@@ -131,6 +131,9 @@ public:
   // Network::DnsResolver
   MOCK_METHOD3(resolve, ActiveDnsQuery*(const std::string& dns_name,
                                         DnsLookupFamily dns_lookup_family, ResolveCb callback));
+  MOCK_METHOD3(resolveWithTtl,
+               ActiveDnsQuery*(const std::string& dns_name, DnsLookupFamily dns_lookup_family,
+                               ResolveWithTtlCb callback));
 
   testing::NiceMock<MockActiveDnsQuery> active_query_;
 };
@@ -27,6 +27,9 @@ MockOptions::MockOptions(const std::string& config_path)
   ON_CALL(*this, logPath()).WillByDefault(ReturnRef(log_path_));
   ON_CALL(*this, maxStats()).WillByDefault(Return(1000));
   ON_CALL(*this, maxObjNameLength()).WillByDefault(Return(150));
+  ON_CALL(*this, statsNameTableBytes()).WillByDefault(Return(64000));
+  ON_CALL(*this, statsInclusions()).WillByDefault(ReturnRef(stats_inclusions_));
+  ON_CALL(*this, statsExclusions()).WillByDefault(ReturnRef(stats_exclusions_));
 }
 MockOptions::~MockOptions() {}
 
@@ -45,6 +45,8 @@ public:
 
   MOCK_METHOD0(baseId, uint64_t());
   MOCK_METHOD0(concurrency, uint32_t());
+  MOCK_METHOD0(healthCheckConcurrency, uint32_t());
+  MOCK_METHOD0(configWorker, bool());
   MOCK_METHOD0(configPath, const std::string&());
   MOCK_METHOD0(adminAddressPath, const std::string&());
   MOCK_METHOD0(localAddressIpVersion, Network::Address::IpVersion());
@@ -60,6 +62,9 @@ public:
   MOCK_METHOD0(serviceZone, const std::string&());
   MOCK_METHOD0(maxStats, uint64_t());
   MOCK_METHOD0(maxObjNameLength, uint64_t());
+  MOCK_METHOD0(statsNameTableBytes, uint64_t());
+  MOCK_METHOD0(statsInclusions, const std::vector<std::string>&());
+  MOCK_METHOD0(statsExclusions, const std::vector<std::string>&());
 
   std::string config_path_;
   std::string admin_address_path_;
@@ -67,6 +72,8 @@ public:
   std::string service_node_name_;
   std::string service_zone_name_;
   std::string log_path_;
+  std::vector<std::string> stats_inclusions_;
+  std::vector<std::string> stats_exclusions_;
 };
 
 class MockAdmin : public Admin {
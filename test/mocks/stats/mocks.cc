@@ -5,16 +5,17 @@
 
 using testing::Invoke;
 using testing::NiceMock;
+using testing::ReturnPointee;
 using testing::ReturnRef;
 using testing::_;
 
 namespace Envoy {
 namespace Stats {
 
-MockCounter::MockCounter() { ON_CALL(*this, name()).WillByDefault(ReturnRef(name_)); }
+MockCounter::MockCounter() { ON_CALL(*this, name()).WillByDefault(ReturnPointee(&name_)); }
 MockCounter::~MockCounter() {}
 
-MockGauge::MockGauge() { ON_CALL(*this, name()).WillByDefault(ReturnRef(name_)); }
+MockGauge::MockGauge() { ON_CALL(*this, name()).WillByDefault(ReturnPointee(&name_)); }
 MockGauge::~MockGauge() {}
 
 MockHistogram::MockHistogram() {
@@ -26,6 +27,13 @@ MockHistogram::MockHistogram() {
 }
 MockHistogram::~MockHistogram() {}
 
+MockParentHistogram::MockParentHistogram() {
+  ON_CALL(*this, used()).WillByDefault(ReturnPointee(&used_));
+  ON_CALL(*this, intervalStatistics()).WillByDefault(ReturnRef(interval_statistics_));
+  ON_CALL(*this, cumulativeStatistics()).WillByDefault(ReturnRef(cumulative_statistics_));
+}
+MockParentHistogram::~MockParentHistogram() {}
+
 MockSink::MockSink() {}
 MockSink::~MockSink() {}
 
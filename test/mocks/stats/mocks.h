@@ -10,6 +10,7 @@
 #include "envoy/thread_local/thread_local.h"
 #include "envoy/upstream/cluster_manager.h"
 
+#include "common/stats/histogram_impl.h"
 #include "common/stats/stats_impl.h"
 
 #include "gmock/gmock.h"
@@ -25,9 +26,9 @@ public:
   MOCK_METHOD1(add, void(uint64_t amount));
   MOCK_METHOD0(inc, void());
   MOCK_METHOD0(latch, uint64_t());
-  MOCK_CONST_METHOD0(name, const std::string&());
-  MOCK_CONST_METHOD0(tagExtractedName, const std::string&());
-  MOCK_CONST_METHOD0(tags, const std::vector<Tag>&());
+  MOCK_CONST_METHOD0(name, std::string());
+  MOCK_CONST_METHOD0(tagExtractedName, std::string());
+  MOCK_CONST_METHOD0(tags, std::vector<Tag>());
   MOCK_METHOD0(reset, void());
   MOCK_CONST_METHOD0(used, bool());
   MOCK_CONST_METHOD0(value, uint64_t());
@@ -43,9 +44,9 @@ public:
   MOCK_METHOD1(add, void(uint64_t amount));
   MOCK_METHOD0(dec, void());
   MOCK_METHOD0(inc, void());
-  MOCK_CONST_METHOD0(name, const std::string&());
-  MOCK_CONST_METHOD0(tagExtractedName, const std::string&());
-  MOCK_CONST_METHOD0(tags, const std::vector<Tag>&());
+  MOCK_CONST_METHOD0(name, std::string());
+  MOCK_CONST_METHOD0(tagExtractedName, std::string());
+  MOCK_CONST_METHOD0(tags, std::vector<Tag>());
   MOCK_METHOD1(set, void(uint64_t value));
   MOCK_METHOD1(sub, void(uint64_t amount));
   MOCK_CONST_METHOD0(used, bool());
@@ -61,16 +62,37 @@ public:
 
   // Note: cannot be mocked because it is accessed as a Property in a gmock EXPECT_CALL. This
   // creates a deadlock in gmock and is an unintended use of mock functions.
-  const std::string& name() const override { return name_; };
+  std::string name() const override { return name_; };
 
-  MOCK_CONST_METHOD0(tagExtractedName, const std::string&());
-  MOCK_CONST_METHOD0(tags, const std::vector<Tag>&());
+  MOCK_CONST_METHOD0(tagExtractedName, std::string());
+  MOCK_CONST_METHOD0(tags, std::vector<Tag>());
   MOCK_METHOD1(recordValue, void(uint64_t value));
 
   std::string name_;
   Store* store_;
 };
 
+class MockParentHistogram : public ParentHistogram {
+public:
+  MockParentHistogram();
+  ~MockParentHistogram();
+
+  // See MockHistogram.
+  std::string name() const override { return name_; };
+
+  MOCK_CONST_METHOD0(tagExtractedName, std::string());
+  MOCK_CONST_METHOD0(tags, std::vector<Tag>());
+  MOCK_METHOD1(recordValue, void(uint64_t value));
+  MOCK_CONST_METHOD0(used, bool());
+  MOCK_CONST_METHOD0(intervalStatistics, const HistogramStatistics&());
+  MOCK_CONST_METHOD0(cumulativeStatistics, const HistogramStatistics&());
+
+  std::string name_;
+  bool used_{};
+  HistogramStatisticsImpl interval_statistics_;
+  HistogramStatisticsImpl cumulative_statistics_;
+};
+
 class MockSink : public Sink {
 public:
   MockSink();
@@ -79,6 +101,7 @@ public:
   MOCK_METHOD0(beginFlush, void());
   MOCK_METHOD2(flushCounter, void(const Counter& counter, uint64_t delta));
   MOCK_METHOD2(flushGauge, void(const Gauge& gauge, uint64_t value));
+  MOCK_METHOD1(flushHistogram, void(const ParentHistogram& histogram));
   MOCK_METHOD0(endFlush, void());
   MOCK_METHOD2(onHistogramComplete, void(const Histogram& histogram, uint64_t value));
 };
@@ -97,6 +120,7 @@ public:
   MOCK_METHOD1(gauge, Gauge&(const std::string&));
   MOCK_CONST_METHOD0(gauges, std::list<GaugeSharedPtr>());
   MOCK_METHOD1(histogram, Histogram&(const std::string& name));
+  MOCK_CONST_METHOD0(histograms, std::list<ParentHistogramSharedPtr>());
 
   testing::NiceMock<MockCounter> counter_;
   std::vector<std::unique_ptr<MockHistogram>> histograms_;
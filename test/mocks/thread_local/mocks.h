@@ -52,6 +52,10 @@ public:
     // ThreadLocal::Slot
     ThreadLocalObjectSharedPtr get() override { return parent_.data_[index_]; }
     void runOnAllThreads(Event::PostCb cb) override { parent_.runOnAllThreads(cb); }
+    void runOnAllThreads(Event::PostCb cb, Event::PostCb all_threads_complete_cb) override {
+      parent_.runOnAllThreads(cb);
+      all_threads_complete_cb();
+    }
     void set(InitializeCb cb) override { parent_.data_[index_] = cb(parent_.dispatcher_); }
 
     MockInstance& parent_;
@@ -29,8 +29,15 @@ MockClusterInfo::MockClusterInfo()
   ON_CALL(*this, connectTimeout()).WillByDefault(Return(std::chrono::milliseconds(1)));
   ON_CALL(*this, name()).WillByDefault(ReturnRef(name_));
   ON_CALL(*this, http2Settings()).WillByDefault(ReturnRef(http2_settings_));
+  ON_CALL(*this, perConnectionBufferLimitBytes())
+      .WillByDefault(ReturnPointee(&per_connection_buffer_limit_bytes_));
   ON_CALL(*this, maxRequestsPerConnection())
       .WillByDefault(ReturnPointee(&max_requests_per_connection_));
+  ON_CALL(*this, idleTimeout()).WillByDefault(ReturnPointee(&idle_timeout_));
+  ON_CALL(*this, maxConnectionDuration()).WillByDefault(ReturnPointee(&max_connection_duration_));
+  ON_CALL(*this, prefetchMinIdleConnections())
+      .WillByDefault(ReturnPointee(&prefetch_min_idle_connections_));
+  ON_CALL(*this, prefetchRatioPercent()).WillByDefault(ReturnPointee(&prefetch_ratio_percent_));
   ON_CALL(*this, stats()).WillByDefault(ReturnRef(stats_));
   ON_CALL(*this, statsScope()).WillByDefault(ReturnRef(stats_store_));
   ON_CALL(*this, loadReportStats()).WillByDefault(ReturnRef(load_report_stats_));
@@ -48,18 +48,28 @@ public:
   MOCK_CONST_METHOD0(lbType, LoadBalancerType());
   MOCK_CONST_METHOD0(maintenanceMode, bool());
   MOCK_CONST_METHOD0(maxRequestsPerConnection, uint64_t());
+  MOCK_CONST_METHOD0(idleTimeout, std::chrono::milliseconds());
+  MOCK_CONST_METHOD0(maxConnectionDuration, std::chrono::milliseconds());
+  MOCK_CONST_METHOD0(prefetchMinIdleConnections, uint64_t());
+  MOCK_CONST_METHOD0(prefetchRatioPercent, uint64_t());
   MOCK_CONST_METHOD0(name, const std::string&());
   MOCK_CONST_METHOD1(resourceManager, ResourceManager&(ResourcePriority priority));
   MOCK_CONST_METHOD0(sslContext, Ssl::ClientContext*());
   MOCK_CONST_METHOD0(stats, ClusterStats&());
   MOCK_CONST_METHOD0(statsScope, Stats::Scope&());
+  MOCK_CONST_METHOD0(pendingStats, uint64_t());
   MOCK_CONST_METHOD0(loadReportStats, ClusterLoadReportStats&());
   MOCK_CONST_METHOD0(sourceAddress, const Network::Address::InstanceConstSharedPtr&());
   MOCK_CONST_METHOD0(lbSubsetInfo, const LoadBalancerSubsetInfo&());
 
   std::string name_{"fake_cluster"};
   Http::Http2Settings http2_settings_{};
+  uint32_t per_connection_buffer_limit_bytes_{};
   uint64_t max_requests_per_connection_{};
+  std::chrono::milliseconds idle_timeout_{};
+  std::chrono::milliseconds max_connection_duration_{};
+  uint64_t prefetch_min_idle_connections_{};
+  uint64_t prefetch_ratio_percent_{};
   NiceMock<Stats::MockIsolatedStatsStore> stats_store_;
   ClusterStats stats_;
   NiceMock<Stats::MockIsolatedStatsStore> load_report_stats_store_;
@@ -69,6 +69,15 @@ public:
   MOCK_METHOD0(setUnhealthy, void());
 };
 
+class MockLatencyHostMonitor : public LatencyHostMonitor {
+public:
+  MockLatencyHostMonitor();
+  ~MockLatencyHostMonitor();
+
+  MOCK_METHOD1(putResponseTime, void(std::chrono::milliseconds time));
+  MOCK_METHOD0(latencyEstimate, double());
+};
+
 class MockHostDescription : public HostDescription {
 public:
   MockHostDescription();
@@ -80,6 +89,7 @@ public:
   MOCK_CONST_METHOD0(cluster, const ClusterInfo&());
   MOCK_CONST_METHOD0(outlierDetector, Outlier::DetectorHostMonitor&());
   MOCK_CONST_METHOD0(healthChecker, HealthCheckHostMonitor&());
+  MOCK_CONST_METHOD0(latencyMonitor, LatencyHostMonitor&());
   MOCK_CONST_METHOD0(hostname, const std::string&());
   MOCK_CONST_METHOD0(stats, HostStats&());
   MOCK_CONST_METHOD0(locality, const envoy::api::v2::Locality&());
@@ -88,6 +98,7 @@ public:
   Network::Address::InstanceConstSharedPtr address_;
   testing::NiceMock<Outlier::MockDetectorHostMonitor> outlier_detector_;
   testing::NiceMock<MockHealthCheckHostMonitor> health_checker_;
+  testing::NiceMock<MockLatencyHostMonitor> latency_monitor_;
   testing::NiceMock<MockClusterInfo> cluster_;
   Stats::IsolatedStoreImpl stats_store_;
   HostStats stats_{ALL_HOST_STATS(POOL_COUNTER(stats_store_), POOL_GAUGE(stats_store_))};
@@ -129,18 +140,24 @@ public:
   MOCK_METHOD1(healthFlagSet, void(HealthFlag flag));
   MOCK_CONST_METHOD0(healthy, bool());
   MOCK_CONST_METHOD0(hostname, const std::string&());
+  MOCK_CONST_METHOD0(latencyMonitor, LatencyHostMonitor&());
   MOCK_CONST_METHOD0(outlierDetector, Outlier::DetectorHostMonitor&());
   MOCK_METHOD1(setHealthChecker_, void(HealthCheckHostMonitorPtr& health_checker));
   MOCK_METHOD1(setOutlierDetector_, void(Outlier::DetectorHostMonitorPtr& outlier_detector));
   MOCK_CONST_METHOD0(stats, HostStats&());
   MOCK_CONST_METHOD0(weight, uint32_t());
   MOCK_METHOD1(weight, void(uint32_t new_weight));
+  MOCK_CONST_METHOD0(priority, uint32_t());
+  MOCK_METHOD1(priority, void(uint32_t new_priority));
+  MOCK_CONST_METHOD0(localityWeight, uint32_t());
+  MOCK_METHOD1(localityWeight, void(uint32_t new_locality_weight));
   MOCK_CONST_METHOD0(used, bool());
   MOCK_METHOD1(used, void(bool new_used));
   MOCK_CONST_METHOD0(locality, const envoy::api::v2::Locality&());
 
   testing::NiceMock<MockClusterInfo> cluster_;
   testing::NiceMock<Outlier::MockDetectorHostMonitor> outlier_detector_;
+  testing::NiceMock<MockLatencyHostMonitor> latency_monitor_;
   Stats::IsolatedStoreImpl stats_store_;
   HostStats stats_{ALL_HOST_STATS(POOL_COUNTER(stats_store_), POOL_GAUGE(stats_store_))};
 };
@@ -55,7 +55,8 @@ TEST_F(HotRestartImplTest, versionString) {
   EXPECT_EQ(hot_restart_->version(),
             Envoy::Server::SharedMemory::version(options_.maxStats(),
                                                  options_.maxObjNameLength() +
-                                                     Stats::RawStatData::maxStatSuffixLength()));
+                                                     Stats::RawStatData::maxStatSuffixLength(),
+                                                 options_.statsNameTableBytes()));
 }
 
 TEST_F(HotRestartImplTest, crossAlloc) {
@@ -84,6 +85,40 @@ TEST_F(HotRestartImplTest, crossAlloc) {
   EXPECT_EQ(stat5, stat5_prime);
 }
 
+TEST_F(HotRestartImplTest, longNames) {
+  setup();
+
+  // Names are not limited by --max-obj-name-len.
+  const std::string long_name(Stats::RawStatData::maxNameLength() * 2, 'a');
+  Stats::RawStatData* stat1 = hot_restart_->alloc(long_name);
+  Stats::RawStatData* stat2 = hot_restart_->alloc(long_name + "b");
+  EXPECT_NE(nullptr, stat1);
+  EXPECT_NE(stat1, stat2);
+  EXPECT_EQ(stat1, hot_restart_->alloc(long_name));
+  EXPECT_EQ(2, stat1->ref_count_);
+  hot_restart_->free(*stat1);
+  hot_restart_->free(*stat1);
+  hot_restart_->free(*stat2);
+}
+
+TEST_F(HotRestartImplTest, allocFailNameTable) {
+  EXPECT_CALL(options_, maxStats()).WillRepeatedly(Return(2));
+  // Rounded down to a multiple of 4.
+  EXPECT_CALL(options_, statsNameTableBytes()).WillRepeatedly(Return(130));
+  setup();
+
+  // Only one of the names fits into 128 bytes.
+  Stats::RawStatData* s1 = hot_restart_->alloc(std::string(100, 'a'));
+  Stats::RawStatData* s2 = hot_restart_->alloc(std::string(100, 'b'));
+  EXPECT_NE(s1, nullptr);
+  EXPECT_EQ(s2, nullptr);
+
+  // The space is reused once the stat is freed.
+  hot_restart_->free(*s1);
+  s2 = hot_restart_->alloc(std::string(100, 'b'));
+  EXPECT_NE(s2, nullptr);
+}
+
 TEST_F(HotRestartImplTest, allocFail) {
   EXPECT_CALL(options_, maxStats()).WillRepeatedly(Return(2));
   setup();
@@ -142,13 +177,8 @@ TEST_P(HotRestartImplAlignmentTest, objectOverlap) {
                            .substr(0, Stats::RawStatData::maxNameLength());
     TestStat ts;
     ts.stat_ = hot_restart_->alloc(name);
-    ts.name_ = ts.stat_->name_;
+    ts.name_ = name;
     ts.index_ = i;
-
-    // If this isn't true then the hard coded part of the name isn't long enough to make the test
-    // valid.
-    EXPECT_EQ(ts.name_.size(), Stats::RawStatData::maxNameLength());
-
     stats.push_back(ts);
   }
 
@@ -161,7 +191,6 @@ TEST_P(HotRestartImplAlignmentTest, objectOverlap) {
   };
 
   auto verify = [](TestStat& ts) {
-    EXPECT_TRUE(ts.stat_->matches(ts.name_));
     EXPECT_EQ(ts.stat_->value_, ts.index_);
     EXPECT_EQ(ts.stat_->pending_increment_, ts.index_);
     EXPECT_EQ(ts.stat_->flags_, ts.index_);
@@ -184,6 +213,50 @@ TEST_P(HotRestartImplAlignmentTest, objectOverlap) {
   for (auto it = stats.rbegin(); it != stats.rend(); ++it) {
     verify(*it);
   }
+
+  // The names must not have been overwritten either.
+  for (TestStat& ts : stats) {
+    EXPECT_EQ(ts.stat_, hot_restart_->alloc(ts.name_));
+  }
+}
+
+TEST(StatNameTableTest, AddRemove) {
+  std::vector<uint8_t> memory(64);
+  uint64_t used = 0;
+  StatNameTable table(memory.data(), memory.size(), used);
+
+  EXPECT_EQ(0, table.add("abc"));
+  EXPECT_EQ(8, table.add("defgh"));
+  EXPECT_EQ(20, table.add("x"));
+  EXPECT_EQ(28, used);
+  EXPECT_TRUE(table.equals(8, "defgh"));
+  EXPECT_FALSE(table.equals(8, "defg"));
+  EXPECT_FALSE(table.equals(8, "defgi"));
+  EXPECT_EQ("abc", table.get(0));
+
+  // Adjacent free records are merged to fit a longer name.
+  table.remove(0);
+  table.remove(8);
+  EXPECT_EQ(0, table.add("0123456789a"));
+  EXPECT_EQ("0123456789a", table.get(0));
+  EXPECT_EQ("x", table.get(20));
+
+  // Free records at the end of the table are handed back.
+  table.remove(20);
+  EXPECT_EQ(20, used);
+  EXPECT_EQ(20, table.add("x"));
+
+  // A large free record is split.
+  table.remove(0);
+  EXPECT_EQ(0, table.add("ab"));
+  EXPECT_EQ(8, table.add("cd"));
+  EXPECT_EQ(28, used);
+
+  // Fill the table.
+  EXPECT_EQ(28, table.add(std::string(32, 'z')));
+  EXPECT_EQ(64, used);
+  EXPECT_TRUE(StatNameTable::NO_SPACE == table.add("a"));
+  EXPECT_TRUE(StatNameTable::NO_SPACE == table.add(std::string(UINT16_MAX + 1, 'a')));
 }
 
 INSTANTIATE_TEST_CASE_P(HotRestartImplAlignmentTest, HotRestartImplAlignmentTest,
@@ -1,11 +1,15 @@
+#include <cstring>
 #include <fstream>
 
 #include "common/http/message_impl.h"
 #include "common/profiler/profiler.h"
+#include "common/stats/histogram_impl.h"
+#include "common/stats/stats_impl.h"
 
 #include "server/http/admin.h"
 
 #include "test/mocks/server/mocks.h"
+#include "test/mocks/stats/mocks.h"
 #include "test/test_common/environment.h"
 #include "test/test_common/network_utility.h"
 #include "test/test_common/printers.h"
@@ -14,7 +18,11 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+using testing::HasSubstr;
+using testing::InSequence;
+using testing::Invoke;
 using testing::NiceMock;
+using testing::Return;
 using testing::_;
 
 namespace Envoy {
@@ -61,6 +69,27 @@ TEST_P(AdminFilterTest, Trailers) {
   filter_.decodeTrailers(request_headers_);
 }
 
+TEST_P(AdminFilterTest, PrometheusStatsStreamed) {
+  Http::TestHeaderMapImpl request_headers{{":path", "/stats?format=prometheus"}};
+  Event::MockTimer* chunk_timer = new Event::MockTimer(&callbacks_.dispatcher_);
+  {
+    InSequence s;
+    EXPECT_CALL(callbacks_, encodeHeaders_(_, false))
+        .WillOnce(Invoke([](Http::HeaderMap& headers, bool) -> void {
+          EXPECT_STREQ("200", headers.Status()->value().c_str());
+          EXPECT_STREQ("text/plain; version=0.0.4", headers.ContentType()->value().c_str());
+        }));
+    EXPECT_CALL(callbacks_, addDownstreamWatermarkCallbacks(_));
+    EXPECT_CALL(callbacks_, removeDownstreamWatermarkCallbacks(_));
+    EXPECT_CALL(callbacks_, encodeData(_, true));
+  }
+  filter_.decodeHeaders(request_headers, true);
+  EXPECT_TRUE(callbacks_.callbacks_.empty());
+
+  EXPECT_CALL(*chunk_timer, disableTimer());
+  filter_.onDestroy();
+}
+
 class AdminInstanceTest : public testing::TestWithParam<Network::Address::IpVersion> {
 public:
   AdminInstanceTest()
@@ -146,5 +175,467 @@ TEST_P(AdminInstanceTest, CustomHandler) {
   EXPECT_EQ(Http::Code::Accepted, admin_.runCallback("/foo/bar", response));
 }
 
+TEST_P(AdminInstanceTest, Memory) {
+  NiceMock<Upstream::MockCluster> cluster1;
+  NiceMock<Upstream::MockCluster> cluster2;
+  ON_CALL(*cluster1.info_, pendingStats()).WillByDefault(Return(2));
+  Upstream::ClusterManager::ClusterInfoMap clusters{{"cluster1", cluster1},
+                                                    {"cluster2", cluster2}};
+  ON_CALL(server_.cluster_manager_, clusters()).WillByDefault(Return(clusters));
+
+  Buffer::OwnedImpl response;
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/memory", response));
+  const std::string output = TestUtility::bufferToString(response);
+  EXPECT_NE(std::string::npos, output.find("allocated: "));
+  EXPECT_NE(std::string::npos, output.find("compact_cluster_stats_pending: 2\n"));
+}
+
+TEST_P(AdminInstanceTest, PrometheusStats) {
+  server_.stats().counter("cluster.foo.upstream_rq").inc();
+  server_.stats().gauge("server.live").set(1);
+
+  Buffer::OwnedImpl response;
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/stats?format=prometheus", response));
+  const std::string output = TestUtility::bufferToString(response);
+  EXPECT_THAT(output, HasSubstr("# TYPE envoy_cluster_foo_upstream_rq counter\n"
+                                "envoy_cluster_foo_upstream_rq 1\n"));
+  EXPECT_THAT(output, HasSubstr("# TYPE envoy_server_live gauge\nenvoy_server_live 1\n"));
+
+  Buffer::OwnedImpl usage;
+  EXPECT_EQ(Http::Code::NotFound, admin_.runCallback("/stats?format=xml", usage));
+  EXPECT_THAT(TestUtility::bufferToString(usage), HasSubstr("format=(json|prometheus)"));
+}
+
+TEST_P(AdminInstanceTest, BinaryStats) {
+  server_.stats().counter("cluster.foo.upstream_rq").inc();
+
+  Buffer::OwnedImpl response;
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/stats?format=binary", response));
+  EXPECT_EQ(std::string("ESS1\x01\x00", 6), TestUtility::bufferToString(response).substr(0, 6));
+  Buffer::OwnedImpl delta;
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/stats?format=binary&cursor=1", delta));
+  EXPECT_EQ(std::string("ESS1\x02\x01", 6), TestUtility::bufferToString(delta).substr(0, 6));
+
+  Buffer::OwnedImpl usage;
+  EXPECT_EQ(Http::Code::NotFound, admin_.runCallback("/stats?format=binary&cursor=x", usage));
+  EXPECT_THAT(TestUtility::bufferToString(usage), HasSubstr("format=binary[&cursor=<cursor>]"));
+}
+
+class PrometheusStatsFormatterTest : public testing::Test {
+public:
+  PrometheusStatsFormatterTest() {
+    addCounter("cluster.foo.upstream_rq_total", {{"envoy.cluster_name", "foo"}}, 5);
+    addCounter("cluster.bar.upstream_rq_total", {{"envoy.cluster_name", "bar"}}, 7);
+
+    auto gauge = std::make_shared<NiceMock<Stats::MockGauge>>();
+    gauge->name_ = "server.live";
+    ON_CALL(*gauge, tagExtractedName()).WillByDefault(Return("server.live"));
+    ON_CALL(*gauge, value()).WillByDefault(Return(1));
+    gauges_.push_back(gauge);
+
+    auto histogram = std::make_shared<NiceMock<Stats::MockParentHistogram>>();
+    histogram->name_ = "cluster.foo.upstream_rq_time";
+    ON_CALL(*histogram, tagExtractedName()).WillByDefault(Return("cluster.upstream_rq_time"));
+    ON_CALL(*histogram, tags())
+        .WillByDefault(Return(std::vector<Stats::Tag>{{"envoy.cluster_name", "foo"}}));
+    Stats::LogLinearHistogram values;
+    values.recordValue(5);
+    values.recordValue(50);
+    histogram->cumulative_statistics_.refresh(values);
+    histograms_.push_back(histogram);
+  }
+
+  void addCounter(const std::string& name, std::vector<Stats::Tag> tags, uint64_t value) {
+    auto counter = std::make_shared<NiceMock<Stats::MockCounter>>();
+    counter->name_ = name;
+    ON_CALL(*counter, tagExtractedName()).WillByDefault(Return("cluster.upstream_rq_total"));
+    ON_CALL(*counter, tags()).WillByDefault(Return(tags));
+    ON_CALL(*counter, value()).WillByDefault(Return(value));
+    counters_.push_back(counter);
+  }
+
+  std::list<Stats::CounterSharedPtr> counters_;
+  std::list<Stats::GaugeSharedPtr> gauges_;
+  std::list<Stats::ParentHistogramSharedPtr> histograms_;
+};
+
+TEST_F(PrometheusStatsFormatterTest, Names) {
+  EXPECT_EQ("envoy_cluster_upstream_rq_total",
+            PrometheusStatsFormatter::metricName("cluster.upstream_rq_total"));
+  EXPECT_EQ("envoy_listener_admin_downstream_cx_total",
+            PrometheusStatsFormatter::metricName("listener.admin.downstream_cx_total"));
+  EXPECT_EQ("envoy_a_b:c_d", PrometheusStatsFormatter::metricName("a-b:c/d"));
+
+  EXPECT_EQ("", PrometheusStatsFormatter::formattedTags({}));
+  EXPECT_EQ("envoy_cluster_name=\"foo\",envoy_response_code=\"200\"",
+            PrometheusStatsFormatter::formattedTags(
+                {{"envoy.cluster_name", "foo"}, {"envoy.response_code", "200"}}));
+  EXPECT_EQ("name=\"a\\\\b\\\"c\\nd\"",
+            PrometheusStatsFormatter::formattedTags({{"name", "a\\b\"c\nd"}}));
+}
+
+TEST_F(PrometheusStatsFormatterTest, Output) {
+  PrometheusStatsFormatter formatter(counters_, gauges_, histograms_);
+  Buffer::OwnedImpl response;
+  EXPECT_FALSE(formatter.nextChunk(response));
+  const std::string output = TestUtility::bufferToString(response);
+
+  EXPECT_THAT(output, HasSubstr("# TYPE envoy_cluster_upstream_rq_total counter\n"
+                                "envoy_cluster_upstream_rq_total{envoy_cluster_name=\"foo\"} 5\n"
+                                "envoy_cluster_upstream_rq_total{envoy_cluster_name=\"bar\"} 7\n"));
+  EXPECT_THAT(output, HasSubstr("# TYPE envoy_server_live gauge\nenvoy_server_live 1\n"));
+  EXPECT_THAT(output, HasSubstr("# TYPE envoy_cluster_upstream_rq_time histogram\n"));
+  EXPECT_THAT(output, HasSubstr("envoy_cluster_upstream_rq_time_bucket{envoy_cluster_name=\"foo\","
+                                "le=\"0.5\"} 0\n"));
+  EXPECT_THAT(output, HasSubstr("envoy_cluster_upstream_rq_time_bucket{envoy_cluster_name=\"foo\","
+                                "le=\"5\"} 1\n"));
+  EXPECT_THAT(output, HasSubstr("envoy_cluster_upstream_rq_time_bucket{envoy_cluster_name=\"foo\","
+                                "le=\"3600000\"} 2\n"
+                                "envoy_cluster_upstream_rq_time_bucket{envoy_cluster_name=\"foo\","
+                                "le=\"+Inf\"} 2\n"
+                                "envoy_cluster_upstream_rq_time_sum{envoy_cluster_name=\"foo\"} "
+                                "55\n"
+                                "envoy_cluster_upstream_rq_time_count{envoy_cluster_name=\"foo\"} "
+                                "2\n"));
+}
+
+TEST_F(PrometheusStatsFormatterTest, Chunks) {
+  Buffer::OwnedImpl all;
+  PrometheusStatsFormatter(counters_, gauges_, histograms_).nextChunk(all);
+
+  // With a one byte chunk size every series is a chunk of its own.
+  PrometheusStatsFormatter formatter(counters_, gauges_, histograms_, 1);
+  std::string chunks;
+  uint32_t num_chunks = 0;
+  bool more;
+  do {
+    Buffer::OwnedImpl chunk;
+    more = formatter.nextChunk(chunk);
+    EXPECT_NE(0, chunk.length());
+    chunks += TestUtility::bufferToString(chunk);
+    num_chunks++;
+  } while (more);
+  EXPECT_EQ(4, num_chunks);
+  EXPECT_EQ(TestUtility::bufferToString(all), chunks);
+}
+
+/**
+ * Decodes binary stats snapshots and applies them to its view of the stats, as a scraping agent
+ * would.
+ */
+class BinaryStatsClient {
+public:
+  struct Stat {
+    uint64_t type_;
+    std::string name_;
+    std::string extracted_name_;
+    std::vector<Stats::Tag> tags_;
+    std::vector<double> bounds_;
+    std::vector<uint64_t> values_;
+  };
+
+  void apply(const std::string& snapshot) {
+    data_ = snapshot;
+    position_ = 4;
+    ASSERT_EQ("ESS1", snapshot.substr(0, 4));
+    cursor_ = varint();
+    base_ = varint();
+    if (base_ == 0) {
+      strings_.clear();
+      stats_.clear();
+    }
+
+    const uint64_t first_string = varint();
+    num_strings_ = varint();
+    EXPECT_EQ(strings_.size(), first_string);
+    for (uint64_t i = 0; i < num_strings_; i++) {
+      strings_.push_back(string());
+    }
+
+    num_stats_ = varint();
+    uint64_t id = 0;
+    for (uint64_t i = 0; i < num_stats_; i++) {
+      id += varint();
+      Stat& stat = stats_[id];
+      stat.type_ = varint();
+      stat.name_ = string();
+      stat.extracted_name_ = strings_.at(varint());
+      stat.tags_.clear();
+      for (uint64_t num_tags = varint(); num_tags > 0; num_tags--) {
+        const std::string& name = strings_.at(varint());
+        stat.tags_.push_back({name, strings_.at(varint())});
+      }
+      stat.bounds_.clear();
+      if (stat.type_ == 2) {
+        for (uint64_t num_bounds = varint(); num_bounds > 0; num_bounds--) {
+          uint64_t bits = 0;
+          for (uint32_t byte = 0; byte < 8; byte++) {
+            bits |= static_cast<uint64_t>(static_cast<uint8_t>(data_.at(position_++)))
+                    << (8 * byte);
+          }
+          double bound;
+          memcpy(&bound, &bits, sizeof(bound));
+          stat.bounds_.push_back(bound);
+        }
+      }
+    }
+
+    num_values_ = varint();
+    id = 0;
+    for (uint64_t i = 0; i < num_values_; i++) {
+      id += varint();
+      Stat& stat = stats_.at(id);
+      const size_t num_values = stat.type_ == 2 ? 2 + stat.bounds_.size() : 1;
+      stat.values_.clear();
+      for (size_t value = 0; value < num_values; value++) {
+        stat.values_.push_back(varint());
+      }
+    }
+
+    num_removed_ = varint();
+    id = 0;
+    for (uint64_t i = 0; i < num_removed_; i++) {
+      id += varint();
+      EXPECT_EQ(1UL, stats_.erase(id));
+    }
+    EXPECT_EQ(data_.size(), position_);
+  }
+
+  const Stat& stat(const std::string& name) const {
+    for (const auto& stat : stats_) {
+      if (stat.second.name_ == name) {
+        return stat.second;
+      }
+    }
+    ADD_FAILURE() << "no stat " << name;
+    static const Stat missing{};
+    return missing;
+  }
+
+  uint64_t cursor_{};
+  uint64_t base_{};
+  uint64_t num_strings_{};
+  uint64_t num_stats_{};
+  uint64_t num_values_{};
+  uint64_t num_removed_{};
+  std::vector<std::string> strings_;
+  std::map<uint64_t, Stat> stats_;
+
+private:
+  uint64_t varint() {
+    uint64_t value = 0;
+    for (uint32_t shift = 0;; shift += 7) {
+      const uint8_t byte = data_.at(position_++);
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return value;
+      }
+    }
+  }
+
+  std::string string() {
+    const uint64_t size = varint();
+    std::string value = data_.substr(position_, size);
+    position_ += size;
+    return value;
+  }
+
+  std::string data_;
+  size_t position_{};
+};
+
+class BinaryStatsSnapshotsTest : public testing::Test {
+public:
+  std::shared_ptr<NiceMock<Stats::MockCounter>>
+  addCounter(const std::string& name, const std::string& extracted_name,
+             std::vector<Stats::Tag> tags, uint64_t value) {
+    auto counter = std::make_shared<NiceMock<Stats::MockCounter>>();
+    counter->name_ = name;
+    ON_CALL(*counter, tagExtractedName()).WillByDefault(Return(extracted_name));
+    ON_CALL(*counter, tags()).WillByDefault(Return(tags));
+    ON_CALL(*counter, value()).WillByDefault(Return(value));
+    counters_.push_back(counter);
+    return counter;
+  }
+
+  void addGauge(const std::string& name, uint64_t value) {
+    auto gauge = std::make_shared<NiceMock<Stats::MockGauge>>();
+    gauge->name_ = name;
+    ON_CALL(*gauge, tagExtractedName()).WillByDefault(Return(name));
+    ON_CALL(*gauge, value()).WillByDefault(Return(value));
+    gauges_.push_back(gauge);
+  }
+
+  uint64_t snapshot(uint64_t cursor) {
+    Buffer::OwnedImpl response;
+    const uint64_t new_cursor =
+        snapshots_.encode(cursor, counters_, gauges_, histograms_, response);
+    client_.apply(TestUtility::bufferToString(response));
+    EXPECT_EQ(new_cursor, client_.cursor_);
+    return new_cursor;
+  }
+
+  BinaryStatsSnapshots snapshots_{2};
+  BinaryStatsClient client_;
+  Stats::IsolatedStoreImpl store_;
+  std::list<Stats::CounterSharedPtr> counters_;
+  std::list<Stats::GaugeSharedPtr> gauges_;
+  std::list<Stats::ParentHistogramSharedPtr> histograms_;
+};
+
+TEST_F(BinaryStatsSnapshotsTest, Full) {
+  addCounter("cluster.foo.upstream_rq_total", "cluster.upstream_rq_total",
+             {{"envoy.cluster_name", "foo"}}, 5);
+  addCounter("cluster.bar.upstream_rq_total", "cluster.upstream_rq_total",
+             {{"envoy.cluster_name", "bar"}}, 7);
+  addGauge("server.live", 1);
+
+  EXPECT_EQ(1UL, snapshot(0));
+  EXPECT_EQ(0UL, client_.base_);
+  // The extracted name and tag name are sent once.
+  EXPECT_EQ(5UL, client_.num_strings_);
+  EXPECT_EQ(3UL, client_.num_stats_);
+  EXPECT_EQ(3UL, client_.num_values_);
+
+  const BinaryStatsClient::Stat& foo = client_.stat("cluster.foo.upstream_rq_total");
+  EXPECT_EQ(0UL, foo.type_);
+  EXPECT_EQ("cluster.upstream_rq_total", foo.extracted_name_);
+  ASSERT_EQ(1, foo.tags_.size());
+  EXPECT_EQ("envoy.cluster_name", foo.tags_[0].name_);
+  EXPECT_EQ("foo", foo.tags_[0].value_);
+  EXPECT_EQ(std::vector<uint64_t>{5}, foo.values_);
+  EXPECT_EQ(std::vector<uint64_t>{7}, client_.stat("cluster.bar.upstream_rq_total").values_);
+  EXPECT_EQ(1UL, client_.stat("server.live").type_);
+  EXPECT_EQ(std::vector<uint64_t>{1}, client_.stat("server.live").values_);
+}
+
+TEST_F(BinaryStatsSnapshotsTest, Delta) {
+  auto foo = addCounter("cluster.foo.upstream_rq_total", "cluster.upstream_rq_total",
+                        {{"envoy.cluster_name", "foo"}}, 5);
+  addCounter("cluster.bar.upstream_rq_total", "cluster.upstream_rq_total",
+             {{"envoy.cluster_name", "bar"}}, 7);
+  addGauge("server.live", 1);
+  uint64_t cursor = snapshot(0);
+
+  // Nothing changed.
+  cursor = snapshot(cursor);
+  EXPECT_EQ(1UL, client_.base_);
+  EXPECT_EQ(0UL, client_.num_strings_);
+  EXPECT_EQ(0UL, client_.num_stats_);
+  EXPECT_EQ(0UL, client_.num_values_);
+  EXPECT_EQ(0UL, client_.num_removed_);
+
+  // Only the changed, added and removed stats are sent.
+  ON_CALL(*foo, value()).WillByDefault(Return(6));
+  addCounter("cluster.baz.upstream_rq_total", "cluster.upstream_rq_total",
+             {{"envoy.cluster_name", "baz"}}, 1);
+  gauges_.clear();
+  cursor = snapshot(cursor);
+  EXPECT_EQ(2UL, client_.base_);
+  EXPECT_EQ(1UL, client_.num_strings_);
+  EXPECT_EQ(1UL, client_.num_stats_);
+  EXPECT_EQ(2UL, client_.num_values_);
+  EXPECT_EQ(1UL, client_.num_removed_);
+  EXPECT_EQ(3UL, client_.stats_.size());
+  EXPECT_EQ(std::vector<uint64_t>{6}, client_.stat("cluster.foo.upstream_rq_total").values_);
+  EXPECT_EQ(std::vector<uint64_t>{7}, client_.stat("cluster.bar.upstream_rq_total").values_);
+  EXPECT_EQ("baz", client_.stat("cluster.baz.upstream_rq_total").tags_[0].value_);
+
+  // A stat that comes back while a kept snapshot still has it keeps its id but is defined again.
+  addGauge("server.live", 0);
+  snapshot(cursor);
+  EXPECT_EQ(0UL, client_.num_strings_);
+  EXPECT_EQ(1UL, client_.num_stats_);
+  EXPECT_EQ(1UL, client_.num_values_);
+  EXPECT_EQ(std::vector<uint64_t>{0}, client_.stat("server.live").values_);
+}
+
+TEST_F(BinaryStatsSnapshotsTest, UnknownCursor) {
+  addGauge("server.live", 1);
+  const uint64_t cursor = snapshot(0);
+  snapshot(cursor);
+  snapshot(cursor + 1);
+
+  // Only the last two snapshots are kept.
+  snapshot(cursor);
+  EXPECT_EQ(0UL, client_.base_);
+  EXPECT_EQ(1UL, client_.num_stats_);
+  snapshot(100);
+  EXPECT_EQ(0UL, client_.base_);
+  EXPECT_EQ(1UL, client_.num_values_);
+}
+
+TEST_F(BinaryStatsSnapshotsTest, ExpiredStatIds) {
+  addGauge("server.live", 1);
+  uint64_t cursor = snapshot(0);
+  const uint64_t live_id = client_.stats_.begin()->first;
+
+  // Once no kept snapshot has the stat, its id is given to the next new stat.
+  gauges_.clear();
+  cursor = snapshot(cursor);
+  cursor = snapshot(cursor);
+  EXPECT_TRUE(client_.stats_.empty());
+  addCounter("cluster.foo.upstream_rq_total", "cluster.upstream_rq_total", {}, 5);
+  cursor = snapshot(cursor);
+  ASSERT_EQ(1UL, client_.stats_.size());
+  EXPECT_EQ(live_id, client_.stats_.begin()->first);
+  EXPECT_EQ(0UL, client_.stat("cluster.foo.upstream_rq_total").type_);
+
+  // A stat that comes back after that is defined again with a new id.
+  addGauge("server.live", 0);
+  snapshot(cursor);
+  EXPECT_EQ(1UL, client_.num_stats_);
+  EXPECT_EQ(2UL, client_.stats_.size());
+  EXPECT_EQ(std::vector<uint64_t>{0}, client_.stat("server.live").values_);
+}
+
+// Stats of the stores are looked up by their encoded names.
+TEST_F(BinaryStatsSnapshotsTest, StoreStats) {
+  store_.counter("cluster.foo.upstream_rq_total").add(5);
+  store_.gauge("server.live").set(1);
+  counters_ = store_.counters();
+  gauges_ = store_.gauges();
+
+  uint64_t cursor = snapshot(0);
+  EXPECT_EQ(2UL, client_.num_stats_);
+  EXPECT_EQ(std::vector<uint64_t>{5}, client_.stat("cluster.foo.upstream_rq_total").values_);
+
+  store_.counter("cluster.foo.upstream_rq_total").inc();
+  cursor = snapshot(cursor);
+  EXPECT_EQ(0UL, client_.num_stats_);
+  EXPECT_EQ(1UL, client_.num_values_);
+  EXPECT_EQ(std::vector<uint64_t>{6}, client_.stat("cluster.foo.upstream_rq_total").values_);
+  EXPECT_EQ(std::vector<uint64_t>{1}, client_.stat("server.live").values_);
+}
+
+TEST_F(BinaryStatsSnapshotsTest, Histograms) {
+  auto histogram = std::make_shared<NiceMock<Stats::MockParentHistogram>>();
+  histogram->name_ = "cluster.foo.upstream_rq_time";
+  ON_CALL(*histogram, tagExtractedName()).WillByDefault(Return("cluster.upstream_rq_time"));
+  Stats::LogLinearHistogram values;
+  values.recordValue(5);
+  values.recordValue(50);
+  histogram->cumulative_statistics_.refresh(values);
+  histograms_.push_back(histogram);
+
+  const uint64_t cursor = snapshot(0);
+  const BinaryStatsClient::Stat& stat = client_.stat("cluster.foo.upstream_rq_time");
+  EXPECT_EQ(2UL, stat.type_);
+  EXPECT_EQ(histogram->cumulative_statistics_.supportedBuckets(), stat.bounds_);
+  ASSERT_EQ(2 + stat.bounds_.size(), stat.values_.size());
+  EXPECT_EQ(2UL, stat.values_[0]);
+  EXPECT_EQ(55UL, stat.values_[1]);
+  EXPECT_EQ(histogram->cumulative_statistics_.computedBuckets(),
+            std::vector<uint64_t>(stat.values_.begin() + 2, stat.values_.end()));
+
+  snapshot(cursor);
+  EXPECT_EQ(0UL, client_.num_values_);
+  values.recordValue(500);
+  histogram->cumulative_statistics_.refresh(values);
+  snapshot(cursor + 1);
+  EXPECT_EQ(1UL, client_.num_values_);
+  EXPECT_EQ(3UL, client_.stat("cluster.foo.upstream_rq_time").values_[0]);
+}
+
 } // namespace Server
 } // namespace Envoy
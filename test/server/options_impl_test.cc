@@ -20,7 +20,9 @@ std::unique_ptr<OptionsImpl> createOptionsImpl(const std::string& args) {
     argv.push_back(s.c_str());
   }
   return std::unique_ptr<OptionsImpl>(new OptionsImpl(argv.size(), const_cast<char**>(&argv[0]),
-                                                      [](uint64_t, uint64_t) { return "1"; },
+                                                      [](uint64_t, uint64_t, uint64_t) {
+                                                        return "1";
+                                                      },
                                                       spdlog::level::warn));
 }
 
@@ -38,12 +40,16 @@ TEST(OptionsImplDeathTest, InvalidCommandLine) {
 
 TEST(OptionsImplTest, All) {
   std::unique_ptr<OptionsImpl> options = createOptionsImpl(
-      "envoy --mode validate --concurrency 2 -c hello --admin-address-path path --restart-epoch 1 "
-      "--local-address-ip-version v6 -l info --service-cluster cluster --service-node node "
-      "--service-zone zone --file-flush-interval-msec 9000 --drain-time-s 60 "
-      "--parent-shutdown-time-s 90 --log-path /foo/bar");
+      "envoy --mode validate --concurrency 2 --health-check-concurrency 3 --config-worker "
+      "-c hello "
+      "--admin-address-path path --restart-epoch 1 --local-address-ip-version v6 -l info "
+      "--service-cluster cluster --service-node node --service-zone zone "
+      "--file-flush-interval-msec 9000 --drain-time-s 60 --parent-shutdown-time-s 90 "
+      "--log-path /foo/bar --stats-name-table-bytes 1000");
   EXPECT_EQ(Server::Mode::Validate, options->mode());
   EXPECT_EQ(2U, options->concurrency());
+  EXPECT_EQ(3U, options->healthCheckConcurrency());
+  EXPECT_TRUE(options->configWorker());
   EXPECT_EQ("hello", options->configPath());
   EXPECT_EQ("path", options->adminAddressPath());
   EXPECT_EQ(Network::Address::IpVersion::v6, options->localAddressIpVersion());
@@ -56,6 +62,7 @@ TEST(OptionsImplTest, All) {
   EXPECT_EQ(std::chrono::milliseconds(9000), options->fileFlushIntervalMsec());
   EXPECT_EQ(std::chrono::seconds(60), options->drainTime());
   EXPECT_EQ(std::chrono::seconds(90), options->parentShutdownTime());
+  EXPECT_EQ(1000U, options->statsNameTableBytes());
 }
 
 TEST(OptionsImplTest, DefaultParams) {
@@ -65,6 +72,13 @@ TEST(OptionsImplTest, DefaultParams) {
   EXPECT_EQ("", options->adminAddressPath());
   EXPECT_EQ(Network::Address::IpVersion::v4, options->localAddressIpVersion());
   EXPECT_EQ(Server::Mode::Serve, options->mode());
+  EXPECT_EQ(0U, options->healthCheckConcurrency());
+  EXPECT_FALSE(options->configWorker());
+  EXPECT_EQ(16384U * 64, options->statsNameTableBytes());
+
+  // The default name table grows with --max-stats.
+  options = createOptionsImpl("envoy -c hello --max-stats 100");
+  EXPECT_EQ(6400U, options->statsNameTableBytes());
 }
 
 TEST(OptionsImplTest, BadCliOption) {
@@ -76,4 +90,9 @@ TEST(OptionsImplTest, BadObjNameLenOption) {
   EXPECT_DEATH(createOptionsImpl("envoy --max-obj-name-len 1"),
                "error: the 'max-obj-name-len' value specified");
 }
+
+TEST(OptionsImplTest, BadStatsNameTableBytesOption) {
+  EXPECT_DEATH(createOptionsImpl("envoy --stats-name-table-bytes 4294967296"),
+               "error: the 'stats-name-table-bytes' value specified");
+}
 } // namespace Envoy
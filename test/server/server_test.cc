@@ -1,5 +1,6 @@
 #include "common/common/version.h"
 #include "common/network/address_impl.h"
+#include "common/stats/thread_local_store.h"
 #include "common/thread_local/thread_local_impl.h"
 
 #include "server/server.h"
@@ -13,6 +14,7 @@
 
 using testing::InSequence;
 using testing::Property;
+using testing::Return;
 using testing::SaveArg;
 using testing::StrictMock;
 using testing::_;
@@ -34,7 +36,37 @@ TEST(ServerInstanceUtil, flushHelper) {
 
   std::list<Stats::SinkPtr> sinks;
   sinks.emplace_back(std::move(sink));
-  InstanceUtil::flushCountersAndGaugesToSinks(sinks, store);
+  InstanceUtil::flushMetricsToSinks(sinks, store);
+}
+
+TEST(ServerInstanceUtil, flushHistograms) {
+  InSequence s;
+
+  NiceMock<Stats::MockStore> store;
+  std::shared_ptr<NiceMock<Stats::MockParentHistogram>> used(
+      new NiceMock<Stats::MockParentHistogram>());
+  used->name_ = "used";
+  used->used_ = true;
+  std::shared_ptr<NiceMock<Stats::MockParentHistogram>> unused(
+      new NiceMock<Stats::MockParentHistogram>());
+  unused->name_ = "unused";
+  ON_CALL(store, histograms())
+      .WillByDefault(Return(std::list<Stats::ParentHistogramSharedPtr>{used, unused}));
+
+  std::unique_ptr<Stats::MockSink> sink(new StrictMock<Stats::MockSink>());
+  Stats::MockSink* raw_sink = sink.get();
+  EXPECT_CALL(*sink, beginFlush());
+  EXPECT_CALL(*sink, flushHistogram(Property(&Stats::Metric::name, "used")));
+  EXPECT_CALL(*sink, endFlush());
+
+  std::list<Stats::SinkPtr> sinks;
+  sinks.emplace_back(std::move(sink));
+  InstanceUtil::flushHistogramsToSinks(sinks, store);
+
+  // Counters and gauges are flushed without the histograms.
+  EXPECT_CALL(*raw_sink, beginFlush());
+  EXPECT_CALL(*raw_sink, endFlush());
+  InstanceUtil::flushMetricsToSinks(sinks, store);
 }
 
 class RunHelperTest : public testing::Test {
@@ -90,7 +122,9 @@ class ServerInstanceImplTest : public testing::TestWithParam<Network::Address::I
 protected:
   ServerInstanceImplTest() : version_(GetParam()) {}
 
-  void initialize(const std::string& bootstrap_path) {
+  void initialize(const std::string& bootstrap_path) { initialize(bootstrap_path, stats_store_); }
+
+  void initialize(const std::string& bootstrap_path, Stats::StoreRoot& stats_store) {
     if (bootstrap_path.empty()) {
       options_.config_path_ = TestEnvironment::temporaryFileSubstitute(
           "test/config/integration/server.json", {{"upstream_0", 0}, {"upstream_1", 0}}, version_);
@@ -101,7 +135,7 @@ protected:
     server_.reset(new InstanceImpl(
         options_,
         Network::Address::InstanceConstSharedPtr(new Network::Address::Ipv4Instance("127.0.0.1")),
-        hooks_, restart_, stats_store_, fakelock_, component_factory_, thread_local_));
+        hooks_, restart_, stats_store, fakelock_, component_factory_, thread_local_));
 
     EXPECT_TRUE(server_->api().fileExists("/dev/null"));
   }
@@ -110,6 +144,9 @@ protected:
     server_->threadLocal().shutdownGlobalThreading();
     server_->clusterManager().shutdown();
     server_->threadLocal().shutdownThread();
+    if (thread_local_stats_store_) {
+      thread_local_stats_store_->shutdownThreading();
+    }
   }
 
   Network::Address::IpVersion version_;
@@ -118,6 +155,8 @@ protected:
   testing::NiceMock<MockHotRestart> restart_;
   ThreadLocal::InstanceImpl thread_local_;
   Stats::TestIsolatedStoreImpl stats_store_;
+  Stats::HeapRawStatDataAllocator stats_allocator_;
+  std::unique_ptr<Stats::ThreadLocalStoreImpl> thread_local_stats_store_;
   Thread::MutexBasicLockable fakelock_;
   TestComponentFactory component_factory_;
   std::unique_ptr<InstanceImpl> server_;
@@ -137,6 +176,23 @@ TEST_P(ServerInstanceImplTest, Stats) {
   EXPECT_NE(nullptr, TestUtility::findCounter(stats_store_, "server.watchdog_miss"));
 }
 
+// The health check state is kept in the server.live gauge, which must keep working when the
+// stats matcher keeps it from being exported.
+TEST_P(ServerInstanceImplTest, RejectedLiveGauge) {
+  options_.service_cluster_name_ = "some_cluster_name";
+  options_.service_node_name_ = "some_node_name";
+  options_.stats_exclusions_ = {"prefix:server."};
+  thread_local_stats_store_.reset(new Stats::ThreadLocalStoreImpl(stats_allocator_));
+  initialize(std::string(), *thread_local_stats_store_);
+  EXPECT_EQ(nullptr, TestUtility::findGauge(*thread_local_stats_store_, "server.live"));
+
+  EXPECT_FALSE(server_->healthCheckFailed());
+  server_->failHealthcheck(true);
+  EXPECT_TRUE(server_->healthCheckFailed());
+  server_->failHealthcheck(false);
+  EXPECT_FALSE(server_->healthCheckFailed());
+}
+
 // Validate server localInfo() from bootstrap Node.
 TEST_P(ServerInstanceImplTest, BootstrapNode) {
   initialize("test/server/node_bootstrap.yaml");